@@ -34,6 +34,11 @@
 // #include <iostream>
 // #include <fstream>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include "ALICE3/Core/DelphesO2TrackSmearer.h"
 
 namespace o2
@@ -43,6 +48,55 @@ namespace delphes
 
 /*****************************************************************/
 
+TrackSmearer::~TrackSmearer()
+{
+  for (unsigned int ipdg = 0; ipdg < nLUTs; ++ipdg) {
+    unloadTable(ipdg);
+  }
+}
+
+/*****************************************************************/
+
+void TrackSmearer::unloadTable(int ipdg)
+{
+  delete mLUTHeader[ipdg];
+  mLUTHeader[ipdg] = nullptr;
+  mLUTEntry[ipdg] = nullptr;
+  std::vector<lutEntry_t>().swap(mLUTStorage[ipdg]);
+  if (mMappedFile[ipdg]) {
+    munmap(mMappedFile[ipdg], mMappedSize[ipdg]);
+    mMappedFile[ipdg] = nullptr;
+    mMappedSize[ipdg] = 0;
+  }
+}
+
+/*****************************************************************/
+
+bool TrackSmearer::mapTable(int ipdg, const char* filename, std::size_t size)
+{
+  int fileDescriptor = open(filename, O_RDONLY);
+  if (fileDescriptor < 0) {
+    return false;
+  }
+  struct stat fileStatus;
+  if (fstat(fileDescriptor, &fileStatus) != 0 || static_cast<std::size_t>(fileStatus.st_size) < size) {
+    close(fileDescriptor);
+    return false;
+  }
+  // private writable mapping: the pages are shared with the other processes mapping the file as long as they are not modified
+  void* address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileDescriptor, 0);
+  close(fileDescriptor);
+  if (address == MAP_FAILED) {
+    return false;
+  }
+  mMappedFile[ipdg] = address;
+  mMappedSize[ipdg] = size;
+  mLUTEntry[ipdg] = reinterpret_cast<lutEntry_t*>(static_cast<char*>(address) + sizeof(lutHeader_t));
+  return true;
+}
+
+/*****************************************************************/
+
 bool TrackSmearer::loadTable(int pdg, const char* filename, bool forceReload)
 {
   auto ipdg = getIndexPDG(pdg);
@@ -50,57 +104,53 @@ bool TrackSmearer::loadTable(int pdg, const char* filename, bool forceReload)
     std::cout << " --- LUT table for PDG " << pdg << " has been already loaded with index " << ipdg << std::endl;
     return false;
   }
+  unloadTable(ipdg);
   mLUTHeader[ipdg] = new lutHeader_t;
 
   std::ifstream lutFile(filename, std::ifstream::binary);
   if (!lutFile.is_open()) {
     std::cout << " --- cannot open covariance matrix file for PDG " << pdg << ": " << filename << std::endl;
-    delete mLUTHeader[ipdg];
-    mLUTHeader[ipdg] = nullptr;
+    unloadTable(ipdg);
     return false;
   }
   lutFile.read(reinterpret_cast<char*>(mLUTHeader[ipdg]), sizeof(lutHeader_t));
   if (lutFile.gcount() != sizeof(lutHeader_t)) {
     std::cout << " --- troubles reading covariance matrix header for PDG " << pdg << ": " << filename << std::endl;
-    delete mLUTHeader[ipdg];
-    mLUTHeader[ipdg] = nullptr;
+    unloadTable(ipdg);
     return false;
   }
   if (mLUTHeader[ipdg]->version != LUTCOVM_VERSION) {
     std::cout << " --- LUT header version mismatch: expected/detected = " << LUTCOVM_VERSION << "/" << mLUTHeader[ipdg]->version << std::endl;
-    delete mLUTHeader[ipdg];
-    mLUTHeader[ipdg] = nullptr;
+    unloadTable(ipdg);
     return false;
   }
   if (mLUTHeader[ipdg]->pdg != pdg) {
     std::cout << " --- LUT header PDG mismatch: expected/detected = " << pdg << "/" << mLUTHeader[ipdg]->pdg << std::endl;
-    delete mLUTHeader[ipdg];
-    mLUTHeader[ipdg] = nullptr;
+    unloadTable(ipdg);
     return false;
   }
-  const int nnch = mLUTHeader[ipdg]->nchmap.nbins;
-  const int nrad = mLUTHeader[ipdg]->radmap.nbins;
-  const int neta = mLUTHeader[ipdg]->etamap.nbins;
-  const int npt = mLUTHeader[ipdg]->ptmap.nbins;
-  mLUTEntry[ipdg] = new lutEntry_t****[nnch];
-  for (int inch = 0; inch < nnch; ++inch) {
-    mLUTEntry[ipdg][inch] = new lutEntry_t***[nrad];
-    for (int irad = 0; irad < nrad; ++irad) {
-      mLUTEntry[ipdg][inch][irad] = new lutEntry_t**[neta];
-      for (int ieta = 0; ieta < neta; ++ieta) {
-        mLUTEntry[ipdg][inch][irad][ieta] = new lutEntry_t*[npt];
-        for (int ipt = 0; ipt < npt; ++ipt) {
-          mLUTEntry[ipdg][inch][irad][ieta][ipt] = new lutEntry_t;
-          lutFile.read(reinterpret_cast<char*>(mLUTEntry[ipdg][inch][irad][ieta][ipt]), sizeof(lutEntry_t));
-          if (lutFile.gcount() != sizeof(lutEntry_t)) {
-            std::cout << " --- troubles reading covariance matrix entry for PDG " << pdg << ": " << filename << std::endl;
-            return false;
-          }
-        }
-      }
+  const std::size_t nnch = mLUTHeader[ipdg]->nchmap.nbins;
+  const std::size_t nrad = mLUTHeader[ipdg]->radmap.nbins;
+  const std::size_t neta = mLUTHeader[ipdg]->etamap.nbins;
+  const std::size_t npt = mLUTHeader[ipdg]->ptmap.nbins;
+  mLUTStride[ipdg][2] = npt;
+  mLUTStride[ipdg][1] = neta * mLUTStride[ipdg][2];
+  mLUTStride[ipdg][0] = nrad * mLUTStride[ipdg][1];
+  const std::size_t nEntries = nnch * mLUTStride[ipdg][0];
+
+  // the entries follow the header in the file, in the order of the flat table
+  static_assert(sizeof(lutHeader_t) % alignof(lutEntry_t) == 0, "LUT entries not aligned in the LUT file");
+  if (!mUseMemoryMapping || !mapTable(ipdg, filename, sizeof(lutHeader_t) + nEntries * sizeof(lutEntry_t))) {
+    mLUTStorage[ipdg].resize(nEntries);
+    lutFile.read(reinterpret_cast<char*>(mLUTStorage[ipdg].data()), nEntries * sizeof(lutEntry_t));
+    if (static_cast<std::size_t>(lutFile.gcount()) != nEntries * sizeof(lutEntry_t)) {
+      std::cout << " --- troubles reading covariance matrix entry for PDG " << pdg << ": " << filename << std::endl;
+      unloadTable(ipdg);
+      return false;
     }
+    mLUTEntry[ipdg] = mLUTStorage[ipdg].data();
   }
-  std::cout << " --- read covariance matrix table for PDG " << pdg << ": " << filename << std::endl;
+  std::cout << " --- read covariance matrix table for PDG " << pdg << ": " << filename << (mMappedFile[ipdg] ? " (memory-mapped)" : "") << std::endl;
   mLUTHeader[ipdg]->print();
 
   lutFile.close();
@@ -119,54 +169,43 @@ lutEntry_t*
   auto irad = mLUTHeader[ipdg]->radmap.find(radius);
   auto ieta = mLUTHeader[ipdg]->etamap.find(eta);
   auto ipt = mLUTHeader[ipdg]->ptmap.find(pt);
+  lutEntry_t* lutEntry = mLUTEntry[ipdg] + inch * mLUTStride[ipdg][0] + irad * mLUTStride[ipdg][1] + ieta * mLUTStride[ipdg][2] + ipt;
+  if (mWhatEfficiency != 1 && mWhatEfficiency != 2)
+    return lutEntry;
+  const bool useEff2 = (mWhatEfficiency == 2);
+  const float eff = useEff2 ? lutEntry->eff2 : lutEntry->eff;
+  if (!mInterpolateEfficiency) {
+    interpolatedEff = eff;
+    return lutEntry;
+  }
 
-  // Interpolate if requested
+  // Interpolate with the neighbouring nch bin on the side of nch, if any
   auto fraction = mLUTHeader[ipdg]->nchmap.fracPositionWithinBin(nch);
-  if (mInterpolateEfficiency) {
-    if (fraction > 0.5) {
-      if (mWhatEfficiency == 1) {
-        if (inch < mLUTHeader[ipdg]->nchmap.nbins - 1) {
-          interpolatedEff = (1.5f - fraction) * mLUTEntry[ipdg][inch][irad][ieta][ipt]->eff + (-0.5f + fraction) * mLUTEntry[ipdg][inch + 1][irad][ieta][ipt]->eff;
-        } else {
-          interpolatedEff = mLUTEntry[ipdg][inch][irad][ieta][ipt]->eff;
-        }
-      }
-      if (mWhatEfficiency == 2) {
-        if (inch < mLUTHeader[ipdg]->nchmap.nbins - 1) {
-          interpolatedEff = (1.5f - fraction) * mLUTEntry[ipdg][inch][irad][ieta][ipt]->eff2 + (-0.5f + fraction) * mLUTEntry[ipdg][inch + 1][irad][ieta][ipt]->eff2;
-        } else {
-          interpolatedEff = mLUTEntry[ipdg][inch][irad][ieta][ipt]->eff2;
-        }
-      }
-    } else {
-      float comparisonValue = mLUTHeader[ipdg]->nchmap.log ? log10(nch) : nch;
-      if (mWhatEfficiency == 1) {
-        if (inch > 0 && comparisonValue < mLUTHeader[ipdg]->nchmap.max) {
-          interpolatedEff = (0.5f + fraction) * mLUTEntry[ipdg][inch][irad][ieta][ipt]->eff + (0.5f - fraction) * mLUTEntry[ipdg][inch - 1][irad][ieta][ipt]->eff;
-        } else {
-          interpolatedEff = mLUTEntry[ipdg][inch][irad][ieta][ipt]->eff;
-        }
-      }
-      if (mWhatEfficiency == 2) {
-        if (inch > 0 && comparisonValue < mLUTHeader[ipdg]->nchmap.max) {
-          interpolatedEff = (0.5f + fraction) * mLUTEntry[ipdg][inch][irad][ieta][ipt]->eff2 + (0.5f - fraction) * mLUTEntry[ipdg][inch - 1][irad][ieta][ipt]->eff2;
-        } else {
-          interpolatedEff = mLUTEntry[ipdg][inch][irad][ieta][ipt]->eff2;
-        }
-      }
-    }
-  } else {
-    if (mWhatEfficiency == 1)
-      interpolatedEff = mLUTEntry[ipdg][inch][irad][ieta][ipt]->eff;
-    if (mWhatEfficiency == 2)
-      interpolatedEff = mLUTEntry[ipdg][inch][irad][ieta][ipt]->eff2;
-  }
-  return mLUTEntry[ipdg][inch][irad][ieta][ipt];
+  float comparisonValue = mLUTHeader[ipdg]->nchmap.log ? log10(nch) : nch;
+  const bool isUpperHalf = (fraction > 0.5);
+  const bool hasNeighbour = isUpperHalf ? (inch < mLUTHeader[ipdg]->nchmap.nbins - 1) : (inch > 0 && comparisonValue < mLUTHeader[ipdg]->nchmap.max);
+  const lutEntry_t* neighbour = hasNeighbour ? (isUpperHalf ? lutEntry + mLUTStride[ipdg][0] : lutEntry - mLUTStride[ipdg][0]) : lutEntry;
+  const float effNeighbour = useEff2 ? neighbour->eff2 : neighbour->eff;
+  const float weight = isUpperHalf ? (1.5f - fraction) : (0.5f + fraction);
+  const float weightNeighbour = isUpperHalf ? (-0.5f + fraction) : (0.5f - fraction);
+  const float effInterpolated = weight * eff + weightNeighbour * effNeighbour;
+  interpolatedEff = hasNeighbour ? effInterpolated : eff;
+  return lutEntry;
 } //;
 
 /*****************************************************************/
 
-bool TrackSmearer::smearTrack(O2Track& o2track, lutEntry_t* lutEntry, float interpolatedEff)
+namespace
+{
+// random numbers of the global ROOT generator
+struct GlobalRandom {
+  double uniform() { return gRandom->Uniform(); }
+  double gaus(double mean, double sigma) { return gRandom->Gaus(mean, sigma); }
+};
+} // namespace
+
+template <typename TRandomGenerator>
+bool TrackSmearer::smearTrackWithGenerator(O2Track& o2track, lutEntry_t* lutEntry, float interpolatedEff, TRandomGenerator& generator)
 {
   bool isReconstructed = true;
   // generate efficiency
@@ -178,7 +217,7 @@ bool TrackSmearer::smearTrack(O2Track& o2track, lutEntry_t* lutEntry, float inte
       eff = lutEntry->eff2;
     if (mInterpolateEfficiency)
       eff = interpolatedEff;
-    if (gRandom->Uniform() > eff)
+    if (generator.uniform() > eff)
       isReconstructed = false;
   }
 
@@ -192,7 +231,7 @@ bool TrackSmearer::smearTrack(O2Track& o2track, lutEntry_t* lutEntry, float inte
     double val = 0.;
     for (int j = 0; j < 5; ++j)
       val += lutEntry->eigvec[j][i] * o2track.getParam(j);
-    params_[i] = gRandom->Gaus(val, sqrt(lutEntry->eigval[i]));
+    params_[i] = generator.gaus(val, sqrt(lutEntry->eigval[i]));
   }
   // transform back params vector
   for (int i = 0; i < 5; ++i) {
@@ -213,7 +252,8 @@ bool TrackSmearer::smearTrack(O2Track& o2track, lutEntry_t* lutEntry, float inte
 
 /*****************************************************************/
 
-bool TrackSmearer::smearTrack(O2Track& o2track, int pdg, float nch)
+template <typename TRandomGenerator>
+bool TrackSmearer::smearTrackWithGenerator(O2Track& o2track, int pdg, float nch, TRandomGenerator& generator)
 {
 
   auto pt = o2track.getPt();
@@ -225,7 +265,31 @@ bool TrackSmearer::smearTrack(O2Track& o2track, int pdg, float nch)
   auto lutEntry = getLUTEntry(pdg, nch, 0., eta, pt, interpolatedEff);
   if (!lutEntry || !lutEntry->valid)
     return false;
-  return smearTrack(o2track, lutEntry, interpolatedEff);
+  return smearTrackWithGenerator(o2track, lutEntry, interpolatedEff, generator);
+}
+
+/*****************************************************************/
+
+bool TrackSmearer::smearTrack(O2Track& o2track, lutEntry_t* lutEntry, float interpolatedEff)
+{
+  GlobalRandom generator;
+  return smearTrackWithGenerator(o2track, lutEntry, interpolatedEff, generator);
+}
+
+bool TrackSmearer::smearTrack(O2Track& o2track, lutEntry_t* lutEntry, float interpolatedEff, CounterBasedRandom& generator)
+{
+  return smearTrackWithGenerator(o2track, lutEntry, interpolatedEff, generator);
+}
+
+bool TrackSmearer::smearTrack(O2Track& o2track, int pdg, float nch)
+{
+  GlobalRandom generator;
+  return smearTrackWithGenerator(o2track, pdg, nch, generator);
+}
+
+bool TrackSmearer::smearTrack(O2Track& o2track, int pdg, float nch, CounterBasedRandom& generator)
+{
+  return smearTrackWithGenerator(o2track, pdg, nch, generator);
 }
 
 /*****************************************************************/
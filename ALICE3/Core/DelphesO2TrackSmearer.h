@@ -24,9 +24,13 @@
 #ifndef ALICE3_CORE_DELPHESO2TRACKSMEARER_H_
 #define ALICE3_CORE_DELPHESO2TRACKSMEARER_H_
 
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
 #include <map>
 #include <iostream>
 #include <fstream>
+#include <vector>
 
 #include "TRandom.h"
 #include "ReconstructionDataFormats/Track.h"
@@ -168,15 +172,120 @@ namespace o2
 namespace delphes
 {
 
+/// Counter-based random number generator (Philox4x32-10, Salmon et al., SC11).
+/// The numbers only depend on the key (seed, event, particle) and on the number of previous draws,
+/// so that the particles can be smeared in any order, or in parallel, with reproducible results.
+class CounterBasedRandom
+{
+ public:
+  CounterBasedRandom(uint64_t seed, uint64_t event, uint64_t particle)
+    : mKey{static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32)},
+      mCounter{0u, static_cast<uint32_t>(particle), static_cast<uint32_t>(event), static_cast<uint32_t>(event >> 32) ^ static_cast<uint32_t>(particle >> 32)}
+  {
+  }
+
+  /// \return uniform random number in ]0, 1[
+  double uniform()
+  {
+    if (mNextWord == 4) {
+      generateBlock();
+    }
+    const uint64_t bits = (static_cast<uint64_t>(mBlock[mNextWord]) << 32) | mBlock[mNextWord + 1];
+    mNextWord += 2;
+    return ((bits >> 11) + 0.5) * 0x1.0p-53;
+  }
+
+  /// \return gaussian random number (Box-Muller method)
+  double gaus(double mean, double sigma)
+  {
+    if (mHasSpareGaus) {
+      mHasSpareGaus = false;
+      return mean + sigma * mSpareGaus;
+    }
+    const double radius = std::sqrt(-2. * std::log(uniform()));
+    const double phi = 2. * M_PI * uniform();
+    mSpareGaus = radius * std::sin(phi);
+    mHasSpareGaus = true;
+    return mean + sigma * radius * std::cos(phi);
+  }
+
+  /// Philox4x32-10 block function
+  /// \param counterIn is the counter
+  /// \param keyIn is the key
+  /// \param output is filled with the four random words of the block
+  static void philox4x32x10(const uint32_t counterIn[4], const uint32_t keyIn[2], uint32_t output[4])
+  {
+    uint32_t counter[4] = {counterIn[0], counterIn[1], counterIn[2], counterIn[3]};
+    uint32_t key[2] = {keyIn[0], keyIn[1]};
+    for (int iRound = 0; iRound < 10; ++iRound) {
+      const uint64_t product0 = static_cast<uint64_t>(0xD2511F53u) * counter[0];
+      const uint64_t product1 = static_cast<uint64_t>(0xCD9E8D57u) * counter[2];
+      const uint32_t next[4] = {static_cast<uint32_t>(product1 >> 32) ^ counter[1] ^ key[0], static_cast<uint32_t>(product1),
+                                static_cast<uint32_t>(product0 >> 32) ^ counter[3] ^ key[1], static_cast<uint32_t>(product0)};
+      for (int iWord = 0; iWord < 4; ++iWord) {
+        counter[iWord] = next[iWord];
+      }
+      key[0] += 0x9E3779B9u;
+      key[1] += 0xBB67AE85u;
+    }
+    for (int iWord = 0; iWord < 4; ++iWord) {
+      output[iWord] = counter[iWord];
+    }
+  }
+
+  /// Known-answer test of the block function, with the reference vectors of Random123 (kat_vectors)
+  /// \return true if the reference outputs are reproduced, which guarantees the reproducibility of the smearing
+  static bool checkKnownAnswers()
+  {
+    struct KnownAnswer {
+      uint32_t counter[4];
+      uint32_t key[2];
+      uint32_t output[4];
+    };
+    constexpr KnownAnswer knownAnswers[] = {
+      {{0x00000000u, 0x00000000u, 0x00000000u, 0x00000000u}, {0x00000000u, 0x00000000u}, {0x6627e8d5u, 0xe169c58du, 0xbc57ac4cu, 0x9b00dbd8u}},
+      {{0xffffffffu, 0xffffffffu, 0xffffffffu, 0xffffffffu}, {0xffffffffu, 0xffffffffu}, {0x408f276du, 0x41c83b0eu, 0xa20bc7c6u, 0x6d5451fdu}},
+      {{0x243f6a88u, 0x85a308d3u, 0x13198a2eu, 0x03707344u}, {0xa4093822u, 0x299f31d0u}, {0xd16cfe09u, 0x94fdccebu, 0x5001e420u, 0x24126ea1u}}};
+    for (const auto& knownAnswer : knownAnswers) {
+      uint32_t output[4];
+      philox4x32x10(knownAnswer.counter, knownAnswer.key, output);
+      for (int iWord = 0; iWord < 4; ++iWord) {
+        if (output[iWord] != knownAnswer.output[iWord]) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+ private:
+  void generateBlock()
+  {
+    philox4x32x10(mCounter, mKey, mBlock);
+    ++mCounter[0];
+    mNextWord = 0;
+  }
+
+  uint32_t mKey[2];
+  uint32_t mCounter[4];
+  uint32_t mBlock[4] = {0u};
+  int mNextWord = 4; // next unused word of the block, 4 if the block is used up
+  double mSpareGaus = 0.;
+  bool mHasSpareGaus = false;
+};
+
 class TrackSmearer
 {
 
  public:
   TrackSmearer() = default;
-  ~TrackSmearer() = default;
+  ~TrackSmearer();
+  TrackSmearer(const TrackSmearer&) = delete;
+  TrackSmearer& operator=(const TrackSmearer&) = delete;
 
   /** LUT methods **/
   bool loadTable(int pdg, const char* filename, bool forceReload = false);
+  void useMemoryMapping(bool val) { mUseMemoryMapping = val; }                //;
   void useEfficiency(bool val) { mUseEfficiency = val; }                      //;
   void interpolateEfficiency(bool val) { mInterpolateEfficiency = val; }      //;
   void skipUnreconstructed(bool val) { mSkipUnreconstructed = val; }          //;
@@ -186,6 +295,9 @@ class TrackSmearer
 
   bool smearTrack(O2Track& o2track, lutEntry_t* lutEntry, float interpolatedEff);
   bool smearTrack(O2Track& o2track, int pdg, float nch);
+  // thread-safe versions, with the random numbers of the given generator instead of gRandom
+  bool smearTrack(O2Track& o2track, lutEntry_t* lutEntry, float interpolatedEff, CounterBasedRandom& generator);
+  bool smearTrack(O2Track& o2track, int pdg, float nch, CounterBasedRandom& generator);
   // bool smearTrack(Track& track, bool atDCA = true); // Only in DelphesO2
   double getPtRes(int pdg, float nch, float eta, float pt);
   double getEtaRes(int pdg, float nch, float eta, float pt);
@@ -222,12 +334,26 @@ class TrackSmearer
  protected:
   static constexpr unsigned int nLUTs = 8; // Number of LUT available
   lutHeader_t* mLUTHeader[nLUTs] = {nullptr};
-  lutEntry_t***** mLUTEntry[nLUTs] = {nullptr};
+  // the entries of a LUT are stored in a flat table, ordered by nch, radius, eta and pt bins as in the LUT file
+  lutEntry_t* mLUTEntry[nLUTs] = {nullptr};
+  std::size_t mLUTStride[nLUTs][3] = {{0}};   // distance between consecutive nch, radius and eta bins in the flat table
+  std::vector<lutEntry_t> mLUTStorage[nLUTs]; // flat table, if read from the file
+  void* mMappedFile[nLUTs] = {nullptr};       // LUT file, if memory-mapped
+  std::size_t mMappedSize[nLUTs] = {0};       // size of the memory-mapped LUT file
+  bool mUseMemoryMapping = true;              // memory-map the LUT files, so that the processes using the same file share the memory
   bool mUseEfficiency = true;
   bool mInterpolateEfficiency = false;
   bool mSkipUnreconstructed = true; // don't smear tracks that are not reco'ed
   int mWhatEfficiency = 1;
   float mdNdEta = 1600.;
+
+ private:
+  bool mapTable(int ipdg, const char* filename, std::size_t size);
+  void unloadTable(int ipdg);
+  template <typename TRandomGenerator>
+  bool smearTrackWithGenerator(O2Track& o2track, lutEntry_t* lutEntry, float interpolatedEff, TRandomGenerator& generator);
+  template <typename TRandomGenerator>
+  bool smearTrackWithGenerator(O2Track& o2track, int pdg, float nch, TRandomGenerator& generator);
 };
 
 } // namespace delphes
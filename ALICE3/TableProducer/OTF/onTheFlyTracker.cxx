@@ -23,7 +23,10 @@
 /// \author Roberto Preghenella preghenella@bo.infn.it
 ///
 
+#include <algorithm>
+#include <memory>
 #include <utility>
+#include <vector>
 
 #include <TGeoGlobalMagField.h>
 
@@ -42,6 +45,7 @@
 #include "SimulationDataFormat/InteractionSampler.h"
 #include "Field/MagneticField.h"
 
+#include "Common/Core/WorkerPool.h"
 #include "ALICE3/Core/DelphesO2TrackSmearer.h"
 #include "ALICE3/DataModel/collisionAlice3.h"
 #include "ALICE3/DataModel/tracksAlice3.h"
@@ -74,6 +78,10 @@ struct OnTheFlyTracker {
   Configurable<bool> enableNucleiSmearing{"enableNucleiSmearing", false, "Enable smearing of nuclei"};
   Configurable<bool> enablePrimaryVertexing{"enablePrimaryVertexing", true, "Enable primary vertexing"};
   Configurable<bool> interpolateLutEfficiencyVsNch{"interpolateLutEfficiencyVsNch", true, "interpolate LUT efficiency as f(Nch)"};
+  Configurable<bool> memoryMapLut{"memoryMapLut", true, "memory-map the LUT files, shared by the processes of a node"};
+  Configurable<bool> useCounterBasedRandom{"useCounterBasedRandom", false, "smear with random numbers keyed on (event, particle), reproducible for any number of threads"};
+  Configurable<int> randomSeed{"randomSeed", 0, "seed of the counter-based random numbers"};
+  Configurable<int> nSmearingThreads{"nSmearingThreads", 1, "number of threads smearing the particles of an event (requires useCounterBasedRandom)"};
 
   Configurable<bool> populateTracksDCA{"populateTracksDCA", true, "populate TracksDCA table"};
   Configurable<bool> populateTracksExtra{"populateTracksExtra", false, "populate TracksExtra table (legacy)"};
@@ -135,9 +143,24 @@ struct OnTheFlyTracker {
   o2::steer::InteractionSampler irSampler;
   o2::vertexing::PVertexer vertexer;
 
+  // For smearing with counter-based random numbers, before the main loop
+  std::vector<o2::track::TrackParCov> smearedTracks;
+  std::vector<uint8_t> smearedReconstructed;
+  std::unique_ptr<o2::common::core::WorkerPool> smearingWorkers; // threads smearing the particles, started once
+
   void init(o2::framework::InitContext&)
   {
+    if (nSmearingThreads > 1 && !useCounterBasedRandom) {
+      LOGF(fatal, "Smearing in %d threads requires useCounterBasedRandom", static_cast<int>(nSmearingThreads));
+    }
+    if (useCounterBasedRandom && !o2::delphes::CounterBasedRandom::checkKnownAnswers()) {
+      LOGF(fatal, "The counter-based random number generator does not reproduce the Philox4x32-10 reference vectors");
+    }
+    if (nSmearingThreads > 1) {
+      smearingWorkers = std::make_unique<o2::common::core::WorkerPool>(nSmearingThreads);
+    }
     if (enableLUT) {
+      mSmearer.useMemoryMapping(static_cast<bool>(memoryMapLut));
       std::map<int, const char*> mapPdgLut;
       const char* lutElChar = lutEl->c_str();
       const char* lutMuChar = lutMu->c_str();
@@ -263,6 +286,47 @@ struct OnTheFlyTracker {
     new (&o2track)(o2::track::TrackParCov)(x, particle.phi(), params, covm);
   }
 
+  /// Function to smear the selected particles of a collision, in parallel if requested.
+  /// Each particle has its own counter-based random numbers, the result does not depend on the number of threads
+  /// \param collisionIndex the global index of the collision (mcCollision)
+  /// \param mcParticles the particles of the collision, selected as in the main loop
+  template <typename McParticlesType>
+  void smearParticles(uint64_t collisionIndex, McParticlesType const& mcParticles)
+  {
+    smearedTracks.clear();
+    std::vector<int> pdgCodes;
+    std::vector<uint64_t> particleIndices;
+    for (const auto& mcParticle : mcParticles) {
+      if (!mcParticle.isPhysicalPrimary()) {
+        continue;
+      }
+      const auto pdg = std::abs(mcParticle.pdgCode());
+      if (pdg != kElectron && pdg != kMuonMinus && pdg != kPiPlus && pdg != kKPlus && pdg != kProton) {
+        continue;
+      }
+      if (std::fabs(mcParticle.eta()) > maxEta || mcParticle.pt() < minPt) {
+        continue;
+      }
+      convertMCParticleToO2Track(mcParticle, smearedTracks.emplace_back());
+      pdgCodes.push_back(mcParticle.pdgCode());
+      particleIndices.push_back(mcParticle.globalIndex());
+    }
+    smearedReconstructed.assign(smearedTracks.size(), 0);
+
+    const int nThreads = (smearingWorkers && smearedTracks.size() > 1) ? smearingWorkers->getNThreads() : 1;
+    auto smearShare = [&](int iThread) {
+      for (size_t iTrack = iThread; iTrack < smearedTracks.size(); iTrack += nThreads) {
+        o2::delphes::CounterBasedRandom generator(static_cast<int>(randomSeed), collisionIndex, particleIndices[iTrack]);
+        smearedReconstructed[iTrack] = mSmearer.smearTrack(smearedTracks[iTrack], pdgCodes[iTrack], dNdEta, generator);
+      }
+    };
+    if (nThreads == 1) {
+      smearShare(0);
+    } else {
+      smearingWorkers->run(smearShare); // the threads are started once in init and only woken up here
+    }
+  }
+
   float dNdEta = 0.f; // Charged particle multiplicity to use in the efficiency evaluation
   void process(aod::McCollision const& mcCollision, aod::McParticles const& mcParticles)
   {
@@ -304,6 +368,11 @@ struct OnTheFlyTracker {
     uint32_t multiplicityCounter = 0;
     histos.fill(HIST("hLUTMultiplicity"), dNdEta);
 
+    if (useCounterBasedRandom) {
+      smearParticles(mcCollision.globalIndex(), mcParticles);
+    }
+    size_t iSmearedTrack = 0;
+
     for (const auto& mcParticle : mcParticles) {
       if (!mcParticle.isPhysicalPrimary()) {
         continue;
@@ -342,7 +411,14 @@ struct OnTheFlyTracker {
         histos.fill(HIST("hSimTrackX"), trackParCov.getX());
       }
 
-      bool reconstructed = mSmearer.smearTrack(trackParCov, mcParticle.pdgCode(), dNdEta);
+      bool reconstructed = false;
+      if (useCounterBasedRandom) {
+        trackParCov = smearedTracks[iSmearedTrack];
+        reconstructed = smearedReconstructed[iSmearedTrack];
+        iSmearedTrack++;
+      } else {
+        reconstructed = mSmearer.smearTrack(trackParCov, mcParticle.pdgCode(), dNdEta);
+      }
       if (!reconstructed && !processUnreconstructedTracks) {
         continue;
       }
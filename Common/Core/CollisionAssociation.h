@@ -136,26 +136,25 @@ class CollisionAssociation
     if (tracks.size() > 0) {
       lastCollisionId = trackBegin.collisionId();
     }
+    // reverse index from track to ambiguous track, to avoid scanning the ambiguous tracks for each unassigned track
+    if (mIncludeUnassigned) {
+      fillAmbiguousTrackIndex<TTracks>(tracksUnfiltered.size(), ambiguousTracks);
+    }
     auto track = trackBegin;
     for (; track != tracks.end(); ++track) {
       int64_t trackBC = -1;
       if (track.has_collision()) {
         trackBC = track.collision().bc().globalBC();
       } else if (mIncludeUnassigned) {
-        for (const auto& ambTrack : ambiguousTracks) {
-          if constexpr (isCentralBarrel) { // FIXME: to be removed as soon as it is possible to use getId<Table>() for joined tables
-            if (ambTrack.trackId() == track.globalIndex()) {
-              if (!ambTrack.has_bc() || ambTrack.bc().size() == 0) {
-                break;
-              }
+        const int ambTrackIdx = mAmbTrackIdxPerTrack[track.globalIndex()];
+        if (ambTrackIdx >= 0) {
+          const auto& ambTrack = ambiguousTracks.rawIteratorAt(ambTrackIdx);
+          if constexpr (isCentralBarrel) {
+            if (ambTrack.has_bc() && ambTrack.bc().size() != 0) {
               trackBC = ambTrack.bc().begin().globalBC();
-              break;
             }
           } else {
-            if (ambTrack.template getId<TTracks>() == track.globalIndex()) {
-              trackBC = ambTrack.bc().begin().globalBC();
-              break;
-            }
+            trackBC = ambTrack.bc().begin().globalBC();
           }
         }
       }
@@ -177,8 +176,8 @@ class CollisionAssociation
       trackIterationWindows.push_back(std::make_pair(trackBegin, track));
     }
 
-    // define vector of vectors to store indices of compatible collisions per track
-    std::vector<std::unique_ptr<std::vector<int>>> collsPerTrack(tracksUnfiltered.size());
+    // compatible (track, collision) pairs in the order in which they are found, converted into a CSR layout per track at the end
+    mCompatiblePairs.clear();
 
     // loop over collisions to find time-compatible tracks
     int64_t bcOffsetMax = mBcWindowForOneSigma * mNumSigmaForTimeCompat + mTimeMargin / o2::constants::lhc::LHCBunchSpacingNS;
@@ -266,10 +265,7 @@ class CollisionAssociation
             LOGP(debug, "Filling track id {} for coll id {}", trackIdx, collIdx);
             association(collIdx, trackIdx);
             if (mFillTableOfCollIdsPerTrack) {
-              if (collsPerTrack[trackIdx] == nullptr) {
-                collsPerTrack[trackIdx] = std::make_unique<std::vector<int>>();
-              }
-              collsPerTrack[trackIdx].get()->push_back(collIdx);
+              mCompatiblePairs.emplace_back(trackIdx, collIdx);
             }
           }
         }
@@ -277,20 +273,56 @@ class CollisionAssociation
     }
     // create reverse index track to collisions if enabled
     if (mFillTableOfCollIdsPerTrack) {
-      std::vector<int> empty{};
+      fillCompatibleCollisionsPerTrack(tracksUnfiltered.size());
+      std::vector<int> collIds{};
       for (const auto& track : tracksUnfiltered) {
-
         const auto trackId = track.globalIndex();
-        if (collsPerTrack[trackId] == nullptr) {
-          reverseIndices(empty);
-        } else {
-          reverseIndices(*collsPerTrack[trackId].get());
-        }
+        collIds.assign(mCollIdsPerTrack.begin() + mCollOffsetsPerTrack[trackId], mCollIdsPerTrack.begin() + mCollOffsetsPerTrack[trackId + 1]);
+        reverseIndices(collIds);
       }
     }
   }
 
  private:
+  /// Builds in one pass the index from track to the row of the ambiguous track table referring to it (-1 if none)
+  template <typename TTracks, typename TAmbiTracks>
+  void fillAmbiguousTrackIndex(const int nTracks, TAmbiTracks const& ambiguousTracks)
+  {
+    mAmbTrackIdxPerTrack.assign(nTracks, -1);
+    int ambTrackIdx = 0;
+    for (const auto& ambTrack : ambiguousTracks) {
+      int trackId = -1;
+      if constexpr (isCentralBarrel) { // FIXME: to be removed as soon as it is possible to use getId<Table>() for joined tables
+        trackId = ambTrack.trackId();
+      } else {
+        trackId = ambTrack.template getId<TTracks>();
+      }
+      // keep the first ambiguous track referring to a track, as the linear search did
+      if (trackId >= 0 && trackId < nTracks && mAmbTrackIdxPerTrack[trackId] < 0) {
+        mAmbTrackIdxPerTrack[trackId] = ambTrackIdx;
+      }
+      ambTrackIdx++;
+    }
+  }
+
+  /// Converts the compatible (track, collision) pairs into offsets and collision indices per track (CSR),
+  /// keeping for each track the collisions in the order in which they were found
+  void fillCompatibleCollisionsPerTrack(const int nTracks)
+  {
+    mCollOffsetsPerTrack.assign(nTracks + 1, 0);
+    for (const auto& [trackIdx, collIdx] : mCompatiblePairs) {
+      mCollOffsetsPerTrack[trackIdx + 1]++;
+    }
+    for (int i = 0; i < nTracks; i++) {
+      mCollOffsetsPerTrack[i + 1] += mCollOffsetsPerTrack[i];
+    }
+    mCollIdsPerTrack.resize(mCompatiblePairs.size());
+    std::vector<int> fillPosition(mCollOffsetsPerTrack.begin(), mCollOffsetsPerTrack.end() - 1);
+    for (const auto& [trackIdx, collIdx] : mCompatiblePairs) {
+      mCollIdsPerTrack[fillPosition[trackIdx]++] = collIdx;
+    }
+  }
+
   float mNumSigmaForTimeCompat{4.};                                                  // number of sigma for time compatibility
   float mTimeMargin{500.};                                                           // additional time margin in ns
   int mTrackSelection{o2::aod::track_association::TrackSelection::GlobalTrackWoDCA}; // track selection for central barrel tracks (standard association only)
@@ -298,6 +330,12 @@ class CollisionAssociation
   bool mIncludeUnassigned{true};                                                     // include tracks that were originally not assigned to any collision
   bool mFillTableOfCollIdsPerTrack{false};                                           // fill additional table with vectors of compatible collisions per track
   int mBcWindowForOneSigma{115};                                                     // BC window to be multiplied by the number of sigmas to define maximum window to be considered
+
+  // buffers reused across timeframes
+  std::vector<int> mAmbTrackIdxPerTrack{};             // row in the ambiguous track table for each track, -1 if not ambiguous
+  std::vector<std::pair<int, int>> mCompatiblePairs{}; // compatible (track, collision) pairs
+  std::vector<int> mCollOffsetsPerTrack{};             // offsets in mCollIdsPerTrack for each track (size nTracks + 1)
+  std::vector<int> mCollIdsPerTrack{};                 // compatible collisions of all tracks, grouped by track
 };
 
 #endif // COMMON_CORE_COLLISIONASSOCIATION_H_
@@ -0,0 +1,279 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+
+/// \file OccupancyCalculator.h
+/// \brief Occupancy and nearby-collision estimators in a time window around each collision, used by the event selection
+///
+/// Collisions are expected to be ordered by their global BC, as they are in the AO2Ds. In this case the time window of
+/// each collision is found with monotone cursors and the number of tracks in the time bins with prefix sums, so that the
+/// cost per collision does not depend on the number of collisions in the window. If the ordering is violated, the
+/// windows are built by walking from each collision towards the past and the future until the first collision outside
+/// of the window, as done originally in the event selection. Both paths give identical results.
+
+#ifndef COMMON_CORE_OCCUPANCYCALCULATOR_H_
+#define COMMON_CORE_OCCUPANCYCALCULATOR_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "CommonConstants/LHCConstants.h"
+
+namespace o2::aod::evsel
+{
+
+class OccupancyCalculator
+{
+ public:
+  OccupancyCalculator() = default;
+
+  /// Time window around each collision used for the occupancy calculation, in ns
+  void setTimeWindow(float minNS, float maxNS)
+  {
+    mTimeWinMinNS = minNS;
+    mTimeWinMaxNS = maxNS;
+  }
+  /// Time frame definition: collisions in different time frames never belong to the same window
+  void setTimeFrame(int64_t bcSOR, int64_t nBCsPerTF)
+  {
+    mBcSOR = bcSOR;
+    mNBCsPerTF = nBCsPerTF;
+  }
+  /// Edges of the time bins in which the tracks are counted, in us
+  void setTimeBins(const std::vector<float>& timeBinsUS) { mTimeBinsUS = timeBinsUS; }
+  /// Half widths of the ranges used to veto collisions with nearby collisions, in us
+  void setVetoRanges(float standardUS, float narrowUS)
+  {
+    mVetoRangeStandardUS = standardUS;
+    mVetoRangeNarrowUS = narrowUS;
+  }
+  void setUseWeights(bool useWeights) { mUseWeights = useWeights; }
+
+  /// Weight of a collision at a time distance dt (in us) for the weighted occupancy estimator
+  static float getOccupancyWeight(float dt)
+  {
+    float wOccup = 0;
+    if (dt >= -40 && dt < -5) // collisions in the past
+      wOccup = 1. / 1225 * (dt + 40) * (dt + 40);
+    else if (dt >= -5 && dt < 15) // collisions near a given one
+      wOccup = 1;
+    else if (dt >= 15 && dt < 100) // collisions from the future
+      wOccup = -1. / 85 * dt + 20. / 17;
+    return wOccup;
+  }
+
+  /// Computes the estimators for all collisions
+  /// \param globalBC global BC of each collision
+  /// \param nTracks number of tracks of each collision entering the occupancy
+  /// \param isFullInfo whether the time window of the collision is fully contained in the time frame; other collisions get no estimators
+  void calculate(const std::vector<int64_t>& globalBC, const std::vector<int>& nTracks, const std::vector<bool>& isFullInfo)
+  {
+    const int nColls = globalBC.size();
+    const int nBins = getNTimeBins();
+    mOccupancy.assign(nColls, -1);
+    mTracksInTimeBins.assign(nColls * nBins, 0);
+    mNoCollInTimeRangeStandard.assign(nColls, false);
+    mNoCollInTimeRangeNarrow.assign(nColls, false);
+    mPrefixTracks.resize(nColls + 1);
+    mPrefixTracks[0] = 0;
+    for (int j = 0; j < nColls; j++) {
+      mPrefixTracks[j + 1] = mPrefixTracks[j] + nTracks[j];
+    }
+
+    if (std::is_sorted(globalBC.begin(), globalBC.end())) {
+      calculateSorted(globalBC, nTracks, isFullInfo);
+    } else {
+      calculateUnsorted(globalBC, nTracks, isFullInfo);
+    }
+  }
+
+  int getNTimeBins() const { return std::max(static_cast<int>(mTimeBinsUS.size()) - 1, 0); }
+  /// Occupancy in the full time window, not counting the collision itself (-1 if not available)
+  int getOccupancy(int collision) const { return mOccupancy[collision]; }
+  /// Number of tracks in a time bin, not counting the collision itself
+  int getTracksInTimeBin(int collision, int bin) const { return mTracksInTimeBins[collision * getNTimeBins() + bin]; }
+  bool getNoCollInTimeRangeStandard(int collision) const { return mNoCollInTimeRangeStandard[collision]; }
+  bool getNoCollInTimeRangeNarrow(int collision) const { return mNoCollInTimeRangeNarrow[collision]; }
+
+ private:
+  static constexpr double bcNS = o2::constants::lhc::LHCBunchSpacingNS;
+
+  int64_t getTimeFrameId(int64_t bc) const { return (bc - mBcSOR) / mNBCsPerTF; }
+  /// Time difference of a collision with respect to a given one, with the same rounding as the occupancy definition
+  static float getDeltaTimeNS(int64_t bc, int64_t bcRef) { return (bc - bcRef) * bcNS; }
+  static float getDeltaTimeUS(int64_t bc, int64_t bcRef)
+  {
+    float dtNS = getDeltaTimeNS(bc, bcRef);
+    return dtNS / 1e3;
+  }
+  int64_t sumTracks(int first, int last) const { return first < last ? mPrefixTracks[last] - mPrefixTracks[first] : 0; }
+
+  /// Windows from monotone cursors: for BC-ordered collisions every boundary moves forward only
+  void calculateSorted(const std::vector<int64_t>& globalBC, const std::vector<int>& nTracks, const std::vector<bool>& isFullInfo)
+  {
+    const int nColls = globalBC.size();
+    const int nBins = getNTimeBins();
+    // cursors on the first collision with dt above the edges (time bins, then lower and upper edges of the veto ranges)
+    mEdges.clear();
+    for (const auto& edge : mTimeBinsUS) {
+      mEdges.push_back({edge, false, 0});
+    }
+    const int iEdgeVeto = mEdges.size();
+    for (const auto& range : {mVetoRangeStandardUS, mVetoRangeNarrowUS}) {
+      mEdges.push_back({-range, false, 0});
+      mEdges.push_back({range, true, 0});
+    }
+
+    int first = 0; // first collision of the window
+    int last = 0;  // one after the last collision of the window
+    for (int i = 0; i < nColls; i++) {
+      if (!isFullInfo[i]) {
+        continue;
+      }
+      const int64_t bcRef = globalBC[i];
+      const int64_t tfRef = getTimeFrameId(bcRef);
+      while (first <= i && (getTimeFrameId(globalBC[first]) != tfRef || getDeltaTimeNS(globalBC[first], bcRef) < mTimeWinMinNS)) {
+        first++;
+      }
+      last = std::max(last, i + 1);
+      while (last < nColls && getTimeFrameId(globalBC[last]) == tfRef && getDeltaTimeNS(globalBC[last], bcRef) <= mTimeWinMaxNS) {
+        last++;
+      }
+      for (auto& edge : mEdges) {
+        while (edge.cursor < nColls && !(edge.inclusive ? getDeltaTimeUS(globalBC[edge.cursor], bcRef) >= edge.value : getDeltaTimeUS(globalBC[edge.cursor], bcRef) > edge.value)) {
+          edge.cursor++;
+        }
+      }
+      // number of tracks in [from, to) within the window, without the collision itself
+      auto tracksInRange = [&](int from, int to) {
+        from = std::max(from, first);
+        to = std::min(to, last);
+        return sumTracks(from, to) - ((from <= i && i < to) ? nTracks[i] : 0);
+      };
+
+      if (!mUseWeights) {
+        mOccupancy[i] = tracksInRange(0, nColls);
+      } else {
+        // the weighted estimator is truncated at each step, so the original order (past, then future) is kept
+        int occupancy = 0;
+        if (first <= i) {
+          for (int j = i - 1; j >= first; j--) {
+            addWeighted(occupancy, globalBC[j], bcRef, nTracks[j]);
+          }
+        }
+        for (int j = i + 1; j < last; j++) {
+          addWeighted(occupancy, globalBC[j], bcRef, nTracks[j]);
+        }
+        mOccupancy[i] = occupancy;
+      }
+      for (int iBin = 0; iBin < nBins; iBin++) {
+        mTracksInTimeBins[i * nBins + iBin] = tracksInRange(mEdges[iBin].cursor, mEdges[iBin + 1].cursor);
+      }
+      mNoCollInTimeRangeStandard[i] = tracksInRange(mEdges[iEdgeVeto].cursor, mEdges[iEdgeVeto + 1].cursor) == 0;
+      mNoCollInTimeRangeNarrow[i] = tracksInRange(mEdges[iEdgeVeto + 2].cursor, mEdges[iEdgeVeto + 3].cursor) == 0;
+    }
+  }
+
+  /// Windows built by walking from each collision, for collisions which are not ordered by BC
+  void calculateUnsorted(const std::vector<int64_t>& globalBC, const std::vector<int>& nTracks, const std::vector<bool>& isFullInfo)
+  {
+    const int nColls = globalBC.size();
+    const int nBins = getNTimeBins();
+    for (int i = 0; i < nColls; i++) {
+      if (!isFullInfo[i]) {
+        continue;
+      }
+      const int64_t bcRef = globalBC[i];
+      const int64_t tfRef = getTimeFrameId(bcRef);
+      mWindow.clear();
+      for (int j = i; j >= 0; j--) {
+        if (getTimeFrameId(globalBC[j]) != tfRef || getDeltaTimeNS(globalBC[j], bcRef) < mTimeWinMinNS) {
+          break;
+        }
+        mWindow.push_back(j);
+      }
+      for (int j = i + 1; j < nColls; j++) {
+        if (getTimeFrameId(globalBC[j]) != tfRef || getDeltaTimeNS(globalBC[j], bcRef) > mTimeWinMaxNS) {
+          break;
+        }
+        mWindow.push_back(j);
+      }
+
+      int occupancy = 0;
+      int tracksForVetoStandard = 0;
+      int tracksForVetoNarrow = 0;
+      for (const auto& j : mWindow) {
+        if (j == i) {
+          continue;
+        }
+        const float dt = getDeltaTimeUS(globalBC[j], bcRef);
+        if (!mUseWeights) {
+          occupancy += nTracks[j];
+        } else {
+          addWeighted(occupancy, globalBC[j], bcRef, nTracks[j]);
+        }
+        for (int iBin = 0; iBin < nBins; iBin++) {
+          if (mTimeBinsUS[iBin] < dt && dt <= mTimeBinsUS[iBin + 1]) {
+            mTracksInTimeBins[i * nBins + iBin] += nTracks[j];
+          }
+        }
+        if (std::fabs(dt) < mVetoRangeStandardUS) {
+          tracksForVetoStandard += nTracks[j];
+        }
+        if (std::fabs(dt) < mVetoRangeNarrowUS) {
+          tracksForVetoNarrow += nTracks[j];
+        }
+      }
+      mOccupancy[i] = occupancy;
+      mNoCollInTimeRangeStandard[i] = tracksForVetoStandard == 0;
+      mNoCollInTimeRangeNarrow[i] = tracksForVetoNarrow == 0;
+    }
+  }
+
+  static void addWeighted(int& occupancy, int64_t bc, int64_t bcRef, int tracks)
+  {
+    const float wOccup = getOccupancyWeight(getDeltaTimeUS(bc, bcRef));
+    if (wOccup > 0) {
+      occupancy += wOccup * tracks;
+    }
+  }
+
+  // configuration
+  float mTimeWinMinNS = -40e3;
+  float mTimeWinMaxNS = 100e3;
+  int64_t mBcSOR = 0;
+  int64_t mNBCsPerTF = 32 * o2::constants::lhc::LHCMaxBunches;
+  std::vector<float> mTimeBinsUS = {-40, -20, 0, 25, 50, 75, 100};
+  float mVetoRangeStandardUS = 10;
+  float mVetoRangeNarrowUS = 4;
+  bool mUseWeights = true;
+
+  // results
+  std::vector<int> mOccupancy;
+  std::vector<int> mTracksInTimeBins;
+  std::vector<bool> mNoCollInTimeRangeStandard;
+  std::vector<bool> mNoCollInTimeRangeNarrow;
+
+  // work buffers, reused across time frames
+  struct CursorEdge {
+    float value;    // edge in us
+    bool inclusive; // whether the cursor points to the first collision with dt >= value (otherwise dt > value)
+    int cursor;     // first collision beyond the edge
+  };
+  std::vector<int64_t> mPrefixTracks;
+  std::vector<int> mWindow;
+  std::vector<CursorEdge> mEdges;
+};
+
+} // namespace o2::aod::evsel
+
+#endif // COMMON_CORE_OCCUPANCYCALCULATOR_H_
@@ -20,6 +20,7 @@
 #include <array>
 #include <vector>
 #include <cmath>
+#include <span>
 #include "Framework/Logger.h"
 // O2 includes
 #include "ReconstructionDataFormats/PID.h"
@@ -85,6 +86,11 @@ class Response
   float GetSignalDelta(const TrackType& trk, const o2::track::PID::ID id) const;
   /// Gets relative dEdx resolution contribution due to relative pt resolution
   float GetRelativeResolutiondEdx(const float p, const float mass, const float charge, const float resol) const;
+  /// Gets the expected signal, the expected resolution and the number of sigmas for a batch of tracks and a list of mass hypotheses.
+  /// The inputs have one entry per track (tracks are expected to have TPC information), the outputs are filled as out[iSpecies * nTracks + iTrack].
+  /// Empty output spans are not filled. No memory is allocated and the results are identical to the single track methods.
+  void GetNumberOfSigmaBatch(std::span<const float> tpcSignal, std::span<const float> tpcInnerParam, std::span<const float> tgl, std::span<const float> nCls, std::span<const float> signed1Pt, std::span<const float> multTPC,
+                             std::span<const o2::track::PID::ID> species, std::span<float> nSigma, std::span<float> expSigma = {}, std::span<float> expSignal = {}) const;
 
   void PrintAll() const;
 
@@ -98,6 +104,9 @@ class Response
   bool mUseDefaultResolutionParam = true;
   float nClNorm = 152.f;
 
+  /// Relative dEdx resolution contribution with the charge factor already applied
+  float GetRelativeResolutiondEdxCharged(const float p, const float mass, const float chargeFactor, const float resol) const;
+
   ClassDefNV(Response, 3);
 
 }; // class Response
@@ -133,9 +142,14 @@ inline float Response::GetExpectedSigma(const CollisionType& collision, const Tr
     const double dEdx = o2::tpc::BetheBlochAleph(static_cast<float>(bg), mBetheBlochParams[0], mBetheBlochParams[1], mBetheBlochParams[2], mBetheBlochParams[3], mBetheBlochParams[4]) * std::pow(static_cast<float>(o2::track::pid_constants::sCharges[id]), mChargeFactor);
     const double relReso = GetRelativeResolutiondEdx(p, mass, o2::track::pid_constants::sCharges[id], mResolutionParams[3]);
 
-    const std::vector<double> values{1.f / dEdx, track.tgl(), std::sqrt(ncl), relReso, track.signed1Pt(), collision.multTPC() / mMultNormalization};
+    const double invdEdx = 1.f / dEdx;
+    const double sqrtNcl = std::sqrt(ncl);
+    const double tgl = track.tgl();
+    const double signed1Pt = track.signed1Pt();
+    const double mult = collision.multTPC() / mMultNormalization;
+    const double dEdxTgl = invdEdx / std::sqrt(1 + tgl * tgl);
 
-    const float reso = sqrt(pow(mResolutionParams[0], 2) * values[0] + pow(mResolutionParams[1], 2) * (values[2] * mResolutionParams[5]) * pow(values[0] / sqrt(1 + pow(values[1], 2)), mResolutionParams[2]) + values[2] * pow(values[3], 2) + pow(mResolutionParams[4] * values[4], 2) + pow(values[5] * mResolutionParams[6], 2) + pow(values[5] * (values[0] / sqrt(1 + pow(values[1], 2))) * mResolutionParams[7], 2)) * dEdx * mMIP;
+    const float reso = std::sqrt(mResolutionParams[0] * mResolutionParams[0] * invdEdx + mResolutionParams[1] * mResolutionParams[1] * (sqrtNcl * mResolutionParams[5]) * std::pow(dEdxTgl, mResolutionParams[2]) + sqrtNcl * (relReso * relReso) + (mResolutionParams[4] * signed1Pt) * (mResolutionParams[4] * signed1Pt) + (mult * mResolutionParams[6]) * (mult * mResolutionParams[6]) + (mult * dEdxTgl * mResolutionParams[7]) * (mult * dEdxTgl * mResolutionParams[7])) * dEdx * mMIP;
     reso >= 0.f ? resolution = reso : resolution = -999.f;
   }
   return resolution;
@@ -197,6 +211,104 @@ inline float Response::GetRelativeResolutiondEdx(const float p, const float mass
   return deltaRel;
 }
 
+inline float Response::GetRelativeResolutiondEdxCharged(const float p, const float mass, const float chargeFactor, const float resol) const
+{
+  const float bg = p / mass;
+  const float dEdx = o2::tpc::BetheBlochAleph(bg, mBetheBlochParams[0], mBetheBlochParams[1], mBetheBlochParams[2], mBetheBlochParams[3], mBetheBlochParams[4]) * chargeFactor;
+  const float deltaP = resol * std::sqrt(dEdx);
+  const float bgDelta = p * (1 + deltaP) / mass;
+  const float dEdx2 = o2::tpc::BetheBlochAleph(bgDelta, mBetheBlochParams[0], mBetheBlochParams[1], mBetheBlochParams[2], mBetheBlochParams[3], mBetheBlochParams[4]) * chargeFactor;
+  return std::abs(dEdx2 - dEdx) / dEdx;
+}
+
+/// Batch version of GetExpectedSignal, GetExpectedSigma and GetNumberOfSigma.
+/// The species dependent constants are computed once per species and the per-track loops are branch free.
+inline void Response::GetNumberOfSigmaBatch(std::span<const float> tpcSignal, std::span<const float> tpcInnerParam, std::span<const float> tgl, std::span<const float> nCls, std::span<const float> signed1Pt, std::span<const float> multTPC,
+                                            std::span<const o2::track::PID::ID> species, std::span<float> nSigma, std::span<float> expSigma, std::span<float> expSignal) const
+{
+  const size_t nTracks = tpcInnerParam.size();
+  if (tpcSignal.size() != nTracks || tgl.size() != nTracks || nCls.size() != nTracks || signed1Pt.size() != nTracks || multTPC.size() != nTracks) {
+    LOGP(fatal, "TPC PID batch: inconsistent input sizes");
+  }
+  const size_t nOutput = nTracks * species.size();
+  if ((!nSigma.empty() && nSigma.size() < nOutput) || (!expSigma.empty() && expSigma.size() < nOutput) || (!expSignal.empty() && expSignal.size() < nOutput)) {
+    LOGP(fatal, "TPC PID batch: output spans too small for {} tracks and {} species", nTracks, species.size());
+  }
+  const float* __restrict__ signalIn = tpcSignal.data();
+  const float* __restrict__ pIn = tpcInnerParam.data();
+  const float* __restrict__ tglIn = tgl.data();
+  const float* __restrict__ nClsIn = nCls.data();
+  const float* __restrict__ signed1PtIn = signed1Pt.data();
+  const float* __restrict__ multIn = multTPC.data();
+  const float bb0 = mBetheBlochParams[0], bb1 = mBetheBlochParams[1], bb2 = mBetheBlochParams[2], bb3 = mBetheBlochParams[3], bb4 = mBetheBlochParams[4];
+
+  for (size_t iSpecies = 0; iSpecies < species.size(); iSpecies++) {
+    const o2::track::PID::ID id = species[iSpecies];
+    const float mass = o2::track::pid_constants::sMasses[id];
+    const float chargeFactor = std::pow(static_cast<float>(o2::track::pid_constants::sCharges[id]), mChargeFactor);
+    float* __restrict__ nSigmaOut = nSigma.empty() ? nullptr : nSigma.data() + iSpecies * nTracks;
+    float* __restrict__ expSigmaOut = expSigma.empty() ? nullptr : expSigma.data() + iSpecies * nTracks;
+    float* __restrict__ expSignalOut = expSignal.empty() ? nullptr : expSignal.data() + iSpecies * nTracks;
+
+    if (mUseDefaultResolutionParam) {
+      const float reso0 = mResolutionParamsDefault[0];
+      const float reso1 = mResolutionParamsDefault[1];
+      for (size_t i = 0; i < nTracks; i++) {
+        const float bethe = mMIP * o2::tpc::BetheBlochAleph(pIn[i] / mass, bb0, bb1, bb2, bb3, bb4) * chargeFactor;
+        const float signal = bethe >= 0.f ? bethe : -999.f;
+        const float reso = signal * reso0 * (nClsIn[i] > 0 ? std::sqrt(1. + reso1 / nClsIn[i]) : 1.f);
+        const float sigma = reso >= 0.f ? reso : -999.f;
+        if (expSignalOut) {
+          expSignalOut[i] = signal;
+        }
+        if (expSigmaOut) {
+          expSigmaOut[i] = sigma;
+        }
+        if (nSigmaOut) {
+          nSigmaOut[i] = (sigma < 0.f || signal < 0.f) ? -999.f : (signalIn[i] - signal) / sigma;
+        }
+      }
+      continue;
+    }
+
+    const double reso0Sq = static_cast<double>(mResolutionParams[0]) * mResolutionParams[0];
+    const double reso1Sq = static_cast<double>(mResolutionParams[1]) * mResolutionParams[1];
+    const double reso2 = mResolutionParams[2];
+    const float reso3 = mResolutionParams[3];
+    const double reso4 = mResolutionParams[4];
+    const double reso5 = mResolutionParams[5];
+    const double reso6 = mResolutionParams[6];
+    const double reso7 = mResolutionParams[7];
+    const double massD = mass;
+    for (size_t i = 0; i < nTracks; i++) {
+      const float bethe = mMIP * o2::tpc::BetheBlochAleph(pIn[i] / mass, bb0, bb1, bb2, bb3, bb4) * chargeFactor;
+      const float signal = bethe >= 0.f ? bethe : -999.f;
+
+      const double ncl = nClNorm / nClsIn[i];
+      const double p = pIn[i];
+      const double dEdx = o2::tpc::BetheBlochAleph(static_cast<float>(p / massD), bb0, bb1, bb2, bb3, bb4) * chargeFactor;
+      const double relReso = GetRelativeResolutiondEdxCharged(p, mass, chargeFactor, reso3);
+      const double invdEdx = 1.f / dEdx;
+      const double sqrtNcl = std::sqrt(ncl);
+      const double tglD = tglIn[i];
+      const double signed1PtD = signed1PtIn[i];
+      const double mult = multIn[i] / mMultNormalization;
+      const double dEdxTgl = invdEdx / std::sqrt(1 + tglD * tglD);
+      const float reso = std::sqrt(reso0Sq * invdEdx + reso1Sq * (sqrtNcl * reso5) * std::pow(dEdxTgl, reso2) + sqrtNcl * (relReso * relReso) + (reso4 * signed1PtD) * (reso4 * signed1PtD) + (mult * reso6) * (mult * reso6) + (mult * dEdxTgl * reso7) * (mult * dEdxTgl * reso7)) * dEdx * mMIP;
+      const float sigma = reso >= 0.f ? reso : -999.f;
+      if (expSignalOut) {
+        expSignalOut[i] = signal;
+      }
+      if (expSigmaOut) {
+        expSigmaOut[i] = sigma;
+      }
+      if (nSigmaOut) {
+        nSigmaOut[i] = (sigma < 0.f || signal < 0.f) ? -999.f : (signalIn[i] - signal) / sigma;
+      }
+    }
+  }
+}
+
 inline void Response::PrintAll() const
 {
   LOGP(info, "==== TPC PID response parameters: ====");
@@ -230,6 +230,8 @@ class TrackSelection
   void print() const;
 
  private:
+  friend class TrackSelectionEvaluator; // compiles the cuts for the evaluation over whole tables
+
   bool FulfillsITSHitRequirements(uint8_t itsClusterMap) const;
 
   o2::aod::track::TrackTypeEnum mTrackType{o2::aod::track::TrackTypeEnum::Track};
@@ -0,0 +1,276 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+
+/// \file TrackSelectionEvaluator.h
+/// \brief Evaluation of several track selections over all the tracks of a table at once
+///
+/// The cuts of each TrackSelection are compiled once: the ITS layer requirements become bit masks, and a pT-dependent
+/// DCAxy limit is tabulated in pT bins with the lowest and highest limit of each bin. The track variables are then
+/// copied once into columns, and every cut of every selection is evaluated in a branch-free loop over the columns,
+/// giving the same cut mask as TrackSelection::IsSelectedMask for each track. The tabulated DCAxy limit decides only
+/// when the DCA is below the lowest or above the highest limit of the bin, the limit function is evaluated otherwise.
+/// The bounds of a bin are taken from the limit at its edges, so the limit function is assumed to be monotonic in pT,
+/// as all the parametrisations in TrackSelectionDefaults; it is always evaluated if its values at the edges are not.
+
+#ifndef COMMON_CORE_TRACKSELECTIONEVALUATOR_H_
+#define COMMON_CORE_TRACKSELECTIONEVALUATOR_H_
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "Framework/DataTypes.h"
+#include "Common/Core/TrackSelection.h"
+
+class TrackSelectionEvaluator
+{
+ public:
+  using Mask = uint16_t;
+  static constexpr Mask kAllCuts = (1 << static_cast<int>(TrackSelection::TrackCuts::kNCuts)) - 1;
+
+  TrackSelectionEvaluator() = default;
+
+  /// Compiles a track selection, later changes of the selection are not seen by the evaluator
+  /// \return index of the selection in the evaluator
+  int addSelection(TrackSelection const& selection)
+  {
+    CompiledSelection compiled;
+    compiled.trackType = static_cast<uint8_t>(selection.mTrackType);
+    compiled.minPt = selection.mMinPt;
+    compiled.maxPt = selection.mMaxPt;
+    compiled.minEta = selection.mMinEta;
+    compiled.maxEta = selection.mMaxEta;
+    compiled.minNClustersTPC = selection.mMinNClustersTPC;
+    compiled.minNCrossedRowsTPC = selection.mMinNCrossedRowsTPC;
+    compiled.minNClustersITS = selection.mMinNClustersITS;
+    compiled.maxChi2PerClusterTPC = selection.mMaxChi2PerClusterTPC;
+    compiled.maxChi2PerClusterITS = selection.mMaxChi2PerClusterITS;
+    compiled.minNCrossedRowsOverFindableClustersTPC = selection.mMinNCrossedRowsOverFindableClustersTPC;
+    compiled.maxDcaXY = selection.mMaxDcaXY;
+    compiled.maxDcaZ = selection.mMaxDcaZ;
+    compiled.requireITSRefit = selection.mRequireITSRefit;
+    compiled.requireTPCRefit = selection.mRequireTPCRefit;
+    compiled.requireGoldenChi2 = selection.mRequireGoldenChi2;
+    for (const auto& itsRequirement : selection.mRequiredITSHits) {
+      uint32_t layerMask = 0;
+      for (const auto& layer : itsRequirement.second) {
+        if (layer < 32) {
+          layerMask |= 1u << layer;
+        }
+      }
+      compiled.itsRequirements.push_back({itsRequirement.first, layerMask});
+    }
+    if (selection.mMaxDcaXYPtDep) {
+      compiled.maxDcaXYPtDep = selection.mMaxDcaXYPtDep;
+      tabulateMaxDcaXY(compiled);
+    }
+    mSelections.push_back(std::move(compiled));
+    mMasks.emplace_back();
+    return mSelections.size() - 1;
+  }
+
+  int getNSelections() const { return mSelections.size(); }
+
+  /// Evaluates all the selections for all the tracks of the table, which must provide the columns used by TrackSelection
+  template <typename TTracks>
+  void evaluate(TTracks const& tracks)
+  {
+    fillColumns(tracks);
+    for (size_t iSelection = 0; iSelection < mSelections.size(); iSelection++) {
+      evaluateSelection(mSelections[iSelection], mMasks[iSelection]);
+    }
+  }
+
+  /// \return cut mask of a track for a selection, as from TrackSelection::IsSelectedMask
+  Mask getMask(int iSelection, int iTrack) const { return mMasks[iSelection][iTrack]; }
+  /// \return true if a track passes all the cuts of a selection, as from TrackSelection::IsSelected
+  bool isSelected(int iSelection, int iTrack) const { return mMasks[iSelection][iTrack] == kAllCuts; }
+  /// \return cut masks of all the tracks of the last evaluated table for a selection
+  std::vector<Mask> const& getMasks(int iSelection) const { return mMasks[iSelection]; }
+
+ private:
+  static constexpr int NBinsDcaXYPtDep = 4000;   // number of pT bins of the tabulated DCAxy limit
+  static constexpr float MaxPtDcaXYPtDep = 10.f; // upper edge of the tabulated pT range, the limit is evaluated above
+  static constexpr float MarginDcaXYPtDep = 1e-4f;
+
+  struct ITSRequirement {
+    int8_t minNRequiredHits; // -1 if no hits are allowed in the layers
+    uint32_t layerMask;
+  };
+
+  struct CompiledSelection {
+    uint8_t trackType = 0;
+    float minPt = 0.f, maxPt = 1e10f;
+    float minEta = -1e10f, maxEta = 1e10f;
+    int minNClustersTPC = 0;
+    int minNCrossedRowsTPC = 0;
+    int minNClustersITS = 0;
+    float maxChi2PerClusterTPC = 1e10f;
+    float maxChi2PerClusterITS = 1e10f;
+    float minNCrossedRowsOverFindableClustersTPC = 0.f;
+    float maxDcaXY = 1e10f;
+    float maxDcaZ = 1e10f;
+    bool requireITSRefit = false;
+    bool requireTPCRefit = false;
+    bool requireGoldenChi2 = false;
+    std::vector<ITSRequirement> itsRequirements;
+    std::function<float(float)> maxDcaXYPtDep{};
+    std::vector<float> maxDcaXYLow;  // per pT bin, limit below the lowest value of the limit function in the bin
+    std::vector<float> maxDcaXYHigh; // per pT bin, limit above the highest value of the limit function in the bin
+  };
+
+  // Bounds of the pT-dependent DCAxy limit in each pT bin, from the values at the bin edges.
+  // If the values at the edges are not monotonic the table is left empty and the limit is always evaluated.
+  static void tabulateMaxDcaXY(CompiledSelection& compiled)
+  {
+    const float binWidth = MaxPtDcaXYPtDep / NBinsDcaXYPtDep;
+    std::vector<float> edgeValues(NBinsDcaXYPtDep + 1);
+    for (int iEdge = 0; iEdge <= NBinsDcaXYPtDep; iEdge++) {
+      edgeValues[iEdge] = compiled.maxDcaXYPtDep(iEdge * binWidth);
+    }
+    // the first edge is at pT = 0, where the limit may diverge
+    const bool isDecreasing = std::is_sorted(edgeValues.rbegin(), edgeValues.rend() - 1);
+    const bool isIncreasing = std::is_sorted(edgeValues.begin() + 1, edgeValues.end());
+    if (!isDecreasing && !isIncreasing) {
+      return;
+    }
+    compiled.maxDcaXYLow.resize(NBinsDcaXYPtDep);
+    compiled.maxDcaXYHigh.resize(NBinsDcaXYPtDep);
+    for (int iBin = 0; iBin < NBinsDcaXYPtDep; iBin++) {
+      const float low = std::min(edgeValues[iBin], edgeValues[iBin + 1]);
+      const float high = std::max(edgeValues[iBin], edgeValues[iBin + 1]);
+      // the margins absorb the rounding of the bin edges, non-finite bounds leave the decision to the limit function
+      compiled.maxDcaXYLow[iBin] = low - MarginDcaXYPtDep * std::abs(low);
+      compiled.maxDcaXYHigh[iBin] = high + MarginDcaXYPtDep * std::abs(high);
+    }
+  }
+
+  template <typename TTracks>
+  void fillColumns(TTracks const& tracks)
+  {
+    const size_t nTracks = tracks.size();
+    mTrackType.resize(nTracks);
+    mPt.resize(nTracks);
+    mEta.resize(nTracks);
+    mTPCNClsFound.resize(nTracks);
+    mTPCNClsCrossedRows.resize(nTracks);
+    mTPCCrossedRowsOverFindableCls.resize(nTracks);
+    mTPCChi2NCl.resize(nTracks);
+    mITSNCls.resize(nTracks);
+    mITSChi2NCl.resize(nTracks);
+    mITSClusterMap.resize(nTracks);
+    mFlags.resize(nTracks);
+    mHasTPC.resize(nTracks);
+    mHasITS.resize(nTracks);
+    mDcaXY.resize(nTracks);
+    mDcaZ.resize(nTracks);
+    size_t iTrack = 0;
+    for (const auto& track : tracks) {
+      mTrackType[iTrack] = track.trackType();
+      mPt[iTrack] = track.pt();
+      mEta[iTrack] = track.eta();
+      mTPCNClsFound[iTrack] = track.tpcNClsFound();
+      mTPCNClsCrossedRows[iTrack] = track.tpcNClsCrossedRows();
+      mTPCCrossedRowsOverFindableCls[iTrack] = track.tpcCrossedRowsOverFindableCls();
+      mTPCChi2NCl[iTrack] = track.tpcChi2NCl();
+      mITSNCls[iTrack] = track.itsNCls();
+      mITSChi2NCl[iTrack] = track.itsChi2NCl();
+      mITSClusterMap[iTrack] = track.itsClusterMap();
+      mFlags[iTrack] = track.flags();
+      mHasTPC[iTrack] = track.hasTPC();
+      mHasITS[iTrack] = track.hasITS();
+      mDcaXY[iTrack] = track.dcaXY();
+      mDcaZ[iTrack] = track.dcaZ();
+      iTrack++;
+    }
+  }
+
+  bool passesMaxDcaXYPtDep(CompiledSelection const& compiled, float pt, float absDcaXY) const
+  {
+    if (!compiled.maxDcaXYLow.empty() && pt >= 0.f && pt < MaxPtDcaXYPtDep) {
+      const int iBin = std::min(static_cast<int>(pt * (NBinsDcaXYPtDep / MaxPtDcaXYPtDep)), NBinsDcaXYPtDep - 1);
+      if (absDcaXY <= compiled.maxDcaXYLow[iBin]) {
+        return true;
+      }
+      if (absDcaXY > compiled.maxDcaXYHigh[iBin]) {
+        return false;
+      }
+    }
+    return absDcaXY <= compiled.maxDcaXYPtDep(pt);
+  }
+
+  void evaluateSelection(CompiledSelection const& compiled, std::vector<Mask>& masks) const
+  {
+    using TrackCuts = TrackSelection::TrackCuts;
+    auto bit = [](TrackCuts cut, bool passed) -> Mask { return static_cast<Mask>(passed) << static_cast<int>(cut); };
+    const size_t nTracks = mPt.size();
+    masks.resize(nTracks);
+    for (size_t i = 0; i < nTracks; i++) {
+      const bool isRun2 = mTrackType[i] == o2::aod::track::Run2Track || mTrackType[i] == o2::aod::track::Run2Tracklet;
+      Mask mask = bit(TrackCuts::kTrackType, mTrackType[i] == compiled.trackType);
+      mask |= bit(TrackCuts::kPtRange, (mPt[i] >= compiled.minPt) & (mPt[i] <= compiled.maxPt));
+      mask |= bit(TrackCuts::kEtaRange, (mEta[i] >= compiled.minEta) & (mEta[i] <= compiled.maxEta));
+      mask |= bit(TrackCuts::kTPCNCls, mTPCNClsFound[i] >= compiled.minNClustersTPC);
+      mask |= bit(TrackCuts::kTPCCrossedRows, mTPCNClsCrossedRows[i] >= compiled.minNCrossedRowsTPC);
+      mask |= bit(TrackCuts::kTPCCrossedRowsOverNCls, mTPCCrossedRowsOverFindableCls[i] >= compiled.minNCrossedRowsOverFindableClustersTPC);
+      mask |= bit(TrackCuts::kTPCChi2NDF, mTPCChi2NCl[i] <= compiled.maxChi2PerClusterTPC);
+      mask |= bit(TrackCuts::kTPCRefit, !compiled.requireTPCRefit || (isRun2 ? (mFlags[i] & o2::aod::track::TPCrefit) != 0 : mHasTPC[i]));
+      mask |= bit(TrackCuts::kITSNCls, mITSNCls[i] >= compiled.minNClustersITS);
+      mask |= bit(TrackCuts::kITSChi2NDF, mITSChi2NCl[i] <= compiled.maxChi2PerClusterITS);
+      mask |= bit(TrackCuts::kITSRefit, !compiled.requireITSRefit || (isRun2 ? (mFlags[i] & o2::aod::track::ITSrefit) != 0 : mHasITS[i]));
+      mask |= bit(TrackCuts::kGoldenChi2, !(isRun2 && compiled.requireGoldenChi2) || (mFlags[i] & o2::aod::track::GoldenChi2) != 0);
+      mask |= bit(TrackCuts::kDCAz, std::abs(mDcaZ[i]) <= compiled.maxDcaZ);
+      masks[i] = mask;
+    }
+    for (size_t i = 0; i < nTracks; i++) {
+      bool passesITSHits = true;
+      for (const auto& itsRequirement : compiled.itsRequirements) {
+        const int hits = std::popcount(mITSClusterMap[i] & itsRequirement.layerMask);
+        passesITSHits &= (itsRequirement.minNRequiredHits == -1) ? (hits == 0) : (hits >= itsRequirement.minNRequiredHits);
+      }
+      masks[i] |= bit(TrackCuts::kITSHits, passesITSHits);
+    }
+    if (compiled.maxDcaXYPtDep) {
+      for (size_t i = 0; i < nTracks; i++) {
+        masks[i] |= bit(TrackCuts::kDCAxy, passesMaxDcaXYPtDep(compiled, mPt[i], std::abs(mDcaXY[i])));
+      }
+    } else {
+      for (size_t i = 0; i < nTracks; i++) {
+        masks[i] |= bit(TrackCuts::kDCAxy, std::abs(mDcaXY[i]) <= compiled.maxDcaXY);
+      }
+    }
+  }
+
+  std::vector<CompiledSelection> mSelections;
+  std::vector<std::vector<Mask>> mMasks; // cut masks of the tracks, per selection
+
+  // track variables of the last evaluated table
+  std::vector<uint8_t> mTrackType;
+  std::vector<float> mPt;
+  std::vector<float> mEta;
+  std::vector<int16_t> mTPCNClsFound;
+  std::vector<int16_t> mTPCNClsCrossedRows;
+  std::vector<float> mTPCCrossedRowsOverFindableCls;
+  std::vector<float> mTPCChi2NCl;
+  std::vector<uint8_t> mITSNCls;
+  std::vector<float> mITSChi2NCl;
+  std::vector<uint8_t> mITSClusterMap;
+  std::vector<uint32_t> mFlags;
+  std::vector<uint8_t> mHasTPC;
+  std::vector<uint8_t> mHasITS;
+  std::vector<float> mDcaXY;
+  std::vector<float> mDcaZ;
+};
+
+#endif // COMMON_CORE_TRACKSELECTIONEVALUATOR_H_
@@ -0,0 +1,116 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+
+/// \file WorkerPool.h
+/// \brief Worker threads started once per task and reused for every parallel section
+///
+/// The threads are created in the constructor, typically in the init of the task, and wait on a condition variable
+/// between the calls of run(). run() executes a job once per thread, the calling thread taking the index 0, and
+/// returns when all threads are done, so the job can capture the local variables of the caller by reference.
+
+#ifndef COMMON_CORE_WORKERPOOL_H_
+#define COMMON_CORE_WORKERPOOL_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace o2::common::core
+{
+
+class WorkerPool
+{
+ public:
+  /// \param nThreads Number of threads running each job, including the calling thread
+  explicit WorkerPool(int nThreads)
+  {
+    for (int iThread = 1; iThread < nThreads; iThread++) {
+      mWorkers.emplace_back(&WorkerPool::work, this, iThread);
+    }
+  }
+
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+
+  ~WorkerPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mStop = true;
+    }
+    mStart.notify_all();
+    for (auto& worker : mWorkers) {
+      worker.join();
+    }
+  }
+
+  /// Number of threads running each job, including the calling thread
+  int getNThreads() const { return mWorkers.size() + 1; }
+
+  /// Runs job(iThread) on all threads and returns when all are done
+  void run(const std::function<void(int)>& job)
+  {
+    if (mWorkers.empty()) {
+      job(0);
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mJob = &job;
+      mNBusy = mWorkers.size();
+      mGeneration++;
+    }
+    mStart.notify_all();
+    job(0);
+    std::unique_lock<std::mutex> lock(mMutex);
+    mDone.wait(lock, [this] { return mNBusy == 0; });
+    mJob = nullptr;
+  }
+
+ private:
+  void work(int iThread)
+  {
+    uint64_t generation = 0;
+    while (true) {
+      const std::function<void(int)>* job = nullptr;
+      {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mStart.wait(lock, [&] { return mStop || mGeneration != generation; });
+        if (mStop) {
+          return;
+        }
+        generation = mGeneration;
+        job = mJob;
+      }
+      (*job)(iThread);
+      std::lock_guard<std::mutex> lock(mMutex);
+      if (--mNBusy == 0) {
+        mDone.notify_one();
+      }
+    }
+  }
+
+  std::vector<std::thread> mWorkers;
+  std::mutex mMutex;
+  std::condition_variable mStart;
+  std::condition_variable mDone;
+  const std::function<void(int)>* mJob = nullptr; // job of the current generation
+  uint64_t mGeneration = 0;                       // incremented at each run()
+  size_t mNBusy = 0;                              // workers still running the job of the current generation
+  bool mStop = false;
+};
+
+} // namespace o2::common::core
+
+#endif // COMMON_CORE_WORKERPOOL_H_
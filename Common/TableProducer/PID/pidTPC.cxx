@@ -35,8 +35,14 @@
 #include "Common/DataModel/Multiplicity.h"
 #include "TableHelper.h"
 #include "Tools/ML/model.h"
+#include "Common/Core/WorkerPool.h"
 #include "pidTPCBase.h"
 
+#include <array>
+#include <memory>
+#include <numeric>
+#include <span>
+
 using namespace o2;
 using namespace o2::framework;
 using namespace o2::pid;
@@ -88,10 +94,20 @@ struct tpcPid {
 
   // Network correction for TPC PID response
   OnnxModel network;
+  std::unique_ptr<o2::common::core::WorkerPool> networkWorkers; // threads evaluating the chunks concurrently, started once
   o2::ccdb::CcdbApi ccdbApi;
   std::map<std::string, std::string> metadata;
   std::map<std::string, std::string> headers;
   std::vector<int> speciesNetworkFlags = std::vector<int>(9);
+  std::array<int, 9> networkSlot; // Position of each mass hypothesis in the network prediction, -1 if the network is not evaluated for it
+  int nNetworkSpecies = 0;
+
+  // Buffers for the batch evaluation of the TPC response, reused across timeframes
+  std::vector<o2::track::PID::ID> batchSpecies;
+  std::array<int, 9> batchSlot; // Position of each mass hypothesis in the batch output, -1 if its tables are not produced
+  std::vector<float> batchSignal, batchInnerParam, batchTgl, batchNCls, batchSigned1Pt, batchMult;
+  std::vector<float> batchNSigma, batchExpSigma, batchExpSignal;
+  uint64_t batchNTracks = 0;
 
   // Input parameters
   Service<o2::ccdb::BasicCCDBManager> ccdb;
@@ -138,6 +154,8 @@ struct tpcPid {
   Configurable<int> useNetworkHe{"useNetworkHe", 1, {"Switch for applying neural network on the helium3 mass hypothesis (if network enabled) (set to 0 to disable)"}};
   Configurable<int> useNetworkAl{"useNetworkAl", 1, {"Switch for applying neural network on the alpha mass hypothesis (if network enabled) (set to 0 to disable)"}};
   Configurable<float> networkBetaGammaCutoff{"networkBetaGammaCutoff", 0.45, {"Lower value of beta-gamma to override the NN application"}};
+  Configurable<int> networkBatchSize{"networkBatchSize", 0, {"Maximum number of tracks per network evaluation chunk (0 evaluates the whole timeframe in one chunk)"}};
+  Configurable<int> networkNumConcurrentChunks{"networkNumConcurrentChunks", 1, {"Number of network evaluation chunks run concurrently"}};
 
   // Parametrization configuration
   bool useCCDBParam = false;
@@ -187,6 +205,27 @@ struct tpcPid {
     speciesNetworkFlags[7] = useNetworkHe;
     speciesNetworkFlags[8] = useNetworkAl;
 
+    // The network is only evaluated for the mass hypotheses whose tables are produced.
+    // For the MC tune-on-data the hypothesis is given by the MC particle, hence all enabled species are kept.
+    const std::array<int, 9> fullFlags{pidFullEl, pidFullMu, pidFullPi, pidFullKa, pidFullPr, pidFullDe, pidFullTr, pidFullHe, pidFullAl};
+    const std::array<int, 9> tinyFlags{pidTinyEl, pidTinyMu, pidTinyPi, pidTinyKa, pidTinyPr, pidTinyDe, pidTinyTr, pidTinyHe, pidTinyAl};
+    nNetworkSpecies = 0;
+    for (int i = 0; i < 9; i++) {
+      const bool tableRequested = doprocessMcTuneOnData || fullFlags[i] == 1 || tinyFlags[i] == 1;
+      networkSlot[i] = (speciesNetworkFlags[i] && tableRequested) ? nNetworkSpecies++ : -1;
+    }
+    if (useNetworkCorrection) {
+      LOGP(info, "Network correction evaluated for {} mass hypotheses", nNetworkSpecies);
+    }
+    batchSpecies.clear();
+    for (int i = 0; i < 9; i++) {
+      batchSlot[i] = -1;
+      if (fullFlags[i] == 1 || tinyFlags[i] == 1) {
+        batchSlot[i] = batchSpecies.size();
+        batchSpecies.push_back(static_cast<o2::track::PID::ID>(i));
+      }
+    }
+
     // Initialise metadata object for CCDB calls
     if (recoPass.value == "") {
       LOGP(info, "Reco pass not specified; CCDB will take latest available object");
@@ -235,6 +274,9 @@ struct tpcPid {
     if (!useNetworkCorrection) {
       return;
     } else {
+      if (networkNumConcurrentChunks > 1) {
+        networkWorkers = std::make_unique<o2::common::core::WorkerPool>(networkNumConcurrentChunks);
+      }
       /// CCDB and auto-fetching
       ccdbApi.init(url);
       if (!autofetchNetworks) {
@@ -269,6 +311,28 @@ struct tpcPid {
   Partition<Trks> notTPCStandaloneTracks = (aod::track::tpcNClsFindable > (uint8_t)0) && ((aod::track::itsClusterSizes > (uint32_t)0) || (aod::track::trdPattern > (uint8_t)0) || (aod::track::tofExpMom > 0.f && aod::track::tofChi2 > 0.f)); // To count number of tracks for use in NN array
   Partition<Trks> tracksWithTPC = (aod::track::tpcNClsFindable > (uint8_t)0);
 
+  /// Updates the TPC response from the CCDB if the cached object is not valid for the timestamp of the BC
+  template <typename B>
+  void updateResponse(B const& bc)
+  {
+    if (useCCDBParam && ccdbTimestamp.value == 0 && !ccdb->isCachedObjectValid(ccdbPath.value, bc.timestamp())) { // Updating parametrisation only if the initial timestamp is 0
+      if (recoPass.value == "") {
+        LOGP(info, "Retrieving latest TPC response object for timestamp {}:", bc.timestamp());
+      } else {
+        LOGP(info, "Retrieving TPC Response for timestamp {} and recoPass {}:", bc.timestamp(), recoPass.value);
+      }
+      response = ccdb->getSpecific<o2::pid::tpc::Response>(ccdbPath.value, bc.timestamp(), metadata);
+      if (!response) {
+        LOGP(warning, "!! Could not find a valid TPC response object for specific pass name {}! Falling back to latest uploaded object.", recoPass.value);
+        response = ccdb->getForTimeStamp<o2::pid::tpc::Response>(ccdbPath.value, bc.timestamp());
+        if (!response) {
+          LOGP(fatal, "Could not find ANY TPC response object for the timestamp {}!", bc.timestamp());
+        }
+      }
+      response->PrintAll();
+    }
+  }
+
   template <typename C, typename T, typename B>
   std::vector<float> createNetworkPrediction(C const& collisions, T const& tracks, B const& bcs, const size_t size)
   {
@@ -279,22 +343,7 @@ struct tpcPid {
     if (autofetchNetworks) {
       const auto& bc = bcs.begin();
       // Initialise correct TPC response object before NN setup (for NCl normalisation)
-      if (useCCDBParam && ccdbTimestamp.value == 0 && !ccdb->isCachedObjectValid(ccdbPath.value, bc.timestamp())) { // Updating parametrisation only if the initial timestamp is 0
-        if (recoPass.value == "") {
-          LOGP(info, "Retrieving latest TPC response object for timestamp {}:", bc.timestamp());
-        } else {
-          LOGP(info, "Retrieving TPC Response for timestamp {} and recoPass {}:", bc.timestamp(), recoPass.value);
-        }
-        response = ccdb->getSpecific<o2::pid::tpc::Response>(ccdbPath.value, bc.timestamp(), metadata);
-        if (!response) {
-          LOGP(warning, "!! Could not find a valid TPC response object for specific pass name {}! Falling back to latest uploaded object.", recoPass.value);
-          response = ccdb->getForTimeStamp<o2::pid::tpc::Response>(ccdbPath.value, bc.timestamp());
-          if (!response) {
-            LOGP(fatal, "Could not find ANY TPC response object for the timestamp {}!", bc.timestamp());
-          }
-        }
-        response->PrintAll();
-      }
+      updateResponse(bc);
 
       if (bc.timestamp() < network.getValidityFrom() || bc.timestamp() > network.getValidityUntil()) { // fetches network only if the runnumbers change
         LOG(info) << "Fetching network for timestamp: " << bc.timestamp();
@@ -311,64 +360,112 @@ struct tpcPid {
     }
 
     // Defining some network parameters
-    int input_dimensions = network.getNumInputNodes();
-    int output_dimensions = network.getNumOutputNodes();
-    const uint64_t track_prop_size = input_dimensions * size;
+    const int input_dimensions = network.getNumInputNodes();
+    const int output_dimensions = network.getNumOutputNodes();
     const uint64_t prediction_size = output_dimensions * size;
 
-    network_prediction = std::vector<float>(prediction_size * 9); // For each mass hypotheses
+    // Only the species with an active network slot are evaluated, see init()
+    network_prediction = std::vector<float>(prediction_size * nNetworkSpecies);
+    if (nNetworkSpecies == 0 || size == 0) {
+      return network_prediction;
+    }
     const float nNclNormalization = response->GetNClNormalization();
-    float duration_network = 0;
 
-    std::vector<float> track_properties(track_prop_size);
-    uint64_t counter_track_props = 0;
-    int loop_counter = 0;
+    // Multiplicity is gathered once per collision instead of once per track and species
+    std::vector<float> multiplicityInput(collisions.size());
+    for (auto const& collision : collisions) {
+      multiplicityInput[collision.globalIndex()] = collision.multTPC() / 11000.;
+    }
 
-    // Filling a std::vector<float> to be evaluated by the network
-    // Evaluation on single tracks brings huge overhead: Thus evaluation is done on one large vector
-    for (int i = 0; i < 9; i++) { // Loop over particle number for which network correction is used
-      for (auto const& trk : tracks) {
-        if (!trk.hasTPC()) {
+    // Filling one contiguous block of track features to be evaluated by the network
+    // Evaluation on single tracks brings huge overhead: Thus evaluation is done on one large block
+    // The block is species independent, only the mass column (index 3) is rewritten for each hypothesis
+    std::vector<float> track_properties(input_dimensions * size);
+    uint64_t counter_track_props = 0;
+    for (auto const& trk : tracks) {
+      if (!trk.hasTPC()) {
+        continue;
+      }
+      if (skipTPCOnly) {
+        if (!trk.hasITS() && !trk.hasTRD() && !trk.hasTOF()) {
           continue;
         }
-        if (skipTPCOnly) {
-          if (!trk.hasITS() && !trk.hasTRD() && !trk.hasTOF()) {
-            continue;
-          }
-        }
-        track_properties[counter_track_props] = trk.tpcInnerParam();
-        track_properties[counter_track_props + 1] = trk.tgl();
-        track_properties[counter_track_props + 2] = trk.signed1Pt();
-        track_properties[counter_track_props + 3] = o2::track::pid_constants::sMasses[i];
-        track_properties[counter_track_props + 4] = trk.has_collision() ? collisions.iteratorAt(trk.collisionId()).multTPC() / 11000. : 1.;
-        track_properties[counter_track_props + 5] = std::sqrt(nNclNormalization / trk.tpcNClsFound());
-        counter_track_props += input_dimensions;
       }
+      if (counter_track_props >= track_properties.size()) {
+        LOGF(fatal, "Number of tracks for the network exceeds the expected size {}!", size);
+      }
+      track_properties[counter_track_props] = trk.tpcInnerParam();
+      track_properties[counter_track_props + 1] = trk.tgl();
+      track_properties[counter_track_props + 2] = trk.signed1Pt();
+      track_properties[counter_track_props + 4] = trk.has_collision() ? multiplicityInput[trk.collisionId()] : 1.;
+      track_properties[counter_track_props + 5] = std::sqrt(nNclNormalization / trk.tpcNClsFound());
+      counter_track_props += input_dimensions;
+    }
 
-      auto start_network_eval = std::chrono::high_resolution_clock::now();
-      float* output_network = network.evalModel(track_properties);
-      auto stop_network_eval = std::chrono::high_resolution_clock::now();
-      duration_network += std::chrono::duration<float, std::ratio<1, 1000000000>>(stop_network_eval - start_network_eval).count();
-      for (uint64_t i = 0; i < prediction_size; i += output_dimensions) {
-        for (int j = 0; j < output_dimensions; j++) {
-          network_prediction[i + j + prediction_size * loop_counter] = output_network[i + j];
+    // Splitting the block into chunks, each chunk owns its input buffer so that chunks can be evaluated concurrently
+    const uint64_t chunk_size = (networkBatchSize.value > 0) ? std::min<uint64_t>(networkBatchSize.value, size) : size;
+    const uint64_t n_chunks = (size + chunk_size - 1) / chunk_size;
+    std::vector<std::vector<float>> chunk_properties(n_chunks);
+    if (n_chunks == 1) {
+      chunk_properties[0] = std::move(track_properties);
+    } else {
+      for (uint64_t c = 0; c < n_chunks; c++) {
+        const uint64_t first = c * chunk_size;
+        const uint64_t last = std::min<uint64_t>(first + chunk_size, size);
+        chunk_properties[c].assign(track_properties.begin() + first * input_dimensions, track_properties.begin() + last * input_dimensions);
+      }
+      track_properties.clear();
+    }
+
+    std::vector<float> duration_network(n_chunks, 0.f);
+    auto evaluateChunk = [&](const uint64_t c) {
+      auto& chunk = chunk_properties[c];
+      const uint64_t chunk_tracks = chunk.size() / input_dimensions;
+      for (int pid = 0; pid < 9; pid++) { // Loop over particle number for which network correction is used
+        const int slot = networkSlot[pid];
+        if (slot < 0) {
+          continue;
+        }
+        for (uint64_t i = 3; i < chunk.size(); i += input_dimensions) {
+          chunk[i] = o2::track::pid_constants::sMasses[pid];
+        }
+        auto start_network_eval = std::chrono::high_resolution_clock::now();
+        // zero-copy evaluation writing directly into the prediction, safe for concurrent chunks
+        std::span<float> output_network{network_prediction.data() + prediction_size * slot + c * chunk_size * output_dimensions, chunk_tracks * output_dimensions};
+        bool success = network.evalModel(std::span<const float>{chunk}, output_network);
+        auto stop_network_eval = std::chrono::high_resolution_clock::now();
+        duration_network[c] += std::chrono::duration<float, std::ratio<1, 1000000000>>(stop_network_eval - start_network_eval).count();
+        if (!success) {
+          LOGF(fatal, "Network evaluation failed!");
         }
       }
+    };
 
-      counter_track_props = 0;
-      loop_counter += 1;
+    if (!networkWorkers || n_chunks == 1) {
+      for (uint64_t c = 0; c < n_chunks; c++) {
+        evaluateChunk(c);
+      }
+    } else {
+      // the worker threads live as long as the task, they are only woken up here
+      const uint64_t n_workers = networkWorkers->getNThreads();
+      networkWorkers->run([&](const int w) {
+        for (uint64_t c = w; c < n_chunks; c += n_workers) {
+          evaluateChunk(c);
+        }
+      });
     }
-    track_properties.clear();
 
+    const float duration_network_total = std::accumulate(duration_network.begin(), duration_network.end(), 0.f);
     auto stop_network_total = std::chrono::high_resolution_clock::now();
-    LOG(debug) << "Neural Network for the TPC PID response correction: Time per track (eval ONNX): " << duration_network / (size * 9) << "ns ; Total time (eval ONNX): " << duration_network / 1000000000 << " s";
-    LOG(debug) << "Neural Network for the TPC PID response correction: Time per track (eval + overhead): " << std::chrono::duration<float, std::ratio<1, 1000000000>>(stop_network_total - start_network_total).count() / (size * 9) << "ns ; Total time (eval + overhead): " << std::chrono::duration<float, std::ratio<1, 1000000000>>(stop_network_total - start_network_total).count() / 1000000000 << " s";
+    LOG(debug) << "Neural Network for the TPC PID response correction: Time per track (eval ONNX): " << duration_network_total / (size * nNetworkSpecies) << "ns ; Total time (eval ONNX): " << duration_network_total / 1000000000 << " s";
+    LOG(debug) << "Neural Network for the TPC PID response correction: Time per track (eval + overhead): " << std::chrono::duration<float, std::ratio<1, 1000000000>>(stop_network_total - start_network_total).count() / (size * nNetworkSpecies) << "ns ; Total time (eval + overhead): " << std::chrono::duration<float, std::ratio<1, 1000000000>>(stop_network_total - start_network_total).count() / 1000000000 << " s";
 
     return network_prediction;
   }
 
+  /// Fills the PID tables of one track. If batchIndex is not negative the response is taken from the batch evaluation, see computeBatchResponse()
   template <typename C, typename T, typename NSF, typename NST>
-  void makePidTables(const int flagFull, NSF& tableFull, const int flagTiny, NST& tableTiny, const o2::track::PID::ID pid, const float tpcSignal, const T& trk, const C& collisions, const std::vector<float>& network_prediction, const int& count_tracks, const int& tracksForNet_size)
+  void makePidTables(const int flagFull, NSF& tableFull, const int flagTiny, NST& tableTiny, const o2::track::PID::ID pid, const float tpcSignal, const T& trk, const C& collisions, const std::vector<float>& network_prediction, const int& count_tracks, const int& tracksForNet_size, const int64_t batchIndex = -1)
   {
     if (flagFull != 1 && flagTiny != 1) {
       return;
@@ -389,9 +486,13 @@ struct tpcPid {
         return;
       }
     }
-    auto expSignal = response->GetExpectedSignal(trk, pid);
-    auto expSigma = trk.has_collision() ? response->GetExpectedSigma(collisions.iteratorAt(trk.collisionId()), trk, pid) : 0.07 * expSignal; // use default sigma value of 7% if no collision information to estimate resolution
-    if (expSignal < 0. || expSigma < 0.) {                                                                                                   // skip if expected signal invalid
+    const uint64_t batchOffset = batchIndex < 0 ? 0 : batchSlot[pid] * batchNTracks + batchIndex;
+    float expSignal = batchIndex < 0 ? response->GetExpectedSignal(trk, pid) : batchExpSignal[batchOffset];
+    float expSigma = 0.07 * expSignal; // use default sigma value of 7% if no collision information to estimate resolution
+    if (trk.has_collision()) {
+      expSigma = batchIndex < 0 ? response->GetExpectedSigma(collisions.iteratorAt(trk.collisionId()), trk, pid) : batchExpSigma[batchOffset];
+    }
+    if (expSignal < 0. || expSigma < 0.) { // skip if expected signal invalid
       if (flagFull)
         tableFull(-999.f, -999.f);
       if (flagTiny)
@@ -401,26 +502,28 @@ struct tpcPid {
 
     float nSigma = -999.f;
     float bg = trk.tpcInnerParam() / o2::track::pid_constants::sMasses[pid]; // estimated beta-gamma for network cutoff
-    if (useNetworkCorrection && speciesNetworkFlags[pid] && trk.has_collision() && bg > networkBetaGammaCutoff) {
+    if (useNetworkCorrection && networkSlot[pid] >= 0 && trk.has_collision() && bg > networkBetaGammaCutoff) {
 
       // Here comes the application of the network. The output--dimensions of the network determine the application: 1: mean, 2: sigma, 3: sigma asymmetric
       // For now only the option 2: sigma will be used. The other options are kept if there would be demand later on
       if (network.getNumOutputNodes() == 1) { // Expected mean correction; no sigma correction
-        nSigma = (tpcSignal - network_prediction[count_tracks + tracksForNet_size * pid] * expSignal) / expSigma;
+        nSigma = (tpcSignal - network_prediction[count_tracks + tracksForNet_size * networkSlot[pid]] * expSignal) / expSigma;
       } else if (network.getNumOutputNodes() == 2) { // Symmetric sigma correction
-        expSigma = (network_prediction[2 * (count_tracks + tracksForNet_size * pid) + 1] - network_prediction[2 * (count_tracks + tracksForNet_size * pid)]) * expSignal;
-        nSigma = (tpcSignal / expSignal - network_prediction[2 * (count_tracks + tracksForNet_size * pid)]) / (network_prediction[2 * (count_tracks + tracksForNet_size * pid) + 1] - network_prediction[2 * (count_tracks + tracksForNet_size * pid)]);
+        expSigma = (network_prediction[2 * (count_tracks + tracksForNet_size * networkSlot[pid]) + 1] - network_prediction[2 * (count_tracks + tracksForNet_size * networkSlot[pid])]) * expSignal;
+        nSigma = (tpcSignal / expSignal - network_prediction[2 * (count_tracks + tracksForNet_size * networkSlot[pid])]) / (network_prediction[2 * (count_tracks + tracksForNet_size * networkSlot[pid]) + 1] - network_prediction[2 * (count_tracks + tracksForNet_size * networkSlot[pid])]);
       } else if (network.getNumOutputNodes() == 3) { // Asymmetric sigma corection
-        if (tpcSignal / expSignal >= network_prediction[3 * (count_tracks + tracksForNet_size * pid)]) {
-          expSigma = (network_prediction[3 * (count_tracks + tracksForNet_size * pid) + 1] - network_prediction[3 * (count_tracks + tracksForNet_size * pid)]) * expSignal;
-          nSigma = (tpcSignal / expSignal - network_prediction[3 * (count_tracks + tracksForNet_size * pid)]) / (network_prediction[3 * (count_tracks + tracksForNet_size * pid) + 1] - network_prediction[3 * (count_tracks + tracksForNet_size * pid)]);
+        if (tpcSignal / expSignal >= network_prediction[3 * (count_tracks + tracksForNet_size * networkSlot[pid])]) {
+          expSigma = (network_prediction[3 * (count_tracks + tracksForNet_size * networkSlot[pid]) + 1] - network_prediction[3 * (count_tracks + tracksForNet_size * networkSlot[pid])]) * expSignal;
+          nSigma = (tpcSignal / expSignal - network_prediction[3 * (count_tracks + tracksForNet_size * networkSlot[pid])]) / (network_prediction[3 * (count_tracks + tracksForNet_size * networkSlot[pid]) + 1] - network_prediction[3 * (count_tracks + tracksForNet_size * networkSlot[pid])]);
         } else {
-          expSigma = (network_prediction[3 * (count_tracks + tracksForNet_size * pid)] - network_prediction[3 * (count_tracks + tracksForNet_size * pid) + 2]) * expSignal;
-          nSigma = (tpcSignal / expSignal - network_prediction[3 * (count_tracks + tracksForNet_size * pid)]) / (network_prediction[3 * (count_tracks + tracksForNet_size * pid)] - network_prediction[3 * (count_tracks + tracksForNet_size * pid) + 2]);
+          expSigma = (network_prediction[3 * (count_tracks + tracksForNet_size * networkSlot[pid])] - network_prediction[3 * (count_tracks + tracksForNet_size * networkSlot[pid]) + 2]) * expSignal;
+          nSigma = (tpcSignal / expSignal - network_prediction[3 * (count_tracks + tracksForNet_size * networkSlot[pid])]) / (network_prediction[3 * (count_tracks + tracksForNet_size * networkSlot[pid])] - network_prediction[3 * (count_tracks + tracksForNet_size * networkSlot[pid]) + 2]);
         }
       } else {
         LOGF(fatal, "Network output-dimensions incompatible!");
       }
+    } else if (batchIndex >= 0) {
+      nSigma = batchNSigma[batchOffset];
     } else {
       nSigma = response->GetNumberOfSigmaMCTuned(collisions.iteratorAt(trk.collisionId()), trk, pid, tpcSignal);
     }
@@ -430,6 +533,37 @@ struct tpcPid {
       aod::pidutils::packInTable<aod::pidtpc_tiny::binning>(nSigma, tableTiny);
   };
 
+  /// Evaluates the expected signal, resolution and number of sigmas of all tracks for the mass hypotheses whose tables are produced
+  template <typename C, typename T>
+  void computeBatchResponse(C const& collisions, T const& tracks)
+  {
+    batchNTracks = tracks.size();
+    batchSignal.resize(batchNTracks);
+    batchInnerParam.resize(batchNTracks);
+    batchTgl.resize(batchNTracks);
+    batchNCls.resize(batchNTracks);
+    batchSigned1Pt.resize(batchNTracks);
+    batchMult.resize(batchNTracks);
+    batchNSigma.resize(batchNTracks * batchSpecies.size());
+    batchExpSigma.resize(batchNTracks * batchSpecies.size());
+    batchExpSignal.resize(batchNTracks * batchSpecies.size());
+    if (batchSpecies.empty()) {
+      return;
+    }
+
+    uint64_t index = 0;
+    for (auto const& trk : tracks) {
+      batchSignal[index] = trk.tpcSignal();
+      batchInnerParam[index] = trk.tpcInnerParam();
+      batchTgl[index] = trk.tgl();
+      batchNCls[index] = trk.tpcNClsFound();
+      batchSigned1Pt[index] = trk.signed1Pt();
+      batchMult[index] = trk.has_collision() ? collisions.iteratorAt(trk.collisionId()).multTPC() : 0.f;
+      index++;
+    }
+    response->GetNumberOfSigmaBatch(batchSignal, batchInnerParam, batchTgl, batchNCls, batchSigned1Pt, batchMult, batchSpecies, batchNSigma, batchExpSigma, batchExpSignal);
+  }
+
   void processStandard(Coll const& collisions, Trks const& tracks, aod::BCsWithTimestamps const& bcs)
   {
 
@@ -470,31 +604,20 @@ struct tpcPid {
       network_prediction = createNetworkPrediction(collisions, tracks, bcs, tracksForNet_size);
     }
 
+    // The response is updated once per timeframe so that all tracks can be evaluated in one batch
+    if (tracks.size() > 0) {
+      updateResponse(bcs.begin());
+    }
+    computeBatchResponse(collisions, tracks);
+
     uint64_t count_tracks = 0;
+    int64_t batchIndex = 0;
 
     for (auto const& trk : tracks) {
       // Loop on Tracks
 
-      const auto& bc = trk.has_collision() ? collisions.iteratorAt(trk.collisionId()).bc_as<aod::BCsWithTimestamps>() : bcs.begin();
-      if (useCCDBParam && ccdbTimestamp.value == 0 && !ccdb->isCachedObjectValid(ccdbPath.value, bc.timestamp())) { // Updating parametrisation only if the initial timestamp is 0
-        if (recoPass.value == "") {
-          LOGP(info, "Retrieving latest TPC response object for timestamp {}:", bc.timestamp());
-        } else {
-          LOGP(info, "Retrieving TPC Response for timestamp {} and recoPass {}:", bc.timestamp(), recoPass.value);
-        }
-        response = ccdb->getSpecific<o2::pid::tpc::Response>(ccdbPath.value, bc.timestamp(), metadata);
-        if (!response) {
-          LOGP(warning, "!! Could not find a valid TPC response object for specific pass name {}! Falling back to latest uploaded object.", recoPass.value);
-          response = ccdb->getForTimeStamp<o2::pid::tpc::Response>(ccdbPath.value, bc.timestamp());
-          if (!response) {
-            LOGP(fatal, "Could not find ANY TPC response object for the timestamp {}!", bc.timestamp());
-          }
-        }
-        response->PrintAll();
-      }
-
-      auto makePidTablesDefault = [&trk, &collisions, &network_prediction, &count_tracks, &tracksForNet_size, this](const int flagFull, auto& tableFull, const int flagTiny, auto& tableTiny, const o2::track::PID::ID pid) {
-        makePidTables(flagFull, tableFull, flagTiny, tableTiny, pid, trk.tpcSignal(), trk, collisions, network_prediction, count_tracks, tracksForNet_size);
+      auto makePidTablesDefault = [&trk, &collisions, &network_prediction, &count_tracks, &tracksForNet_size, &batchIndex, this](const int flagFull, auto& tableFull, const int flagTiny, auto& tableTiny, const o2::track::PID::ID pid) {
+        makePidTables(flagFull, tableFull, flagTiny, tableTiny, pid, trk.tpcSignal(), trk, collisions, network_prediction, count_tracks, tracksForNet_size, batchIndex);
       };
 
       makePidTablesDefault(pidFullEl, tablePIDFullEl, pidTinyEl, tablePIDTinyEl, o2::track::PID::Electron);
@@ -510,6 +633,7 @@ struct tpcPid {
       if (trk.hasTPC() && (!skipTPCOnly || trk.hasITS() || trk.hasTRD() || trk.hasTOF())) {
         count_tracks++; // Increment network track counter only if track has TPC, and (not skipping TPConly) or (is not TPConly)
       }
+      batchIndex++;
     }
   }
 
@@ -565,22 +689,7 @@ struct tpcPid {
     for (auto const& trk : tracksMc) {
       // Loop on Tracks
       const auto& bc = trk.has_collision() ? collisionsMc.iteratorAt(trk.collisionId()).bc_as<aod::BCsWithTimestamps>() : bcs.begin();
-      if (useCCDBParam && ccdbTimestamp.value == 0 && !ccdb->isCachedObjectValid(ccdbPath.value, bc.timestamp())) { // Updating parametrisation only if the initial timestamp is 0
-        if (recoPass.value == "") {
-          LOGP(info, "Retrieving latest TPC response object for timestamp {}:", bc.timestamp());
-        } else {
-          LOGP(info, "Retrieving TPC Response for timestamp {} and recoPass {}:", bc.timestamp(), recoPass.value);
-        }
-        response = ccdb->getSpecific<o2::pid::tpc::Response>(ccdbPath.value, bc.timestamp(), metadata);
-        if (!response) {
-          LOGP(warning, "!! Could not find a valid TPC response object for specific pass name {}! Falling back to latest uploaded object.", recoPass.value);
-          response = ccdb->getForTimeStamp<o2::pid::tpc::Response>(ccdbPath.value, bc.timestamp());
-          if (!response) {
-            LOGP(fatal, "Could not find ANY TPC response object for the timestamp {}!", bc.timestamp());
-          }
-        }
-        response->PrintAll();
-      }
+      updateResponse(bc);
 
       // Perform TuneOnData sampling for MC dE/dx
       float mcTunedTPCSignal = 0.;
@@ -601,9 +710,9 @@ struct tpcPid {
         }
         float bg = trk.tpcInnerParam() / o2::track::pid_constants::sMasses[pid]; // estimated beta-gamma for network cutoff
 
-        if (useNetworkCorrection && speciesNetworkFlags[pid] && trk.has_collision() && bg > networkBetaGammaCutoff) {
-          auto mean = network_prediction[2 * (count_tracks + tracksForNet_size * pid)] * expSignal; // Absolute mean, i.e. the mean dE/dx value of the data in that slice, not the mean of the NSigma distribution
-          auto sigma = (network_prediction[2 * (count_tracks + tracksForNet_size * pid) + 1] - network_prediction[2 * (count_tracks + tracksForNet_size * pid)]) * expSignal;
+        if (useNetworkCorrection && networkSlot[pid] >= 0 && trk.has_collision() && bg > networkBetaGammaCutoff) {
+          auto mean = network_prediction[2 * (count_tracks + tracksForNet_size * networkSlot[pid])] * expSignal; // Absolute mean, i.e. the mean dE/dx value of the data in that slice, not the mean of the NSigma distribution
+          auto sigma = (network_prediction[2 * (count_tracks + tracksForNet_size * networkSlot[pid]) + 1] - network_prediction[2 * (count_tracks + tracksForNet_size * networkSlot[pid])]) * expSignal;
           if (mean < 0.f || sigma < 0.f) {
             mcTunedTPCSignal = -999.f;
           } else {
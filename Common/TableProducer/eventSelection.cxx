@@ -16,6 +16,7 @@
 #include "Common/DataModel/EventSelection.h"
 #include "Common/CCDB/EventSelectionParams.h"
 #include "Common/CCDB/TriggerAliases.h"
+#include "Common/Core/OccupancyCalculator.h"
 #include "CCDB/BasicCCDBManager.h"
 #include "CommonConstants/LHCConstants.h"
 #include "Framework/HistogramRegistry.h"
@@ -26,6 +27,9 @@
 
 #include "TH1D.h"
 
+#include <algorithm>
+#include <vector>
+
 using namespace o2;
 using namespace o2::framework;
 using namespace o2::aod::evsel;
@@ -54,6 +58,19 @@ struct BcSelectionTask {
   int mTimeFrameStartBorderMargin = 300; // default value
   int mTimeFrameEndBorderMargin = 4000;  // default value
 
+  // Run 2 alias: fired if any of its trigger classes is in the trigger mask (first 50 or next 50 classes)
+  struct Run2AliasMasks {
+    uint64_t triggerMask;       // trigger classes of the alias among the first 50 classes
+    uint64_t triggerMaskNext50; // trigger classes of the alias among the next 50 classes
+    uint32_t aliasBit;          // BIT(alias)
+  };
+  int lastRun2RunNumber = -1;                    // run of the cached Run 2 parameters and aliases
+  EventSelectionParams* run2Par = nullptr;       // event selection parameters of lastRun2RunNumber
+  std::vector<Run2AliasMasks> run2AliasMasks;    // dense alias table of lastRun2RunNumber
+  std::vector<uint64_t> run2BCTriggerMask;       // trigger masks of the bc table
+  std::vector<uint64_t> run2BCTriggerMaskNext50; // trigger masks (next 50 classes) of the bc table
+  std::vector<uint32_t> run2BCAlias;             // fired aliases of the bc table
+
   void init(InitContext&)
   {
     // ccdb->setURL("http://ccdb-test.cern.ch:8080");
@@ -79,6 +96,43 @@ struct BcSelectionTask {
     histos.add("hLumiZNCafterBCcuts", ";;Luminosity, 1/#mub", kTH1D, {{1, 0., 1.}});
   }
 
+  /// Fetches the event selection parameters and the trigger aliases when the run changes
+  /// and compiles the alias maps into the dense table run2AliasMasks
+  void updateRun2Parameters(int run, uint64_t timestamp)
+  {
+    if (run == lastRun2RunNumber) {
+      return;
+    }
+    lastRun2RunNumber = run;
+    run2Par = ccdb->getForTimeStamp<EventSelectionParams>("EventSelection/EventSelectionParams", timestamp);
+    TriggerAliases* aliases = ccdb->getForTimeStamp<TriggerAliases>("EventSelection/TriggerAliases", timestamp);
+    run2AliasMasks.clear();
+    for (auto& al : aliases->GetAliasToTriggerMaskMap()) {
+      run2AliasMasks.push_back({al.second, 0, static_cast<uint32_t>(BIT(al.first))});
+    }
+    for (auto& al : aliases->GetAliasToTriggerMaskNext50Map()) {
+      auto it = std::find_if(run2AliasMasks.begin(), run2AliasMasks.end(), [&](const Run2AliasMasks& m) { return m.aliasBit == static_cast<uint32_t>(BIT(al.first)); });
+      if (it != run2AliasMasks.end()) {
+        it->triggerMaskNext50 = al.second;
+      } else {
+        run2AliasMasks.push_back({0, al.second, static_cast<uint32_t>(BIT(al.first))});
+      }
+    }
+  }
+
+  /// Fills fired aliases for bcs [first, last) of the current run, one alias at a time over all bcs
+  void fillRun2Aliases(size_t first, size_t last)
+  {
+    for (size_t i = first; i < last; i++) {
+      run2BCAlias[i] = BIT(kALL);
+    }
+    for (const auto& al : run2AliasMasks) {
+      for (size_t i = first; i < last; i++) {
+        run2BCAlias[i] |= ((run2BCTriggerMask[i] & al.triggerMask) | (run2BCTriggerMaskNext50[i] & al.triggerMaskNext50)) ? al.aliasBit : 0;
+      }
+    }
+  }
+
   void processRun2(
     BCsWithRun2InfosTimestampsAndMatches const& bcs,
     aod::Zdcs const&,
@@ -89,24 +143,30 @@ struct BcSelectionTask {
   {
     bcsel.reserve(bcs.size());
 
+    // fill fired aliases for all bcs, with the alias table updated at run boundaries
+    const size_t nBCs = bcs.size();
+    run2BCTriggerMask.resize(nBCs);
+    run2BCTriggerMaskNext50.resize(nBCs);
+    run2BCAlias.resize(nBCs);
+    size_t firstBCOfRun = 0;
+    size_t i = 0;
     for (auto& bc : bcs) {
-      EventSelectionParams* par = ccdb->getForTimeStamp<EventSelectionParams>("EventSelection/EventSelectionParams", bc.timestamp());
-      TriggerAliases* aliases = ccdb->getForTimeStamp<TriggerAliases>("EventSelection/TriggerAliases", bc.timestamp());
-      // fill fired aliases
-      uint32_t alias{0};
-      uint64_t triggerMask = bc.triggerMask();
-      for (auto& al : aliases->GetAliasToTriggerMaskMap()) {
-        if (triggerMask & al.second) {
-          alias |= BIT(al.first);
-        }
-      }
-      uint64_t triggerMaskNext50 = bc.triggerMaskNext50();
-      for (auto& al : aliases->GetAliasToTriggerMaskNext50Map()) {
-        if (triggerMaskNext50 & al.second) {
-          alias |= BIT(al.first);
-        }
+      if (bc.runNumber() != lastRun2RunNumber) {
+        fillRun2Aliases(firstBCOfRun, i);
+        updateRun2Parameters(bc.runNumber(), bc.timestamp());
+        firstBCOfRun = i;
       }
-      alias |= BIT(kALL);
+      run2BCTriggerMask[i] = bc.triggerMask();
+      run2BCTriggerMaskNext50[i] = bc.triggerMaskNext50();
+      i++;
+    }
+    fillRun2Aliases(firstBCOfRun, nBCs);
+
+    i = 0;
+    for (auto& bc : bcs) {
+      updateRun2Parameters(bc.runNumber(), bc.timestamp());
+      EventSelectionParams* par = run2Par;
+      uint32_t alias = run2BCAlias[i++];
 
       // get timing info from ZDC, FV0, FT0 and FDD
       float timeZNA = bc.has_zdc() ? bc.zdc().timeZNA() : -999.f;
@@ -440,10 +500,14 @@ struct EventSelectionTask {
 
   int lastRun = -1;                                          // last run number (needed to access ccdb only if run!=lastRun)
   std::bitset<o2::constants::lhc::LHCMaxBunches> bcPatternB; // bc pattern of colliding bunches
+  int lastRun2RunNumber = -1;                                // run of the cached Run 2 event selection parameters
+  EventSelectionParams* run2Par = nullptr;                   // event selection parameters of lastRun2RunNumber
 
   int64_t bcSOR = -1;     // global bc of the start of the first orbit
   int64_t nBCsPerTF = -1; // duration of TF in bcs, should be 128*3564 or 32*3564
 
+  OccupancyCalculator occupancyCalculator; // occupancy and nearby-collision estimators in time windows around each collision
+
   int32_t findClosest(int64_t globalBC, std::map<int64_t, int32_t>& bcs)
   {
     auto it = bcs.lower_bound(globalBC);
@@ -479,7 +543,11 @@ struct EventSelectionTask {
   void processRun2(aod::Collision const& col, BCsWithBcSelsRun2 const&, aod::Tracks const&, aod::FV0Cs const&)
   {
     auto bc = col.bc_as<BCsWithBcSelsRun2>();
-    EventSelectionParams* par = ccdb->getForTimeStamp<EventSelectionParams>("EventSelection/EventSelectionParams", bc.timestamp());
+    if (bc.runNumber() != lastRun2RunNumber) {
+      lastRun2RunNumber = bc.runNumber();
+      run2Par = ccdb->getForTimeStamp<EventSelectionParams>("EventSelection/EventSelectionParams", bc.timestamp());
+    }
+    EventSelectionParams* par = run2Par;
     bool* applySelection = par->GetSelection(muonSelection);
     if (isMC) {
       applySelection[kIsBBZAC] = 0;
@@ -703,60 +771,14 @@ struct EventSelectionTask {
       vIsFullInfoForOccupancy[colIndex] = ((bcInTF - 300) * bcNS > -timeWinOccupancyCalcMinNS) && ((nBCsPerTF - 4000 - bcInTF) * bcNS > timeWinOccupancyCalcMaxNS) ? true : false;
     }
 
-    // save indices of collisions in time range for occupancy calculation
-    std::vector<std::vector<int>> vCollsInTimeWin;
-    std::vector<std::vector<float>> vTimeDeltaForColls; // delta time wrt a given collision
-    for (auto& col : cols) {
-      int32_t colIndex = col.globalIndex();
-      std::vector<int> vAssocToThisCol;
-      std::vector<float> vCollsTimeDeltaWrtGivenColl;
-
-      // protection against the TF borders
-      if (!vIsFullInfoForOccupancy[colIndex]) {
-        vCollsInTimeWin.push_back(vAssocToThisCol);
-        vTimeDeltaForColls.push_back(vCollsTimeDeltaWrtGivenColl);
-        continue;
-      }
-
-      int64_t foundGlobalBC = vFoundGlobalBC[colIndex];
-      int64_t TFid = (foundGlobalBC - bcSOR) / nBCsPerTF;
-
-      // find all collisions in time window before the current one (start with the current collision)
-      int32_t minColIndex = colIndex;
-      while (minColIndex >= 0) {
-        int64_t thisBC = vFoundGlobalBC[minColIndex];
-        // check if this is still the same TF
-        int64_t thisTFid = (thisBC - bcSOR) / nBCsPerTF;
-        if (thisTFid != TFid)
-          break;
-        float dt = (thisBC - foundGlobalBC) * bcNS; // ns
-
-        // check if we are within the chosen time range
-        if (dt < timeWinOccupancyCalcMinNS)
-          break;
-        vAssocToThisCol.push_back(minColIndex);
-        vCollsTimeDeltaWrtGivenColl.push_back(dt);
-        minColIndex--;
-      }
-      // find all collisions in time window after the current one
-      int32_t maxColIndex = colIndex + 1;
-      while (maxColIndex < cols.size()) {
-        int64_t thisBC = vFoundGlobalBC[maxColIndex];
-        int64_t thisTFid = (thisBC - bcSOR) / nBCsPerTF;
-        if (thisTFid != TFid)
-          break;
-        float dt = (thisBC - foundGlobalBC) * bcNS; // ns
-        if (dt > timeWinOccupancyCalcMaxNS)
-          break;
-        vAssocToThisCol.push_back(maxColIndex);
-        vCollsTimeDeltaWrtGivenColl.push_back(dt);
-        maxColIndex++;
-      }
-      vCollsInTimeWin.push_back(vAssocToThisCol);
-      vTimeDeltaForColls.push_back(vCollsTimeDeltaWrtGivenColl);
-    }
-
     // perform the occupancy calculation in the pre-defined time window
+    occupancyCalculator.setTimeWindow(timeWinOccupancyCalcMinNS, timeWinOccupancyCalcMaxNS);
+    occupancyCalculator.setTimeFrame(bcSOR, nBCsPerTF);
+    occupancyCalculator.setTimeBins(confTimeBinsForOccupancyCalculation.value);
+    occupancyCalculator.setVetoRanges(confTimeRangeVetoOnCollStandard, confTimeRangeVetoOnCollNarrow);
+    occupancyCalculator.setUseWeights(confUseWeightsForOccupancyVariable);
+    occupancyCalculator.calculate(vFoundGlobalBC, vTracksITS567perColl, vIsFullInfoForOccupancy);
+
     std::vector<int> vNumTracksITS567inFullTimeWin(cols.size(), 0); // counter of tracks in full time window for occupancy studies
     std::vector<bool> vNoOccupAggressiveCuts(cols.size(), 0);       // no occupancy according to the agressive cuts
     std::vector<bool> vNoOccupStrictCuts(cols.size(), 0);           // no occupancy according to the strict cuts
@@ -777,43 +799,11 @@ struct EventSelectionTask {
         vNumTracksITS567inFullTimeWin[colIndex] = -1; // occupancy in undefined (too close to TF borders)
         continue;
       }
-      std::vector<int> vAssocToThisCol = vCollsInTimeWin[colIndex];
-      std::vector<float> vCollsTimeDeltaWrtGivenColl = vTimeDeltaForColls[colIndex];
-      int nITS567tracksInFullTimeWindow = 0;
       int nITS567tracksInTimeBins[nTimeIntervals] = {};
-      int nITS567tracksForVetoStandard = 0; // to veto events with nearby collisions
-      int nITS567tracksForVetoNarrow = 0;   // to veto events with nearby collisions (narrower range)
-      for (int iCol = 0; iCol < vAssocToThisCol.size(); iCol++) {
-        int thisColIndex = vAssocToThisCol[iCol];
-        if (thisColIndex == colIndex) // skip the same collision
-          continue;
-        float dt = vCollsTimeDeltaWrtGivenColl[iCol] / 1e3; // ns -> us
-
-        if (!confUseWeightsForOccupancyVariable) {
-          nITS567tracksInFullTimeWindow += vTracksITS567perColl[thisColIndex];
-        } else {
-          // weighted occupancy
-          float wOccup = 0;
-          if (dt >= -40 && dt < -5) // collisions in the past
-            wOccup = 1. / 1225 * (dt + 40) * (dt + 40);
-          else if (dt >= -5 && dt < 15) // collisions near a given one
-            wOccup = 1;
-          else if (dt >= 15 && dt < 100) // collisions from the future
-            wOccup = -1. / 85 * dt + 20. / 17;
-          if (wOccup > 0)
-            nITS567tracksInFullTimeWindow += wOccup * vTracksITS567perColl[thisColIndex];
-        }
-
-        for (int iTime = 0; iTime < nTimeIntervals; iTime++) {
-          if (confTimeBinsForOccupancyCalculation->at(iTime) < dt && dt <= confTimeBinsForOccupancyCalculation->at(iTime + 1))
-            nITS567tracksInTimeBins[iTime] += vTracksITS567perColl[thisColIndex];
-          if (fabs(dt) < confTimeRangeVetoOnCollStandard)
-            nITS567tracksForVetoStandard += vTracksITS567perColl[thisColIndex];
-          if (fabs(dt) < confTimeRangeVetoOnCollNarrow)
-            nITS567tracksForVetoNarrow += vTracksITS567perColl[thisColIndex];
-        }
+      for (int iTime = 0; iTime < nTimeIntervals; iTime++) {
+        nITS567tracksInTimeBins[iTime] = occupancyCalculator.getTracksInTimeBin(colIndex, iTime);
       }
-      vNumTracksITS567inFullTimeWin[colIndex] = nITS567tracksInFullTimeWindow; // occupancy (without a current collision)
+      vNumTracksITS567inFullTimeWin[colIndex] = occupancyCalculator.getOccupancy(colIndex); // occupancy (without a current collision)
 
       // decisions based on occupancies in time bins
       bool decisions[4];
@@ -827,8 +817,8 @@ struct EventSelectionTask {
       vNoOccupRelaxedCuts[colIndex] = decisions[2];
       vNoOccupGentleCuts[colIndex] = decisions[3];
       vNoOccupAggressiveCuts[colIndex] = ((nITS567tracksInTimeBins[0] < 300) && (nITS567tracksInTimeBins[1] == 0) && (nITS567tracksInTimeBins[2] == 0) && (nITS567tracksInTimeBins[3] == 0) && (nITS567tracksInTimeBins[4] < 200) && (nITS567tracksInTimeBins[5] < 400));
-      vNoCollInTimeRangeStandard[colIndex] = (nITS567tracksForVetoStandard == 0);
-      vNoCollInTimeRangeNarrow[colIndex] = (nITS567tracksForVetoNarrow == 0);
+      vNoCollInTimeRangeStandard[colIndex] = occupancyCalculator.getNoCollInTimeRangeStandard(colIndex);
+      vNoCollInTimeRangeNarrow[colIndex] = occupancyCalculator.getNoCollInTimeRangeNarrow(colIndex);
     }
 
     for (auto& col : cols) {
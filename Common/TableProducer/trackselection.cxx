@@ -22,6 +22,7 @@
 #include "Framework/runDataProcessing.h"
 #include "Common/Core/TrackSelection.h"
 #include "Common/Core/TrackSelectionDefaults.h"
+#include "Common/Core/TrackSelectionEvaluator.h"
 #include "Common/DataModel/TrackSelectionTables.h"
 #include "Common/Core/trackUtilities.h"
 #include "TableHelper.h"
@@ -57,6 +58,9 @@ struct TrackSelectionTask {
   TrackSelection filtBit3;
   TrackSelection filtBit4;
   TrackSelection filtBit5;
+  // all the selections above, evaluated at once over the whole track table
+  TrackSelectionEvaluator evaluator;
+  int idxGlobalTracks = -1, idxGlobalTracksSDD = -1, idxFiltBit1 = -1, idxFiltBit2 = -1, idxFiltBit3 = -1, idxFiltBit4 = -1, idxFiltBit5 = -1;
 
   void init(InitContext& initContext)
   {
@@ -135,6 +139,14 @@ struct TrackSelectionTask {
 
     LOG(info) << "setting up filtBit5 = getJEGlobalTrackSelectionRun2();";
     filtBit5 = getJEGlobalTrackSelectionRun2(); // Jet validation requires reduced set of cuts
+
+    idxGlobalTracks = evaluator.addSelection(globalTracks);
+    idxGlobalTracksSDD = evaluator.addSelection(globalTracksSDD);
+    idxFiltBit1 = evaluator.addSelection(filtBit1);
+    idxFiltBit2 = evaluator.addSelection(filtBit2);
+    idxFiltBit3 = evaluator.addSelection(filtBit3);
+    idxFiltBit4 = evaluator.addSelection(filtBit4);
+    idxFiltBit5 = evaluator.addSelection(filtBit5);
   }
 
   void process(soa::Join<aod::FullTracks, aod::TracksDCA> const& tracks)
@@ -148,25 +160,28 @@ struct TrackSelectionTask {
     if (produceTable == 0 && produceFBextendedTable == 0) {
       return;
     }
+    evaluator.evaluate(tracks);
+    const auto& masksGlob = evaluator.getMasks(idxGlobalTracks);
+    const int nTracks = tracks.size();
     if (isRun3) {
-      for (auto& track : tracks) {
+      for (int iTrack = 0; iTrack < nTracks; iTrack++) {
 
         if (produceTable == 1) {
           filterTable((uint8_t)0,
-                      globalTracks.IsSelectedMask(track),
-                      filtBit1.IsSelected(track),
-                      filtBit2.IsSelected(track),
-                      filtBit3.IsSelected(track),
-                      filtBit4.IsSelected(track),
-                      filtBit5.IsSelected(track));
+                      masksGlob[iTrack],
+                      evaluator.isSelected(idxFiltBit1, iTrack),
+                      evaluator.isSelected(idxFiltBit2, iTrack),
+                      evaluator.isSelected(idxFiltBit3, iTrack),
+                      evaluator.isSelected(idxFiltBit4, iTrack),
+                      evaluator.isSelected(idxFiltBit5, iTrack));
         }
         if (produceFBextendedTable == 1) {
-          o2::aod::track::TrackSelectionFlags::flagtype trackflagGlob = globalTracks.IsSelectedMask(track);
-          o2::aod::track::TrackSelectionFlags::flagtype trackflagFB1 = filtBit1.IsSelectedMask(track);
-          o2::aod::track::TrackSelectionFlags::flagtype trackflagFB2 = filtBit2.IsSelectedMask(track);
-          // o2::aod::track::TrackSelectionFlags::flagtype trackflagFB3 = filtBit3.IsSelectedMask(track); // only temporarily commented, will be used
-          // o2::aod::track::TrackSelectionFlags::flagtype trackflagFB4 = filtBit4.IsSelectedMask(track);
-          // o2::aod::track::TrackSelectionFlags::flagtype trackflagFB5 = filtBit5.IsSelectedMask(track);
+          o2::aod::track::TrackSelectionFlags::flagtype trackflagGlob = masksGlob[iTrack];
+          o2::aod::track::TrackSelectionFlags::flagtype trackflagFB1 = evaluator.getMask(idxFiltBit1, iTrack);
+          o2::aod::track::TrackSelectionFlags::flagtype trackflagFB2 = evaluator.getMask(idxFiltBit2, iTrack);
+          // o2::aod::track::TrackSelectionFlags::flagtype trackflagFB3 = evaluator.getMask(idxFiltBit3, iTrack); // only temporarily commented, will be used
+          // o2::aod::track::TrackSelectionFlags::flagtype trackflagFB4 = evaluator.getMask(idxFiltBit4, iTrack);
+          // o2::aod::track::TrackSelectionFlags::flagtype trackflagFB5 = evaluator.getMask(idxFiltBit5, iTrack);
 
           filterTableDetail(o2::aod::track::TrackSelectionFlags::checkFlag(trackflagGlob, o2::aod::track::TrackSelectionFlags::kTrackType),
                             o2::aod::track::TrackSelectionFlags::checkFlag(trackflagGlob, o2::aod::track::TrackSelectionFlags::kPtRange),
@@ -190,16 +205,16 @@ struct TrackSelectionTask {
       return;
     }
 
-    for (auto& track : tracks) {
-      o2::aod::track::TrackSelectionFlags::flagtype trackflagGlob = globalTracks.IsSelectedMask(track);
+    for (int iTrack = 0; iTrack < nTracks; iTrack++) {
+      o2::aod::track::TrackSelectionFlags::flagtype trackflagGlob = masksGlob[iTrack];
       if (produceTable == 1) {
-        filterTable((uint8_t)globalTracksSDD.IsSelected(track),
-                    globalTracks.IsSelectedMask(track),
-                    filtBit1.IsSelected(track),
-                    filtBit2.IsSelected(track),
-                    filtBit3.IsSelected(track),
-                    filtBit4.IsSelected(track),
-                    filtBit5.IsSelected(track));
+        filterTable((uint8_t)evaluator.isSelected(idxGlobalTracksSDD, iTrack),
+                    trackflagGlob,
+                    evaluator.isSelected(idxFiltBit1, iTrack),
+                    evaluator.isSelected(idxFiltBit2, iTrack),
+                    evaluator.isSelected(idxFiltBit3, iTrack),
+                    evaluator.isSelected(idxFiltBit4, iTrack),
+                    evaluator.isSelected(idxFiltBit5, iTrack));
       }
       if (produceFBextendedTable == 1) {
         filterTableDetail(o2::aod::track::TrackSelectionFlags::checkFlag(trackflagGlob, o2::aod::track::TrackSelectionFlags::kTrackType),
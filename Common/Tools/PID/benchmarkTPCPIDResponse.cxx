@@ -0,0 +1,103 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+
+///
+/// \file   benchmarkTPCPIDResponse.cxx
+/// \brief  exec to compare the single track and the batch evaluation of the TPC PID response (timing and results)
+///
+
+#include <chrono>
+#include <cstring>
+#include <vector>
+
+#include "TRandom3.h"
+#include "Common/Core/PID/TPCPIDResponse.h"
+
+using namespace o2;
+
+/// Minimal track and collision interfaces used by the single track methods of the response
+struct BenchmarkTrack {
+  float mTPCInnerParam, mTgl, mSigned1Pt, mTPCSignal;
+  int mTPCNClsFound;
+  bool hasTPC() const { return true; }
+  float tpcInnerParam() const { return mTPCInnerParam; }
+  float tgl() const { return mTgl; }
+  float signed1Pt() const { return mSigned1Pt; }
+  float tpcSignal() const { return mTPCSignal; }
+  int tpcNClsFound() const { return mTPCNClsFound; }
+};
+
+struct BenchmarkCollision {
+  int mMultTPC;
+  int multTPC() const { return mMultTPC; }
+};
+
+bool process(const bool useDefaultResolution, const int ntracks, const int nrepetitions)
+{
+  pid::tpc::Response response;
+  response.SetUseDefaultResolutionParam(useDefaultResolution);
+
+  TRandom3 rng(1234);
+  std::vector<BenchmarkTrack> tracks(ntracks);
+  std::vector<BenchmarkCollision> collisions(ntracks);
+  std::vector<float> tpcSignal(ntracks), tpcInnerParam(ntracks), tgl(ntracks), nCls(ntracks), signed1Pt(ntracks), multTPC(ntracks);
+  for (int i = 0; i < ntracks; i++) {
+    tracks[i] = {static_cast<float>(rng.Uniform(0.05, 5.)), static_cast<float>(rng.Uniform(-1., 1.)), static_cast<float>(rng.Uniform(-10., 10.)), static_cast<float>(rng.Uniform(30., 200.)), static_cast<int>(rng.Uniform(60, 159))};
+    collisions[i] = {static_cast<int>(rng.Uniform(0, 10000))};
+    tpcSignal[i] = tracks[i].tpcSignal();
+    tpcInnerParam[i] = tracks[i].tpcInnerParam();
+    tgl[i] = tracks[i].tgl();
+    nCls[i] = tracks[i].tpcNClsFound();
+    signed1Pt[i] = tracks[i].signed1Pt();
+    multTPC[i] = collisions[i].multTPC();
+  }
+
+  const std::vector<track::PID::ID> species{track::PID::Electron, track::PID::Muon, track::PID::Pion, track::PID::Kaon, track::PID::Proton, track::PID::Deuteron, track::PID::Triton, track::PID::Helium3, track::PID::Alpha};
+  const int nspecies = species.size();
+  std::vector<float> nSigmaScalar(ntracks * nspecies);
+  std::vector<float> nSigmaBatch(ntracks * nspecies);
+
+  auto start = std::chrono::high_resolution_clock::now();
+  for (int r = 0; r < nrepetitions; r++) {
+    for (int s = 0; s < nspecies; s++) {
+      for (int i = 0; i < ntracks; i++) {
+        nSigmaScalar[s * ntracks + i] = response.GetNumberOfSigma(collisions[i], tracks[i], species[s]);
+      }
+    }
+  }
+  const float durationScalar = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+  start = std::chrono::high_resolution_clock::now();
+  for (int r = 0; r < nrepetitions; r++) {
+    response.GetNumberOfSigmaBatch(tpcSignal, tpcInnerParam, tgl, nCls, signed1Pt, multTPC, species, nSigmaBatch);
+  }
+  const float durationBatch = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+  int nMismatches = 0;
+  for (int i = 0; i < ntracks * nspecies; i++) {
+    if (std::memcmp(&nSigmaScalar[i], &nSigmaBatch[i], sizeof(float)) != 0) {
+      nMismatches++;
+    }
+  }
+  LOGP(info, "Default resolution = {}: scalar {:.2f} ms, batch {:.2f} ms, speed-up {:.2f}, mismatches {}", useDefaultResolution, durationScalar, durationBatch, durationScalar / durationBatch, nMismatches);
+  return nMismatches == 0;
+}
+
+int main(int /*argc*/, char* /*argv*/[])
+{
+  LOG(info) << "Comparing the single track and the batch evaluation of the TPC PID response.";
+  for (const bool useDefaultResolution : {true, false}) {
+    if (!process(useDefaultResolution, 100000, 10)) {
+      LOG(fatal) << "Single track and batch evaluation of the TPC PID response differ.";
+    }
+  }
+  LOG(info) << "Single track and batch evaluation of the TPC PID response agree.";
+} // main
@@ -0,0 +1,201 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+
+///
+/// \file   checkOccupancyCalculator.cxx
+/// \brief  exec to check that the occupancy estimators of the event selection are identical to the reference per-collision window implementation
+///
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "Framework/Logger.h"
+#include "Common/Core/OccupancyCalculator.h"
+
+using namespace o2::aod::evsel;
+
+struct ReferenceResult {
+  std::vector<int> occupancy;
+  std::vector<std::vector<int>> tracksInTimeBins;
+  std::vector<bool> noCollStandard;
+  std::vector<bool> noCollNarrow;
+};
+
+/// Reference implementation: vectors of collisions in the time window of each collision, as originally in the event selection
+ReferenceResult calculateReference(const std::vector<int64_t>& vFoundGlobalBC, const std::vector<int>& vTracksITS567perColl, const std::vector<bool>& vIsFullInfoForOccupancy,
+                                   int64_t bcSOR, int64_t nBCsPerTF, float timeWinOccupancyCalcMinNS, float timeWinOccupancyCalcMaxNS, const std::vector<float>& timeBins,
+                                   float vetoStandard, float vetoNarrow, bool useWeights)
+{
+  const double bcNS = o2::constants::lhc::LHCBunchSpacingNS;
+  const int nColls = vFoundGlobalBC.size();
+  std::vector<std::vector<int>> vCollsInTimeWin;
+  std::vector<std::vector<float>> vTimeDeltaForColls;
+  for (int colIndex = 0; colIndex < nColls; colIndex++) {
+    std::vector<int> vAssocToThisCol;
+    std::vector<float> vCollsTimeDeltaWrtGivenColl;
+    if (!vIsFullInfoForOccupancy[colIndex]) {
+      vCollsInTimeWin.push_back(vAssocToThisCol);
+      vTimeDeltaForColls.push_back(vCollsTimeDeltaWrtGivenColl);
+      continue;
+    }
+    int64_t foundGlobalBC = vFoundGlobalBC[colIndex];
+    int64_t TFid = (foundGlobalBC - bcSOR) / nBCsPerTF;
+    int32_t minColIndex = colIndex;
+    while (minColIndex >= 0) {
+      int64_t thisBC = vFoundGlobalBC[minColIndex];
+      int64_t thisTFid = (thisBC - bcSOR) / nBCsPerTF;
+      if (thisTFid != TFid)
+        break;
+      float dt = (thisBC - foundGlobalBC) * bcNS;
+      if (dt < timeWinOccupancyCalcMinNS)
+        break;
+      vAssocToThisCol.push_back(minColIndex);
+      vCollsTimeDeltaWrtGivenColl.push_back(dt);
+      minColIndex--;
+    }
+    int32_t maxColIndex = colIndex + 1;
+    while (maxColIndex < nColls) {
+      int64_t thisBC = vFoundGlobalBC[maxColIndex];
+      int64_t thisTFid = (thisBC - bcSOR) / nBCsPerTF;
+      if (thisTFid != TFid)
+        break;
+      float dt = (thisBC - foundGlobalBC) * bcNS;
+      if (dt > timeWinOccupancyCalcMaxNS)
+        break;
+      vAssocToThisCol.push_back(maxColIndex);
+      vCollsTimeDeltaWrtGivenColl.push_back(dt);
+      maxColIndex++;
+    }
+    vCollsInTimeWin.push_back(vAssocToThisCol);
+    vTimeDeltaForColls.push_back(vCollsTimeDeltaWrtGivenColl);
+  }
+
+  const int nTimeIntervals = timeBins.size() - 1;
+  ReferenceResult result;
+  result.occupancy.assign(nColls, 0);
+  result.tracksInTimeBins.assign(nColls, std::vector<int>(nTimeIntervals, 0));
+  result.noCollStandard.assign(nColls, false);
+  result.noCollNarrow.assign(nColls, false);
+  for (int colIndex = 0; colIndex < nColls; colIndex++) {
+    if (!vIsFullInfoForOccupancy[colIndex]) {
+      result.occupancy[colIndex] = -1;
+      continue;
+    }
+    std::vector<int> vAssocToThisCol = vCollsInTimeWin[colIndex];
+    std::vector<float> vCollsTimeDeltaWrtGivenColl = vTimeDeltaForColls[colIndex];
+    int nITS567tracksInFullTimeWindow = 0;
+    int nITS567tracksForVetoStandard = 0;
+    int nITS567tracksForVetoNarrow = 0;
+    for (size_t iCol = 0; iCol < vAssocToThisCol.size(); iCol++) {
+      int thisColIndex = vAssocToThisCol[iCol];
+      if (thisColIndex == colIndex)
+        continue;
+      float dt = vCollsTimeDeltaWrtGivenColl[iCol] / 1e3;
+      if (!useWeights) {
+        nITS567tracksInFullTimeWindow += vTracksITS567perColl[thisColIndex];
+      } else {
+        float wOccup = 0;
+        if (dt >= -40 && dt < -5)
+          wOccup = 1. / 1225 * (dt + 40) * (dt + 40);
+        else if (dt >= -5 && dt < 15)
+          wOccup = 1;
+        else if (dt >= 15 && dt < 100)
+          wOccup = -1. / 85 * dt + 20. / 17;
+        if (wOccup > 0)
+          nITS567tracksInFullTimeWindow += wOccup * vTracksITS567perColl[thisColIndex];
+      }
+      for (int iTime = 0; iTime < nTimeIntervals; iTime++) {
+        if (timeBins[iTime] < dt && dt <= timeBins[iTime + 1])
+          result.tracksInTimeBins[colIndex][iTime] += vTracksITS567perColl[thisColIndex];
+        if (std::fabs(dt) < vetoStandard)
+          nITS567tracksForVetoStandard += vTracksITS567perColl[thisColIndex];
+        if (std::fabs(dt) < vetoNarrow)
+          nITS567tracksForVetoNarrow += vTracksITS567perColl[thisColIndex];
+      }
+    }
+    result.occupancy[colIndex] = nITS567tracksInFullTimeWindow;
+    result.noCollStandard[colIndex] = (nITS567tracksForVetoStandard == 0);
+    result.noCollNarrow[colIndex] = (nITS567tracksForVetoNarrow == 0);
+  }
+  return result;
+}
+
+/// Generates time frames with a given collision rate and compares the calculator with the reference
+bool process(std::mt19937& rng, int nColls, double meanSpacingBC, bool sorted, bool useWeights)
+{
+  const int64_t nBCsPerTF = 32 * o2::constants::lhc::LHCMaxBunches;
+  const int64_t bcSOR = 1000;
+  const float timeWinMinNS = -40e3;
+  const float timeWinMaxNS = 100e3;
+  const std::vector<float> timeBins = {-40, -20, 0, 25, 50, 75, 100};
+  const float vetoStandard = 10;
+  const float vetoNarrow = 4;
+
+  std::exponential_distribution<double> spacing(1. / meanSpacingBC);
+  std::uniform_int_distribution<int> tracks(0, 3000);
+  std::uniform_int_distribution<int> jitter(-50, 50);
+  std::vector<int64_t> globalBC(nColls);
+  std::vector<int> nTracks(nColls);
+  std::vector<bool> isFullInfo(nColls);
+  double bc = bcSOR;
+  for (int i = 0; i < nColls; i++) {
+    bc += (i % 7 == 0) ? 0. : spacing(rng); // some collisions in the same BC
+    globalBC[i] = static_cast<int64_t>(bc) + (sorted ? 0 : jitter(rng));
+    nTracks[i] = (i % 11 == 0) ? 0 : tracks(rng);
+    const int64_t bcInTF = (globalBC[i] - bcSOR) % nBCsPerTF;
+    isFullInfo[i] = ((bcInTF - 300) * o2::constants::lhc::LHCBunchSpacingNS > -timeWinMinNS) && ((nBCsPerTF - 4000 - bcInTF) * o2::constants::lhc::LHCBunchSpacingNS > timeWinMaxNS);
+  }
+
+  OccupancyCalculator calculator;
+  calculator.setTimeWindow(timeWinMinNS, timeWinMaxNS);
+  calculator.setTimeFrame(bcSOR, nBCsPerTF);
+  calculator.setTimeBins(timeBins);
+  calculator.setVetoRanges(vetoStandard, vetoNarrow);
+  calculator.setUseWeights(useWeights);
+  calculator.calculate(globalBC, nTracks, isFullInfo);
+
+  const auto reference = calculateReference(globalBC, nTracks, isFullInfo, bcSOR, nBCsPerTF, timeWinMinNS, timeWinMaxNS, timeBins, vetoStandard, vetoNarrow, useWeights);
+  int nMismatches = 0;
+  for (int i = 0; i < nColls; i++) {
+    bool ok = calculator.getOccupancy(i) == reference.occupancy[i];
+    ok = ok && calculator.getNoCollInTimeRangeStandard(i) == reference.noCollStandard[i];
+    ok = ok && calculator.getNoCollInTimeRangeNarrow(i) == reference.noCollNarrow[i];
+    for (int iBin = 0; iBin < calculator.getNTimeBins(); iBin++) {
+      ok = ok && calculator.getTracksInTimeBin(i, iBin) == reference.tracksInTimeBins[i][iBin];
+    }
+    if (!ok) {
+      nMismatches++;
+    }
+  }
+  LOGP(info, "{} collisions, mean spacing {} BCs, sorted = {}, weights = {}: {} mismatches", nColls, meanSpacingBC, sorted, useWeights, nMismatches);
+  return nMismatches == 0;
+}
+
+int main(int /*argc*/, char* /*argv*/[])
+{
+  LOG(info) << "Checking the occupancy estimators of the event selection against the reference implementation.";
+  std::mt19937 rng(42);
+  bool allOk = true;
+  for (const double meanSpacingBC : {20., 200., 2000.}) {
+    for (const bool sorted : {true, false}) {
+      for (const bool useWeights : {true, false}) {
+        allOk = process(rng, 20000, meanSpacingBC, sorted, useWeights) && allOk;
+      }
+    }
+  }
+  if (allOk) {
+    LOG(info) << "Occupancy estimators are identical to the reference implementation.";
+  } else {
+    LOG(fatal) << "Occupancy estimators differ from the reference implementation.";
+  }
+} // main
@@ -12,7 +12,9 @@
 
 #include "Zorro.h"
 
+#include <algorithm>
 #include <map>
+#include <numeric>
 
 #include "TH1D.h"
 
@@ -35,17 +37,26 @@ std::vector<int> Zorro::initCCDB(o2::ccdb::BasicCCDBManager* ccdb, int runNumber
   mSelections = mCCDB->getSpecific<TH1D>(mBaseCCDBPath + "SelectionCounters", timestamp, metadata);
   mInspectedTVX = mCCDB->getSpecific<TH1D>(mBaseCCDBPath + "InspectedTVX", timestamp, metadata);
   auto selectedBCs = mCCDB->getSpecific<std::vector<std::array<uint64_t, 2>>>(mBaseCCDBPath + "SelectedBCs", timestamp, metadata);
+  mSelectionBitMask = mCCDB->getSpecific<std::vector<std::array<uint64_t, 2>>>(mBaseCCDBPath + "SelectionBitMask", timestamp, metadata);
+  mFilterBitMask = mCCDB->getSpecific<std::vector<std::array<uint64_t, 2>>>(mBaseCCDBPath + "FilterBitMask", timestamp, metadata);
+
+  /// sort the ranges by start, keeping the filter bits of each range
+  std::vector<size_t> order(selectedBCs->size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return std::min((*selectedBCs)[a][0], (*selectedBCs)[a][1]) < std::min((*selectedBCs)[b][0], (*selectedBCs)[b][1]); });
   mBCranges.clear();
-  for (auto bc : *selectedBCs) {
+  mBCrangesMaxEnd.clear();
+  mBCrangesFilterBits.clear();
+  uint64_t maxEnd = 0;
+  for (auto i : order) {
+    const auto& bc = (*selectedBCs)[i];
     mBCranges.emplace_back(InteractionRecord::long2IR(std::min(bc[0], bc[1])), InteractionRecord::long2IR(std::max(bc[0], bc[1])));
+    maxEnd = std::max(maxEnd, std::max(bc[0], bc[1]));
+    mBCrangesMaxEnd.push_back(maxEnd);
+    mBCrangesFilterBits.push_back(mFilterBitMask->at(i));
   }
-  std::sort(mBCranges.begin(), mBCranges.end(), [](const auto& a, const auto& b) { return a.getMin() < b.getMin(); });
 
-  mSelectionBitMask = mCCDB->getSpecific<std::vector<std::array<uint64_t, 2>>>(mBaseCCDBPath + "SelectionBitMask", timestamp, metadata);
-  mFilterBitMask = mCCDB->getSpecific<std::vector<std::array<uint64_t, 2>>>(mBaseCCDBPath + "FilterBitMask", timestamp, metadata);
-
-  mLastBCglobalId = 0;
-  mLastSelectedIdx = 0;
+  mLastSelectedIdx = -1;
   mTOIs.clear();
   mTOIidx.clear();
   size_t pos = 0;
@@ -63,38 +74,47 @@ std::vector<int> Zorro::initCCDB(o2::ccdb::BasicCCDBManager* ccdb, int runNumber
   return mTOIidx;
 }
 
-std::bitset<128> Zorro::fetch(uint64_t bcGlobalId, uint64_t tolerance)
+int Zorro::findRange(uint64_t bcGlobalId, uint64_t tolerance) const
 {
-  std::bitset<128> result;
   o2::dataformats::IRFrame bcFrame{InteractionRecord::long2IR(bcGlobalId) - tolerance, InteractionRecord::long2IR(bcGlobalId) + tolerance};
-  if (bcGlobalId < mLastBCglobalId) {
-    mLastSelectedIdx = 0;
-  }
-  for (size_t i = mLastSelectedIdx; i < mBCranges.size(); i++) {
+  const uint64_t frameMin = bcFrame.getMin().toLong();
+  const uint64_t frameMax = bcFrame.getMax().toLong();
+  /// the first range which can overlap with the frame is the first one whose running maximum end reaches the frame
+  size_t i = std::lower_bound(mBCrangesMaxEnd.begin(), mBCrangesMaxEnd.end(), frameMin) - mBCrangesMaxEnd.begin();
+  for (; i < mBCranges.size() && static_cast<uint64_t>(mBCranges[i].getMin().toLong()) <= frameMax; ++i) {
     if (!bcFrame.getOverlap(mBCranges[i]).isZeroLength()) {
-      for (int iMask{0}; iMask < 2; ++iMask) {
-        for (int iTOI{0}; iTOI < 64; ++iTOI) {
-          result.set(iMask * 64 + iTOI, mFilterBitMask->at(i)[iMask] & (1ull << iTOI));
-        }
-      }
-      mLastSelectedIdx = i;
-      return result;
+      return i;
     }
   }
-  return result;
+  return -1;
+}
+
+std::bitset<128> Zorro::fetch(uint64_t bcGlobalId, uint64_t tolerance) const
+{
+  int idx = findRange(bcGlobalId, tolerance);
+  if (idx < 0) {
+    return {};
+  }
+  const auto& bits = mBCrangesFilterBits[idx];
+  return (std::bitset<128>(bits[1]) << 64) | std::bitset<128>(bits[0]);
 }
 
 bool Zorro::isSelected(uint64_t bcGlobalId, uint64_t tolerance)
 {
-  int lastSelectedIdx = mLastSelectedIdx;
-  std::bitset<128> result = fetch(bcGlobalId, tolerance);
+  int idx = findRange(bcGlobalId, tolerance);
+  if (idx < 0) {
+    return false;
+  }
+  const auto& bits = mBCrangesFilterBits[idx];
+  bool isNewRange = idx != mLastSelectedIdx;
+  mLastSelectedIdx = idx;
   for (size_t i{0}; i < mTOIidx.size(); ++i) {
     if (mTOIidx[i] < 0) {
       continue;
-    } else if (result.test(mTOIidx[i])) {
-      mTOIcounts[i] += (lastSelectedIdx != mLastSelectedIdx); /// Avoid double counting
+    } else if (bits[mTOIidx[i] / 64] & (1ull << (mTOIidx[i] % 64))) {
+      mTOIcounts[i] += isNewRange; /// Avoid double counting
       return true;
     }
   }
   return false;
-}
\ No newline at end of file
+}
@@ -14,6 +14,7 @@
 #ifndef EVENTFILTERING_ZORRO_H_
 #define EVENTFILTERING_ZORRO_H_
 
+#include <array>
 #include <bitset>
 #include <string>
 #include <vector>
@@ -34,7 +35,7 @@ class Zorro
  public:
   Zorro() = default;
   std::vector<int> initCCDB(o2::ccdb::BasicCCDBManager* ccdb, int runNumber, uint64_t timestamp, std::string tois, int bcTolerance = 500);
-  std::bitset<128> fetch(uint64_t bcGlobalId, uint64_t tolerance = 100);
+  std::bitset<128> fetch(uint64_t bcGlobalId, uint64_t tolerance = 100) const;
   bool isSelected(uint64_t bcGlobalId, uint64_t tolerance = 100);
 
   std::vector<int> getTOIcounters() const { return mTOIcounts; }
@@ -44,15 +45,18 @@ class Zorro
   void setBCtolerance(int tolerance) { mBCtolerance = tolerance; }
 
  private:
+  int findRange(uint64_t bcGlobalId, uint64_t tolerance) const;
+
   std::string mBaseCCDBPath = "Users/m/mpuccio/EventFiltering/OTS/";
   int mRunNumber = 0;
   int mBCtolerance = 100;
-  uint64_t mLastBCglobalId = 0;
-  uint64_t mLastSelectedIdx = 0;
+  int mLastSelectedIdx = -1;
   TH1D* mScalers = nullptr;
   TH1D* mSelections = nullptr;
   TH1D* mInspectedTVX = nullptr;
   std::vector<o2::dataformats::IRFrame> mBCranges;
+  std::vector<uint64_t> mBCrangesMaxEnd;
+  std::vector<std::array<uint64_t, 2>> mBCrangesFilterBits;
   std::vector<std::array<uint64_t, 2>>* mFilterBitMask = nullptr;
   std::vector<std::array<uint64_t, 2>>* mSelectionBitMask = nullptr;
   std::vector<std::string> mTOIs;
@@ -16,6 +16,10 @@
 #ifndef PWGCF_FEMTODREAM_CORE_FEMTODREAMDETADPHISTAR_H_
 #define PWGCF_FEMTODREAM_CORE_FEMTODREAMDETADPHISTAR_H_
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
 #include <memory>
 #include <string>
 #include <vector>
@@ -63,6 +67,7 @@ class FemtoDreamDetaDphiStar
     atWhichRadiiToSelect = atWhichRadiiToCut;
     radiiTPC = radiiTPCtoCut;
     fillQA = fillTHSparse;
+    mCacheMagField.clear(); // invalidate phi* computed with previous settings
 
     if constexpr (mPartOneType == o2::aod::femtodreamparticle::ParticleType::kTrack && mPartTwoType == o2::aod::femtodreamparticle::ParticleType::kTrack) {
       std::string dirName = static_cast<std::string>(dirNames[0]);
@@ -430,15 +435,23 @@ class FemtoDreamDetaDphiStar
   std::array<std::shared_ptr<THnSparse>, 3> histdetadpi_eta{};
   std::array<std::shared_ptr<THnSparse>, 3> histdetadpi_phi{};
 
-  ///  Calculate phi at all required radii stored in tmpRadiiTPC
-  /// Magnetic field to be provided in Tesla
+  /// Cache of the phi* of the particles at the TPC radii, filled once per particle and magnetic field
+  /// and indexed by the global index of the particle, so that the pair loops only compare phi* values.
+  /// An entry is reused only if the phi, pt, selection bits and magnetic field of the particle are unchanged,
+  /// which makes the cache safe across events, mixed events and data frames.
+  std::vector<float> mCachePhiStar;                                     ///< phi* at the tmpRadiiTPC radii, 9 consecutive entries per particle
+  std::vector<float> mCachePhiStarAtRadius;                             ///< phi* at radiiTPC
+  std::vector<float> mCachePhi;                                         ///< phi of the cached particle
+  std::vector<float> mCachePt;                                          ///< pt of the cached particle
+  std::vector<float> mCacheMagField;                                    ///< magnetic field used for the cached entry, NaN if the entry is empty
+  std::vector<o2::aod::femtodreamparticle::cutContainerType> mCacheCut; ///< selection bits of the cached particle
+  std::vector<int> mCacheCharge;                                        ///< charge of the cached particle
+
+  /// Get the charge from cutcontainer using masks
   template <typename T>
-  int PhiAtRadiiTPC(const T& part, std::vector<float>& tmpVec)
+  int ChargeFromCut(const T& part)
   {
-
-    float phi0 = part.phi();
-    // Start: Get the charge from cutcontainer using masks
-    int charge = 0.;
+    int charge = 0;
     if ((part.cut() & kSignMinusMask) == kValue0 && (part.cut() & kSignPlusMask) == kValue0) {
       charge = 0;
     } else if ((part.cut() & kSignPlusMask) == kSignPlusMask) {
@@ -448,23 +461,55 @@ class FemtoDreamDetaDphiStar
     } else {
       LOG(fatal) << "FemtoDreamDetaDphiStar: Charge bits are set wrong!";
     }
-    // End: Get the charge from cutcontainer using masks
-    float pt = part.pt();
+    return charge;
+  }
+
+  ///  Calculate phi at a given radius
+  /// Magnetic field to be provided in Tesla
+  float PhiStar(float phi0, int charge, float pt, float radius)
+  {
+    if (runOldVersion) {
+      return phi0 - std::asin(0.3 * charge * 0.1 * magfield * radius * 0.01 / (2. * pt));
+    }
+    auto arg = 0.3 * charge * magfield * radius * 0.01 / (2. * pt);
+    // for very low pT particles, this value goes outside of range -1 to 1 at at large tpc radius; asin fails
+    if (abs(arg) < 1) {
+      return phi0 - std::asin(arg);
+    }
+    return 999.;
+  }
+
+  ///  Calculate phi at all required radii stored in tmpRadiiTPC, if not cached yet
+  /// \return position of the particle in the cache
+  template <typename T>
+  size_t PhiAtRadiiTPC(const T& part)
+  {
+    const size_t slot = part.globalIndex();
+    if (slot >= mCacheMagField.size()) {
+      mCachePhiStar.resize(9 * (slot + 1));
+      mCachePhiStarAtRadius.resize(slot + 1);
+      mCachePhi.resize(slot + 1);
+      mCachePt.resize(slot + 1);
+      mCacheMagField.resize(slot + 1, std::numeric_limits<float>::quiet_NaN());
+      mCacheCut.resize(slot + 1);
+      mCacheCharge.resize(slot + 1);
+    }
+    const float phi0 = part.phi();
+    const float pt = part.pt();
+    if (mCacheMagField[slot] == magfield && mCachePhi[slot] == phi0 && mCachePt[slot] == pt && mCacheCut[slot] == part.cut()) {
+      return slot;
+    }
+    const int charge = ChargeFromCut(part);
     for (size_t i = 0; i < 9; i++) {
-      if (runOldVersion) {
-        tmpVec.push_back(phi0 - std::asin(0.3 * charge * 0.1 * magfield * tmpRadiiTPC[i] * 0.01 / (2. * pt)));
-      }
-      if (!runOldVersion) {
-        auto arg = 0.3 * charge * magfield * tmpRadiiTPC[i] * 0.01 / (2. * pt);
-        // for very low pT particles, this value goes outside of range -1 to 1 at at large tpc radius; asin fails
-        if (abs(arg) < 1) {
-          tmpVec.push_back(phi0 - std::asin(0.3 * charge * magfield * tmpRadiiTPC[i] * 0.01 / (2. * pt)));
-        } else {
-          tmpVec.push_back(999);
-        }
-      }
+      mCachePhiStar[9 * slot + i] = PhiStar(phi0, charge, pt, tmpRadiiTPC[i]);
     }
-    return charge;
+    mCachePhiStarAtRadius[slot] = PhiStar(phi0, charge, pt, radiiTPC);
+    mCachePhi[slot] = phi0;
+    mCachePt[slot] = pt;
+    mCacheMagField[slot] = magfield;
+    mCacheCut[slot] = part.cut();
+    mCacheCharge[slot] = charge;
+    return slot;
   }
 
   ///  Calculate phi at specific radii
@@ -496,39 +541,18 @@ class FemtoDreamDetaDphiStar
           break;
       }
     } else {
-      phi0 = part.phi();
-      // Start: Get the charge from cutcontainer using masks
-      if ((part.cut() & kSignMinusMask) == kValue0 && (part.cut() & kSignPlusMask) == kValue0) {
-        charge = 0;
-      } else if ((part.cut() & kSignPlusMask) == kSignPlusMask) {
-        charge = 1;
-      } else if ((part.cut() & kSignMinusMask) == kSignMinusMask) {
-        charge = -1;
-      } else {
-        LOG(fatal) << "FemtoDreamDetaDphiStar: Charge bits are set wrong!";
+      if (radii == radiiTPC) {
+        return mCachePhiStarAtRadius[PhiAtRadiiTPC(part)];
       }
+      phi0 = part.phi();
+      charge = ChargeFromCut(part);
       pt = part.pt();
     }
-    // End: Get the charge from cutcontainer using masks
-    float phiAtRadii = 0;
-    if (runOldVersion) {
-      phiAtRadii = phi0 - std::asin(0.3 * charge * 0.1 * magfield * radii * 0.01 / (2. * pt));
-    }
-    if (!runOldVersion) {
-      auto arg = 0.3 * charge * magfield * radii * 0.01 / (2. * pt);
-      // for very low pT particles, this value goes outside of range -1 to 1 at at large tpc radius; asin fails
-      if (abs(arg) < 1) {
-        phiAtRadii = phi0 - std::asin(0.3 * charge * magfield * radii * 0.01 / (2. * pt));
-      } else {
-        phiAtRadii = 999.;
-      }
-    }
-
-    return phiAtRadii;
+    return PhiStar(phi0, charge, pt, radii);
   }
 
   template <typename T>
-  int PhiAtRadiiTPCForHF(const T& part, std::vector<float>& tmpVec, int prong)
+  int PhiAtRadiiTPCForHF(const T& part, std::array<float, 9>& phiStar, int prong)
   {
     int charge = 0;
     float pt = -999.;
@@ -554,18 +578,7 @@ class FemtoDreamDetaDphiStar
         break;
     }
     for (size_t i = 0; i < 9; i++) {
-      if (runOldVersion) {
-        tmpVec.push_back(phi0 - std::asin(0.3 * charge * 0.1 * magfield * tmpRadiiTPC[i] * 0.01 / (2. * pt)));
-      }
-      if (!runOldVersion) {
-        auto arg = 0.3 * charge * magfield * tmpRadiiTPC[i] * 0.01 / (2. * pt);
-        // for very low pT particles, this value goes outside of range -1 to 1 at at large tpc radius; asin fails
-        if (abs(arg) < 1) {
-          tmpVec.push_back(phi0 - std::asin(0.3 * charge * magfield * tmpRadiiTPC[i] * 0.01 / (2. * pt)));
-        } else {
-          tmpVec.push_back(999);
-        }
-      }
+      phiStar[i] = PhiStar(phi0, charge, pt, tmpRadiiTPC[i]);
     }
     return charge;
   }
@@ -574,25 +587,28 @@ class FemtoDreamDetaDphiStar
   template <bool isHF = false, typename T1, typename T2>
   float AveragePhiStar(const T1& part1, const T2& part2, int iHist, bool* sameCharge)
   {
-    std::vector<float> tmpVec1;
-    std::vector<float> tmpVec2;
-    auto charge1 = PhiAtRadiiTPC(part1, tmpVec1);
+    std::array<float, 9> phiStar1;
+    std::array<float, 9> phiStar2;
+    // both slots are looked up before copying, as filling the second one can reallocate the cache
+    const size_t slot1 = PhiAtRadiiTPC(part1);
     if constexpr (!isHF) {
-      auto charge2 = PhiAtRadiiTPC(part2, tmpVec2);
-      if (charge1 == charge2) {
+      const size_t slot2 = PhiAtRadiiTPC(part2);
+      if (mCacheCharge[slot1] == mCacheCharge[slot2]) {
         *sameCharge = true;
       }
+      std::copy_n(mCachePhiStar.begin() + 9 * slot2, 9, phiStar2.begin());
     } else {
-      PhiAtRadiiTPCForHF(part2, tmpVec2, iHist);
+      PhiAtRadiiTPCForHF(part2, phiStar2, iHist);
       *sameCharge = true; // always true as we checked the condition in the HF task
     }
-    int num = tmpVec1.size();
+    std::copy_n(mCachePhiStar.begin() + 9 * slot1, 9, phiStar1.begin());
+    int num = phiStar1.size();
     int meaningfulEntries = num;
     float dPhiAvg = 0;
     float dphi;
     for (int i = 0; i < num; i++) {
-      if (tmpVec1.at(i) != 999 && tmpVec2.at(i) != 999) {
-        dphi = tmpVec1.at(i) - tmpVec2.at(i);
+      if (phiStar1[i] != 999 && phiStar2[i] != 999) {
+        dphi = phiStar1[i] - phiStar2[i];
       } else {
         dphi = 0;
         meaningfulEntries = meaningfulEntries - 1;
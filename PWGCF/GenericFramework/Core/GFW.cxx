@@ -82,6 +82,7 @@ int GFW::CreateRegions()
   for (auto pItr = fCumulants.begin(); pItr != fCumulants.end(); ++pItr)
     pItr->DestroyComplexVectorArray();
   fCumulants.clear();
+  fCorrMemo.clear();
   InitializePowerArrays();
   if (fRegions.size() < 1) {
     printf("No regions set. Skipping...\n");
@@ -101,11 +102,35 @@ int GFW::CreateRegions()
 void GFW::Fill(double eta, int ptin, double phi, double weight, int mask, double SecondWeight)
 {
   // if(!fInitialized) return;
+  if (!fCorrMemo.empty())
+    fCorrMemo.clear(); // Q-vectors change, memoised correlators are no longer valid
   for (int i = 0; i < static_cast<int>(fRegions.size()); ++i) {
     if (fRegions.at(i).EtaMin < eta && fRegions.at(i).EtaMax > eta && (fRegions.at(i).BitMask & mask))
       fCumulants.at(i).FillArray(ptin, phi, weight, SecondWeight);
   }
 };
+void GFW::Fill(std::span<const double> eta, std::span<const int> ptin, std::span<const double> phi, std::span<const double> weight, std::span<const int> mask, double SecondWeight)
+{
+  if (!fCorrMemo.empty())
+    fCorrMemo.clear(); // Q-vectors change, memoised correlators are no longer valid
+  // Tracks are added region by region, in the same order as with the single-track Fill
+  const size_t nTracks = eta.size();
+  for (int i = 0; i < static_cast<int>(fRegions.size()); ++i) {
+    const Region& lRegion = fRegions[i];
+    fFillPtin.clear();
+    fFillPhi.clear();
+    fFillWeight.clear();
+    for (size_t iTrack = 0; iTrack < nTracks; ++iTrack) {
+      if (lRegion.EtaMin < eta[iTrack] && lRegion.EtaMax > eta[iTrack] && (lRegion.BitMask & mask[iTrack])) {
+        fFillPtin.push_back(ptin[iTrack]);
+        fFillPhi.push_back(phi[iTrack]);
+        fFillWeight.push_back(weight[iTrack]);
+      }
+    }
+    if (!fFillPhi.empty())
+      fCumulants[i].FillArray(fFillPtin, fFillPhi, fFillWeight, SecondWeight);
+  }
+};
 complex<double> GFW::TwoRec(int n1, int n2, int p1, int p2, int ptbin, GFWCumulant* r1, GFWCumulant* r2, GFWCumulant* r3)
 {
   complex<double> part1 = r1->Vec(n1, p1, ptbin);
@@ -131,6 +156,11 @@ complex<double> GFW::RecursiveCorr(GFWCumulant* qpoi, GFWCumulant* qref, GFWCumu
     return qpoi->Vec(hars.at(0), pows.at(0), ptbin);
   if (hars.size() < 3)
     return TwoRec(hars.at(0), hars.at(1), pows.at(0), pows.at(1), ptbin, qpoi, qref, qol);
+  // Higher orders are memoised for the current event: the same sub-terms appear in many configurations and pt bins
+  SetCorrKey(qpoi, qref, qol, ptbin, hars, pows);
+  auto memoItr = fCorrMemo.find(fCorrKey);
+  if (memoItr != fCorrMemo.end())
+    return memoItr->second;
   int harlast = hars.at(hars.size() - 1);
   int powlast = pows.at(pows.size() - 1);
   hars.erase(hars.end() - 1);
@@ -160,14 +190,28 @@ complex<double> GFW::RecursiveCorr(GFWCumulant* qpoi, GFWCumulant* qref, GFWCumu
   }
   hars.push_back(harlast);
   pows.push_back(powlast);
+  SetCorrKey(qpoi, qref, qol, ptbin, hars, pows); // key buffer was overwritten by the recursion
+  fCorrMemo.emplace(fCorrKey, formula);
   return formula;
 };
+void GFW::SetCorrKey(GFWCumulant* qpoi, GFWCumulant* qref, GFWCumulant* qol, int ptbin, const vector<int>& hars, const vector<int>& pows)
+{
+  auto cumulantIndex = [this](GFWCumulant* q) { return q ? static_cast<int>(q - fCumulants.data()) : -1; };
+  fCorrKey.clear();
+  fCorrKey.push_back(cumulantIndex(qpoi));
+  fCorrKey.push_back(cumulantIndex(qref));
+  fCorrKey.push_back(cumulantIndex(qol));
+  fCorrKey.push_back(ptbin);
+  fCorrKey.insert(fCorrKey.end(), hars.begin(), hars.end());
+  fCorrKey.insert(fCorrKey.end(), pows.begin(), pows.end());
+};
 void GFW::Clear()
 {
   if (!fInitialized)
     CreateRegions();
   for (auto ptr = fCumulants.begin(); ptr != fCumulants.end(); ++ptr)
     ptr->ResetQs();
+  fCorrMemo.clear();
 };
 GFW::CorrConfig GFW::GetCorrelatorConfig(string config, string head, bool ptdif)
 {
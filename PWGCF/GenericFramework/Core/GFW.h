@@ -26,6 +26,9 @@ If used, modified, or distributed, please aknowledge the author of this code.
 #include <utility>
 #include <algorithm>
 #include <complex>
+#include <functional>
+#include <span>
+#include <unordered_map>
 
 class GFW
 {
@@ -62,6 +65,7 @@ class GFW
   void AddRegion(std::string refName, int lNhar, int* lNparVec, double lEtaMin, double lEtaMax, int lNpT, int BitMask);  // Legacy support, array instead of a vector
   int CreateRegions();
   void Fill(double eta, int ptin, double phi, double weight, int mask, double secondWeight = -1);
+  void Fill(std::span<const double> eta, std::span<const int> ptin, std::span<const double> phi, std::span<const double> weight, std::span<const int> mask, double secondWeight = -1); // all tracks of an event at once
   void Clear();
   GFWCumulant GetCumulant(int index) { return fCumulants.at(index); }
   CorrConfig GetCorrelatorConfig(std::string config, std::string head = "", bool ptdif = false);
@@ -71,6 +75,21 @@ class GFW
  protected:
   bool fInitialized;
   std::vector<CorrConfig> fListOfCFGs;
+  struct CorrKeyHash {
+    size_t operator()(const std::vector<int>& key) const
+    {
+      size_t hash = key.size();
+      for (const int k : key)
+        hash ^= std::hash<int>()(k) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+      return hash;
+    }
+  };
+  std::unordered_map<std::vector<int>, std::complex<double>, CorrKeyHash> fCorrMemo; //! Correlators of the current event, keyed on (poi, ref, overlap, ptbin, harmonics, powers)
+  std::vector<int> fCorrKey;                                                        //! Buffer for the memo key
+  void SetCorrKey(GFWCumulant* qpoi, GFWCumulant* qref, GFWCumulant* qol, int ptbin, const std::vector<int>& hars, const std::vector<int>& pows);
+  std::vector<int> fFillPtin;      //! Per-region buffers for the batch fill
+  std::vector<double> fFillPhi;    //!
+  std::vector<double> fFillWeight; //!
   std::complex<double> TwoRec(int n1, int n2, int p1, int p2, int ptbin, GFWCumulant*, GFWCumulant*, GFWCumulant*);
   std::complex<double> RecursiveCorr(GFWCumulant* qpoi, GFWCumulant* qref, GFWCumulant* qol, int ptbin, std::vector<int>& hars, std::vector<int>& pows); // POI, Ref. flow, overlapping region
   std::complex<double> RecursiveCorr(GFWCumulant* qpoi, GFWCumulant* qref, GFWCumulant* qol, int ptbin, std::vector<int>& hars);                         // POI, Ref. flow, overlapping region
@@ -19,16 +19,22 @@ If used, modified, or distributed, please aknowledge the author of this code.
 
 #include "GFWCumulant.h"
 
+#include <algorithm>
+
 using std::complex;
 using std::vector;
 
-GFWCumulant::GFWCumulant() : fQvector(0),
+GFWCumulant::GFWCumulant() : fQvector(),
+                             fHarOffset(),
+                             fPtStride(0),
+                             fMaxPow(0),
+                             fPrefactors(),
                              fUsed(kBlank),
                              fNEntries(-1),
                              fN(1),
                              fPow(1),
                              fPt(1),
-                             fFilledPts(0),
+                             fFilledPts(),
                              fInitialized(false) {}
 
 GFWCumulant::~GFWCumulant() {}
@@ -36,27 +42,44 @@ void GFWCumulant::FillArray(int ptin, double phi, double weight, double SecondWe
 {
   if (!fInitialized)
     CreateComplexVectorArray(1, 1, 1);
+  FillTrack(ptin, phi, weight, SecondWeight);
+};
+void GFWCumulant::FillArray(std::span<const int> ptin, std::span<const double> phi, std::span<const double> weight, double SecondWeight)
+{
+  if (!fInitialized)
+    CreateComplexVectorArray(1, 1, 1);
+  const size_t nTracks = phi.size();
+  for (size_t i = 0; i < nTracks; i++)
+    FillTrack(ptin[i], phi[i], weight[i], SecondWeight);
+};
+void GFWCumulant::FillTrack(int ptin, double phi, double weight, double SecondWeight)
+{
   if (fPt == 1)
     ptin = 0; // If one bin, then just fill it straight; otherwise, if ptin is out-of-range, do not fill
   else if (ptin < 0 || ptin >= fPt)
     return;
   fFilledPts[ptin] = true;
+  // Weight powers built incrementally, once for all harmonics
+  // If second weight is specified, then keep the first weight with power no more than 1, and us the other weight otherwise
+  // this is important when POIs are a subset of REFs and have different weights than REFs
+  double* lPrefactor = fPrefactors.data();
+  lPrefactor[0] = 1.;
+  if (fMaxPow > 1)
+    lPrefactor[1] = weight;
+  const double lHigherWeight = (SecondWeight > 0) ? SecondWeight : weight;
+  for (int lPow = 2; lPow < fMaxPow; lPow++)
+    lPrefactor[lPow] = lPrefactor[lPow - 1] * lHigherWeight;
+  // Harmonics from the recurrence e^{i(n+1)phi} = e^{in phi} e^{i phi}
+  const complex<double> lUnit(cos(phi), sin(phi));
+  complex<double> lHarmonic(1., 0.);
+  complex<double>* lQ = fQvector.data() + ptin * fPtStride;
   for (int lN = 0; lN < fN; lN++) {
-    double lSin = sin(lN * phi); // No need to recalculate for each power
-    double lCos = cos(lN * phi); // No need to recalculate for each power
-    for (int lPow = 0; lPow < PW(lN); lPow++) {
-      double lPrefactor = 0;
-      // Dont calculate it twice; multiplication is cheaper that power
-      // Also, if second weight is specified, then keep the first weight with power no more than 1, and us the other weight otherwise
-      // this is important when POIs are a subset of REFs and have different weights than REFs
-      if (SecondWeight > 0 && lPow > 1)
-        lPrefactor = pow(SecondWeight, lPow - 1) * weight;
-      else
-        lPrefactor = pow(weight, lPow);
-      double qsin = lPrefactor * lSin;
-      double qcos = lPrefactor * lCos;
-      fQvector[ptin][lN][lPow] += complex<double>(qcos, qsin);
-    }
+    if (lN > 0)
+      lHarmonic *= lUnit;
+    complex<double>* lQN = lQ + fHarOffset[lN];
+    const int lNPow = PW(lN);
+    for (int lPow = 0; lPow < lNPow; lPow++)
+      lQN[lPow] += lPrefactor[lPow] * lHarmonic;
   }
   Inc();
 };
@@ -64,30 +87,18 @@ void GFWCumulant::ResetQs()
 {
   if (!fNEntries)
     return; // If 0 entries, then no need to reset. Otherwise, if -1, then just initialized and need to set to 0.
-  for (int i = 0; i < fPt; i++) {
-    fFilledPts[i] = false;
-    for (int lN = 0; lN < fN; lN++) {
-      for (int lPow = 0; lPow < PW(lN); lPow++) {
-        fQvector[i][lN][lPow] = fNullQ;
-      }
-    }
-  }
+  std::fill(fFilledPts.begin(), fFilledPts.end(), false);
+  std::fill(fQvector.begin(), fQvector.end(), fNullQ);
   fNEntries = 0;
 };
 void GFWCumulant::DestroyComplexVectorArray()
 {
   if (!fInitialized)
     return;
-  for (int l_n = 0; l_n < fN; l_n++) {
-    for (int i = 0; i < fPt; i++) {
-      delete[] fQvector[i][l_n];
-    }
-  }
-  for (int i = 0; i < fPt; i++) {
-    delete[] fQvector[i];
-  }
-  delete[] fQvector;
-  delete[] fFilledPts;
+  fQvector.clear();
+  fHarOffset.clear();
+  fFilledPts.clear();
+  fPrefactors.clear();
   fInitialized = false;
   fNEntries = -1;
 };
@@ -106,17 +117,18 @@ void GFWCumulant::CreateComplexVectorArrayVarPower(int N, vector<int> PowVec, in
   fN = N;
   fPow = 0;
   fPt = Pt;
-  fFilledPts = new bool[Pt];
   fPowVec = PowVec;
-  fQvector = new complex<double>**[fPt];
-  for (int i = 0; i < fPt; i++) {
-    fQvector[i] = new complex<double>*[fN];
-  }
+  fHarOffset.resize(fN);
+  fPtStride = 0;
+  fMaxPow = 1;
   for (int l_n = 0; l_n < fN; l_n++) {
-    for (int i = 0; i < fPt; i++) {
-      fQvector[i][l_n] = new complex<double>[PW(l_n)];
-    }
+    fHarOffset[l_n] = fPtStride;
+    fPtStride += PW(l_n);
+    fMaxPow = std::max(fMaxPow, PW(l_n));
   }
+  fPrefactors.resize(fMaxPow);
+  fFilledPts.resize(fPt);
+  fQvector.resize(fPt * fPtStride);
   ResetQs();
   fInitialized = true;
 };
@@ -127,12 +139,12 @@ complex<double> GFWCumulant::Vec(int n, int p, int ptbin)
   if (ptbin >= fPt || ptbin < 0)
     ptbin = 0;
   if (n >= 0)
-    return fQvector[ptbin][n][p];
-  return conj(fQvector[ptbin][-n][p]);
+    return fQvector[ptbin * fPtStride + fHarOffset[n] + p];
+  return conj(fQvector[ptbin * fPtStride + fHarOffset[-n] + p]);
 };
 bool GFWCumulant::IsPtBinFilled(int ptb)
 {
-  if (!fFilledPts)
+  if (fFilledPts.empty())
     return false;
   if (ptb > 0) {
     if (fPt == 1)
@@ -21,6 +21,7 @@ If used, modified, or distributed, please aknowledge the author of this code.
 
 #include <cmath>
 #include <complex>
+#include <span>
 #include <vector>
 
 class GFWCumulant
@@ -30,6 +31,7 @@ class GFWCumulant
   ~GFWCumulant();
   void ResetQs();
   void FillArray(int ptin, double phi, double weight = 1, double SecondWeight = -1);
+  void FillArray(std::span<const int> ptin, std::span<const double> phi, std::span<const double> weight, double SecondWeight = -1); // all tracks of an event at once
   enum UsedFlags_t { kBlank = 0,
                      kFull = 1,
                      kPt = 2 };
@@ -43,11 +45,16 @@ class GFWCumulant
   bool IsPtBinFilled(int ptb);
   void CreateComplexVectorArray(int N = 1, int P = 1, int Pt = 1);
   void CreateComplexVectorArrayVarPower(int N = 1, std::vector<int> Pvec = {1}, int Pt = 1);
-  int PW(int ind) { return fPowVec.at(ind); }; // No checks to speed up, be carefull!!!
+  int PW(int ind) { return fPowVec[ind]; }; // No checks to speed up, be carefull!!!
   void DestroyComplexVectorArray();
   std::complex<double> Vec(int, int, int ptbin = 0); // envelope class to summarize pt-dif. Q-vec getter
  protected:
-  std::complex<double>*** fQvector;
+  void FillTrack(int ptin, double phi, double weight, double SecondWeight);
+  std::vector<std::complex<double>> fQvector; // Q-vectors, contiguous in [pt][harmonic][power]
+  std::vector<int> fHarOffset;                 //! Offset of each harmonic in a pt bin of fQvector
+  int fPtStride;                               //! Number of Q-vectors per pt bin
+  int fMaxPow;                                 //! Maximum power over all harmonics
+  std::vector<double> fPrefactors;             //! Weight powers of the current track
   uint fUsed;
   int fNEntries;
   // Q-vectors. Could be done recursively, but maybe defining each one of them explicitly is easier to read
@@ -55,7 +62,7 @@ class GFWCumulant
   int fPow;                 //! Power
   std::vector<int> fPowVec; //! Powers array
   int fPt;                  //! fPt bins
-  bool* fFilledPts;
+  std::vector<bool> fFilledPts;
   bool fInitialized; // Arrays are initialized
   std::complex<double> fNullQ = 0;
 };
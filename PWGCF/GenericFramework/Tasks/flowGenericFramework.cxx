@@ -121,6 +121,12 @@ struct GenericFramework {
   std::vector<GFW::CorrConfig> corrconfigs;
   TRandom3* fRndm = new TRandom3(0);
   TAxis* fPtAxis;
+  // tracks of the current event, filled into the GFW at once
+  std::vector<double> gfwEta;
+  std::vector<int> gfwPtBin;
+  std::vector<double> gfwPhi;
+  std::vector<double> gfwWeight;
+  std::vector<int> gfwMask;
 
   // Event selection cuts - Alex
   TF1* fPhiCutLow = nullptr;
@@ -454,9 +460,15 @@ struct GenericFramework {
     fGFW->Clear();
     fFCpt->ClearVector();
     float l_Random = fRndm->Rndm();
+    gfwEta.clear();
+    gfwPtBin.clear();
+    gfwPhi.clear();
+    gfwWeight.clear();
+    gfwMask.clear();
     for (auto& track : tracks) {
       ProcessTrack(track, centrality, vtxz, field);
     }
+    fGFW->Fill(gfwEta, gfwPtBin, gfwPhi, gfwWeight, gfwMask);
     FillOutputContainers<dt>((cfgUseNch) ? tracks.size() : centrality, l_Random);
   }
 
@@ -521,12 +533,19 @@ struct GenericFramework {
     fFCpt->Fill(weff, track.pt());
     bool WithinPtPOI = (ptpoilow < track.pt()) && (track.pt() < ptpoiup); // within POI pT range
     bool WithinPtRef = (ptreflow < track.pt()) && (track.pt() < ptrefup); // within RF pT range
-    if (WithinPtRef)
-      fGFW->Fill(track.eta(), fPtAxis->FindBin(track.pt()) - 1, track.phi(), weff * wacc, 1);
-    if (WithinPtPOI)
-      fGFW->Fill(track.eta(), fPtAxis->FindBin(track.pt()) - 1, track.phi(), weff * wacc, 2);
-    if (WithinPtPOI && WithinPtRef)
-      fGFW->Fill(track.eta(), fPtAxis->FindBin(track.pt()) - 1, track.phi(), weff * wacc, 4);
+    if (!WithinPtRef && !WithinPtPOI)
+      return;
+    // one entry per mask, filled into the GFW for the whole event in processCollision
+    const int ptBin = fPtAxis->FindBin(track.pt()) - 1;
+    for (const int mask : {1, 2, 4}) {
+      if ((mask == 1 && !WithinPtRef) || (mask == 2 && !WithinPtPOI) || (mask == 4 && !(WithinPtPOI && WithinPtRef)))
+        continue;
+      gfwEta.push_back(track.eta());
+      gfwPtBin.push_back(ptBin);
+      gfwPhi.push_back(track.phi());
+      gfwWeight.push_back(weff * wacc);
+      gfwMask.push_back(mask);
+    }
     return;
   }
 
@@ -14,6 +14,10 @@
 #include <iostream>
 #include <memory>
 #include <fstream>
+#include <functional>
+#include <initializer_list>
+#include <string_view>
+#include <unordered_map>
 #include "Framework/Logger.h"
 using namespace std;
 
@@ -33,12 +37,84 @@ using namespace std;
 
 ClassImp(HistogramManager);
 
+namespace
+{
+// Fill functions, one for each kind of histogram, with and without weight.
+// vars contains the indices of the variables on each axis (and the profiled variable), followed by the weight variable
+using FillFunction = void (*)(TObject* h, const int* vars, int nVars, const float* values);
+
+void fillTH1(TObject* h, const int* vars, int, const float* values) { static_cast<TH1*>(h)->Fill(values[vars[0]]); }
+void fillTH1W(TObject* h, const int* vars, int, const float* values) { static_cast<TH1*>(h)->Fill(values[vars[0]], values[vars[1]]); }
+void fillTProfile(TObject* h, const int* vars, int, const float* values) { static_cast<TProfile*>(h)->Fill(values[vars[0]], values[vars[1]]); }
+void fillTProfileW(TObject* h, const int* vars, int, const float* values) { static_cast<TProfile*>(h)->Fill(values[vars[0]], values[vars[1]], values[vars[2]]); }
+void fillTH2(TObject* h, const int* vars, int, const float* values) { static_cast<TH2*>(h)->Fill(values[vars[0]], values[vars[1]]); }
+void fillTH2W(TObject* h, const int* vars, int, const float* values) { static_cast<TH2*>(h)->Fill(values[vars[0]], values[vars[1]], values[vars[2]]); }
+void fillTProfile2D(TObject* h, const int* vars, int, const float* values) { static_cast<TProfile2D*>(h)->Fill(values[vars[0]], values[vars[1]], values[vars[2]]); }
+void fillTProfile2DW(TObject* h, const int* vars, int, const float* values) { static_cast<TProfile2D*>(h)->Fill(values[vars[0]], values[vars[1]], values[vars[2]], values[vars[3]]); }
+void fillTH3(TObject* h, const int* vars, int, const float* values) { static_cast<TH3*>(h)->Fill(values[vars[0]], values[vars[1]], values[vars[2]]); }
+void fillTH3W(TObject* h, const int* vars, int, const float* values) { static_cast<TH3*>(h)->Fill(values[vars[0]], values[vars[1]], values[vars[2]], values[vars[3]]); }
+void fillTProfile3D(TObject* h, const int* vars, int, const float* values) { static_cast<TProfile3D*>(h)->Fill(values[vars[0]], values[vars[1]], values[vars[2]], values[vars[3]]); }
+void fillTProfile3DW(TObject* h, const int* vars, int, const float* values) { static_cast<TProfile3D*>(h)->Fill(values[vars[0]], values[vars[1]], values[vars[2]], values[vars[3]], values[vars[4]]); }
+
+// TODO: At the moment, maximum 20 dimensions are foreseen for the THn histograms. We should make this more dynamic
+void fillTHn(TObject* h, const int* vars, int nVars, const float* values)
+{
+  double fillValues[20] = {0.0};
+  for (int i = 0; i < nVars; i++) {
+    fillValues[i] = values[vars[i]];
+  }
+  static_cast<THnBase*>(h)->Fill(fillValues);
+}
+void fillTHnW(TObject* h, const int* vars, int nVars, const float* values)
+{
+  double fillValues[20] = {0.0};
+  for (int i = 0; i < nVars - 1; i++) {
+    fillValues[i] = values[vars[i]];
+  }
+  static_cast<THnBase*>(h)->Fill(fillValues, values[vars[nVars - 1]]);
+}
+
+// hash allowing to look up the classes by name without constructing a std::string
+struct ClassNameHash {
+  using is_transparent = void;
+  size_t operator()(std::string_view name) const { return std::hash<std::string_view>{}(name); }
+};
+} // namespace
+
+// Flat description of how to fill each histogram class, built while the histograms are added
+class HistogramFillPlan
+{
+ public:
+  struct Entry {
+    TObject* histogram; // histogram, owned by the main histogram list
+    FillFunction fill;  // fill function for the kind of histogram
+    int firstVar;       // position of the first variable index in variables
+    int nVars;          // number of variable indices, including the weight
+  };
+
+  std::vector<std::vector<Entry>> classes;                                       // entries of each histogram class, indexed by the class handle
+  std::vector<int> variables;                                                    // variable indices of all the entries
+  std::unordered_map<std::string, int, ClassNameHash, std::equal_to<>> handles; // class handles by class name
+
+  void add(const char* histClass, TObject* h, FillFunction fill, std::initializer_list<int> vars, const int* extraVars = nullptr, int nExtraVars = 0)
+  {
+    auto handle = handles.find(std::string_view(histClass));
+    if (handle == handles.end()) {
+      return;
+    }
+    const int firstVar = variables.size();
+    variables.insert(variables.end(), extraVars, extraVars + nExtraVars);
+    variables.insert(variables.end(), vars);
+    classes[handle->second].push_back({h, fill, firstVar, static_cast<int>(variables.size()) - firstVar});
+  }
+};
+
 //_______________________________________________________________________________
 HistogramManager::HistogramManager() : TNamed("", ""),
                                        fMainList(nullptr),
                                        fNVars(0),
                                        fUsedVars(nullptr),
-                                       fVariablesMap(),
+                                       fFillPlan(new HistogramFillPlan),
                                        fUseDefaultVariableNames(false),
                                        fBinsAllocated(0),
                                        fVariableNames(nullptr),
@@ -54,7 +130,7 @@ HistogramManager::HistogramManager(const char* name, const char* title, const in
                                                                                               fMainList(),
                                                                                               fNVars(maxNVars),
                                                                                               fUsedVars(),
-                                                                                              fVariablesMap(),
+                                                                                              fFillPlan(new HistogramFillPlan),
                                                                                               fUseDefaultVariableNames(kFALSE),
                                                                                               fBinsAllocated(0),
                                                                                               fVariableNames(),
@@ -82,6 +158,7 @@ HistogramManager::~HistogramManager()
   //
   delete fMainList;
   delete[] fUsedVars;
+  delete fFillPlan;
 }
 
 //_______________________________________________________________________________
@@ -111,8 +188,8 @@ void HistogramManager::AddHistClass(const char* histClass)
   hList->SetOwner(kTRUE);
   hList->SetName(histClass);
   fMainList->Add(hList);
-  std::list<std::vector<int>> varList;
-  fVariablesMap[histClass] = varList;
+  fFillPlan->handles.emplace(histClass, fFillPlan->classes.size());
+  fFillPlan->classes.emplace_back();
 }
 
 //_________________________________________________________________
@@ -171,19 +248,6 @@ void HistogramManager::AddHistogram(const char* histClass, const char* hname, co
     fUsedVars[varW] = kTRUE;
   }
 
-  // encode needed variable identifiers in a vector and push it to the std::list corresponding to the current histogram list
-  std::vector<int> varVector;
-  varVector.push_back(isProfile ? 1 : 0); // whether the histogram is a profile
-  varVector.push_back(0);                 // whether it is a THn
-  varVector.push_back(varW);              // variable used for weighting
-  varVector.push_back(varX);              // variables on each axis
-  varVector.push_back(varY);
-  varVector.push_back(varZ);
-  varVector.push_back(varT); // variable used for profiling in case of TProfile3D
-  std::list varList = fVariablesMap[histClass];
-  varList.push_back(varVector);
-  fVariablesMap[histClass] = varList;
-
   // create and configure histograms according to required options
   TH1* h = nullptr;
   switch (dimension) {
@@ -322,6 +386,7 @@ void HistogramManager::AddHistogram(const char* histClass, const char* hname, co
       hList->Add(h);
       break;
   } // end switch
+  AddToFillPlan(histClass, h, isProfile, varX, varY, varZ, varT, varW);
 }
 
 //_________________________________________________________________
@@ -380,19 +445,6 @@ void HistogramManager::AddHistogram(const char* histClass, const char* hname, co
   TString titleStr(title);
   std::unique_ptr<TObjArray> arr(titleStr.Tokenize(";"));
 
-  // encode needed variable identifiers in a vector and push it to the std::list corresponding to the current histogram list
-  std::vector<int> varVector;
-  varVector.push_back(isProfile ? 1 : 0); // whether the histogram is a profile
-  varVector.push_back(0);                 // whether it is a THn
-  varVector.push_back(varW);              // variable used for weighting
-  varVector.push_back(varX);              // variables on each axis
-  varVector.push_back(varY);
-  varVector.push_back(varZ);
-  varVector.push_back(varT); // variable used for profiling in case of TProfile3D
-  std::list varList = fVariablesMap[histClass];
-  varList.push_back(varVector);
-  fVariablesMap[histClass] = varList;
-
   TH1* h = nullptr;
   switch (dimension) {
     case 1:
@@ -527,6 +579,7 @@ void HistogramManager::AddHistogram(const char* histClass, const char* hname, co
       hList->Add(h);
       break;
   } // end switch(dimension)
+  AddToFillPlan(histClass, h, isProfile, varX, varY, varZ, varT, varW);
 }
 
 //_________________________________________________________________
@@ -559,18 +612,6 @@ void HistogramManager::AddHistogram(const char* histClass, const char* hname, co
     fUsedVars[varW] = kTRUE;
   }
 
-  // encode needed variable identifiers in a vector and push it to the std::list corresponding to the current histogram list
-  std::vector<int> varVector;
-  varVector.push_back(0);           // whether the histogram is a profile
-  varVector.push_back(nDimensions); // number of dimensions
-  varVector.push_back(varW);        // variable used for weighting
-  for (int idim = 0; idim < nDimensions; ++idim) {
-    varVector.push_back(vars[idim]); // axes variables
-  }
-  std::list varList = fVariablesMap[histClass];
-  varList.push_back(varVector);
-  fVariablesMap[histClass] = varList;
-
   uint32_t nbins = 1;
   THnBase* h = nullptr;
   if (!isdouble) {
@@ -618,6 +659,7 @@ void HistogramManager::AddHistogram(const char* histClass, const char* hname, co
       hList->Add(reinterpret_cast<THnD*>(h));
     }
   }
+  AddToFillPlan(histClass, h, nDimensions, vars, varW);
 
   fBinsAllocated += nbins;
 }
@@ -652,18 +694,6 @@ void HistogramManager::AddHistogram(const char* histClass, const char* hname, co
     fUsedVars[varW] = kTRUE;
   }
 
-  // encode needed variable identifiers in a vector and push it to the std::list corresponding to the current histogram list
-  std::vector<int> varVector;
-  varVector.push_back(0);           // whether the histogram is a profile
-  varVector.push_back(nDimensions); // number of dimensions
-  varVector.push_back(varW);        // variable used for weighting
-  for (int idim = 0; idim < nDimensions; ++idim) {
-    varVector.push_back(vars[idim]); // axes variables
-  }
-  std::list varList = fVariablesMap[histClass];
-  varList.push_back(varVector);
-  fVariablesMap[histClass] = varList;
-
   // get the min and max for each axis
   auto* xmin = new double[nDimensions];
   auto* xmax = new double[nDimensions];
@@ -725,134 +755,90 @@ void HistogramManager::AddHistogram(const char* histClass, const char* hname, co
       hList->Add(reinterpret_cast<THnD*>(h));
     }
   }
+  AddToFillPlan(histClass, h, nDimensions, vars, varW);
   fBinsAllocated += bins;
 }
 
+//__________________________________________________________________
+void HistogramManager::AddToFillPlan(const char* histClass, TH1* h, bool isProfile, int varX, int varY, int varZ, int varT, int varW)
+{
+  //
+  // add a TH1, TH2, TH3 or profile histogram to the fill plan of its class
+  //
+  const bool isWeighted = (varW > kNothing);
+  switch (h->GetDimension()) {
+    case 1:
+      if (isProfile) {
+        fFillPlan->add(histClass, h, isWeighted ? fillTProfileW : fillTProfile, {varX, varY, varW});
+      } else {
+        fFillPlan->add(histClass, h, isWeighted ? fillTH1W : fillTH1, {varX, varW});
+      }
+      break;
+    case 2:
+      if (isProfile) {
+        fFillPlan->add(histClass, h, isWeighted ? fillTProfile2DW : fillTProfile2D, {varX, varY, varZ, varW});
+      } else {
+        fFillPlan->add(histClass, h, isWeighted ? fillTH2W : fillTH2, {varX, varY, varW});
+      }
+      break;
+    case 3:
+      if (isProfile) {
+        fFillPlan->add(histClass, h, isWeighted ? fillTProfile3DW : fillTProfile3D, {varX, varY, varZ, varT, varW});
+      } else {
+        fFillPlan->add(histClass, h, isWeighted ? fillTH3W : fillTH3, {varX, varY, varZ, varW});
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+//__________________________________________________________________
+void HistogramManager::AddToFillPlan(const char* histClass, THnBase* h, int nDimensions, const int* vars, int varW)
+{
+  //
+  // add a THn or THnSparse histogram to the fill plan of its class
+  //
+  if (varW > kNothing) {
+    fFillPlan->add(histClass, h, fillTHnW, {varW}, vars, nDimensions);
+  } else {
+    fFillPlan->add(histClass, h, fillTHn, {}, vars, nDimensions);
+  }
+}
+
+//__________________________________________________________________
+int HistogramManager::GetHistClassHandle(const char* className) const
+{
+  //
+  // get the handle of a histogram class, -1 if the class does not exist
+  //
+  auto handle = fFillPlan->handles.find(std::string_view(className));
+  return (handle == fFillPlan->handles.end()) ? kNothing : handle->second;
+}
+
 //__________________________________________________________________
 void HistogramManager::FillHistClass(const char* className, Float_t* values)
 {
   //
   //  fill a class of histograms
   //
+  FillHistClass(GetHistClassHandle(className), values);
+}
 
-  // get the needed histogram list
-  auto* hList = reinterpret_cast<TList*>(fMainList->FindObject(className));
-  if (!hList) {
+//__________________________________________________________________
+void HistogramManager::FillHistClass(int handle, Float_t* values)
+{
+  //
+  //  fill a class of histograms, given by its handle
+  //
+  if (handle < 0) {
     // TODO: add some meaningfull error message
-    /*LOG(warn) << "HistogramManager::FillHistClass(): Histogram list " << className << " not found!";
-    LOG(warn) << "         Histogram list not filled" << endl; */
     return;
   }
-
-  // get the corresponding std::list containng identifiers to the needed variables to be filled
-  list varList = fVariablesMap[className];
-
-  TIter next(hList);
-
-  TObject* h = nullptr;
-  bool isProfile;
-  bool isTHn;
-  int dimension = 0;
-  bool isSparse = kFALSE;
-  // TODO: At the moment, maximum 20 dimensions are foreseen for the THn histograms. We should make this more dynamic
-  //       But maybe its better to have it like to avoid dynamically allocating this array in the histogram loop
-  double fillValues[20] = {0.0};
-  int varX = -1, varY = -1, varZ = -1, varT = -1, varW = -1;
-
-  // loop over the histogram and std::list
-  // NOTE: these two should contain the same number of elements and be synchronized, otherwise its a mess
-  for (auto varIter = varList.begin(); varIter != varList.end(); varIter++) {
-    h = next(); // get the histogram
-    // decode information from the vector of indices
-    isProfile = (varIter->at(0) == 1 ? true : false);
-    isTHn = (varIter->at(1) > 0 ? true : false);
-    if (isTHn) {
-      dimension = varIter->at(1);
-    } else {
-      dimension = (reinterpret_cast<TH1*>(h))->GetDimension();
-    }
-
-    // get the various variable indices
-    varW = varIter->at(2);
-    if (isTHn) {
-      for (int i = 0; i < dimension; i++) {
-        fillValues[i] = values[varIter->at(3 + i)];
-      }
-    } else {
-      varX = varIter->at(3);
-      varY = varIter->at(4);
-      varZ = varIter->at(5);
-      varT = varIter->at(6);
-    }
-
-    if (!isTHn) {
-      switch (dimension) {
-        case 1:
-          if (isProfile) {
-            if (varW > kNothing) {
-              (reinterpret_cast<TProfile*>(h))->Fill(values[varX], values[varY], values[varW]);
-            } else {
-              (reinterpret_cast<TProfile*>(h))->Fill(values[varX], values[varY]);
-            }
-          } else {
-            if (varW > kNothing) {
-              (reinterpret_cast<TH1*>(h))->Fill(values[varX], values[varW]);
-            } else {
-              (reinterpret_cast<TH1*>(h))->Fill(values[varX]);
-            }
-          }
-          break;
-        case 2:
-          if (isProfile) {
-            if (varW > kNothing) {
-              (reinterpret_cast<TProfile2D*>(h))->Fill(values[varX], values[varY], values[varZ], values[varW]);
-            } else {
-              (reinterpret_cast<TProfile2D*>(h))->Fill(values[varX], values[varY], values[varZ]);
-            }
-          } else {
-            if (varW > kNothing) {
-              (reinterpret_cast<TH2*>(h))->Fill(values[varX], values[varY], values[varW]);
-            } else {
-              (reinterpret_cast<TH2*>(h))->Fill(values[varX], values[varY]);
-            }
-          }
-          break;
-        case 3:
-          if (isProfile) {
-            if (varW > kNothing) {
-              (reinterpret_cast<TProfile3D*>(h))->Fill(values[varX], values[varY], values[varZ], values[varT], values[varW]);
-            } else {
-              (reinterpret_cast<TProfile3D*>(h))->Fill(values[varX], values[varY], values[varZ], values[varT]);
-            }
-          } else {
-            if (varW > kNothing) {
-              (reinterpret_cast<TH3*>(h))->Fill(values[varX], values[varY], values[varZ], values[varW]);
-            } else {
-              (reinterpret_cast<TH3*>(h))->Fill(values[varX], values[varY], values[varZ]);
-            }
-          }
-          break;
-
-        default:
-          break;
-      } // end switch
-      // end if(!isTHn)
-    } else {
-      if (varW > kNothing) {
-        if (isSparse) {
-          (reinterpret_cast<THnSparse*>(h))->Fill(fillValues, values[varW]);
-        } else {
-          (reinterpret_cast<THn*>(h))->Fill(fillValues, values[varW]);
-        }
-      } else {
-        if (isSparse) {
-          (reinterpret_cast<THnSparse*>(h))->Fill(fillValues);
-        } else {
-          (reinterpret_cast<THn*>(h))->Fill(fillValues);
-        }
-      }
-    } // end else
-  }   // end loop over histograms
+  const int* variables = fFillPlan->variables.data();
+  for (const auto& entry : fFillPlan->classes[handle]) {
+    entry.fill(entry.histogram, variables + entry.firstVar, entry.nVars, values);
+  }
 }
 
 //____________________________________________________________________________________
@@ -29,6 +29,10 @@
 #include <vector>
 #include <list>
 
+class TH1;
+class THnBase;
+class HistogramFillPlan;
+
 class HistogramManager : public TNamed
 {
 
@@ -85,6 +89,10 @@ class HistogramManager : public TNamed
                     TString* axLabels = nullptr, int varW = -1, bool useSparse = kFALSE, bool isdouble = false);
 
   void FillHistClass(const char* className, float* values);
+  // Get the handle of a histogram class, or -1 if the class does not exist
+  // Filling through the handle avoids the lookup of the class by name, to be preferred in loops over tracks and pairs
+  int GetHistClassHandle(const char* className) const;
+  void FillHistClass(int handle, float* values);
 
   void SetUseDefaultVariableNames(bool flag) { fUseDefaultVariableNames = flag; }
   void SetDefaultVarNames(TString* vars, TString* units);
@@ -99,8 +107,8 @@ class HistogramManager : public TNamed
   THashList* fMainList; // master histogram list
   int fNVars;           // number of variables handled (tipically from the Variable Manager)
 
-  bool* fUsedVars;                                                  //! flags of used variables
-  std::map<std::string, std::list<std::vector<int>>> fVariablesMap; //!  map holding identifiers for all variables needed by histograms
+  bool* fUsedVars;              //! flags of used variables
+  HistogramFillPlan* fFillPlan; //! histograms of each class with the function and the variables needed to fill them
 
   // various
   bool fUseDefaultVariableNames;    //! toggle the usage of default variable names and units
@@ -109,6 +117,8 @@ class HistogramManager : public TNamed
   TString* fVariableUnits;          //! variable units
 
   void MakeAxisLabels(TAxis* ax, const char* labels);
+  void AddToFillPlan(const char* histClass, TH1* h, bool isProfile, int varX, int varY, int varZ, int varT, int varW);
+  void AddToFillPlan(const char* histClass, THnBase* h, int nDimensions, const int* vars, int varW);
 
   HistogramManager& operator=(const HistogramManager& c);
   HistogramManager(const HistogramManager& c);
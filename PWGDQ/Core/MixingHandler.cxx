@@ -12,6 +12,8 @@
 #include "PWGDQ/Core/MixingHandler.h"
 #include "PWGDQ/Core/VarManager.h"
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <fstream>
 using namespace std;
@@ -26,7 +28,10 @@ ClassImp(MixingHandler);
 MixingHandler::MixingHandler() : TNamed(),
                                  fIsInitialized(kFALSE),
                                  fVariableLimits(),
-                                 fVariables()
+                                 fVariables(),
+                                 fCategoryStrides(),
+                                 fIsUniform(),
+                                 fInvBinWidth()
 {
   //
   // default constructor
@@ -37,7 +42,10 @@ MixingHandler::MixingHandler() : TNamed(),
 MixingHandler::MixingHandler(const char* name, const char* title) : TNamed(name, title),
                                                                     fIsInitialized(kFALSE),
                                                                     fVariableLimits(),
-                                                                    fVariables()
+                                                                    fVariables(),
+                                                                    fCategoryStrides(),
+                                                                    fIsUniform(),
+                                                                    fInvBinWidth()
 {
   //
   // Named constructor
@@ -63,17 +71,13 @@ void MixingHandler::AddMixingVariable(int var, int nBins, float* binLims)
   varBins.Set(nBins, binLims);
   fVariableLimits.push_back(varBins);
   VarManager::SetUseVariable(var);
+  fIsInitialized = kFALSE;
 }
 
 //_________________________________________________________________________
 void MixingHandler::AddMixingVariable(int var, int nBins, std::vector<float> binLims)
 {
-
-  float* bins = new float[nBins];
-  for (int i = 0; i < nBins; ++i) {
-    bins[i] = binLims[i];
-  }
-  AddMixingVariable(var, nBins, bins);
+  AddMixingVariable(var, nBins, binLims.data());
 }
 
 //_________________________________________________________________________
@@ -110,15 +114,60 @@ void MixingHandler::Init()
   //
   // Initialization of pools
   //       The correct event category will be retrieved using the function FindEventCategory()
+  //       The strides of the variables in the category index and the bin widths of equidistant limits are cached here
   //
-  int size = 1;
-  for (auto v : fVariableLimits) {
-    size *= (v.GetSize() - 1);
+  int nVars = fVariables.size();
+  fCategoryStrides.assign(nVars, 1);
+  fIsUniform.assign(nVars, false);
+  fInvBinWidth.assign(nVars, 0.0f);
+  for (int iVar = nVars - 2; iVar >= 0; --iVar) {
+    fCategoryStrides[iVar] = fCategoryStrides[iVar + 1] * (fVariableLimits[iVar + 1].GetSize() - 1);
+  }
+  for (int iVar = 0; iVar < nVars; ++iVar) {
+    const TArrayF& lims = fVariableLimits[iVar];
+    int nBins = lims.GetSize() - 1;
+    if (nBins < 1 || !(lims[nBins] > lims[0])) {
+      continue;
+    }
+    float width = (lims[nBins] - lims[0]) / nBins;
+    bool isUniform = true;
+    for (int iBin = 1; iBin <= nBins; ++iBin) {
+      if (std::abs(lims[iBin] - lims[iBin - 1] - width) > 1.0e-3 * width) {
+        isUniform = false;
+        break;
+      }
+    }
+    fIsUniform[iVar] = isUniform;
+    fInvBinWidth[iVar] = 1.0f / width;
   }
-  (void)size;
   fIsInitialized = kTRUE;
 }
 
+//_________________________________________________________________________
+int MixingHandler::FindBin(int iVar, float value) const
+{
+  //
+  // Find the bin of the value in the limits of the variable, -1 if outside the limits
+  //
+  const TArrayF& lims = fVariableLimits[iVar];
+  int nBins = lims.GetSize() - 1;
+  if (nBins < 1 || !(value >= lims[0] && value < lims[nBins])) {
+    return -1; // also for NaN
+  }
+  if (!fIsUniform[iVar]) {
+    return std::upper_bound(lims.GetArray(), lims.GetArray() + nBins + 1, value) - lims.GetArray() - 1;
+  }
+  // equidistant limits: compute the bin and correct for the rounding at the bin edges
+  int bin = std::min(static_cast<int>((value - lims[0]) * fInvBinWidth[iVar]), nBins - 1);
+  while (bin > 0 && value < lims[bin]) {
+    --bin;
+  }
+  while (bin < nBins - 1 && value >= lims[bin + 1]) {
+    ++bin;
+  }
+  return bin;
+}
+
 //_________________________________________________________________________
 int MixingHandler::FindEventCategory(float* values)
 {
@@ -132,31 +181,13 @@ int MixingHandler::FindEventCategory(float* values)
     Init();
   }
 
-  std::vector<int> bin;
-  int iVar = 0;
-  for (auto v = fVariableLimits.begin(); v != fVariableLimits.end(); v++, iVar++) {
-    int binValue = TMath::BinarySearch((*v).GetSize(), (*v).GetArray(), values[fVariables[iVar]]);
-    bin.push_back(binValue);
-    if (bin[iVar] == -1 || bin[iVar] == (*v).GetSize() - 1) {
-      return -1; // all variables must be inside limits
-    }
-  }
-
   int category = 0;
-  int tempCategory = 1;
-  int iv1 = 0;
-  int iv2 = 0;
-  for (auto v1 = fVariables.begin(); v1 != fVariables.end(); v1++, iv1++) {
-    tempCategory = 1;
-    iv2 = iv1;
-    for (auto v2 = v1; v2 != fVariables.end(); v2++, iv2++) {
-      if (iv2 == iv1) {
-        tempCategory *= bin[iv2];
-      } else {
-        tempCategory *= (fVariableLimits[iv2].GetSize() - 1);
-      }
+  for (size_t iVar = 0; iVar < fVariables.size(); ++iVar) {
+    int bin = FindBin(iVar, values[fVariables[iVar]]);
+    if (bin < 0) {
+      return -1; // all variables must be inside limits
     }
-    category += tempCategory;
+    category += bin * fCategoryStrides[iVar];
   }
   return category;
 }
@@ -58,6 +58,13 @@ class MixingHandler : public TNamed
   std::vector<TArrayF> fVariableLimits;
   std::vector<int> fVariables;
 
+  // Lookup helpers, computed in Init()
+  std::vector<int> fCategoryStrides; //! stride of each variable in the category index
+  std::vector<bool> fIsUniform;      //! flag for equidistant bin limits, where the bin is computed directly
+  std::vector<float> fInvBinWidth;   //! inverse bin width for the equidistant bin limits
+
+  int FindBin(int iVar, float value) const;
+
   ClassDef(MixingHandler, 1);
 };
 
@@ -21,6 +21,7 @@ ClassImp(VarManager);
 TString VarManager::fgVariableNames[VarManager::kNVars] = {""};
 TString VarManager::fgVariableUnits[VarManager::kNVars] = {""};
 bool VarManager::fgUsedVars[VarManager::kNVars] = {false};
+std::vector<int> VarManager::fgUsedVarsList = {};
 bool VarManager::fgUsedKF = false;
 float VarManager::fgMagField = 0.5;
 float VarManager::fgValues[VarManager::kNVars] = {0.0f};
@@ -88,6 +89,21 @@ void VarManager::SetVariableDependencies()
   if (fgUsedVars[kTrackIsInsideTPCModule]) {
     fgUsedVars[kPhiTPCOuter] = true;
   }
+  UpdateUsedVarsList();
+}
+
+//__________________________________________________________________
+void VarManager::UpdateUsedVarsList()
+{
+  //
+  // Rebuild the list of used variables from the flags
+  //
+  fgUsedVarsList.clear();
+  for (int i = 0; i < kNVars; ++i) {
+    if (fgUsedVars[i]) {
+      fgUsedVarsList.push_back(i);
+    }
+  }
 }
 
 //__________________________________________________________________
@@ -104,6 +120,21 @@ void VarManager::ResetValues(int startValue, int endValue, float* values)
   }
 }
 
+//__________________________________________________________________
+void VarManager::ResetUsedValues(float* values)
+{
+  //
+  // reset to the same neutral value as ResetValues() only the variables flagged as used
+  // NOTE: the other variables keep the values of the previous candidate, so this is suitable only
+  //       when the values are consumed by the histogram manager, the cuts or any other user of the flagged variables
+  if (!values) {
+    values = fgValues;
+  }
+  for (const auto& i : fgUsedVarsList) {
+    values[i] = -9999.;
+  }
+}
+
 //__________________________________________________________________
 void VarManager::SetRunNumbers(int n, int* runs)
 {
@@ -728,6 +728,7 @@ class VarManager : public TObject
     for (auto& var : usedVars) {
       fgUsedVars[var] = true;
     }
+    UpdateUsedVarsList();
   }
   static bool GetUsedVar(int var)
   {
@@ -970,11 +971,14 @@ class VarManager : public TObject
 
   static float fgValues[kNVars]; // array holding all variables computed during analysis
   static void ResetValues(int startValue = 0, int endValue = kNVars, float* values = nullptr);
+  static void ResetUsedValues(float* values = nullptr); // reset only the variables flagged as used, cheaper than ResetValues(0, kNVars) when few variables are needed
 
  private:
   static bool fgUsedVars[kNVars]; // holds flags for when the corresponding variable is needed (e.g., in the histogram manager, in cuts, mixing handler, etc.)
   static bool fgUsedKF;
   static void SetVariableDependencies(); // toggle those variables on which other used variables might depend
+  static std::vector<int> fgUsedVarsList; // indices of the used variables, kept in sync with fgUsedVars
+  static void UpdateUsedVarsList();
 
   static float fgMagField;
   static std::map<int, int> fgRunMap;     // map of runs to be used in histogram axes
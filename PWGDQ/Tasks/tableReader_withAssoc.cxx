@@ -1366,7 +1366,7 @@ struct AnalysisSameEventPairing {
   template <int TPairType, uint32_t TEventFillMap, typename TAssoc1, typename TAssoc2, typename TTracks1, typename TTracks2>
   void runMixedPairing(TAssoc1 const& assocs1, TAssoc2 const& assocs2, TTracks1 const& /*tracks1*/, TTracks2 const& /*tracks2*/)
   {
-    std::map<int, std::vector<TString>> histNames = fTrackHistNames;
+    const std::map<int, std::vector<TString>>& histNames = (TPairType == VarManager::kDecayToMuMu ? fMuonHistNames : fTrackHistNames);
     int pairSign = 0;
     int ncuts = 0;
     uint32_t twoTrackFilter = 0;
@@ -1398,7 +1398,6 @@ struct AnalysisSameEventPairing {
             VarManager::FillPairVn<TPairType>(t1, t2);
           }
           ncuts = fNCutsMuon;
-          histNames = fMuonHistNames;
         }
         /*if constexpr (TPairType == VarManager::kElectronMuon) {
           twoTrackFilter = a1.isBarrelSelected_raw() & a1.isBarrelSelectedPrefilter_raw() & a2.isMuonSelected_raw() & fTrackFilterMask;
@@ -1409,12 +1408,12 @@ struct AnalysisSameEventPairing {
             continue; // cut not passed
           }
           if (pairSign == 0) {
-            fHistMan->FillHistClass(histNames[icut][3].Data(), VarManager::fgValues);
+            fHistMan->FillHistClass(histNames.at(icut)[3].Data(), VarManager::fgValues);
           } else {
             if (pairSign > 0) {
-              fHistMan->FillHistClass(histNames[icut][4].Data(), VarManager::fgValues);
+              fHistMan->FillHistClass(histNames.at(icut)[4].Data(), VarManager::fgValues);
             } else {
-              fHistMan->FillHistClass(histNames[icut][5].Data(), VarManager::fgValues);
+              fHistMan->FillHistClass(histNames.at(icut)[5].Data(), VarManager::fgValues);
             }
           }
         } // end for (cuts)
@@ -1429,7 +1428,7 @@ struct AnalysisSameEventPairing {
     events.bindExternalIndices(&assocs);
     int mixingDepth = fConfigMixingDepth.value;
     for (auto& [event1, event2] : selfCombinations(hashBin, mixingDepth, -1, events, events)) {
-      VarManager::ResetValues(0, VarManager::kNVars);
+      VarManager::ResetUsedValues(); // only histograms are filled from the mixed-event values
       VarManager::FillEvent<TEventFillMap>(event1, VarManager::fgValues);
 
       auto assocs1 = assocs.sliceBy(preSlice, event1.globalIndex());
@@ -2449,7 +2448,7 @@ struct AnalysisDileptonTrack {
     events.bindExternalIndices(&assocs);
 
     for (auto& [event1, event2] : selfCombinations(fHashBin, fConfigMixingDepth.value, -1, events, events)) {
-      VarManager::ResetValues(0, VarManager::kNVars);
+      VarManager::ResetUsedValues(); // only histograms are filled from the mixed-event values
       VarManager::FillEvent<gkEventFillMap>(event1, VarManager::fgValues);
 
       auto evDileptons = dileptons.sliceBy(dielectronsPerCollision, event1.globalIndex());
@@ -2487,7 +2486,7 @@ struct AnalysisDileptonTrack {
     events.bindExternalIndices(&assocs);
 
     for (auto& [event1, event2] : selfCombinations(fHashBin, fConfigMixingDepth.value, -1, events, events)) {
-      VarManager::ResetValues(0, VarManager::kNVars);
+      VarManager::ResetUsedValues(); // only histograms are filled from the mixed-event values
       VarManager::FillEvent<gkEventFillMap>(event1, VarManager::fgValues);
 
       auto evDileptons = dileptons.sliceBy(dimuonsPerCollision, event1.globalIndex());
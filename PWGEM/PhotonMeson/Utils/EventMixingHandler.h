@@ -15,63 +15,146 @@
 #ifndef PWGEM_PHOTONMESON_UTILS_EVENTMIXINGHANDLER_H_
 #define PWGEM_PHOTONMESON_UTILS_EVENTMIXINGHANDLER_H_
 
+#include <algorithm>
+#include <cstdint>
+#include <functional>
 #include <map>
+#include <span>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
 namespace o2::aod::pwgem::photonmeson::utils
 {
+/// Event pools for mixing, one per mixing bin (key T), holding up to ndepth collisions (key U) with their tracks (V).
+/// The tracks of the current collision are staged with AddTrackToEventPool() and moved into the pool of its bin
+/// by AddCollisionIdAtLast(). The track buffers of the collisions leaving the pool are reused for the next ones,
+/// so that the memory stays bounded by (number of bins) x ndepth collisions.
+/// The pool and the position in the pool of each collision are kept in a hash map, for constant-time track lookups.
+/// The accessors return views on the internal buffers, valid until the next call to AddTrackToEventPool() or AddCollisionIdAtLast().
 template <typename T, typename U, typename V>
 class EventMixingHandler
 {
  public:
-  EventMixingHandler()
-  {
-    fNdepth = 0;
-    fMapMixBins.clear();
-    fMap_Tracks_per_collision.clear();
-  }
+  EventMixingHandler() : EventMixingHandler(0) {}
 
   explicit EventMixingHandler(int ndepth)
   {
     fNdepth = ndepth;
     fMapMixBins.clear();
-    fMap_Tracks_per_collision.clear();
+    fPools.clear();
+    fMapCollisions.clear();
   }
 
   ~EventMixingHandler()
   {
     fMapMixBins.clear();
-    fMap_Tracks_per_collision.clear();
+    fPools.clear();
+    fMapCollisions.clear();
   }
 
   void SetNdepth(int ndepth) { fNdepth = ndepth; }
 
   void AddTrackToEventPool(U key_df_collision, V obj)
   {
-    fMap_Tracks_per_collision[key_df_collision].emplace_back(obj);
+    if (!fHasCurrentCollision || key_df_collision != fCurrentCollision) {
+      // tracks of a collision which was not added to any pool are dropped here
+      fCurrentCollision = key_df_collision;
+      fHasCurrentCollision = true;
+      fCurrentTracks.clear();
+    }
+    fCurrentTracks.emplace_back(obj);
   }
 
-  std::vector<U> GetCollisionIdsFromEventPool(T key_bin) { return fMapMixBins[key_bin]; }
-  std::vector<V> GetTracksPerCollision(T key_bin, int index) { return fMap_Tracks_per_collision[fMapMixBins[key_bin][index]]; }
-  std::vector<V> GetTracksPerCollision(U key_df_collision) { return fMap_Tracks_per_collision[key_df_collision]; }
+  std::span<const U> GetCollisionIdsFromEventPool(T key_bin) { return fPools[GetPoolIndex(key_bin)].collisionIds; }
+  std::span<const V> GetTracksPerCollision(T key_bin, int index) { return fPools[GetPoolIndex(key_bin)].tracks[index]; }
+  std::span<const V> GetTracksPerCollision(U key_df_collision)
+  {
+    if (fHasCurrentCollision && key_df_collision == fCurrentCollision) {
+      return fCurrentTracks;
+    }
+    auto it = fMapCollisions.find(key_df_collision);
+    if (it == fMapCollisions.end()) {
+      return {};
+    }
+    const auto& pool = fPools[it->second.pool];
+    return pool.tracks[it->second.entry - pool.firstEntry];
+  }
 
   // call this function at the end of collision loop
   void AddCollisionIdAtLast(T key_bin, U key_df_collision)
   {
-    // LOGF(info, "fMapMixBins[key_bin].size() = %d", fMapMixBins[key_bin].size());
-    if (static_cast<int>(fMapMixBins[key_bin].size()) >= fNdepth) {
-      fMap_Tracks_per_collision[fMapMixBins[key_bin][0]].clear();
-      fMap_Tracks_per_collision[fMapMixBins[key_bin][0]].shrink_to_fit();
-      fMapMixBins[key_bin].erase(fMapMixBins[key_bin].begin());
+    if (fNdepth <= 0) {
+      return;
+    }
+    const int iPool = GetPoolIndex(key_bin);
+    auto& pool = fPools[iPool];
+    if (static_cast<int>(pool.collisionIds.size()) >= fNdepth) {
+      // the oldest collision leaves the pool, its track buffer is recycled at the end
+      auto itOldest = fMapCollisions.find(pool.collisionIds.front());
+      if (itOldest != fMapCollisions.end() && itOldest->second.pool == iPool && itOldest->second.entry == pool.firstEntry) {
+        fMapCollisions.erase(itOldest);
+      }
+      pool.firstEntry++;
+      std::rotate(pool.collisionIds.begin(), pool.collisionIds.begin() + 1, pool.collisionIds.end());
+      std::rotate(pool.tracks.begin(), pool.tracks.begin() + 1, pool.tracks.end());
+      pool.collisionIds.back() = key_df_collision;
+    } else {
+      pool.collisionIds.emplace_back(key_df_collision);
+      pool.tracks.emplace_back();
+    }
+    pool.tracks.back().clear();
+    fMapCollisions[key_df_collision] = {iPool, pool.firstEntry + pool.collisionIds.size() - 1};
+    if (fHasCurrentCollision && key_df_collision == fCurrentCollision) {
+      pool.tracks.back().swap(fCurrentTracks);
+      fHasCurrentCollision = false;
     }
-    fMapMixBins[key_bin].emplace_back(key_df_collision);
   }
 
  private:
-  int fNdepth;                                           // depth of event mixing
-  std::map<T, std::vector<U>> fMapMixBins;               // map : e.g. <zbin, centbin, epbin> -> pair<df index, global collision index>
-  std::map<U, std::vector<V>> fMap_Tracks_per_collision; // map : e.g. pair<df index, global collision index> -> track array
+  struct Pool {
+    std::vector<U> collisionIds;        // collisions in the pool, from the oldest to the newest
+    std::vector<std::vector<V>> tracks; // track array of each collision in the pool
+    uint64_t firstEntry = 0;            // number of collisions which left the pool, i.e. entry number of the oldest one
+  };
+
+  struct CollisionLocation {
+    int pool;       // index of the pool
+    uint64_t entry; // entry number of the collision in its pool, its position is entry - firstEntry
+  };
+
+  struct CollisionHash {
+    size_t operator()(const U& key) const
+    {
+      if constexpr (requires { key.first; key.second; }) {
+        const size_t h1 = std::hash<decltype(key.first)>{}(key.first);
+        const size_t h2 = std::hash<decltype(key.second)>{}(key.second);
+        return h1 ^ (h2 + 0x9e3779b97f4a7c15ULL + (h1 << 6) + (h1 >> 2));
+      } else {
+        return std::hash<U>{}(key);
+      }
+    }
+  };
+
+  int GetPoolIndex(T key_bin)
+  {
+    auto it = fMapMixBins.find(key_bin);
+    if (it == fMapMixBins.end()) {
+      it = fMapMixBins.emplace(key_bin, static_cast<int>(fPools.size())).first;
+      fPools.emplace_back();
+      fPools.back().collisionIds.reserve(fNdepth > 0 ? fNdepth : 0);
+      fPools.back().tracks.reserve(fNdepth > 0 ? fNdepth : 0);
+    }
+    return it->second;
+  }
+
+  int fNdepth;                                                            // depth of event mixing
+  std::map<T, int> fMapMixBins;                                           // map : e.g. <zbin, centbin, epbin> -> index of the pool
+  std::vector<Pool> fPools;                                               // pool of each mixing bin
+  std::unordered_map<U, CollisionLocation, CollisionHash> fMapCollisions; // map : collision -> pool and entry in the pool
+  U fCurrentCollision{};                                                  // e.g. pair<df index, global collision index> of the current collision
+  bool fHasCurrentCollision = false;                                      // flag set once tracks of the current collision are staged
+  std::vector<V> fCurrentTracks;                                          // tracks of the current collision, not yet in a pool
 };
 } // namespace o2::aod::pwgem::photonmeson::utils
 #endif // PWGEM_PHOTONMESON_UTILS_EVENTMIXINGHANDLER_H_
@@ -76,6 +76,19 @@ struct HfCandidateSelectorD0 {
   o2::analysis::HfMlResponseD0ToKPi<float> hfMlResponse;
   std::vector<float> outputMlD0 = {};
   std::vector<float> outputMlD0bar = {};
+
+  /// Selection status of a candidate, kept until the ML scores of all the candidates are evaluated
+  struct SelectionStatus {
+    int statusD0;
+    int statusD0bar;
+    int statusHFFlag;
+    int statusTopol;
+    int statusCand;
+    int statusPID;
+    int iMlD0 = -1;    // position of the D0 hypothesis in the ML batch, -1 if not evaluated
+    int iMlD0bar = -1; // position of the D0bar hypothesis in the ML batch, -1 if not evaluated
+  };
+  std::vector<SelectionStatus> selectionStatuses;
   o2::ccdb::CcdbApi ccdbApi;
   TrackSelectorPi selectorPion;
   TrackSelectorKa selectorKaon;
@@ -255,6 +268,7 @@ struct HfCandidateSelectorD0 {
   void processSel(CandType const& candidates,
                   TracksSel const&)
   {
+    selectionStatuses.clear();
     // looping over 2-prong candidates
     for (const auto& candidate : candidates) {
 
@@ -266,14 +280,8 @@ struct HfCandidateSelectorD0 {
       int statusCand = 0;
       int statusPID = 0;
 
-      outputMlD0.clear();
-      outputMlD0bar.clear();
-
       if (!(candidate.hfflag() & 1 << aod::hf_cand_2prong::DecayType::D0ToPiK)) {
-        hfSelD0Candidate(statusD0, statusD0bar, statusHFFlag, statusTopol, statusCand, statusPID);
-        if (applyMl) {
-          hfMlD0Candidate(outputMlD0, outputMlD0bar);
-        }
+        selectionStatuses.push_back({statusD0, statusD0bar, statusHFFlag, statusTopol, statusCand, statusPID});
         continue;
       }
       statusHFFlag = 1;
@@ -284,10 +292,7 @@ struct HfCandidateSelectorD0 {
 
       // conjugate-independent topological selection
       if (!selectionTopol<reconstructionType>(candidate)) {
-        hfSelD0Candidate(statusD0, statusD0bar, statusHFFlag, statusTopol, statusCand, statusPID);
-        if (applyMl) {
-          hfMlD0Candidate(outputMlD0, outputMlD0bar);
-        }
+        selectionStatuses.push_back({statusD0, statusD0bar, statusHFFlag, statusTopol, statusCand, statusPID});
         continue;
       }
       statusTopol = 1;
@@ -301,10 +306,7 @@ struct HfCandidateSelectorD0 {
       bool topolD0bar = selectionTopolConjugate<reconstructionType>(candidate, trackNeg, trackPos);
 
       if (!topolD0 && !topolD0bar) {
-        hfSelD0Candidate(statusD0, statusD0bar, statusHFFlag, statusTopol, statusCand, statusPID);
-        if (applyMl) {
-          hfMlD0Candidate(outputMlD0, outputMlD0bar);
-        }
+        selectionStatuses.push_back({statusD0, statusD0bar, statusHFFlag, statusTopol, statusCand, statusPID});
         continue;
       }
       statusCand = 1;
@@ -355,10 +357,7 @@ struct HfCandidateSelectorD0 {
         }
 
         if (pidD0 == 0 && pidD0bar == 0) {
-          hfSelD0Candidate(statusD0, statusD0bar, statusHFFlag, statusTopol, statusCand, statusPID);
-          if (applyMl) {
-            hfMlD0Candidate(outputMlD0, outputMlD0bar);
-          }
+          selectionStatuses.push_back({statusD0, statusD0bar, statusHFFlag, statusTopol, statusCand, statusPID});
           continue;
         }
 
@@ -378,45 +377,68 @@ struct HfCandidateSelectorD0 {
         }
       }
 
+      int iMlD0 = -1;
+      int iMlD0bar = -1;
       if (applyMl) {
-        // ML selections
-        bool isSelectedMlD0 = false;
-        bool isSelectedMlD0bar = false;
-
+        // ML selections, evaluated in batch for all the candidates after this loop
         if (statusD0 > 0) {
           std::vector<float> inputFeaturesD0 = hfMlResponse.getInputFeatures(candidate, trackPos, trackNeg, o2::constants::physics::kD0);
-          isSelectedMlD0 = hfMlResponse.isSelectedMl(inputFeaturesD0, ptCand, outputMlD0);
+          iMlD0 = hfMlResponse.enqueueMl(inputFeaturesD0, ptCand);
         }
         if (statusD0bar > 0) {
           std::vector<float> inputFeaturesD0bar = hfMlResponse.getInputFeatures(candidate, trackPos, trackNeg, o2::constants::physics::kD0Bar);
-          isSelectedMlD0bar = hfMlResponse.isSelectedMl(inputFeaturesD0bar, ptCand, outputMlD0bar);
+          iMlD0bar = hfMlResponse.enqueueMl(inputFeaturesD0bar, ptCand);
+        }
+      }
+      selectionStatuses.push_back({statusD0, statusD0bar, statusHFFlag, statusTopol, statusCand, statusPID, iMlD0, iMlD0bar});
+    }
+
+    if (applyMl) {
+      hfMlResponse.evaluateBatch();
+    }
+
+    // filling the tables, in the same order as the candidates
+    auto status = selectionStatuses.begin();
+    for (const auto& candidate : candidates) {
+      if (applyMl) {
+        bool isSelectedMlD0 = false;
+        bool isSelectedMlD0bar = false;
+        outputMlD0.clear();
+        outputMlD0bar.clear();
+
+        if (status->iMlD0 >= 0) {
+          isSelectedMlD0 = hfMlResponse.isSelectedMlBatch(status->iMlD0, outputMlD0);
+        }
+        if (status->iMlD0bar >= 0) {
+          isSelectedMlD0bar = hfMlResponse.isSelectedMlBatch(status->iMlD0bar, outputMlD0bar);
         }
 
         if (!isSelectedMlD0) {
-          statusD0 = 0;
+          status->statusD0 = 0;
         }
         if (!isSelectedMlD0bar) {
-          statusD0bar = 0;
+          status->statusD0bar = 0;
         }
 
         hfMlD0Candidate(outputMlD0, outputMlD0bar);
 
         if (enableDebugMl) {
           if (isSelectedMlD0) {
-            registry.fill(HIST("DebugBdt/hBdtScore1VsStatus"), outputMlD0[0], statusD0);
-            registry.fill(HIST("DebugBdt/hBdtScore2VsStatus"), outputMlD0[1], statusD0);
-            registry.fill(HIST("DebugBdt/hBdtScore3VsStatus"), outputMlD0[2], statusD0);
+            registry.fill(HIST("DebugBdt/hBdtScore1VsStatus"), outputMlD0[0], status->statusD0);
+            registry.fill(HIST("DebugBdt/hBdtScore2VsStatus"), outputMlD0[1], status->statusD0);
+            registry.fill(HIST("DebugBdt/hBdtScore3VsStatus"), outputMlD0[2], status->statusD0);
             registry.fill(HIST("DebugBdt/hMassDmesonSel"), hfHelper.invMassD0ToPiK(candidate));
           }
           if (isSelectedMlD0bar) {
-            registry.fill(HIST("DebugBdt/hBdtScore1VsStatus"), outputMlD0bar[0], statusD0bar);
-            registry.fill(HIST("DebugBdt/hBdtScore2VsStatus"), outputMlD0bar[1], statusD0bar);
-            registry.fill(HIST("DebugBdt/hBdtScore3VsStatus"), outputMlD0bar[2], statusD0bar);
+            registry.fill(HIST("DebugBdt/hBdtScore1VsStatus"), outputMlD0bar[0], status->statusD0bar);
+            registry.fill(HIST("DebugBdt/hBdtScore2VsStatus"), outputMlD0bar[1], status->statusD0bar);
+            registry.fill(HIST("DebugBdt/hBdtScore3VsStatus"), outputMlD0bar[2], status->statusD0bar);
             registry.fill(HIST("DebugBdt/hMassDmesonSel"), hfHelper.invMassD0barToKPi(candidate));
           }
         }
       }
-      hfSelD0Candidate(statusD0, statusD0bar, statusHFFlag, statusTopol, statusCand, statusPID);
+      hfSelD0Candidate(status->statusD0, status->statusD0bar, status->statusHFFlag, status->statusTopol, status->statusCand, status->statusPID);
+      ++status;
     }
   }
 
@@ -21,8 +21,14 @@
 /// \author Federica Zanone <federica.zanone@cern.ch>, Heidelberg University
 
 #include <algorithm> // std::find
+#include <atomic>    // std::atomic
+#include <cmath>     // std::sqrt
 #include <iterator>  // std::distance
+#include <limits>    // std::numeric_limits
+#include <memory>    // std::unique_ptr
+#include <mutex>     // std::mutex
 #include <string>    // std::string
+#include <tuple>     // std::tuple
 #include <vector>    // std::vector
 
 #include "CommonConstants/PhysicsConstants.h"
@@ -39,6 +45,7 @@
 #include "ReconstructionDataFormats/Vertex.h" // for PV refit
 
 #include "Common/Core/TrackSelectorPID.h"
+#include "Common/Core/WorkerPool.h"
 #include "Common/Core/trackUtilities.h"
 #include "Common/DataModel/Centrality.h"
 #include "Common/DataModel/CollisionAssociationTables.h"
@@ -53,6 +60,7 @@
 #include "PWGHF/Utils/utilsAnalysis.h"
 #include "PWGHF/Utils/utilsBfieldCCDB.h"
 #include "PWGHF/Utils/utilsEvSelHf.h"
+#include "PWGHF/Utils/utilsPvRefitHf.h"
 
 using namespace o2;
 using namespace o2::analysis;
@@ -261,6 +269,9 @@ struct HfTrackIndexSkimCreatorTagSelTracks {
   o2::base::MatLayerCylSet* lut;
   o2::base::Propagator::MatCorrType noMatCorr = o2::base::Propagator::MatCorrType::USEMatCorrNONE;
   int runNumber;
+  o2::hf_pvrefit::PvRefitter pvRefitter;                           // PV refit, prepared once per collision
+  std::vector<int64_t> vecPvContributorGlobId;                     // global ID of PV contributors for the current collision
+  std::vector<o2::track::TrackParCov> vecPvContributorTrackParCov; // TrackParCov of PV contributors for the current collision
 
   // single-track cuts
   static const int nCuts = 4;
@@ -670,75 +681,25 @@ struct HfTrackIndexSkimCreatorTagSelTracks {
   }
 
   /// Method for the PV refit and DCA recalculation for tracks with a collision assigned
-  /// \param collision is a collision
-  /// \param bcWithTimeStamps is a table of bunch crossing joined with timestamps used to query the CCDB for B and material budget
-  /// \param vecPvContributorGlobId is a vector containing the global ID of PV contributors for the current collision
-  /// \param vecPvContributorTrackParCov is a vector containing the TrackParCov of PV contributors for the current collision
+  /// \param collision is a collision, whose vertex refit was prepared in pvRefitter
   /// \param trackToRemove is the track to be removed, if contributor, from the PV refit
   /// \param pvCoord is an array containing the coordinates of the refitted PV
   /// \param pvCovMatrix is an array containing the covariance matrix values of the refitted PV
   /// \param dcaXYdcaZ is an array containing the dcaXY and dcaZ of trackToRemove with respect to the refitted PV
   template <typename TTrack>
   void performPvRefitTrack(aod::Collision const& collision,
-                           aod::BCsWithTimestamps const&,
-                           std::vector<int64_t> vecPvContributorGlobId,
-                           std::vector<o2::track::TrackParCov> vecPvContributorTrackParCov,
                            TTrack const& trackToRemove,
                            std::array<float, 3>& pvCoord,
                            std::array<float, 6>& pvCovMatrix,
                            std::array<float, 2>& dcaXYdcaZ)
   {
-    std::vector<bool> vecPvRefitContributorUsed(vecPvContributorGlobId.size(), true);
-
-    /// Prepare the vertex refitting
-    // set the magnetic field from CCDB
-    auto bc = collision.bc_as<o2::aod::BCsWithTimestamps>();
-    initCCDB(bc, runNumber, ccdb, config.isRun2 ? config.ccdbPathGrp : config.ccdbPathGrpMag, lut, config.isRun2);
-    /*if (runNumber != bc.runNumber()) {
-
-      if (isRun2) { // Run 2 GRP object
-        o2::parameters::GRPObject* grpo = ccdb->getForTimeStamp<o2::parameters::GRPObject>(ccdbPathGrp, bc.timestamp());
-        if (grpo != nullptr) {
-          o2::base::Propagator::initFieldFromGRP(grpo);
-          o2::base::Propagator::Instance()->setMatLUT(lut);
-          LOGF(info, "Setting magnetic field to %d kG for run %d from its GRP CCDB object (type o2::parameters::GRPObject)", grpo->getNominalL3Field(), bc.runNumber());
-        } else {
-          LOGF(fatal, "Run 2 GRP object (type o2::parameters::GRPObject) is not available in CCDB for run=%d at timestamp=%llu", bc.runNumber(), bc.timestamp());
-        }
-      } else { // Run 3 GRP object
-        o2::parameters::GRPMagField* grpo = ccdb->getForTimeStamp<o2::parameters::GRPMagField>(ccdbPathGrpMag, bc.timestamp());
-        if (grpo != nullptr) {
-          o2::base::Propagator::initFieldFromGRP(grpo);
-          o2::base::Propagator::Instance()->setMatLUT(lut);
-          LOG(info) << "Setting magnetic field to current" << grpo->getL3Current() << " A for run" << bc.runNumber() << " from its GRP CCDB object (type o2::parameters::GRPMagField)";
-        } else {
-          LOGF(fatal, "Run 3 GRP object (type o2::parameters::GRPMagField) is not available in CCDB for run=%d at timestamp=%llu", bc.runNumber(), bc.timestamp());
-        }
-      }
-
-      runNumber = bc.runNumber();
-    }*/
-
-    // build the VertexBase to initialize the vertexer
-    o2::dataformats::VertexBase primVtx;
-    primVtx.setX(collision.posX());
-    primVtx.setY(collision.posY());
-    primVtx.setZ(collision.posZ());
-    primVtx.setCov(collision.covXX(), collision.covXY(), collision.covYY(), collision.covXZ(), collision.covYZ(), collision.covZZ());
-    // configure PVertexer
-    o2::vertexing::PVertexer vertexer;
-    o2::conf::ConfigurableParam::updateFromString("pvertexer.useMeanVertexConstraint=false"); /// remove diamond constraint (let's keep it at the moment...)
-    vertexer.init();
-    bool pvRefitDoable = vertexer.prepareVertexRefit(vecPvContributorTrackParCov, primVtx);
+    const auto& primVtx = pvRefitter.getPrimaryVertex();
+    bool pvRefitDoable = pvRefitter.isDoable();
     if (!pvRefitDoable) {
-      LOG(info) << "Not enough tracks accepted for the refit";
       if (config.doPvRefit && config.fillHistograms) {
         registry.fill(HIST("PvRefit/hNContribPvRefitNotDoable"), collision.numContrib());
       }
     }
-    if (config.debugPvRefit) {
-      LOG(info) << "prepareVertexRefit = " << pvRefitDoable << " Ncontrib= " << vecPvContributorTrackParCov.size() << " Ntracks= " << collision.numContrib() << " Vtx= " << primVtx.asString();
-    }
 
     if (config.fillHistograms) {
       registry.fill(HIST("PvRefit/hVerticesPerTrack"), 1);
@@ -751,15 +712,11 @@ struct HfTrackIndexSkimCreatorTagSelTracks {
     bool recalcImpPar = false;
     if (config.doPvRefit && pvRefitDoable) {
       recalcImpPar = true;
-      auto trackIterator = std::find(vecPvContributorGlobId.begin(), vecPvContributorGlobId.end(), trackToRemove.globalIndex()); /// track global index
-      if (trackIterator != vecPvContributorGlobId.end()) {
+      if (pvRefitter.isContributor(trackToRemove.globalIndex())) {
 
         /// this track contributed to the PV fit: let's do the refit without it
-        const int entry = std::distance(vecPvContributorGlobId.begin(), trackIterator);
-
-        vecPvRefitContributorUsed[entry] = false; /// remove the track from the PV refitting
-
-        auto primVtxRefitted = vertexer.refitVertex(vecPvRefitContributorUsed, primVtx); // vertex refit
+        int nRemoved = 0;
+        auto primVtxRefitted = pvRefitter.refitWithout({trackToRemove.globalIndex()}, nRemoved); // vertex refit
         // LOG(info) << "refit " << cnt << "/" << ntr << " result = " << primVtxRefitted.asString();
         if (config.debugPvRefit) {
           LOG(info) << "refit for track with global index " << static_cast<int>(trackToRemove.globalIndex()) << " " << primVtxRefitted.asString();
@@ -782,8 +739,6 @@ struct HfTrackIndexSkimCreatorTagSelTracks {
           registry.fill(HIST("PvRefit/hChi2vsNContrib"), primVtxRefitted.getNContributors(), primVtxRefitted.getChi2());
         }
 
-        vecPvRefitContributorUsed[entry] = true; /// restore the track for the next PV refitting (probably not necessary here)
-
         if (recalcImpPar) {
           // fill the histograms for refitted PV with good Chi2
           const double deltaX = primVtx.getX() - primVtxRefitted.getX();
@@ -868,12 +823,13 @@ struct HfTrackIndexSkimCreatorTagSelTracks {
                        TTracks const&,
                        GroupedTrackIndices const& trackIndicesCollision,
                        GroupedPvContributors const& pvContrCollision,
-                       aod::BCsWithTimestamps const& bcWithTimeStamps,
+                       aod::BCsWithTimestamps const&,
                        std::vector<std::array<float, 2>>& pvRefitDcaPerTrack,
                        std::vector<std::array<float, 3>>& pvRefitPvCoordPerTrack,
                        std::vector<std::array<float, 6>>& pvRefitPvCovMatrixPerTrack)
   {
     auto thisCollId = collision.globalIndex();
+    bool isPvRefitPrepared = false;
     for (const auto& trackId : trackIndicesCollision) {
       int statusProng = BIT(CandidateType::NCandidateTypes) - 1; // all bits on
       auto track = trackId.template track_as<TTracks>();
@@ -890,23 +846,36 @@ struct HfTrackIndexSkimCreatorTagSelTracks {
         pvRefitPvCoord = {collision.posX(), collision.posY(), collision.posZ()};
         pvRefitPvCovMatrix = {collision.covXX(), collision.covXY(), collision.covYY(), collision.covXZ(), collision.covYZ(), collision.covZZ()};
 
-        /// retrieve PV contributors for the current collision
-        std::vector<int64_t> vecPvContributorGlobId = {};
-        std::vector<o2::track::TrackParCov> vecPvContributorTrackParCov = {};
+        /// retrieve PV contributors for the current collision and prepare the vertex refit, once per collision
+        if (!isPvRefitPrepared) {
+          vecPvContributorGlobId.clear();
+          vecPvContributorTrackParCov.clear();
+          for (const auto& contributor : pvContrCollision) {
+            vecPvContributorGlobId.push_back(contributor.globalIndex());
+            vecPvContributorTrackParCov.push_back(getTrackParCov(contributor));
+          }
+          if (config.debugPvRefit) {
+            LOG(info) << "### vecPvContributorGlobId.size()=" << vecPvContributorGlobId.size() << ", vecPvContributorTrackParCov.size()=" << vecPvContributorTrackParCov.size() << ", N. original contributors=" << collision.numContrib();
+          }
 
-        for (const auto& contributor : pvContrCollision) {
-          vecPvContributorGlobId.push_back(contributor.globalIndex());
-          vecPvContributorTrackParCov.push_back(getTrackParCov(contributor));
-        }
-        if (config.debugPvRefit) {
-          LOG(info) << "### vecPvContributorGlobId.size()=" << vecPvContributorGlobId.size() << ", vecPvContributorTrackParCov.size()=" << vecPvContributorTrackParCov.size() << ", N. original contributors=" << collision.numContrib();
+          // set the magnetic field from CCDB
+          auto bc = collision.bc_as<o2::aod::BCsWithTimestamps>();
+          initCCDB(bc, runNumber, ccdb, config.isRun2 ? config.ccdbPathGrp : config.ccdbPathGrpMag, lut, config.isRun2);
+          bool pvRefitDoable = pvRefitter.prepare(collision, vecPvContributorGlobId, vecPvContributorTrackParCov);
+          if (!pvRefitDoable) {
+            LOG(info) << "Not enough tracks accepted for the refit";
+          }
+          if (config.debugPvRefit) {
+            LOG(info) << "prepareVertexRefit = " << pvRefitDoable << " Ncontrib= " << vecPvContributorTrackParCov.size() << " Ntracks= " << collision.numContrib() << " Vtx= " << pvRefitter.getPrimaryVertex().asString();
+          }
+          isPvRefitPrepared = true;
         }
 
         /// Perform the PV refit only for tracks with an assigned collision
         if (config.debugPvRefit) {
           LOG(info) << "[BEFORE performPvRefitTrack] track.collision().globalIndex(): " << collision.globalIndex();
         }
-        performPvRefitTrack(collision, bcWithTimeStamps, vecPvContributorGlobId, vecPvContributorTrackParCov, track, pvRefitPvCoord, pvRefitPvCovMatrix, pvRefitDcaXYDcaZ);
+        performPvRefitTrack(collision, track, pvRefitPvCoord, pvRefitPvCovMatrix, pvRefitDcaXYDcaZ);
         // we subtract the offset since trackIdx is the global index referred to the total track table
         pvRefitDcaPerTrack[trackIdx] = pvRefitDcaXYDcaZ;
         pvRefitPvCoordPerTrack[trackIdx] = pvRefitPvCoord;
@@ -1135,6 +1104,8 @@ struct HfTrackIndexSkimCreator {
     Configurable<bool> debug{"debug", false, "debug mode"};
     Configurable<bool> debugPvRefit{"debugPvRefit", false, "debug lines for primary vertex refit"};
     Configurable<bool> fillHistograms{"fillHistograms", true, "fill histograms"};
+    Configurable<int> nThreads{"nThreads", 1, "number of threads sharing the collisions for the 2-prong and 3-prong combinatorics (1: serial)"};
+    Configurable<int> nCollisionsPerBatch{"nCollisionsPerBatch", 32, "number of collisions processed by the threads before their candidates are written"};
     // Configurable<int> nCollsMax{"nCollsMax", -1, "Max collisions per file"}; //can be added to run over limited collisions per file - for tesing purposes
     // preselection
     Configurable<double> ptTolerance{"ptTolerance", 0.1, "pT tolerance in GeV/c for applying preselections before vertex reconstruction"};
@@ -1202,8 +1173,6 @@ struct HfTrackIndexSkimCreator {
   } config;
 
   SliceCache cache;
-  o2::vertexing::DCAFitterN<2> df2; // 2-prong vertex fitter
-  o2::vertexing::DCAFitterN<3> df3; // 3-prong vertex fitter
   // Needed for PV refitting
   Service<o2::ccdb::BasicCCDBManager> ccdb;
   o2::base::MatLayerCylSet* lut;
@@ -1233,16 +1202,109 @@ struct HfTrackIndexSkimCreator {
   std::array<LabeledArray<double>, kN3ProngDecays> cut3Prong;
   std::array<std::vector<double>, kN3ProngDecays> pTBins3Prong;
 
+  // pre-screening of the 3-prong combinations before the track access and the preselections
+  enum PrescreenSpecies { PrescreenPion = 0,
+                          PrescreenKaon,
+                          PrescreenProton,
+                          NPrescreenSpecies };
+  static constexpr double kPrescreenTolerance = 1.e-4; // relative tolerance on the pT and mass limits, to absorb the different rounding
+  struct Prescreen3Prong {
+    double minPt{0.}, maxPt{0.};                 // pT range of the pT bins
+    bool hasMassCut{false};                      // whether the mass window is applied in all pT bins
+    double minMass2{0.}, maxMass2{0.};           // loosest mass window over the pT bins
+    std::array<std::array<int, 3>, 2> species{}; // PrescreenSpecies of the prongs in the two mass hypotheses
+    int channelProtonPid{-1};                    // channel of the proton PID required for the first and third prong, -1 if none
+  };
+  std::array<Prescreen3Prong, kN3ProngDecays> prescreen3Prong;
+  double minPtPrescreen3Prong{0.}; // lowest pT of the 3-prong pT bins of all the decays
+  // track candidates of one charge in the current collision, with the momenta at this collision
+  struct ProngCandidates {
+    std::vector<o2::track::TrackParCov> trackParVar;
+    std::vector<o2::gpu::gpustd::array<float, 2>> dcaInfo;
+    std::vector<std::array<float, 3>> pVec;
+    std::vector<float> suffixMaxPt; // highest pT of the candidates from this one to the last one
+    std::array<std::vector<double>, NPrescreenSpecies> energy;
+    std::vector<int8_t> isIdentifiedPid;
+  };
+  // state of one thread of the 2-prong and 3-prong combinatorics
+  struct SkimWorker {
+    o2::vertexing::DCAFitterN<2> df2;      // 2-prong vertex fitter
+    o2::vertexing::DCAFitterN<3> df3;      // 3-prong vertex fitter
+    o2::hf_pvrefit::PvRefitter pvRefitter; // PV refit, prepared once per collision
+    ProngCandidates positiveCandidates;
+    ProngCandidates negativeCandidates;
+    std::vector<uint8_t> isPrescreened3Prong; // outcome of the pre-screening of the third prong
+  };
+  std::vector<SkimWorker> workers;
+  std::unique_ptr<o2::common::core::WorkerPool> workerThreads; // threads of the workers, started once, only with more than one worker
+
+  // rows of a table produced for one collision, written to the table in the collision order
+  template <typename... Ts>
+  struct StagedRows {
+    std::vector<std::tuple<Ts...>> rows;
+    void operator()(Ts... values) { rows.emplace_back(values...); }
+    int64_t lastIndex() const { return static_cast<int64_t>(rows.size()) - 1; }
+  };
+  // histogram fill of one collision, done in the collision order
+  struct StagedFill {
+    void (*fill)(HistogramRegistry&, std::array<double, 2> const&);
+    std::array<double, 2> values;
+  };
+  template <typename THistName, int NValues>
+  static void fillStaged(HistogramRegistry& histos, std::array<double, 2> const& values)
+  {
+    if constexpr (NValues == 1) {
+      histos.fill(THistName{}, values[0]);
+    } else {
+      histos.fill(THistName{}, values[0], values[1]);
+    }
+  }
+  // output of one collision; the D0 index of the D* rows counts the 2-prong rows of this collision only
+  struct CollisionOutput {
+    StagedRows<int64_t, int64_t, int64_t, int> rowTrackIndexProng2;
+    StagedRows<int, int, int> rowProng2CutStatus;
+    StagedRows<float, float, float, float, float, float, float, float, float> rowProng2PVrefit;
+    StagedRows<int64_t, int64_t, int64_t, int64_t, int> rowTrackIndexProng3;
+    StagedRows<int, int, int, int> rowProng3CutStatus;
+    StagedRows<float, float, float, float, float, float, float, float, float> rowProng3PVrefit;
+    StagedRows<int64_t, int64_t, int> rowTrackIndexDstar;
+    StagedRows<uint8_t> rowDstarCutStatus;
+    StagedRows<float, float, float, float, float, float, float, float, float> rowDstarPVrefit;
+    StagedRows<std::vector<float>> rowTrackIndexMlScoreProng2;
+    StagedRows<std::vector<float>, std::vector<float>, std::vector<float>, std::vector<float>> rowTrackIndexMlScoreProng3;
+    std::vector<StagedFill> histogramFills;
+
+    template <typename THistName, typename... Ts>
+    void fill(THistName const&, Ts... values)
+    {
+      histogramFills.push_back({&fillStaged<THistName, sizeof...(Ts)>, {static_cast<double>(values)...}});
+    }
+  };
+
   // ML response
   o2::analysis::MlResponse<float> hfMlResponse2Prongs;                             // only D0
   std::array<o2::analysis::MlResponse<float>, kN3ProngDecays> hfMlResponse3Prongs; // D+, Lc, Ds, Xic
   std::array<bool, kN3ProngDecays> hasMlModel3Prong{false};
+  std::mutex mutexMl; // the models are shared by the threads
   o2::ccdb::CcdbApi ccdbApi;
 
   using SelectedCollisions = soa::Filtered<soa::Join<aod::Collisions, aod::HfSelCollision>>;
   using TracksWithPVRefitAndDCA = soa::Join<aod::TracksWCovDcaExtra, aod::HfPvRefitTrack>;
   using FilteredTrackAssocSel = soa::Filtered<soa::Join<aod::TrackAssoc, aod::HfSelTrack>>;
 
+  // collisions shared among the threads, with their track indices sliced beforehand
+  template <typename TTrackIndices>
+  struct CollisionBatch {
+    std::vector<SelectedCollisions::iterator> collisions;
+    std::vector<TTrackIndices> trackIndicesPos;
+    std::vector<TTrackIndices> trackIndicesNeg;
+    std::vector<TTrackIndices> softPionIndicesPos;
+    std::vector<TTrackIndices> softPionIndicesNeg;
+    std::vector<std::vector<int64_t>> pvContributorGlobIds;                     // global ID of PV contributors
+    std::vector<std::vector<o2::track::TrackParCov>> pvContributorTrackParCovs; // TrackParCov of PV contributors
+    std::vector<CollisionOutput> outputs;
+  };
+
   // filter collisions
   Filter filterSelectCollisions = (aod::hf_sel_collision::whyRejectColl == static_cast<uint16_t>(0));
 
@@ -1308,21 +1370,67 @@ struct HfTrackIndexSkimCreator {
     cut3Prong = {config.cutsDplusToPiKPi, config.cutsLcToPKPi, config.cutsDsToKKPi, config.cutsXicToPKPi};
     pTBins3Prong = {config.binsPtDplusToPiKPi, config.binsPtLcToPKPi, config.binsPtDsToKKPi, config.binsPtXicToPKPi};
 
-    df2.setPropagateToPCA(config.propagateToPCA);
-    df2.setMaxR(config.maxR);
-    df2.setMaxDZIni(config.maxDZIni);
-    df2.setMinParamChange(config.minParamChange);
-    df2.setMinRelChi2Change(config.minRelChi2Change);
-    df2.setUseAbsDCA(config.useAbsDCA);
-    df2.setWeightedFinalPCA(config.useWeightedFinalPCA);
+    // loosest 3-prong preselections over the pT bins, used to pre-screen the combinations
+    auto getPrescreenSpecies = [&](double mass) {
+      return mass == massPi ? PrescreenPion : (mass == massK ? PrescreenKaon : (mass == massProton ? PrescreenProton : -1));
+    };
+    minPtPrescreen3Prong = std::numeric_limits<double>::max();
+    for (int iDecay3P = 0; iDecay3P < kN3ProngDecays; iDecay3P++) {
+      auto& prescreen = prescreen3Prong[iDecay3P];
+      prescreen.minPt = pTBins3Prong[iDecay3P].front();
+      prescreen.maxPt = pTBins3Prong[iDecay3P].back();
+      minPtPrescreen3Prong = std::min(minPtPrescreen3Prong, prescreen.minPt);
+      prescreen.hasMassCut = true;
+      prescreen.minMass2 = std::numeric_limits<double>::max();
+      prescreen.maxMass2 = 0.;
+      for (auto iBin{0u}; iBin + 1 < pTBins3Prong[iDecay3P].size(); iBin++) {
+        double minMass = cut3Prong[iDecay3P].get(iBin, 0u);
+        double maxMass = cut3Prong[iDecay3P].get(iBin, 1u);
+        if (!(minMass >= 0. && maxMass > 0.)) {
+          prescreen.hasMassCut = false;
+          break;
+        }
+        prescreen.minMass2 = std::min(prescreen.minMass2, minMass * minMass);
+        prescreen.maxMass2 = std::max(prescreen.maxMass2, maxMass * maxMass);
+      }
+      for (int iHypo = 0; iHypo < 2; iHypo++) {
+        for (int iProng = 0; iProng < 3; iProng++) {
+          prescreen.species[iHypo][iProng] = getPrescreenSpecies(arrMass3Prong[iDecay3P][iHypo][iProng]);
+          if (prescreen.species[iHypo][iProng] < 0) {
+            prescreen.hasMassCut = false;
+          }
+        }
+      }
+      if (iDecay3P == hf_cand_3prong::DecayType::LcToPKPi && config.applyProtonPidForLcToPKPi) {
+        prescreen.channelProtonPid = ChannelsProtonPid::LcToPKPi;
+      } else if (iDecay3P == hf_cand_3prong::DecayType::XicToPKPi && config.applyProtonPidForXicToPKPi) {
+        prescreen.channelProtonPid = ChannelsProtonPid::XicToPKPi;
+      }
+    }
 
-    df3.setPropagateToPCA(config.propagateToPCA);
-    df3.setMaxR(config.maxR);
-    df3.setMaxDZIni(config.maxDZIni);
-    df3.setMinParamChange(config.minParamChange);
-    df3.setMinRelChi2Change(config.minRelChi2Change);
-    df3.setUseAbsDCA(config.useAbsDCA);
-    df3.setWeightedFinalPCA(config.useWeightedFinalPCA);
+    workers.resize(std::max(config.nThreads.value, 1));
+    if (workers.size() > 1) {
+      workerThreads = std::make_unique<o2::common::core::WorkerPool>(workers.size());
+    }
+    for (auto& worker : workers) {
+      auto& df2 = worker.df2;
+      df2.setPropagateToPCA(config.propagateToPCA);
+      df2.setMaxR(config.maxR);
+      df2.setMaxDZIni(config.maxDZIni);
+      df2.setMinParamChange(config.minParamChange);
+      df2.setMinRelChi2Change(config.minRelChi2Change);
+      df2.setUseAbsDCA(config.useAbsDCA);
+      df2.setWeightedFinalPCA(config.useWeightedFinalPCA);
+
+      auto& df3 = worker.df3;
+      df3.setPropagateToPCA(config.propagateToPCA);
+      df3.setMaxR(config.maxR);
+      df3.setMaxDZIni(config.maxDZIni);
+      df3.setMinParamChange(config.minParamChange);
+      df3.setMinRelChi2Change(config.minRelChi2Change);
+      df3.setUseAbsDCA(config.useAbsDCA);
+      df3.setWeightedFinalPCA(config.useWeightedFinalPCA);
+    }
 
     ccdb->setURL(config.ccdbUrl);
     ccdb->setCaching(true);
@@ -1442,6 +1550,101 @@ struct HfTrackIndexSkimCreator {
     }
   }
 
+  /// Method to collect the track candidates of one charge of a collision, propagated to it if needed, for the 2-prong and 3-prong loops
+  /// \param candidates are the collected track candidates
+  /// \param trackIndices are the track indices of the candidates associated to the collision
+  /// \param collision is the collision
+  template <typename TTracks, typename TTrackIndices, typename TCollision>
+  void fillProngCandidates(ProngCandidates& candidates, TTrackIndices const& trackIndices, TCollision const& collision)
+  {
+    candidates.trackParVar.clear();
+    candidates.dcaInfo.clear();
+    candidates.pVec.clear();
+    candidates.isIdentifiedPid.clear();
+    for (const auto& trackIndex : trackIndices) {
+      auto track = trackIndex.template track_as<TTracks>();
+      auto trackParVar = getTrackParCov(track);
+      std::array<float, 3> pVec{track.pVector()};
+      o2::gpu::gpustd::array<float, 2> dcaInfo{track.dcaXY(), track.dcaZ()};
+      if (collision.globalIndex() != track.collisionId()) { // this is not the "default" collision for this track, we have to re-propagate it
+        o2::base::Propagator::Instance()->propagateToDCABxByBz({collision.posX(), collision.posY(), collision.posZ()}, trackParVar, 2.f, noMatCorr, &dcaInfo);
+        getPxPyPz(trackParVar, pVec);
+      }
+      candidates.trackParVar.push_back(trackParVar);
+      candidates.dcaInfo.push_back(dcaInfo);
+      candidates.pVec.push_back(pVec);
+      candidates.isIdentifiedPid.push_back(trackIndex.isIdentifiedPid());
+    }
+
+    const int nCandidates = candidates.pVec.size();
+    const std::array<double, NPrescreenSpecies> massesSpecies{massPi, massK, massProton};
+    for (int iSpecies = 0; iSpecies < NPrescreenSpecies; iSpecies++) {
+      candidates.energy[iSpecies].resize(nCandidates);
+      for (int iCandidate = 0; iCandidate < nCandidates; iCandidate++) {
+        candidates.energy[iSpecies][iCandidate] = RecoDecay::e(candidates.pVec[iCandidate], massesSpecies[iSpecies]);
+      }
+    }
+    candidates.suffixMaxPt.resize(nCandidates + 1);
+    candidates.suffixMaxPt[nCandidates] = 0.f;
+    for (int iCandidate = nCandidates - 1; iCandidate >= 0; iCandidate--) {
+      candidates.suffixMaxPt[iCandidate] = std::max(candidates.suffixMaxPt[iCandidate + 1], static_cast<float>(RecoDecay::pt(candidates.pVec[iCandidate])));
+    }
+  }
+
+  /// Method to pre-screen the 3-prong candidates made of two given tracks and each of the following candidates with the charge of the first track,
+  /// before the access to the third track and the preselections. Only the pT range, the loosest invariant-mass window over the pT bins and the proton PID
+  /// of each decay are checked, with a tolerance, so that no candidate accepted by applyPreselection3Prong is rejected.
+  /// The masses use the prong energies computed once per collision, and no candidate is checked if the pT of the
+  /// first two prongs plus the highest pT of the remaining candidates is below the pT bins of all the decays.
+  /// \param candidates02 are the candidates of the first and third prong
+  /// \param index0 is the index of the first prong in candidates02
+  /// \param candidates1 are the candidates of the second prong
+  /// \param index1 is the index of the second prong in candidates1
+  /// \param firstIndex2 is the index in candidates02 of the first candidate considered for the third prong
+  /// \param isPrescreened3Prong is filled with the outcome of the pre-screening, for each candidate in candidates02
+  void prescreen3Prongs(ProngCandidates const& candidates02, int index0, ProngCandidates const& candidates1, int index1, int firstIndex2, std::vector<uint8_t>& isPrescreened3Prong)
+  {
+    const int nCandidates = candidates02.pVec.size();
+    isPrescreened3Prong.assign(nCandidates, 0);
+    const auto& pVec0 = candidates02.pVec[index0];
+    const auto& pVec1 = candidates1.pVec[index1];
+    // momentum sums in the same order as in RecoDecay::m2
+    const std::array<double, 3> pVec01{static_cast<double>(pVec0[0]) + pVec1[0], static_cast<double>(pVec0[1]) + pVec1[1], static_cast<double>(pVec0[2]) + pVec1[2]};
+    const double pt01 = RecoDecay::pt(pVec01);
+    if (firstIndex2 >= nCandidates || (pt01 + candidates02.suffixMaxPt[firstIndex2] + config.ptTolerance) * (1. + kPrescreenTolerance) < minPtPrescreen3Prong) {
+      return;
+    }
+    for (int index2 = firstIndex2; index2 < nCandidates; index2++) {
+      const auto& pVec2 = candidates02.pVec[index2];
+      const double px = pVec01[0] + pVec2[0];
+      const double py = pVec01[1] + pVec2[1];
+      const double pz = pVec01[2] + pVec2[2];
+      const double pT = std::sqrt(px * px + py * py) + config.ptTolerance;
+      const double p2 = RecoDecay::p2(std::array{px, py, pz});
+      bool isPrescreened = false;
+      for (int iDecay3P = 0; iDecay3P < kN3ProngDecays && !isPrescreened; iDecay3P++) {
+        const auto& prescreen = prescreen3Prong[iDecay3P];
+        if (pT < prescreen.minPt * (1. - kPrescreenTolerance) || pT >= prescreen.maxPt * (1. + kPrescreenTolerance)) {
+          continue;
+        }
+        for (int iHypo = 0; iHypo < 2 && !isPrescreened; iHypo++) {
+          if (prescreen.channelProtonPid >= 0 && !TESTBIT(candidates02.isIdentifiedPid[iHypo == 0 ? index0 : index2], prescreen.channelProtonPid)) {
+            continue;
+          }
+          if (!prescreen.hasMassCut) {
+            isPrescreened = true;
+            break;
+          }
+          const auto& species = prescreen.species[iHypo];
+          const double energy = candidates02.energy[species[0]][index0] + candidates1.energy[species[1]][index1] + candidates02.energy[species[2]][index2];
+          const double mass2 = energy * energy - p2;
+          isPrescreened = mass2 >= prescreen.minMass2 - kPrescreenTolerance * prescreen.maxMass2 && mass2 < prescreen.maxMass2 * (1. + kPrescreenTolerance);
+        }
+      }
+      isPrescreened3Prong[index2] = isPrescreened;
+    }
+  }
+
   /// Method to perform selections for 2-prong candidates before vertex reconstruction
   /// \param pVecTrack0 is the momentum array of the first daughter track
   /// \param pVecTrack1 is the momentum array of the second daughter track
@@ -1679,17 +1882,22 @@ struct HfTrackIndexSkimCreator {
   /// \param featuresCand is the vector with the candidate features
   /// \param outputScores is the vector with the output scores to be filled
   /// \param isSelected ia s bitmap with selection outcome
-  void applyMlSelectionForHfFilters2Prong(std::vector<float> featuresCand, std::vector<float>& outputScores, int& isSelected)
+  /// \param output is the output of the collision, where the histograms are filled
+  void applyMlSelectionForHfFilters2Prong(std::vector<float> featuresCand, std::vector<float>& outputScores, int& isSelected, CollisionOutput& output)
   {
     if (!TESTBIT(isSelected, hf_cand_2prong::DecayType::D0ToPiK)) {
       return;
     }
     const float ptDummy = 1.; // dummy pT value (only one pT bin)
-    bool isSelMl = hfMlResponse2Prongs.isSelectedMl(featuresCand, ptDummy, outputScores);
+    bool isSelMl{false};
+    {
+      std::lock_guard<std::mutex> lock(mutexMl);
+      isSelMl = hfMlResponse2Prongs.isSelectedMl(featuresCand, ptDummy, outputScores);
+    }
     if (config.fillHistograms) {
-      registry.fill(HIST("ML/hMlScoreBkgD0"), outputScores[0]);
-      registry.fill(HIST("ML/hMlScorePromptD0"), outputScores[1]);
-      registry.fill(HIST("ML/hMlScoreNonpromptD0"), outputScores[2]);
+      output.fill(HIST("ML/hMlScoreBkgD0"), outputScores[0]);
+      output.fill(HIST("ML/hMlScorePromptD0"), outputScores[1]);
+      output.fill(HIST("ML/hMlScoreNonpromptD0"), outputScores[2]);
     }
     if (!isSelMl) {
       CLRBIT(isSelected, hf_cand_2prong::DecayType::D0ToPiK);
@@ -1768,7 +1976,8 @@ struct HfTrackIndexSkimCreator {
   /// \param featuresCand is the vector with the candidate features
   /// \param outputScores is the array of vectors with the output scores to be filled
   /// \param isSelected ia s bitmap with selection outcome
-  void applyMlSelectionForHfFilters3Prong(std::vector<float> featuresCand, std::array<std::vector<float>, kN3ProngDecays>& outputScores, int& isSelected)
+  /// \param output is the output of the collision, where the histograms are filled
+  void applyMlSelectionForHfFilters3Prong(std::vector<float> featuresCand, std::array<std::vector<float>, kN3ProngDecays>& outputScores, int& isSelected, CollisionOutput& output)
   {
     if (isSelected == 0) {
       return;
@@ -1777,31 +1986,35 @@ struct HfTrackIndexSkimCreator {
     const float ptDummy = 1.; // dummy pT value (only one pT bin)
     for (int iDecay3P{0}; iDecay3P < kN3ProngDecays; ++iDecay3P) {
       if (TESTBIT(isSelected, iDecay3P) && hasMlModel3Prong[iDecay3P]) {
-        bool isMlSel = hfMlResponse3Prongs[iDecay3P].isSelectedMl(featuresCand, ptDummy, outputScores[iDecay3P]);
+        bool isMlSel{false};
+        {
+          std::lock_guard<std::mutex> lock(mutexMl);
+          isMlSel = hfMlResponse3Prongs[iDecay3P].isSelectedMl(featuresCand, ptDummy, outputScores[iDecay3P]);
+        }
         if (config.fillHistograms) {
           switch (iDecay3P) {
             case hf_cand_3prong::DecayType::DplusToPiKPi: {
-              registry.fill(HIST("ML/hMlScoreBkgDplus"), outputScores[iDecay3P][0]);
-              registry.fill(HIST("ML/hMlScorePromptDplus"), outputScores[iDecay3P][1]);
-              registry.fill(HIST("ML/hMlScoreNonpromptDplus"), outputScores[iDecay3P][2]);
+              output.fill(HIST("ML/hMlScoreBkgDplus"), outputScores[iDecay3P][0]);
+              output.fill(HIST("ML/hMlScorePromptDplus"), outputScores[iDecay3P][1]);
+              output.fill(HIST("ML/hMlScoreNonpromptDplus"), outputScores[iDecay3P][2]);
               break;
             }
             case hf_cand_3prong::DecayType::LcToPKPi: {
-              registry.fill(HIST("ML/hMlScoreBkgLc"), outputScores[iDecay3P][0]);
-              registry.fill(HIST("ML/hMlScorePromptLc"), outputScores[iDecay3P][1]);
-              registry.fill(HIST("ML/hMlScoreNonpromptLc"), outputScores[iDecay3P][2]);
+              output.fill(HIST("ML/hMlScoreBkgLc"), outputScores[iDecay3P][0]);
+              output.fill(HIST("ML/hMlScorePromptLc"), outputScores[iDecay3P][1]);
+              output.fill(HIST("ML/hMlScoreNonpromptLc"), outputScores[iDecay3P][2]);
               break;
             }
             case hf_cand_3prong::DecayType::DsToKKPi: {
-              registry.fill(HIST("ML/hMlScoreBkgDs"), outputScores[iDecay3P][0]);
-              registry.fill(HIST("ML/hMlScorePromptDs"), outputScores[iDecay3P][1]);
-              registry.fill(HIST("ML/hMlScoreNonpromptDs"), outputScores[iDecay3P][2]);
+              output.fill(HIST("ML/hMlScoreBkgDs"), outputScores[iDecay3P][0]);
+              output.fill(HIST("ML/hMlScorePromptDs"), outputScores[iDecay3P][1]);
+              output.fill(HIST("ML/hMlScoreNonpromptDs"), outputScores[iDecay3P][2]);
               break;
             }
             case hf_cand_3prong::DecayType::XicToPKPi: {
-              registry.fill(HIST("ML/hMlScoreBkgXic"), outputScores[iDecay3P][0]);
-              registry.fill(HIST("ML/hMlScorePromptXic"), outputScores[iDecay3P][1]);
-              registry.fill(HIST("ML/hMlScoreNonpromptXic"), outputScores[iDecay3P][2]);
+              output.fill(HIST("ML/hMlScoreBkgXic"), outputScores[iDecay3P][0]);
+              output.fill(HIST("ML/hMlScorePromptXic"), outputScores[iDecay3P][1]);
+              output.fill(HIST("ML/hMlScoreNonpromptXic"), outputScores[iDecay3P][2]);
               break;
             }
           }
@@ -1867,73 +2080,42 @@ struct HfTrackIndexSkimCreator {
   }
 
   /// Method for the PV refit excluding the candidate daughters
-  /// \param collision is a collision
-  /// \param bcWithTimeStamps is a table of bunch crossing joined with timestamps used to query the CCDB for B and material budget
-  /// \param vecPvContributorGlobId is a vector containing the global ID of PV contributors for the current collision
-  /// \param vecPvContributorTrackParCov is a vector containing the TrackParCov of PV contributors for the current collision
+  /// \param collision is a collision, whose vertex refit was prepared in pvRefitter
   /// \param vecCandPvContributorGlobId is a vector containing the global indices of daughter tracks that contributed to the original PV refit
   /// \param pvCoord is a vector where to store X, Y and Z values of refitted PV
   /// \param pvCovMatrix is a vector where to store the covariance matrix values of refitted PV
+  /// \param pvRefitter is the PV refit prepared for the collision
+  /// \param output is the output of the collision, where the histograms are filled
   void performPvRefitCandProngs(SelectedCollisions::iterator const& collision,
-                                aod::BCsWithTimestamps const&,
-                                std::vector<int64_t> vecPvContributorGlobId,
-                                std::vector<o2::track::TrackParCov> vecPvContributorTrackParCov,
-                                std::vector<int64_t> vecCandPvContributorGlobId,
+                                std::vector<int64_t> const& vecCandPvContributorGlobId,
                                 std::array<float, 3>& pvCoord,
-                                std::array<float, 6>& pvCovMatrix)
+                                std::array<float, 6>& pvCovMatrix,
+                                o2::hf_pvrefit::PvRefitter& pvRefitter,
+                                CollisionOutput& output)
   {
-    std::vector<bool> vecPvRefitContributorUsed(vecPvContributorGlobId.size(), true);
-
-    /// Prepare the vertex refitting
-    // set the magnetic field from CCDB
-    auto bc = collision.bc_as<o2::aod::BCsWithTimestamps>();
-    initCCDB(bc, runNumber, ccdb, config.isRun2 ? config.ccdbPathGrp : config.ccdbPathGrpMag, lut, config.isRun2);
-
-    // build the VertexBase to initialize the vertexer
-    o2::dataformats::VertexBase primVtx;
-    primVtx.setX(collision.posX());
-    primVtx.setY(collision.posY());
-    primVtx.setZ(collision.posZ());
-    primVtx.setCov(collision.covXX(), collision.covXY(), collision.covYY(), collision.covXZ(), collision.covYZ(), collision.covZZ());
-    // configure PVertexer
-    o2::vertexing::PVertexer vertexer;
-    o2::conf::ConfigurableParam::updateFromString("pvertexer.useMeanVertexConstraint=false"); /// remove diamond constraint (let's keep it at the moment...)
-    vertexer.init();
-    bool pvRefitDoable = vertexer.prepareVertexRefit(vecPvContributorTrackParCov, primVtx);
+    const auto& primVtx = pvRefitter.getPrimaryVertex();
+    bool pvRefitDoable = pvRefitter.isDoable();
     if (!pvRefitDoable) {
-      LOG(info) << "Not enough tracks accepted for the refit";
       if (doprocess2And3ProngsWithPvRefit && config.fillHistograms) {
-        registry.fill(HIST("PvRefit/hNContribPvRefitNotDoable"), collision.numContrib());
+        output.fill(HIST("PvRefit/hNContribPvRefitNotDoable"), collision.numContrib());
       }
     }
-    if (config.debugPvRefit) {
-      LOG(info) << "prepareVertexRefit = " << pvRefitDoable << " Ncontrib= " << vecPvContributorTrackParCov.size() << " Ntracks= " << collision.numContrib() << " Vtx= " << primVtx.asString();
-    }
 
     /// PV refitting, if the tracks contributed to this at the beginning
     o2::dataformats::VertexBase primVtxBaseRecalc;
     bool recalcPvRefit = false;
     if (doprocess2And3ProngsWithPvRefit && pvRefitDoable) {
       if (config.fillHistograms) {
-        registry.fill(HIST("PvRefit/verticesPerCandidate"), 2);
+        output.fill(HIST("PvRefit/verticesPerCandidate"), 2);
       }
       recalcPvRefit = true;
-      int nCandContr = 0;
-      for (uint64_t myGlobalID : vecCandPvContributorGlobId) {
-        auto trackIterator = std::find(vecPvContributorGlobId.begin(), vecPvContributorGlobId.end(), myGlobalID); /// track global index
-        if (trackIterator != vecPvContributorGlobId.end()) {
-          /// this is a contributor, let's remove it for the PV refit
-          const int entry = std::distance(vecPvContributorGlobId.begin(), trackIterator);
-          vecPvRefitContributorUsed[entry] = false; /// remove the track from the PV refitting
-          nCandContr++;
-        }
-      }
 
       /// do the PV refit excluding the candidate daughters that originally contributed to fit it
+      int nCandContr = 0;
+      auto primVtxRefitted = pvRefitter.refitWithout(vecCandPvContributorGlobId, nCandContr); // vertex refit
       if (config.debugPvRefit) {
         LOG(info) << "### PV refit after removing " << nCandContr << " tracks";
       }
-      auto primVtxRefitted = vertexer.refitVertex(vecPvRefitContributorUsed, primVtx); // vertex refit
       // LOG(info) << "refit " << cnt << "/" << ntr << " result = " << primVtxRefitted.asString();
       // LOG(info) << "refit for track with global index " << static_cast<int>(myTrack.globalIndex()) << " " << primVtxRefitted.asString();
       if (primVtxRefitted.getChi2() < 0) {
@@ -1941,22 +2123,18 @@ struct HfTrackIndexSkimCreator {
           LOG(info) << "---> Refitted vertex has bad chi2 = " << primVtxRefitted.getChi2();
         }
         if (config.fillHistograms) {
-          registry.fill(HIST("PvRefit/verticesPerCandidate"), 4);
-          registry.fill(HIST("PvRefit/hPvRefitXChi2Minus1"), primVtxRefitted.getX(), collision.posX());
-          registry.fill(HIST("PvRefit/hPvRefitYChi2Minus1"), primVtxRefitted.getY(), collision.posY());
-          registry.fill(HIST("PvRefit/hPvRefitZChi2Minus1"), primVtxRefitted.getZ(), collision.posZ());
-          registry.fill(HIST("PvRefit/hNContribPvRefitChi2Minus1"), collision.numContrib());
+          output.fill(HIST("PvRefit/verticesPerCandidate"), 4);
+          output.fill(HIST("PvRefit/hPvRefitXChi2Minus1"), primVtxRefitted.getX(), collision.posX());
+          output.fill(HIST("PvRefit/hPvRefitYChi2Minus1"), primVtxRefitted.getY(), collision.posY());
+          output.fill(HIST("PvRefit/hPvRefitZChi2Minus1"), primVtxRefitted.getZ(), collision.posZ());
+          output.fill(HIST("PvRefit/hNContribPvRefitChi2Minus1"), collision.numContrib());
         }
         recalcPvRefit = false;
       } else if (config.fillHistograms) {
-        registry.fill(HIST("PvRefit/verticesPerCandidate"), 3);
+        output.fill(HIST("PvRefit/verticesPerCandidate"), 3);
       }
       if (config.fillHistograms) {
-        registry.fill(HIST("PvRefit/hChi2vsNContrib"), primVtxRefitted.getNContributors(), primVtxRefitted.getChi2());
-      }
-
-      for (size_t i = 0; i < vecPvContributorGlobId.size(); i++) {
-        vecPvRefitContributorUsed[i] = true; /// restore the tracks for the next PV refitting (probably not necessary here)
+        output.fill(HIST("PvRefit/hChi2vsNContrib"), primVtxRefitted.getNContributors(), primVtxRefitted.getChi2());
       }
 
       if (recalcPvRefit) {
@@ -1965,9 +2143,9 @@ struct HfTrackIndexSkimCreator {
         const double deltaY = primVtx.getY() - primVtxRefitted.getY();
         const double deltaZ = primVtx.getZ() - primVtxRefitted.getZ();
         if (config.fillHistograms) {
-          registry.fill(HIST("PvRefit/hPvDeltaXvsNContrib"), primVtxRefitted.getNContributors(), deltaX);
-          registry.fill(HIST("PvRefit/hPvDeltaYvsNContrib"), primVtxRefitted.getNContributors(), deltaY);
-          registry.fill(HIST("PvRefit/hPvDeltaZvsNContrib"), primVtxRefitted.getNContributors(), deltaZ);
+          output.fill(HIST("PvRefit/hPvDeltaXvsNContrib"), primVtxRefitted.getNContributors(), deltaX);
+          output.fill(HIST("PvRefit/hPvDeltaYvsNContrib"), primVtxRefitted.getNContributors(), deltaY);
+          output.fill(HIST("PvRefit/hPvDeltaZvsNContrib"), primVtxRefitted.getNContributors(), deltaZ);
         }
 
         // fill the newly calculated PV
@@ -2020,13 +2198,46 @@ struct HfTrackIndexSkimCreator {
     }
     */
 
+    using TrackIndicesSlice = decltype(positiveFor2And3Prongs->sliceByCached(aod::track::collisionId, int64_t{0}, cache));
+    CollisionBatch<TrackIndicesSlice> batch;
+    const int nCollisionsPerBatch = std::max(config.nCollisionsPerBatch.value, 1);
+    batch.pvContributorGlobIds.resize(nCollisionsPerBatch);
+    batch.pvContributorTrackParCovs.resize(nCollisionsPerBatch);
+    batch.outputs.resize(nCollisionsPerBatch);
+
     for (const auto& collision : collisions) {
 
+      // set the magnetic field from CCDB, the collisions of a batch all belong to the same run
+      auto bc = collision.bc_as<o2::aod::BCsWithTimestamps>();
+      if (bc.runNumber() != runNumber) {
+        run2And3ProngsBatch<doPvRefit, TTracks>(batch);
+        initCCDB(bc, runNumber, ccdb, config.isRun2 ? config.ccdbPathGrp : config.ccdbPathGrpMag, lut, config.isRun2);
+        const auto bz = o2::base::Propagator::Instance()->getNominalBz();
+        for (auto& worker : workers) {
+          worker.df2.setBz(bz);
+          worker.df3.setBz(bz);
+          if constexpr (doPvRefit) {
+            worker.pvRefitter.setBz(bz); // initialises the vertexer again if the field changed
+          }
+        }
+      }
+
+      // slices of the track indices, done here since the slice cache is not shared among the threads
+      const int iCollision = batch.collisions.size();
+      batch.collisions.push_back(collision);
+      batch.trackIndicesPos.push_back(positiveFor2And3Prongs->sliceByCached(aod::track::collisionId, collision.globalIndex(), cache));
+      batch.trackIndicesNeg.push_back(negativeFor2And3Prongs->sliceByCached(aod::track::collisionId, collision.globalIndex(), cache));
+      if (config.doDstar) {
+        batch.softPionIndicesPos.push_back(positiveSoftPions->sliceByCached(aod::track::collisionId, collision.globalIndex(), cache));
+        batch.softPionIndicesNeg.push_back(negativeSoftPions->sliceByCached(aod::track::collisionId, collision.globalIndex(), cache));
+      }
+
       /// retrieve PV contributors for the current collision
-      std::vector<int64_t> vecPvContributorGlobId{};
-      std::vector<o2::track::TrackParCov> vecPvContributorTrackParCov{};
-      std::vector<bool> vecPvRefitContributorUsed{};
       if constexpr (doPvRefit) {
+        auto& vecPvContributorGlobId = batch.pvContributorGlobIds[iCollision];
+        auto& vecPvContributorTrackParCov = batch.pvContributorTrackParCovs[iCollision];
+        vecPvContributorGlobId.clear();
+        vecPvContributorTrackParCov.clear();
         auto groupedTracksUnfiltered = tracks.sliceBy(tracksPerCollision, collision.globalIndex());
         const int nTrk = groupedTracksUnfiltered.size();
         int nContrib = 0;
@@ -2052,873 +2263,970 @@ struct HfTrackIndexSkimCreator {
             LOG(info) << "!!! Some problem here !!! vecPvContributorTrackParCov.size()= " << vecPvContributorTrackParCov.size() << ", nContrib=" << nContrib << ", collision.numContrib()" << collision.numContrib();
           }
         }
-        vecPvRefitContributorUsed = std::vector<bool>(vecPvContributorGlobId.size(), true);
       }
 
-      // auto centrality = collision.centV0M(); //FIXME add centrality when option for variations to the process function appears
-
-      int n2ProngBit = BIT(kN2ProngDecays) - 1; // bit value for 2-prong candidates where each candidate is one bit and they are all set to 1
-      int n3ProngBit = BIT(kN3ProngDecays) - 1; // bit value for 3-prong candidates where each candidate is one bit and they are all set to 1
-
-      std::array<std::vector<bool>, kN2ProngDecays> cutStatus2Prong;
-      std::array<std::vector<bool>, kN3ProngDecays> cutStatus3Prong;
-      bool nCutStatus2ProngBit[kN2ProngDecays]; // bit value for selection status for each 2-prong candidate where each selection is one bit and they are all set to 1
-      bool nCutStatus3ProngBit[kN3ProngDecays]; // bit value for selection status for each 3-prong candidate where each selection is one bit and they are all set to 1
-
-      for (int iDecay2P = 0; iDecay2P < kN2ProngDecays; iDecay2P++) {
-        nCutStatus2ProngBit[iDecay2P] = BIT(kNCuts2Prong[iDecay2P]) - 1;
-        cutStatus2Prong[iDecay2P] = std::vector<bool>(kNCuts2Prong[iDecay2P], true);
-      }
-      for (int iDecay3P = 0; iDecay3P < kN3ProngDecays; iDecay3P++) {
-        nCutStatus3ProngBit[iDecay3P] = BIT(kNCuts3Prong[iDecay3P]) - 1;
-        cutStatus3Prong[iDecay3P] = std::vector<bool>(kNCuts3Prong[iDecay3P], true);
+      if (iCollision + 1 == nCollisionsPerBatch) {
+        run2And3ProngsBatch<doPvRefit, TTracks>(batch);
       }
+    }
+    run2And3ProngsBatch<doPvRefit, TTracks>(batch);
+  } /// end of run2And3Prongs function
 
-      int whichHypo2Prong[kN2ProngDecays + 1]; // we also put D0 for D* in the last slot
-      int whichHypo3Prong[kN3ProngDecays];
-
-      // set the magnetic field from CCDB
-      auto bc = collision.bc_as<o2::aod::BCsWithTimestamps>();
-      initCCDB(bc, runNumber, ccdb, config.isRun2 ? config.ccdbPathGrp : config.ccdbPathGrpMag, lut, config.isRun2);
-      df2.setBz(o2::base::Propagator::Instance()->getNominalBz());
-      df3.setBz(o2::base::Propagator::Instance()->getNominalBz());
-
-      // used to calculate number of candidiates per event
-      auto nCand2 = rowTrackIndexProng2.lastIndex();
-      auto nCand3 = rowTrackIndexProng3.lastIndex();
+  /// Processes the collisions of a batch, shared among the threads, and writes their candidates in the collision order
+  /// \param batch is the batch of collisions, emptied at the end
+  template <bool doPvRefit, typename TTracks, typename TBatch>
+  void run2And3ProngsBatch(TBatch& batch)
+  {
+    const int nCollisions = batch.collisions.size();
+    if (nCollisions == 0) {
+      return;
+    }
 
-      // if there isn't at least a positive and a negative track, continue immediately
-      // if (tracksPos.size() < 1 || tracksNeg.size() < 1) {
-      //  return;
-      //}
+    // the collisions are taken one by one by the threads, since their number of combinations varies a lot
+    std::atomic<int> nextCollision{0};
+    auto processCollisions = [&](int iThread) {
+      for (int iCollision = nextCollision++; iCollision < nCollisions; iCollision = nextCollision++) {
+        run2And3ProngsCollision<doPvRefit, TTracks>(batch, iCollision, workers[iThread]);
+      }
+    };
+    if (!workerThreads || nCollisions == 1) {
+      processCollisions(0);
+    } else {
+      workerThreads->run(processCollisions); // the threads are started once in init and only woken up here
+    }
 
-      auto thisCollId = collision.globalIndex();
+    for (int iCollision = 0; iCollision < nCollisions; iCollision++) {
+      writeCollisionOutput(batch.outputs[iCollision]);
+    }
+    batch.collisions.clear();
+    batch.trackIndicesPos.clear();
+    batch.trackIndicesNeg.clear();
+    batch.softPionIndicesPos.clear();
+    batch.softPionIndicesNeg.clear();
+  }
 
-      // first loop over positive tracks
-      auto groupedTrackIndicesPos1 = positiveFor2And3Prongs->sliceByCached(aod::track::collisionId, collision.globalIndex(), cache);
-      int lastFilledD0 = -1; // index to be filled in table for D* mesons
-      for (auto trackIndexPos1 = groupedTrackIndicesPos1.begin(); trackIndexPos1 != groupedTrackIndicesPos1.end(); ++trackIndexPos1) {
-        auto trackPos1 = trackIndexPos1.template track_as<TTracks>();
+  /// Writes the rows and fills the histograms staged for a collision
+  /// \param output is the output of the collision, emptied at the end
+  void writeCollisionOutput(CollisionOutput& output)
+  {
+    // the D0 of the D* candidates are indexed in the whole 2-prong table
+    const auto firstIndexD0 = rowTrackIndexProng2.lastIndex() + 1;
+    for (auto& row : output.rowTrackIndexDstar.rows) {
+      if (std::get<2>(row) >= 0) {
+        std::get<2>(row) += firstIndexD0;
+      }
+    }
+
+    auto writeRows = [](auto& cursor, auto& stagedRows) {
+      for (const auto& row : stagedRows.rows) {
+        std::apply(cursor, row);
+      }
+      stagedRows.rows.clear();
+    };
+    writeRows(rowTrackIndexProng2, output.rowTrackIndexProng2);
+    writeRows(rowProng2CutStatus, output.rowProng2CutStatus);
+    writeRows(rowProng2PVrefit, output.rowProng2PVrefit);
+    writeRows(rowTrackIndexProng3, output.rowTrackIndexProng3);
+    writeRows(rowProng3CutStatus, output.rowProng3CutStatus);
+    writeRows(rowProng3PVrefit, output.rowProng3PVrefit);
+    writeRows(rowTrackIndexDstar, output.rowTrackIndexDstar);
+    writeRows(rowDstarCutStatus, output.rowDstarCutStatus);
+    writeRows(rowDstarPVrefit, output.rowDstarPVrefit);
+    writeRows(rowTrackIndexMlScoreProng2, output.rowTrackIndexMlScoreProng2);
+    writeRows(rowTrackIndexMlScoreProng3, output.rowTrackIndexMlScoreProng3);
+
+    for (const auto& stagedFill : output.histogramFills) {
+      stagedFill.fill(registry, stagedFill.values);
+    }
+    output.histogramFills.clear();
+  }
 
-        // retrieve the selection flag that corresponds to this collision
-        auto isSelProngPos1 = trackIndexPos1.isSelProng();
-        bool sel2ProngStatusPos = TESTBIT(isSelProngPos1, CandidateType::Cand2Prong);
-        bool sel3ProngStatusPos1 = TESTBIT(isSelProngPos1, CandidateType::Cand3Prong);
+  /// Builds the 2-prong, 3-prong and D* candidates of a collision, with the fitters of a thread, and stages its output
+  /// \param batch is the batch of collisions
+  /// \param iCollision is the index of the collision in the batch
+  /// \param worker is the state of the thread
+  template <bool doPvRefit, typename TTracks, typename TBatch>
+  void run2And3ProngsCollision(TBatch& batch, int iCollision, SkimWorker& worker)
+  {
+    const auto& collision = batch.collisions[iCollision];
+    auto& output = batch.outputs[iCollision];
 
-        auto trackParVarPos1 = getTrackParCov(trackPos1);
-        std::array<float, 3> pVecTrackPos1{trackPos1.pVector()};
-        o2::gpu::gpustd::array<float, 2> dcaInfoPos1{trackPos1.dcaXY(), trackPos1.dcaZ()};
-        if (thisCollId != trackPos1.collisionId()) { // this is not the "default" collision for this track, we have to re-propagate it
-          o2::base::Propagator::Instance()->propagateToDCABxByBz({collision.posX(), collision.posY(), collision.posZ()}, trackParVarPos1, 2.f, noMatCorr, &dcaInfoPos1);
-          getPxPyPz(trackParVarPos1, pVecTrackPos1);
-        }
+    // auto centrality = collision.centV0M(); //FIXME add centrality when option for variations to the process function appears
 
-        // first loop over negative tracks
-        auto groupedTrackIndicesNeg1 = negativeFor2And3Prongs->sliceByCached(aod::track::collisionId, collision.globalIndex(), cache);
-        for (auto trackIndexNeg1 = groupedTrackIndicesNeg1.begin(); trackIndexNeg1 != groupedTrackIndicesNeg1.end(); ++trackIndexNeg1) {
-          auto trackNeg1 = trackIndexNeg1.template track_as<TTracks>();
+    int n2ProngBit = BIT(kN2ProngDecays) - 1; // bit value for 2-prong candidates where each candidate is one bit and they are all set to 1
+    int n3ProngBit = BIT(kN3ProngDecays) - 1; // bit value for 3-prong candidates where each candidate is one bit and they are all set to 1
 
-          // retrieve the selection flag that corresponds to this collision
-          auto isSelProngNeg1 = trackIndexNeg1.isSelProng();
-          bool sel2ProngStatusNeg = TESTBIT(isSelProngNeg1, CandidateType::Cand2Prong);
-          bool sel3ProngStatusNeg1 = TESTBIT(isSelProngNeg1, CandidateType::Cand3Prong);
+    std::array<std::vector<bool>, kN2ProngDecays> cutStatus2Prong;
+    std::array<std::vector<bool>, kN3ProngDecays> cutStatus3Prong;
+    bool nCutStatus2ProngBit[kN2ProngDecays]; // bit value for selection status for each 2-prong candidate where each selection is one bit and they are all set to 1
+    bool nCutStatus3ProngBit[kN3ProngDecays]; // bit value for selection status for each 3-prong candidate where each selection is one bit and they are all set to 1
 
-          auto trackParVarNeg1 = getTrackParCov(trackNeg1);
-          std::array<float, 3> pVecTrackNeg1{trackNeg1.pVector()};
-          o2::gpu::gpustd::array<float, 2> dcaInfoNeg1{trackNeg1.dcaXY(), trackNeg1.dcaZ()};
-          if (thisCollId != trackNeg1.collisionId()) { // this is not the "default" collision for this track, we have to re-propagate it
-            o2::base::Propagator::Instance()->propagateToDCABxByBz({collision.posX(), collision.posY(), collision.posZ()}, trackParVarNeg1, 2.f, noMatCorr, &dcaInfoNeg1);
-            getPxPyPz(trackParVarNeg1, pVecTrackNeg1);
-          }
+    for (int iDecay2P = 0; iDecay2P < kN2ProngDecays; iDecay2P++) {
+      nCutStatus2ProngBit[iDecay2P] = BIT(kNCuts2Prong[iDecay2P]) - 1;
+      cutStatus2Prong[iDecay2P] = std::vector<bool>(kNCuts2Prong[iDecay2P], true);
+    }
+    for (int iDecay3P = 0; iDecay3P < kN3ProngDecays; iDecay3P++) {
+      nCutStatus3ProngBit[iDecay3P] = BIT(kNCuts3Prong[iDecay3P]) - 1;
+      cutStatus3Prong[iDecay3P] = std::vector<bool>(kNCuts3Prong[iDecay3P], true);
+    }
 
-          int isSelected2ProngCand = n2ProngBit; // bitmap for checking status of two-prong candidates (1 is true, 0 is rejected)
+    int whichHypo2Prong[kN2ProngDecays + 1]; // we also put D0 for D* in the last slot
+    int whichHypo3Prong[kN3ProngDecays];
 
-          if (config.debug) {
-            for (int iDecay2P = 0; iDecay2P < kN2ProngDecays; iDecay2P++) {
-              for (int iCut = 0; iCut < kNCuts2Prong[iDecay2P]; iCut++) {
-                cutStatus2Prong[iDecay2P][iCut] = true;
-              }
-            }
-          }
-
-          // initialise PV refit coordinates and cov matrix for 2-prongs already here for D*
-          std::array<float, 3> pvRefitCoord2Prong = {collision.posX(), collision.posY(), collision.posZ()}; /// initialize to the original PV
-          std::array<float, 6> pvRefitCovMatrix2Prong = getPrimaryVertex(collision).getCov();               /// initialize to the original PV
+    /// prepare the PV refit once per collision, the candidate daughters are then removed in performPvRefitCandProngs
+    if constexpr (doPvRefit) {
+      const auto& vecPvContributorGlobId = batch.pvContributorGlobIds[iCollision];
+      const auto& vecPvContributorTrackParCov = batch.pvContributorTrackParCovs[iCollision];
+      bool pvRefitDoable = worker.pvRefitter.prepare(collision, vecPvContributorGlobId, vecPvContributorTrackParCov);
+      if (!pvRefitDoable) {
+        LOG(info) << "Not enough tracks accepted for the refit";
+      }
+      if (config.debugPvRefit) {
+        LOG(info) << "prepareVertexRefit = " << pvRefitDoable << " Ncontrib= " << vecPvContributorTrackParCov.size() << " Ntracks= " << collision.numContrib() << " Vtx= " << worker.pvRefitter.getPrimaryVertex().asString();
+      }
+    }
 
-          // 2-prong vertex reconstruction
-          float pt2Prong{-1.};
-          bool is2ProngCandidateGoodFor3Prong{sel3ProngStatusPos1 && sel3ProngStatusNeg1};
-          int nVtxFrom2ProngFitter = 0;
-          if (sel2ProngStatusPos && sel2ProngStatusNeg) {
+    // used to calculate number of candidiates per event
+    auto nCand2 = output.rowTrackIndexProng2.lastIndex();
+    auto nCand3 = output.rowTrackIndexProng3.lastIndex();
 
-            // 2-prong preselections
-            // TODO: in case of PV refit, the single-track DCA is calculated wrt two different PV vertices (only 1 track excluded)
-            applyPreselection2Prong(pVecTrackPos1, pVecTrackNeg1, dcaInfoPos1[0], dcaInfoNeg1[0], cutStatus2Prong, whichHypo2Prong, isSelected2ProngCand, pt2Prong);
+    // if there isn't at least a positive and a negative track, continue immediately
+    // if (tracksPos.size() < 1 || tracksNeg.size() < 1) {
+    //  return;
+    //}
 
-            if (isSelected2ProngCand > 0) {
-              // secondary vertex reconstruction and further 2-prong selections
-              try {
-                nVtxFrom2ProngFitter = df2.process(trackParVarPos1, trackParVarNeg1);
-              } catch (...) {
-              }
+    auto thisCollId = collision.globalIndex();
 
-              if (nVtxFrom2ProngFitter > 0) { // should it be this or > 0 or are they equivalent
-                // get secondary vertex
-                const auto& secondaryVertex2 = df2.getPCACandidate();
-                // get track momenta
-                std::array<float, 3> pvec0;
-                std::array<float, 3> pvec1;
-                df2.getTrack(0).getPxPyPzGlo(pvec0);
-                df2.getTrack(1).getPxPyPzGlo(pvec1);
+    // track candidates of this collision, propagated to it once for all the combinations
+    auto& groupedTrackIndicesPos1 = batch.trackIndicesPos[iCollision];
+    auto& groupedTrackIndicesNeg1 = batch.trackIndicesNeg[iCollision];
+    fillProngCandidates<TTracks>(worker.positiveCandidates, groupedTrackIndicesPos1, collision);
+    fillProngCandidates<TTracks>(worker.negativeCandidates, groupedTrackIndicesNeg1, collision);
+
+    // first loop over positive tracks
+    int lastFilledD0 = -1; // index to be filled in table for D* mesons
+    int iPos1 = -1;
+    for (auto trackIndexPos1 = groupedTrackIndicesPos1.begin(); trackIndexPos1 != groupedTrackIndicesPos1.end(); ++trackIndexPos1) {
+      iPos1++;
+      auto trackPos1 = trackIndexPos1.template track_as<TTracks>();
+
+      // retrieve the selection flag that corresponds to this collision
+      auto isSelProngPos1 = trackIndexPos1.isSelProng();
+      bool sel2ProngStatusPos = TESTBIT(isSelProngPos1, CandidateType::Cand2Prong);
+      bool sel3ProngStatusPos1 = TESTBIT(isSelProngPos1, CandidateType::Cand3Prong);
+
+      const auto& trackParVarPos1 = worker.positiveCandidates.trackParVar[iPos1];
+      const auto& pVecTrackPos1 = worker.positiveCandidates.pVec[iPos1];
+      const auto& dcaInfoPos1 = worker.positiveCandidates.dcaInfo[iPos1];
+
+      // first loop over negative tracks
+      int iNeg1 = -1;
+      for (auto trackIndexNeg1 = groupedTrackIndicesNeg1.begin(); trackIndexNeg1 != groupedTrackIndicesNeg1.end(); ++trackIndexNeg1) {
+        iNeg1++;
+        auto trackNeg1 = trackIndexNeg1.template track_as<TTracks>();
 
-                /// PV refit excluding the candidate daughters, if contributors
-                if constexpr (doPvRefit) {
-                  if (config.fillHistograms) {
-                    registry.fill(HIST("PvRefit/verticesPerCandidate"), 1);
-                  }
-                  int nCandContr = 2;
-                  auto trackFirstIt = std::find(vecPvContributorGlobId.begin(), vecPvContributorGlobId.end(), trackPos1.globalIndex());
-                  auto trackSecondIt = std::find(vecPvContributorGlobId.begin(), vecPvContributorGlobId.end(), trackNeg1.globalIndex());
-                  bool isTrackFirstContr = true;
-                  bool isTrackSecondContr = true;
-                  if (trackFirstIt == vecPvContributorGlobId.end()) {
-                    /// This track did not contribute to the original PV refit
-                    if (config.debugPvRefit) {
-                      LOG(info) << "--- [2 Prong] trackPos1 with globalIndex " << trackPos1.globalIndex() << " was not a PV contributor";
-                    }
-                    nCandContr--;
-                    isTrackFirstContr = false;
-                  }
-                  if (trackSecondIt == vecPvContributorGlobId.end()) {
-                    /// This track did not contribute to the original PV refit
-                    if (config.debugPvRefit) {
-                      LOG(info) << "--- [2 Prong] trackNeg1 with globalIndex " << trackNeg1.globalIndex() << " was not a PV contributor";
-                    }
-                    nCandContr--;
-                    isTrackSecondContr = false;
-                  }
-                  if (nCandContr == 2) {
-                    /// Both the daughter tracks were used for the original PV refit, let's refit it after excluding them
-                    if (config.debugPvRefit) {
-                      LOG(info) << "### [2 Prong] Calling performPvRefitCandProngs for HF 2 prong candidate";
-                    }
-                    performPvRefitCandProngs(collision, bcWithTimeStamps, vecPvContributorGlobId, vecPvContributorTrackParCov, {trackPos1.globalIndex(), trackNeg1.globalIndex()}, pvRefitCoord2Prong, pvRefitCovMatrix2Prong);
-                  } else if (nCandContr == 1) {
-                    /// Only one daughter was a contributor, let's use then the PV recalculated by excluding only it
-                    if (config.debugPvRefit) {
-                      LOG(info) << "####### [2 Prong] nCandContr==" << nCandContr << " ---> just 1 contributor!";
-                    }
-                    if (config.fillHistograms) {
-                      registry.fill(HIST("PvRefit/verticesPerCandidate"), 5);
-                    }
-                    if (isTrackFirstContr && !isTrackSecondContr) {
-                      /// the first daughter is contributor, the second is not
-                      pvRefitCoord2Prong = {trackPos1.pvRefitX(), trackPos1.pvRefitY(), trackPos1.pvRefitZ()};
-                      pvRefitCovMatrix2Prong = {trackPos1.pvRefitSigmaX2(), trackPos1.pvRefitSigmaXY(), trackPos1.pvRefitSigmaY2(), trackPos1.pvRefitSigmaXZ(), trackPos1.pvRefitSigmaYZ(), trackPos1.pvRefitSigmaZ2()};
-                    } else if (!isTrackFirstContr && isTrackSecondContr) {
-                      ///  the second daughter is contributor, the first is not
-                      pvRefitCoord2Prong = {trackNeg1.pvRefitX(), trackNeg1.pvRefitY(), trackNeg1.pvRefitZ()};
-                      pvRefitCovMatrix2Prong = {trackNeg1.pvRefitSigmaX2(), trackNeg1.pvRefitSigmaXY(), trackNeg1.pvRefitSigmaY2(), trackNeg1.pvRefitSigmaXZ(), trackNeg1.pvRefitSigmaYZ(), trackNeg1.pvRefitSigmaZ2()};
-                    }
-                  } else {
-                    /// 0 contributors among the HF candidate daughters
-                    if (config.fillHistograms) {
-                      registry.fill(HIST("PvRefit/verticesPerCandidate"), 6);
-                    }
-                    if (config.debugPvRefit) {
-                      LOG(info) << "####### [2 Prong] nCandContr==" << nCandContr << " ---> some of the candidate daughters did not contribute to the original PV fit, PV refit not redone";
-                    }
-                  }
-                }
+        // retrieve the selection flag that corresponds to this collision
+        auto isSelProngNeg1 = trackIndexNeg1.isSelProng();
+        bool sel2ProngStatusNeg = TESTBIT(isSelProngNeg1, CandidateType::Cand2Prong);
+        bool sel3ProngStatusNeg1 = TESTBIT(isSelProngNeg1, CandidateType::Cand3Prong);
 
-                auto pVecCandProng2 = RecoDecay::pVec(pvec0, pvec1);
-                // 2-prong selections after secondary vertex
-                std::array<float, 3> pvCoord2Prong = {collision.posX(), collision.posY(), collision.posZ()};
-                if constexpr (doPvRefit) {
-                  pvCoord2Prong[0] = pvRefitCoord2Prong[0];
-                  pvCoord2Prong[1] = pvRefitCoord2Prong[1];
-                  pvCoord2Prong[2] = pvRefitCoord2Prong[2];
-                }
-                applySelections2Prong(pVecCandProng2, secondaryVertex2, pvCoord2Prong, cutStatus2Prong, isSelected2ProngCand);
-                if (is2ProngCandidateGoodFor3Prong && config.do3Prong == 1) {
-                  is2ProngCandidateGoodFor3Prong = isTwoTrackVertexSelectedFor3Prongs(secondaryVertex2, pvCoord2Prong, df2);
-                }
+        const auto& trackParVarNeg1 = worker.negativeCandidates.trackParVar[iNeg1];
+        const auto& pVecTrackNeg1 = worker.negativeCandidates.pVec[iNeg1];
+        const auto& dcaInfoNeg1 = worker.negativeCandidates.dcaInfo[iNeg1];
 
-                std::vector<float> mlScoresD0{};
-                if (config.applyMlForHfFilters) {
-                  auto trackParVarPcaPos1 = df2.getTrack(0);
-                  auto trackParVarPcaNeg1 = df2.getTrack(1);
-                  std::vector<float> inputFeatures{trackParVarPcaPos1.getPt(), dcaInfoPos1[0], dcaInfoPos1[1], trackParVarPcaNeg1.getPt(), dcaInfoNeg1[0], dcaInfoNeg1[1]};
-                  applyMlSelectionForHfFilters2Prong(inputFeatures, mlScoresD0, isSelected2ProngCand);
-                }
+        int isSelected2ProngCand = n2ProngBit; // bitmap for checking status of two-prong candidates (1 is true, 0 is rejected)
 
-                if (isSelected2ProngCand > 0) {
-                  // fill table row
-                  rowTrackIndexProng2(thisCollId, trackPos1.globalIndex(), trackNeg1.globalIndex(), isSelected2ProngCand);
-                  if (config.applyMlForHfFilters) {
-                    rowTrackIndexMlScoreProng2(mlScoresD0);
-                  }
-                  if (TESTBIT(isSelected2ProngCand, hf_cand_2prong::DecayType::D0ToPiK)) {
-                    lastFilledD0 = rowTrackIndexProng2.lastIndex();
-                  }
+        if (config.debug) {
+          for (int iDecay2P = 0; iDecay2P < kN2ProngDecays; iDecay2P++) {
+            for (int iCut = 0; iCut < kNCuts2Prong[iDecay2P]; iCut++) {
+              cutStatus2Prong[iDecay2P][iCut] = true;
+            }
+          }
+        }
 
-                  if constexpr (doPvRefit) {
-                    // fill table row with coordinates of PV refit
-                    rowProng2PVrefit(pvRefitCoord2Prong[0], pvRefitCoord2Prong[1], pvRefitCoord2Prong[2],
-                                     pvRefitCovMatrix2Prong[0], pvRefitCovMatrix2Prong[1], pvRefitCovMatrix2Prong[2], pvRefitCovMatrix2Prong[3], pvRefitCovMatrix2Prong[4], pvRefitCovMatrix2Prong[5]);
-                  }
+        // initialise PV refit coordinates and cov matrix for 2-prongs already here for D*
+        std::array<float, 3> pvRefitCoord2Prong = {collision.posX(), collision.posY(), collision.posZ()}; /// initialize to the original PV
+        std::array<float, 6> pvRefitCovMatrix2Prong = getPrimaryVertex(collision).getCov();               /// initialize to the original PV
 
-                  if (config.debug) {
-                    int Prong2CutStatus[kN2ProngDecays];
-                    for (int iDecay2P = 0; iDecay2P < kN2ProngDecays; iDecay2P++) {
-                      Prong2CutStatus[iDecay2P] = nCutStatus2ProngBit[iDecay2P];
-                      for (int iCut = 0; iCut < kNCuts2Prong[iDecay2P]; iCut++) {
-                        if (!cutStatus2Prong[iDecay2P][iCut]) {
-                          CLRBIT(Prong2CutStatus[iDecay2P], iCut);
-                        }
-                      }
-                    }
-                    rowProng2CutStatus(Prong2CutStatus[0], Prong2CutStatus[1], Prong2CutStatus[2]); // FIXME when we can do this by looping over kN2ProngDecays
-                  }
+        // 2-prong vertex reconstruction
+        float pt2Prong{-1.};
+        bool is2ProngCandidateGoodFor3Prong{sel3ProngStatusPos1 && sel3ProngStatusNeg1};
+        int nVtxFrom2ProngFitter = 0;
+        if (sel2ProngStatusPos && sel2ProngStatusNeg) {
 
-                  // fill histograms
-                  if (config.fillHistograms) {
-                    registry.fill(HIST("hVtx2ProngX"), secondaryVertex2[0]);
-                    registry.fill(HIST("hVtx2ProngY"), secondaryVertex2[1]);
-                    registry.fill(HIST("hVtx2ProngZ"), secondaryVertex2[2]);
-                    std::array<std::array<float, 3>, 2> arrMom = {pvec0, pvec1};
-                    for (int iDecay2P = 0; iDecay2P < kN2ProngDecays; iDecay2P++) {
-                      if (TESTBIT(isSelected2ProngCand, iDecay2P)) {
-                        if (TESTBIT(whichHypo2Prong[iDecay2P], 0)) {
-                          auto mass2Prong = RecoDecay::m(arrMom, arrMass2Prong[iDecay2P][0]);
-                          switch (iDecay2P) {
-                            case hf_cand_2prong::DecayType::D0ToPiK:
-                              registry.fill(HIST("hMassD0ToPiK"), mass2Prong);
-                              break;
-                            case hf_cand_2prong::DecayType::JpsiToEE:
-                              registry.fill(HIST("hMassJpsiToEE"), mass2Prong);
-                              break;
-                            case hf_cand_2prong::DecayType::JpsiToMuMu:
-                              registry.fill(HIST("hMassJpsiToMuMu"), mass2Prong);
-                              break;
-                          }
-                        }
-                        if (TESTBIT(whichHypo2Prong[iDecay2P], 1)) {
-                          auto mass2Prong = RecoDecay::m(arrMom, arrMass2Prong[iDecay2P][1]);
-                          if (iDecay2P == hf_cand_2prong::DecayType::D0ToPiK) {
-                            registry.fill(HIST("hMassD0ToPiK"), mass2Prong);
-                          }
-                        }
-                      }
-                    }
-                  }
-                }
-              } else {
-                isSelected2ProngCand = 0; // reset to 0 not to use the D0 to build a D* meson
-              }
-            } else {
-              isSelected2ProngCand = 0; // reset to 0 not to use the D0 to build a D* meson
-            }
-          }
+          // 2-prong preselections
+          // TODO: in case of PV refit, the single-track DCA is calculated wrt two different PV vertices (only 1 track excluded)
+          applyPreselection2Prong(pVecTrackPos1, pVecTrackNeg1, dcaInfoPos1[0], dcaInfoNeg1[0], cutStatus2Prong, whichHypo2Prong, isSelected2ProngCand, pt2Prong);
 
-          // if the cut on the decay length of 3-prongs computed with the first two tracks is enabled and the vertex was not computed for the D0, we compute it now
-          if (config.do3Prong == 1 && is2ProngCandidateGoodFor3Prong && (config.minTwoTrackDecayLengthFor3Prongs > 0.f || config.maxTwoTrackChi2PcaFor3Prongs < 1.e9f) && nVtxFrom2ProngFitter == 0) {
+          if (isSelected2ProngCand > 0) {
+            // secondary vertex reconstruction and further 2-prong selections
             try {
-              nVtxFrom2ProngFitter = df2.process(trackParVarPos1, trackParVarNeg1);
+              nVtxFrom2ProngFitter = worker.df2.process(trackParVarPos1, trackParVarNeg1);
             } catch (...) {
             }
-            if (nVtxFrom2ProngFitter > 0) {
-              const auto& secondaryVertex2 = df2.getPCACandidate();
-              std::array<float, 3> pvCoord2Prong = {collision.posX(), collision.posY(), collision.posZ()};
-              is2ProngCandidateGoodFor3Prong = isTwoTrackVertexSelectedFor3Prongs(secondaryVertex2, pvCoord2Prong, df2);
-            } else {
-              is2ProngCandidateGoodFor3Prong = false;
-            }
-          }
-
-          if (config.do3Prong == 1 && is2ProngCandidateGoodFor3Prong) { // if 3 prongs are enabled and the first 2 tracks are selected for the 3-prong channels
-            // second loop over positive tracks
-            for (auto trackIndexPos2 = trackIndexPos1 + 1; trackIndexPos2 != groupedTrackIndicesPos1.end(); ++trackIndexPos2) {
-
-              int isSelected3ProngCand = n3ProngBit;
-              if (!TESTBIT(trackIndexPos2.isSelProng(), CandidateType::Cand3Prong)) { // continue immediately
-                if (!config.debug) {
-                  continue;
-                } else {
-                  isSelected3ProngCand = 0;
-                }
-              }
-
-              if (config.applyKaonPidIn3Prongs && !TESTBIT(trackIndexNeg1.isIdentifiedPid(), channelKaonPid)) { // continue immediately if kaon PID enabled and opposite-sign track not a kaon
-                if (!config.debug) {
-                  continue;
-                } else {
-                  isSelected3ProngCand = 0;
-                }
-              }
-
-              auto trackPos2 = trackIndexPos2.template track_as<TTracks>();
-              auto trackParVarPos2 = getTrackParCov(trackPos2);
-              o2::gpu::gpustd::array<float, 2> dcaInfoPos2{trackPos2.dcaXY(), trackPos2.dcaZ()};
-
-              // preselection of 3-prong candidates
-              if (isSelected3ProngCand) {
-                std::array<float, 3> pVecTrackPos2{trackPos2.pVector()};
-                if (thisCollId != trackPos2.collisionId()) { // this is not the "default" collision for this track and we still did not re-propagate it, we have to re-propagate it
-                  o2::base::Propagator::Instance()->propagateToDCABxByBz({collision.posX(), collision.posY(), collision.posZ()}, trackParVarPos2, 2.f, noMatCorr, &dcaInfoPos2);
-                  getPxPyPz(trackParVarPos2, pVecTrackPos2);
-                }
 
-                if (config.debug) {
-                  for (int iDecay3P = 0; iDecay3P < kN3ProngDecays; iDecay3P++) {
-                    for (int iCut = 0; iCut < kNCuts3Prong[iDecay3P]; iCut++) {
-                      cutStatus3Prong[iDecay3P][iCut] = true;
-                    }
-                  }
-                }
-
-                // 3-prong preselections
-                int8_t isIdentifiedPidTrackPos1 = trackIndexPos1.isIdentifiedPid();
-                int8_t isIdentifiedPidTrackPos2 = trackIndexPos2.isIdentifiedPid();
-                applyPreselection3Prong(pVecTrackPos1, pVecTrackNeg1, pVecTrackPos2, isIdentifiedPidTrackPos1, isIdentifiedPidTrackPos2, cutStatus3Prong, whichHypo3Prong, isSelected3ProngCand);
-                if (!config.debug && isSelected3ProngCand == 0) {
-                  continue;
-                }
-              }
+            if (nVtxFrom2ProngFitter > 0) { // should it be this or > 0 or are they equivalent
+              // get secondary vertex
+              const auto& secondaryVertex2 = worker.df2.getPCACandidate();
+              // get track momenta
+              std::array<float, 3> pvec0;
+              std::array<float, 3> pvec1;
+              worker.df2.getTrack(0).getPxPyPzGlo(pvec0);
+              worker.df2.getTrack(1).getPxPyPzGlo(pvec1);
 
               /// PV refit excluding the candidate daughters, if contributors
-              std::array<float, 3> pvRefitCoord3Prong2Pos1Neg = {collision.posX(), collision.posY(), collision.posZ()}; /// initialize to the original PV
-              std::array<float, 6> pvRefitCovMatrix3Prong2Pos1Neg = getPrimaryVertex(collision).getCov();               /// initialize to the original PV
               if constexpr (doPvRefit) {
                 if (config.fillHistograms) {
-                  registry.fill(HIST("PvRefit/verticesPerCandidate"), 1);
+                  output.fill(HIST("PvRefit/verticesPerCandidate"), 1);
                 }
-                int nCandContr = 3;
-                auto trackFirstIt = std::find(vecPvContributorGlobId.begin(), vecPvContributorGlobId.end(), trackPos1.globalIndex());
-                auto trackSecondIt = std::find(vecPvContributorGlobId.begin(), vecPvContributorGlobId.end(), trackNeg1.globalIndex());
-                auto trackThirdIt = std::find(vecPvContributorGlobId.begin(), vecPvContributorGlobId.end(), trackPos2.globalIndex());
+                int nCandContr = 2;
                 bool isTrackFirstContr = true;
                 bool isTrackSecondContr = true;
-                bool isTrackThirdContr = true;
-                if (trackFirstIt == vecPvContributorGlobId.end()) {
+                if (!worker.pvRefitter.isContributor(trackPos1.globalIndex())) {
                   /// This track did not contribute to the original PV refit
                   if (config.debugPvRefit) {
-                    LOG(info) << "--- [3 prong] trackPos1 with globalIndex " << trackPos1.globalIndex() << " was not a PV contributor";
+                    LOG(info) << "--- [2 Prong] trackPos1 with globalIndex " << trackPos1.globalIndex() << " was not a PV contributor";
                   }
                   nCandContr--;
                   isTrackFirstContr = false;
                 }
-                if (trackSecondIt == vecPvContributorGlobId.end()) {
+                if (!worker.pvRefitter.isContributor(trackNeg1.globalIndex())) {
                   /// This track did not contribute to the original PV refit
                   if (config.debugPvRefit) {
-                    LOG(info) << "--- [3 prong] trackNeg1 with globalIndex " << trackNeg1.globalIndex() << " was not a PV contributor";
+                    LOG(info) << "--- [2 Prong] trackNeg1 with globalIndex " << trackNeg1.globalIndex() << " was not a PV contributor";
                   }
                   nCandContr--;
                   isTrackSecondContr = false;
                 }
-                if (trackThirdIt == vecPvContributorGlobId.end()) {
-                  /// This track did not contribute to the original PV refit
-                  if (config.debugPvRefit) {
-                    LOG(info) << "--- [3 prong] trackPos2 with globalIndex " << trackPos2.globalIndex() << " was not a PV contributor";
-                  }
-                  nCandContr--;
-                  isTrackThirdContr = false;
-                }
-
-                // Fill a vector with global ID of candidate daughters that are contributors
-                std::vector<int64_t> vecCandPvContributorGlobId = {};
-                if (isTrackFirstContr) {
-                  vecCandPvContributorGlobId.push_back(trackPos1.globalIndex());
-                }
-                if (isTrackSecondContr) {
-                  vecCandPvContributorGlobId.push_back(trackNeg1.globalIndex());
-                }
-                if (isTrackThirdContr) {
-                  vecCandPvContributorGlobId.push_back(trackPos2.globalIndex());
-                }
-
-                if (nCandContr == 3 || nCandContr == 2) {
-                  /// At least two of the daughter tracks were used for the original PV refit, let's refit it after excluding them
+                if (nCandContr == 2) {
+                  /// Both the daughter tracks were used for the original PV refit, let's refit it after excluding them
                   if (config.debugPvRefit) {
-                    LOG(info) << "### [3 prong] Calling performPvRefitCandProngs for HF 3 prong candidate, removing " << nCandContr << " daughters";
+                    LOG(info) << "### [2 Prong] Calling performPvRefitCandProngs for HF 2 prong candidate";
                   }
-                  performPvRefitCandProngs(collision, bcWithTimeStamps, vecPvContributorGlobId, vecPvContributorTrackParCov, vecCandPvContributorGlobId, pvRefitCoord3Prong2Pos1Neg, pvRefitCovMatrix3Prong2Pos1Neg);
+                  performPvRefitCandProngs(collision, {trackPos1.globalIndex(), trackNeg1.globalIndex()}, pvRefitCoord2Prong, pvRefitCovMatrix2Prong, worker.pvRefitter, output);
                 } else if (nCandContr == 1) {
                   /// Only one daughter was a contributor, let's use then the PV recalculated by excluding only it
                   if (config.debugPvRefit) {
-                    LOG(info) << "####### [3 Prong] nCandContr==" << nCandContr << " ---> just 1 contributor!";
+                    LOG(info) << "####### [2 Prong] nCandContr==" << nCandContr << " ---> just 1 contributor!";
                   }
                   if (config.fillHistograms) {
-                    registry.fill(HIST("PvRefit/verticesPerCandidate"), 5);
+                    output.fill(HIST("PvRefit/verticesPerCandidate"), 5);
                   }
-                  if (isTrackFirstContr && !isTrackSecondContr && !isTrackThirdContr) {
-                    /// the first daughter is contributor, the second and the third are not
-                    pvRefitCoord3Prong2Pos1Neg = {trackPos1.pvRefitX(), trackPos1.pvRefitY(), trackPos1.pvRefitZ()};
-                    pvRefitCovMatrix3Prong2Pos1Neg = {trackPos1.pvRefitSigmaX2(), trackPos1.pvRefitSigmaXY(), trackPos1.pvRefitSigmaY2(), trackPos1.pvRefitSigmaXZ(), trackPos1.pvRefitSigmaYZ(), trackPos1.pvRefitSigmaZ2()};
-                  } else if (!isTrackFirstContr && isTrackSecondContr && !isTrackThirdContr) {
-                    /// the second daughter is contributor, the first and the third are not
-                    pvRefitCoord3Prong2Pos1Neg = {trackNeg1.pvRefitX(), trackNeg1.pvRefitY(), trackNeg1.pvRefitZ()};
-                    pvRefitCovMatrix3Prong2Pos1Neg = {trackNeg1.pvRefitSigmaX2(), trackNeg1.pvRefitSigmaXY(), trackNeg1.pvRefitSigmaY2(), trackNeg1.pvRefitSigmaXZ(), trackNeg1.pvRefitSigmaYZ(), trackNeg1.pvRefitSigmaZ2()};
-                  } else if (!isTrackFirstContr && !isTrackSecondContr && isTrackThirdContr) {
-                    /// the third daughter is contributor, the first and the second are not
-                    pvRefitCoord3Prong2Pos1Neg = {trackPos2.pvRefitX(), trackPos2.pvRefitY(), trackPos2.pvRefitZ()};
-                    pvRefitCovMatrix3Prong2Pos1Neg = {trackPos2.pvRefitSigmaX2(), trackPos2.pvRefitSigmaXY(), trackPos2.pvRefitSigmaY2(), trackPos2.pvRefitSigmaXZ(), trackPos2.pvRefitSigmaYZ(), trackPos2.pvRefitSigmaZ2()};
+                  if (isTrackFirstContr && !isTrackSecondContr) {
+                    /// the first daughter is contributor, the second is not
+                    pvRefitCoord2Prong = {trackPos1.pvRefitX(), trackPos1.pvRefitY(), trackPos1.pvRefitZ()};
+                    pvRefitCovMatrix2Prong = {trackPos1.pvRefitSigmaX2(), trackPos1.pvRefitSigmaXY(), trackPos1.pvRefitSigmaY2(), trackPos1.pvRefitSigmaXZ(), trackPos1.pvRefitSigmaYZ(), trackPos1.pvRefitSigmaZ2()};
+                  } else if (!isTrackFirstContr && isTrackSecondContr) {
+                    ///  the second daughter is contributor, the first is not
+                    pvRefitCoord2Prong = {trackNeg1.pvRefitX(), trackNeg1.pvRefitY(), trackNeg1.pvRefitZ()};
+                    pvRefitCovMatrix2Prong = {trackNeg1.pvRefitSigmaX2(), trackNeg1.pvRefitSigmaXY(), trackNeg1.pvRefitSigmaY2(), trackNeg1.pvRefitSigmaXZ(), trackNeg1.pvRefitSigmaYZ(), trackNeg1.pvRefitSigmaZ2()};
                   }
                 } else {
                   /// 0 contributors among the HF candidate daughters
                   if (config.fillHistograms) {
-                    registry.fill(HIST("PvRefit/verticesPerCandidate"), 6);
+                    output.fill(HIST("PvRefit/verticesPerCandidate"), 6);
                   }
                   if (config.debugPvRefit) {
-                    LOG(info) << "####### [3 prong] nCandContr==" << nCandContr << " ---> some of the candidate daughters did not contribute to the original PV fit, PV refit not redone";
+                    LOG(info) << "####### [2 Prong] nCandContr==" << nCandContr << " ---> some of the candidate daughters did not contribute to the original PV fit, PV refit not redone";
                   }
                 }
               }
 
-              // reconstruct the 3-prong secondary vertex
-              int nVtxFrom3ProngFitter = 0;
-              try {
-                nVtxFrom3ProngFitter = df3.process(trackParVarPos1, trackParVarNeg1, trackParVarPos2);
-              } catch (...) {
-                continue;
+              auto pVecCandProng2 = RecoDecay::pVec(pvec0, pvec1);
+              // 2-prong selections after secondary vertex
+              std::array<float, 3> pvCoord2Prong = {collision.posX(), collision.posY(), collision.posZ()};
+              if constexpr (doPvRefit) {
+                pvCoord2Prong[0] = pvRefitCoord2Prong[0];
+                pvCoord2Prong[1] = pvRefitCoord2Prong[1];
+                pvCoord2Prong[2] = pvRefitCoord2Prong[2];
               }
-
-              if (nVtxFrom3ProngFitter == 0) {
-                continue;
+              applySelections2Prong(pVecCandProng2, secondaryVertex2, pvCoord2Prong, cutStatus2Prong, isSelected2ProngCand);
+              if (is2ProngCandidateGoodFor3Prong && config.do3Prong == 1) {
+                is2ProngCandidateGoodFor3Prong = isTwoTrackVertexSelectedFor3Prongs(secondaryVertex2, pvCoord2Prong, worker.df2);
               }
-              // get secondary vertex
-              const auto& secondaryVertex3 = df3.getPCACandidate();
-              // get track momenta
-              std::array<float, 3> pvec0;
-              std::array<float, 3> pvec1;
-              std::array<float, 3> pvec2;
-              auto trackParVarPcaPos1 = df3.getTrack(0);
-              auto trackParVarPcaNeg1 = df3.getTrack(1);
-              auto trackParVarPcaPos2 = df3.getTrack(2);
-              trackParVarPcaPos1.getPxPyPzGlo(pvec0);
-              trackParVarPcaNeg1.getPxPyPzGlo(pvec1);
-              trackParVarPcaPos2.getPxPyPzGlo(pvec2);
-              auto pVecCandProng3Pos = RecoDecay::pVec(pvec0, pvec1, pvec2);
-
-              // 3-prong selections after secondary vertex
-              applySelection3Prong(pVecCandProng3Pos, secondaryVertex3, pvRefitCoord3Prong2Pos1Neg, cutStatus3Prong, isSelected3ProngCand);
-
-              std::array<std::vector<float>, kN3ProngDecays> mlScores3Prongs;
+
+              std::vector<float> mlScoresD0{};
               if (config.applyMlForHfFilters) {
-                std::vector<float> inputFeatures{trackParVarPcaPos1.getPt(), dcaInfoPos1[0], dcaInfoPos1[1], trackParVarPcaNeg1.getPt(), dcaInfoNeg1[0], dcaInfoNeg1[1], trackParVarPcaPos2.getPt(), dcaInfoPos2[0], dcaInfoPos2[1]};
-                applyMlSelectionForHfFilters3Prong(inputFeatures, mlScores3Prongs, isSelected3ProngCand);
+                auto trackParVarPcaPos1 = worker.df2.getTrack(0);
+                auto trackParVarPcaNeg1 = worker.df2.getTrack(1);
+                std::vector<float> inputFeatures{trackParVarPcaPos1.getPt(), dcaInfoPos1[0], dcaInfoPos1[1], trackParVarPcaNeg1.getPt(), dcaInfoNeg1[0], dcaInfoNeg1[1]};
+                applyMlSelectionForHfFilters2Prong(inputFeatures, mlScoresD0, isSelected2ProngCand, output);
               }
 
-              if (!config.debug && isSelected3ProngCand == 0) {
-                continue;
-              }
+              if (isSelected2ProngCand > 0) {
+                // fill table row
+                output.rowTrackIndexProng2(thisCollId, trackPos1.globalIndex(), trackNeg1.globalIndex(), isSelected2ProngCand);
+                if (config.applyMlForHfFilters) {
+                  output.rowTrackIndexMlScoreProng2(mlScoresD0);
+                }
+                if (TESTBIT(isSelected2ProngCand, hf_cand_2prong::DecayType::D0ToPiK)) {
+                  lastFilledD0 = output.rowTrackIndexProng2.lastIndex();
+                }
 
-              // fill table row
-              rowTrackIndexProng3(thisCollId, trackPos1.globalIndex(), trackNeg1.globalIndex(), trackPos2.globalIndex(), isSelected3ProngCand);
-              if (config.applyMlForHfFilters) {
-                rowTrackIndexMlScoreProng3(mlScores3Prongs[0], mlScores3Prongs[1], mlScores3Prongs[2], mlScores3Prongs[3]);
-              }
-              if constexpr (doPvRefit) {
-                // fill table row of coordinates of PV refit
-                rowProng3PVrefit(pvRefitCoord3Prong2Pos1Neg[0], pvRefitCoord3Prong2Pos1Neg[1], pvRefitCoord3Prong2Pos1Neg[2],
-                                 pvRefitCovMatrix3Prong2Pos1Neg[0], pvRefitCovMatrix3Prong2Pos1Neg[1], pvRefitCovMatrix3Prong2Pos1Neg[2], pvRefitCovMatrix3Prong2Pos1Neg[3], pvRefitCovMatrix3Prong2Pos1Neg[4], pvRefitCovMatrix3Prong2Pos1Neg[5]);
-              }
+                if constexpr (doPvRefit) {
+                  // fill table row with coordinates of PV refit
+                  output.rowProng2PVrefit(pvRefitCoord2Prong[0], pvRefitCoord2Prong[1], pvRefitCoord2Prong[2],
+                                          pvRefitCovMatrix2Prong[0], pvRefitCovMatrix2Prong[1], pvRefitCovMatrix2Prong[2], pvRefitCovMatrix2Prong[3], pvRefitCovMatrix2Prong[4], pvRefitCovMatrix2Prong[5]);
+                }
 
-              if (config.debug) {
-                int Prong3CutStatus[kN3ProngDecays];
-                for (int iDecay3P = 0; iDecay3P < kN3ProngDecays; iDecay3P++) {
-                  Prong3CutStatus[iDecay3P] = nCutStatus3ProngBit[iDecay3P];
-                  for (int iCut = 0; iCut < kNCuts3Prong[iDecay3P]; iCut++) {
-                    if (!cutStatus3Prong[iDecay3P][iCut]) {
-                      CLRBIT(Prong3CutStatus[iDecay3P], iCut);
+                if (config.debug) {
+                  int Prong2CutStatus[kN2ProngDecays];
+                  for (int iDecay2P = 0; iDecay2P < kN2ProngDecays; iDecay2P++) {
+                    Prong2CutStatus[iDecay2P] = nCutStatus2ProngBit[iDecay2P];
+                    for (int iCut = 0; iCut < kNCuts2Prong[iDecay2P]; iCut++) {
+                      if (!cutStatus2Prong[iDecay2P][iCut]) {
+                        CLRBIT(Prong2CutStatus[iDecay2P], iCut);
+                      }
                     }
                   }
+                  output.rowProng2CutStatus(Prong2CutStatus[0], Prong2CutStatus[1], Prong2CutStatus[2]); // FIXME when we can do this by looping over kN2ProngDecays
                 }
-                rowProng3CutStatus(Prong3CutStatus[0], Prong3CutStatus[1], Prong3CutStatus[2], Prong3CutStatus[3]); // FIXME when we can do this by looping over kN3ProngDecays
-              }
 
-              // fill histograms
-              if (config.fillHistograms) {
-                registry.fill(HIST("hVtx3ProngX"), secondaryVertex3[0]);
-                registry.fill(HIST("hVtx3ProngY"), secondaryVertex3[1]);
-                registry.fill(HIST("hVtx3ProngZ"), secondaryVertex3[2]);
-                std::array<std::array<float, 3>, 3> arr3Mom = {pvec0, pvec1, pvec2};
-                for (int iDecay3P = 0; iDecay3P < kN3ProngDecays; iDecay3P++) {
-                  if (TESTBIT(isSelected3ProngCand, iDecay3P)) {
-                    if (TESTBIT(whichHypo3Prong[iDecay3P], 0)) {
-                      auto mass3Prong = RecoDecay::m(arr3Mom, arrMass3Prong[iDecay3P][0]);
-                      switch (iDecay3P) {
-                        case hf_cand_3prong::DecayType::DplusToPiKPi:
-                          registry.fill(HIST("hMassDPlusToPiKPi"), mass3Prong);
-                          break;
-                        case hf_cand_3prong::DecayType::DsToKKPi:
-                          registry.fill(HIST("hMassDsToKKPi"), mass3Prong);
-                          break;
-                        case hf_cand_3prong::DecayType::LcToPKPi:
-                          registry.fill(HIST("hMassLcToPKPi"), mass3Prong);
-                          break;
-                        case hf_cand_3prong::DecayType::XicToPKPi:
-                          registry.fill(HIST("hMassXicToPKPi"), mass3Prong);
-                          break;
+                // fill histograms
+                if (config.fillHistograms) {
+                  output.fill(HIST("hVtx2ProngX"), secondaryVertex2[0]);
+                  output.fill(HIST("hVtx2ProngY"), secondaryVertex2[1]);
+                  output.fill(HIST("hVtx2ProngZ"), secondaryVertex2[2]);
+                  std::array<std::array<float, 3>, 2> arrMom = {pvec0, pvec1};
+                  for (int iDecay2P = 0; iDecay2P < kN2ProngDecays; iDecay2P++) {
+                    if (TESTBIT(isSelected2ProngCand, iDecay2P)) {
+                      if (TESTBIT(whichHypo2Prong[iDecay2P], 0)) {
+                        auto mass2Prong = RecoDecay::m(arrMom, arrMass2Prong[iDecay2P][0]);
+                        switch (iDecay2P) {
+                          case hf_cand_2prong::DecayType::D0ToPiK:
+                            output.fill(HIST("hMassD0ToPiK"), mass2Prong);
+                            break;
+                          case hf_cand_2prong::DecayType::JpsiToEE:
+                            output.fill(HIST("hMassJpsiToEE"), mass2Prong);
+                            break;
+                          case hf_cand_2prong::DecayType::JpsiToMuMu:
+                            output.fill(HIST("hMassJpsiToMuMu"), mass2Prong);
+                            break;
+                        }
                       }
-                    }
-                    if (TESTBIT(whichHypo3Prong[iDecay3P], 1)) {
-                      auto mass3Prong = RecoDecay::m(arr3Mom, arrMass3Prong[iDecay3P][1]);
-                      switch (iDecay3P) {
-                        case hf_cand_3prong::DecayType::DsToKKPi:
-                          registry.fill(HIST("hMassDsToKKPi"), mass3Prong);
-                          break;
-                        case hf_cand_3prong::DecayType::LcToPKPi:
-                          registry.fill(HIST("hMassLcToPKPi"), mass3Prong);
-                          break;
-                        case hf_cand_3prong::DecayType::XicToPKPi:
-                          registry.fill(HIST("hMassXicToPKPi"), mass3Prong);
-                          break;
+                      if (TESTBIT(whichHypo2Prong[iDecay2P], 1)) {
+                        auto mass2Prong = RecoDecay::m(arrMom, arrMass2Prong[iDecay2P][1]);
+                        if (iDecay2P == hf_cand_2prong::DecayType::D0ToPiK) {
+                          output.fill(HIST("hMassD0ToPiK"), mass2Prong);
+                        }
                       }
                     }
                   }
                 }
               }
+            } else {
+              isSelected2ProngCand = 0; // reset to 0 not to use the D0 to build a D* meson
             }
+          } else {
+            isSelected2ProngCand = 0; // reset to 0 not to use the D0 to build a D* meson
+          }
+        }
 
-            // second loop over negative tracks
-            for (auto trackIndexNeg2 = trackIndexNeg1 + 1; trackIndexNeg2 != groupedTrackIndicesNeg1.end(); ++trackIndexNeg2) {
+        // if the cut on the decay length of 3-prongs computed with the first two tracks is enabled and the vertex was not computed for the D0, we compute it now
+        if (config.do3Prong == 1 && is2ProngCandidateGoodFor3Prong && (config.minTwoTrackDecayLengthFor3Prongs > 0.f || config.maxTwoTrackChi2PcaFor3Prongs < 1.e9f) && nVtxFrom2ProngFitter == 0) {
+          try {
+            nVtxFrom2ProngFitter = worker.df2.process(trackParVarPos1, trackParVarNeg1);
+          } catch (...) {
+          }
+          if (nVtxFrom2ProngFitter > 0) {
+            const auto& secondaryVertex2 = worker.df2.getPCACandidate();
+            std::array<float, 3> pvCoord2Prong = {collision.posX(), collision.posY(), collision.posZ()};
+            is2ProngCandidateGoodFor3Prong = isTwoTrackVertexSelectedFor3Prongs(secondaryVertex2, pvCoord2Prong, worker.df2);
+          } else {
+            is2ProngCandidateGoodFor3Prong = false;
+          }
+        }
 
-              int isSelected3ProngCand = n3ProngBit;
-              if (!TESTBIT(trackIndexNeg2.isSelProng(), CandidateType::Cand3Prong)) { // continue immediately
-                if (!config.debug) {
-                  continue;
-                } else {
-                  isSelected3ProngCand = 0;
-                }
+        if (config.do3Prong == 1 && is2ProngCandidateGoodFor3Prong) { // if 3 prongs are enabled and the first 2 tracks are selected for the 3-prong channels
+          // pre-screening of the third prongs, the other candidates are kept only in debug mode
+          if (!config.debug) {
+            prescreen3Prongs(worker.positiveCandidates, iPos1, worker.negativeCandidates, iNeg1, iPos1 + 1, worker.isPrescreened3Prong);
+          }
+
+          // second loop over positive tracks
+          int iPos2 = iPos1;
+          for (auto trackIndexPos2 = trackIndexPos1 + 1; trackIndexPos2 != groupedTrackIndicesPos1.end(); ++trackIndexPos2) {
+            iPos2++;
+            if (!config.debug && !worker.isPrescreened3Prong[iPos2]) {
+              continue;
+            }
+
+            int isSelected3ProngCand = n3ProngBit;
+            if (!TESTBIT(trackIndexPos2.isSelProng(), CandidateType::Cand3Prong)) { // continue immediately
+              if (!config.debug) {
+                continue;
+              } else {
+                isSelected3ProngCand = 0;
               }
+            }
 
-              if (config.applyKaonPidIn3Prongs && !TESTBIT(trackIndexPos1.isIdentifiedPid(), channelKaonPid)) { // continue immediately if kaon PID enabled and opposite-sign track not a kaon
-                if (!config.debug) {
-                  continue;
-                } else {
-                  isSelected3ProngCand = 0;
-                }
+            if (config.applyKaonPidIn3Prongs && !TESTBIT(trackIndexNeg1.isIdentifiedPid(), channelKaonPid)) { // continue immediately if kaon PID enabled and opposite-sign track not a kaon
+              if (!config.debug) {
+                continue;
+              } else {
+                isSelected3ProngCand = 0;
               }
+            }
 
-              auto trackNeg2 = trackIndexNeg2.template track_as<TTracks>();
-              auto trackParVarNeg2 = getTrackParCov(trackNeg2);
-              o2::gpu::gpustd::array<float, 2> dcaInfoNeg2{trackNeg2.dcaXY(), trackNeg2.dcaZ()};
-
-              // preselection of 3-prong candidates
-              if (isSelected3ProngCand) {
-                std::array<float, 3> pVecTrackNeg2{trackNeg2.pVector()};
-                if (thisCollId != trackNeg2.collisionId()) { // this is not the "default" collision for this track and we still did not re-propagate it, we have to re-propagate it
-                  o2::base::Propagator::Instance()->propagateToDCABxByBz({collision.posX(), collision.posY(), collision.posZ()}, trackParVarNeg2, 2.f, noMatCorr, &dcaInfoNeg2);
-                  getPxPyPz(trackParVarNeg2, pVecTrackNeg2);
-                }
+            auto trackPos2 = trackIndexPos2.template track_as<TTracks>();
+            // the track is re-propagated to this collision only for candidates to be preselected
+            auto trackParVarPos2 = isSelected3ProngCand ? worker.positiveCandidates.trackParVar[iPos2] : getTrackParCov(trackPos2);
+            auto dcaInfoPos2 = isSelected3ProngCand ? worker.positiveCandidates.dcaInfo[iPos2] : o2::gpu::gpustd::array<float, 2>{trackPos2.dcaXY(), trackPos2.dcaZ()};
 
-                if (config.debug) {
-                  for (int iDecay3P = 0; iDecay3P < kN3ProngDecays; iDecay3P++) {
-                    for (int iCut = 0; iCut < kNCuts3Prong[iDecay3P]; iCut++) {
-                      cutStatus3Prong[iDecay3P][iCut] = true;
-                    }
+            // preselection of 3-prong candidates
+            if (isSelected3ProngCand) {
+              const auto& pVecTrackPos2 = worker.positiveCandidates.pVec[iPos2];
+
+              if (config.debug) {
+                for (int iDecay3P = 0; iDecay3P < kN3ProngDecays; iDecay3P++) {
+                  for (int iCut = 0; iCut < kNCuts3Prong[iDecay3P]; iCut++) {
+                    cutStatus3Prong[iDecay3P][iCut] = true;
                   }
                 }
+              }
 
-                // 3-prong preselections
-                int8_t isIdentifiedPidTrackNeg1 = trackIndexNeg1.isIdentifiedPid();
-                int8_t isIdentifiedPidTrackNeg2 = trackIndexNeg2.isIdentifiedPid();
-                applyPreselection3Prong(pVecTrackNeg1, pVecTrackPos1, pVecTrackNeg2, isIdentifiedPidTrackNeg1, isIdentifiedPidTrackNeg2, cutStatus3Prong, whichHypo3Prong, isSelected3ProngCand);
-                if (!config.debug && isSelected3ProngCand == 0) {
-                  continue;
-                }
+              // 3-prong preselections
+              int8_t isIdentifiedPidTrackPos1 = trackIndexPos1.isIdentifiedPid();
+              int8_t isIdentifiedPidTrackPos2 = trackIndexPos2.isIdentifiedPid();
+              applyPreselection3Prong(pVecTrackPos1, pVecTrackNeg1, pVecTrackPos2, isIdentifiedPidTrackPos1, isIdentifiedPidTrackPos2, cutStatus3Prong, whichHypo3Prong, isSelected3ProngCand);
+              if (!config.debug && isSelected3ProngCand == 0) {
+                continue;
               }
+            }
 
-              /// PV refit excluding the candidate daughters, if contributors
-              std::array<float, 3> pvRefitCoord3Prong1Pos2Neg = {collision.posX(), collision.posY(), collision.posZ()}; /// initialize to the original PV
-              std::array<float, 6> pvRefitCovMatrix3Prong1Pos2Neg = getPrimaryVertex(collision).getCov();               /// initialize to the original PV
-              if constexpr (doPvRefit) {
-                if (config.fillHistograms) {
-                  registry.fill(HIST("PvRefit/verticesPerCandidate"), 1);
-                }
-                int nCandContr = 3;
-                auto trackFirstIt = std::find(vecPvContributorGlobId.begin(), vecPvContributorGlobId.end(), trackPos1.globalIndex());
-                auto trackSecondIt = std::find(vecPvContributorGlobId.begin(), vecPvContributorGlobId.end(), trackNeg1.globalIndex());
-                auto trackThirdIt = std::find(vecPvContributorGlobId.begin(), vecPvContributorGlobId.end(), trackNeg2.globalIndex());
-                bool isTrackFirstContr = true;
-                bool isTrackSecondContr = true;
-                bool isTrackThirdContr = true;
-                if (trackFirstIt == vecPvContributorGlobId.end()) {
-                  /// This track did not contribute to the original PV refit
-                  if (config.debugPvRefit) {
-                    LOG(info) << "--- [3 prong] trackPos1 with globalIndex " << trackPos1.globalIndex() << " was not a PV contributor";
-                  }
-                  nCandContr--;
-                  isTrackFirstContr = false;
+            /// PV refit excluding the candidate daughters, if contributors
+            std::array<float, 3> pvRefitCoord3Prong2Pos1Neg = {collision.posX(), collision.posY(), collision.posZ()}; /// initialize to the original PV
+            std::array<float, 6> pvRefitCovMatrix3Prong2Pos1Neg = getPrimaryVertex(collision).getCov();               /// initialize to the original PV
+            if constexpr (doPvRefit) {
+              if (config.fillHistograms) {
+                output.fill(HIST("PvRefit/verticesPerCandidate"), 1);
+              }
+              int nCandContr = 3;
+              bool isTrackFirstContr = true;
+              bool isTrackSecondContr = true;
+              bool isTrackThirdContr = true;
+              if (!worker.pvRefitter.isContributor(trackPos1.globalIndex())) {
+                /// This track did not contribute to the original PV refit
+                if (config.debugPvRefit) {
+                  LOG(info) << "--- [3 prong] trackPos1 with globalIndex " << trackPos1.globalIndex() << " was not a PV contributor";
                 }
-                if (trackSecondIt == vecPvContributorGlobId.end()) {
-                  /// This track did not contribute to the original PV refit
-                  if (config.debugPvRefit) {
-                    LOG(info) << "--- [3 prong] trackNeg1 with globalIndex " << trackNeg1.globalIndex() << " was not a PV contributor";
-                  }
-                  nCandContr--;
-                  isTrackSecondContr = false;
+                nCandContr--;
+                isTrackFirstContr = false;
+              }
+              if (!worker.pvRefitter.isContributor(trackNeg1.globalIndex())) {
+                /// This track did not contribute to the original PV refit
+                if (config.debugPvRefit) {
+                  LOG(info) << "--- [3 prong] trackNeg1 with globalIndex " << trackNeg1.globalIndex() << " was not a PV contributor";
                 }
-                if (trackThirdIt == vecPvContributorGlobId.end()) {
-                  /// This track did not contribute to the original PV refit
-                  if (config.debugPvRefit) {
-                    LOG(info) << "--- [3 prong] trackNeg2 with globalIndex " << trackNeg2.globalIndex() << " was not a PV contributor";
-                  }
-                  nCandContr--;
-                  isTrackThirdContr = false;
+                nCandContr--;
+                isTrackSecondContr = false;
+              }
+              if (!worker.pvRefitter.isContributor(trackPos2.globalIndex())) {
+                /// This track did not contribute to the original PV refit
+                if (config.debugPvRefit) {
+                  LOG(info) << "--- [3 prong] trackPos2 with globalIndex " << trackPos2.globalIndex() << " was not a PV contributor";
                 }
+                nCandContr--;
+                isTrackThirdContr = false;
+              }
+
+              // Fill a vector with global ID of candidate daughters that are contributors
+              std::vector<int64_t> vecCandPvContributorGlobId = {};
+              if (isTrackFirstContr) {
+                vecCandPvContributorGlobId.push_back(trackPos1.globalIndex());
+              }
+              if (isTrackSecondContr) {
+                vecCandPvContributorGlobId.push_back(trackNeg1.globalIndex());
+              }
+              if (isTrackThirdContr) {
+                vecCandPvContributorGlobId.push_back(trackPos2.globalIndex());
+              }
 
-                // Fill a vector with global ID of candidate daughters that are contributors
-                std::vector<int64_t> vecCandPvContributorGlobId = {};
-                if (isTrackFirstContr) {
-                  vecCandPvContributorGlobId.push_back(trackPos1.globalIndex());
+              if (nCandContr == 3 || nCandContr == 2) {
+                /// At least two of the daughter tracks were used for the original PV refit, let's refit it after excluding them
+                if (config.debugPvRefit) {
+                  LOG(info) << "### [3 prong] Calling performPvRefitCandProngs for HF 3 prong candidate, removing " << nCandContr << " daughters";
                 }
-                if (isTrackSecondContr) {
-                  vecCandPvContributorGlobId.push_back(trackNeg1.globalIndex());
+                performPvRefitCandProngs(collision, vecCandPvContributorGlobId, pvRefitCoord3Prong2Pos1Neg, pvRefitCovMatrix3Prong2Pos1Neg, worker.pvRefitter, output);
+              } else if (nCandContr == 1) {
+                /// Only one daughter was a contributor, let's use then the PV recalculated by excluding only it
+                if (config.debugPvRefit) {
+                  LOG(info) << "####### [3 Prong] nCandContr==" << nCandContr << " ---> just 1 contributor!";
+                }
+                if (config.fillHistograms) {
+                  output.fill(HIST("PvRefit/verticesPerCandidate"), 5);
                 }
-                if (isTrackThirdContr) {
-                  vecCandPvContributorGlobId.push_back(trackNeg2.globalIndex());
+                if (isTrackFirstContr && !isTrackSecondContr && !isTrackThirdContr) {
+                  /// the first daughter is contributor, the second and the third are not
+                  pvRefitCoord3Prong2Pos1Neg = {trackPos1.pvRefitX(), trackPos1.pvRefitY(), trackPos1.pvRefitZ()};
+                  pvRefitCovMatrix3Prong2Pos1Neg = {trackPos1.pvRefitSigmaX2(), trackPos1.pvRefitSigmaXY(), trackPos1.pvRefitSigmaY2(), trackPos1.pvRefitSigmaXZ(), trackPos1.pvRefitSigmaYZ(), trackPos1.pvRefitSigmaZ2()};
+                } else if (!isTrackFirstContr && isTrackSecondContr && !isTrackThirdContr) {
+                  /// the second daughter is contributor, the first and the third are not
+                  pvRefitCoord3Prong2Pos1Neg = {trackNeg1.pvRefitX(), trackNeg1.pvRefitY(), trackNeg1.pvRefitZ()};
+                  pvRefitCovMatrix3Prong2Pos1Neg = {trackNeg1.pvRefitSigmaX2(), trackNeg1.pvRefitSigmaXY(), trackNeg1.pvRefitSigmaY2(), trackNeg1.pvRefitSigmaXZ(), trackNeg1.pvRefitSigmaYZ(), trackNeg1.pvRefitSigmaZ2()};
+                } else if (!isTrackFirstContr && !isTrackSecondContr && isTrackThirdContr) {
+                  /// the third daughter is contributor, the first and the second are not
+                  pvRefitCoord3Prong2Pos1Neg = {trackPos2.pvRefitX(), trackPos2.pvRefitY(), trackPos2.pvRefitZ()};
+                  pvRefitCovMatrix3Prong2Pos1Neg = {trackPos2.pvRefitSigmaX2(), trackPos2.pvRefitSigmaXY(), trackPos2.pvRefitSigmaY2(), trackPos2.pvRefitSigmaXZ(), trackPos2.pvRefitSigmaYZ(), trackPos2.pvRefitSigmaZ2()};
                 }
+              } else {
+                /// 0 contributors among the HF candidate daughters
+                if (config.fillHistograms) {
+                  output.fill(HIST("PvRefit/verticesPerCandidate"), 6);
+                }
+                if (config.debugPvRefit) {
+                  LOG(info) << "####### [3 prong] nCandContr==" << nCandContr << " ---> some of the candidate daughters did not contribute to the original PV fit, PV refit not redone";
+                }
+              }
+            }
 
-                if (nCandContr == 3 || nCandContr == 2) {
-                  /// At least two of the daughter tracks were used for the original PV refit, let's refit it after excluding them
-                  if (config.debugPvRefit) {
-                    LOG(info) << "### [3 prong] Calling performPvRefitCandProngs for HF 3 prong candidate, removing " << nCandContr << " daughters";
-                  }
-                  performPvRefitCandProngs(collision, bcWithTimeStamps, vecPvContributorGlobId, vecPvContributorTrackParCov, vecCandPvContributorGlobId, pvRefitCoord3Prong1Pos2Neg, pvRefitCovMatrix3Prong1Pos2Neg);
-                } else if (nCandContr == 1) {
-                  /// Only one daughter was a contributor, let's use then the PV recalculated by excluding only it
-                  if (config.debugPvRefit) {
-                    LOG(info) << "####### [3 Prong] nCandContr==" << nCandContr << " ---> just 1 contributor!";
-                  }
-                  if (config.fillHistograms) {
-                    registry.fill(HIST("PvRefit/verticesPerCandidate"), 5);
-                  }
-                  if (isTrackFirstContr && !isTrackSecondContr && !isTrackThirdContr) {
-                    /// the first daughter is contributor, the second and the third are not
-                    pvRefitCoord3Prong1Pos2Neg = {trackPos1.pvRefitX(), trackPos1.pvRefitY(), trackPos1.pvRefitZ()};
-                    pvRefitCovMatrix3Prong1Pos2Neg = {trackPos1.pvRefitSigmaX2(), trackPos1.pvRefitSigmaXY(), trackPos1.pvRefitSigmaY2(), trackPos1.pvRefitSigmaXZ(), trackPos1.pvRefitSigmaYZ(), trackPos1.pvRefitSigmaZ2()};
-                  } else if (!isTrackFirstContr && isTrackSecondContr && !isTrackThirdContr) {
-                    /// the second daughter is contributor, the first and the third are not
-                    pvRefitCoord3Prong1Pos2Neg = {trackNeg1.pvRefitX(), trackNeg1.pvRefitY(), trackNeg1.pvRefitZ()};
-                    pvRefitCovMatrix3Prong1Pos2Neg = {trackNeg1.pvRefitSigmaX2(), trackNeg1.pvRefitSigmaXY(), trackNeg1.pvRefitSigmaY2(), trackNeg1.pvRefitSigmaXZ(), trackNeg1.pvRefitSigmaYZ(), trackNeg1.pvRefitSigmaZ2()};
-                  } else if (!isTrackFirstContr && !isTrackSecondContr && isTrackThirdContr) {
-                    /// the third daughter is contributor, the first and the second are not
-                    pvRefitCoord3Prong1Pos2Neg = {trackNeg2.pvRefitX(), trackNeg2.pvRefitY(), trackNeg2.pvRefitZ()};
-                    pvRefitCovMatrix3Prong1Pos2Neg = {trackNeg2.pvRefitSigmaX2(), trackNeg2.pvRefitSigmaXY(), trackNeg2.pvRefitSigmaY2(), trackNeg2.pvRefitSigmaXZ(), trackNeg2.pvRefitSigmaYZ(), trackNeg2.pvRefitSigmaZ2()};
+            // reconstruct the 3-prong secondary vertex
+            int nVtxFrom3ProngFitter = 0;
+            try {
+              nVtxFrom3ProngFitter = worker.df3.process(trackParVarPos1, trackParVarNeg1, trackParVarPos2);
+            } catch (...) {
+              continue;
+            }
+
+            if (nVtxFrom3ProngFitter == 0) {
+              continue;
+            }
+            // get secondary vertex
+            const auto& secondaryVertex3 = worker.df3.getPCACandidate();
+            // get track momenta
+            std::array<float, 3> pvec0;
+            std::array<float, 3> pvec1;
+            std::array<float, 3> pvec2;
+            auto trackParVarPcaPos1 = worker.df3.getTrack(0);
+            auto trackParVarPcaNeg1 = worker.df3.getTrack(1);
+            auto trackParVarPcaPos2 = worker.df3.getTrack(2);
+            trackParVarPcaPos1.getPxPyPzGlo(pvec0);
+            trackParVarPcaNeg1.getPxPyPzGlo(pvec1);
+            trackParVarPcaPos2.getPxPyPzGlo(pvec2);
+            auto pVecCandProng3Pos = RecoDecay::pVec(pvec0, pvec1, pvec2);
+
+            // 3-prong selections after secondary vertex
+            applySelection3Prong(pVecCandProng3Pos, secondaryVertex3, pvRefitCoord3Prong2Pos1Neg, cutStatus3Prong, isSelected3ProngCand);
+
+            std::array<std::vector<float>, kN3ProngDecays> mlScores3Prongs;
+            if (config.applyMlForHfFilters) {
+              std::vector<float> inputFeatures{trackParVarPcaPos1.getPt(), dcaInfoPos1[0], dcaInfoPos1[1], trackParVarPcaNeg1.getPt(), dcaInfoNeg1[0], dcaInfoNeg1[1], trackParVarPcaPos2.getPt(), dcaInfoPos2[0], dcaInfoPos2[1]};
+              applyMlSelectionForHfFilters3Prong(inputFeatures, mlScores3Prongs, isSelected3ProngCand, output);
+            }
+
+            if (!config.debug && isSelected3ProngCand == 0) {
+              continue;
+            }
+
+            // fill table row
+            output.rowTrackIndexProng3(thisCollId, trackPos1.globalIndex(), trackNeg1.globalIndex(), trackPos2.globalIndex(), isSelected3ProngCand);
+            if (config.applyMlForHfFilters) {
+              output.rowTrackIndexMlScoreProng3(mlScores3Prongs[0], mlScores3Prongs[1], mlScores3Prongs[2], mlScores3Prongs[3]);
+            }
+            if constexpr (doPvRefit) {
+              // fill table row of coordinates of PV refit
+              output.rowProng3PVrefit(pvRefitCoord3Prong2Pos1Neg[0], pvRefitCoord3Prong2Pos1Neg[1], pvRefitCoord3Prong2Pos1Neg[2],
+                                      pvRefitCovMatrix3Prong2Pos1Neg[0], pvRefitCovMatrix3Prong2Pos1Neg[1], pvRefitCovMatrix3Prong2Pos1Neg[2], pvRefitCovMatrix3Prong2Pos1Neg[3], pvRefitCovMatrix3Prong2Pos1Neg[4], pvRefitCovMatrix3Prong2Pos1Neg[5]);
+            }
+
+            if (config.debug) {
+              int Prong3CutStatus[kN3ProngDecays];
+              for (int iDecay3P = 0; iDecay3P < kN3ProngDecays; iDecay3P++) {
+                Prong3CutStatus[iDecay3P] = nCutStatus3ProngBit[iDecay3P];
+                for (int iCut = 0; iCut < kNCuts3Prong[iDecay3P]; iCut++) {
+                  if (!cutStatus3Prong[iDecay3P][iCut]) {
+                    CLRBIT(Prong3CutStatus[iDecay3P], iCut);
                   }
-                } else {
-                  /// 0 contributors among the HF candidate daughters
-                  if (config.fillHistograms) {
-                    registry.fill(HIST("PvRefit/verticesPerCandidate"), 6);
+                }
+              }
+              output.rowProng3CutStatus(Prong3CutStatus[0], Prong3CutStatus[1], Prong3CutStatus[2], Prong3CutStatus[3]); // FIXME when we can do this by looping over kN3ProngDecays
+            }
+
+            // fill histograms
+            if (config.fillHistograms) {
+              output.fill(HIST("hVtx3ProngX"), secondaryVertex3[0]);
+              output.fill(HIST("hVtx3ProngY"), secondaryVertex3[1]);
+              output.fill(HIST("hVtx3ProngZ"), secondaryVertex3[2]);
+              std::array<std::array<float, 3>, 3> arr3Mom = {pvec0, pvec1, pvec2};
+              for (int iDecay3P = 0; iDecay3P < kN3ProngDecays; iDecay3P++) {
+                if (TESTBIT(isSelected3ProngCand, iDecay3P)) {
+                  if (TESTBIT(whichHypo3Prong[iDecay3P], 0)) {
+                    auto mass3Prong = RecoDecay::m(arr3Mom, arrMass3Prong[iDecay3P][0]);
+                    switch (iDecay3P) {
+                      case hf_cand_3prong::DecayType::DplusToPiKPi:
+                        output.fill(HIST("hMassDPlusToPiKPi"), mass3Prong);
+                        break;
+                      case hf_cand_3prong::DecayType::DsToKKPi:
+                        output.fill(HIST("hMassDsToKKPi"), mass3Prong);
+                        break;
+                      case hf_cand_3prong::DecayType::LcToPKPi:
+                        output.fill(HIST("hMassLcToPKPi"), mass3Prong);
+                        break;
+                      case hf_cand_3prong::DecayType::XicToPKPi:
+                        output.fill(HIST("hMassXicToPKPi"), mass3Prong);
+                        break;
+                    }
                   }
-                  if (config.debugPvRefit) {
-                    LOG(info) << "####### [3 prong] nCandContr==" << nCandContr << " ---> some of the candidate daughters did not contribute to the original PV fit, PV refit not redone";
+                  if (TESTBIT(whichHypo3Prong[iDecay3P], 1)) {
+                    auto mass3Prong = RecoDecay::m(arr3Mom, arrMass3Prong[iDecay3P][1]);
+                    switch (iDecay3P) {
+                      case hf_cand_3prong::DecayType::DsToKKPi:
+                        output.fill(HIST("hMassDsToKKPi"), mass3Prong);
+                        break;
+                      case hf_cand_3prong::DecayType::LcToPKPi:
+                        output.fill(HIST("hMassLcToPKPi"), mass3Prong);
+                        break;
+                      case hf_cand_3prong::DecayType::XicToPKPi:
+                        output.fill(HIST("hMassXicToPKPi"), mass3Prong);
+                        break;
+                    }
                   }
                 }
               }
+            }
+          }
 
-              // reconstruct the 3-prong secondary vertex
-              int nVtxFrom3ProngFitterSecondLoop = 0;
-              try {
-                nVtxFrom3ProngFitterSecondLoop = df3.process(trackParVarNeg1, trackParVarPos1, trackParVarNeg2);
-              } catch (...) {
+          // pre-screening of the third prongs, the other candidates are kept only in debug mode
+          if (!config.debug) {
+            prescreen3Prongs(worker.negativeCandidates, iNeg1, worker.positiveCandidates, iPos1, iNeg1 + 1, worker.isPrescreened3Prong);
+          }
+
+          // second loop over negative tracks
+          int iNeg2 = iNeg1;
+          for (auto trackIndexNeg2 = trackIndexNeg1 + 1; trackIndexNeg2 != groupedTrackIndicesNeg1.end(); ++trackIndexNeg2) {
+            iNeg2++;
+            if (!config.debug && !worker.isPrescreened3Prong[iNeg2]) {
+              continue;
+            }
+
+            int isSelected3ProngCand = n3ProngBit;
+            if (!TESTBIT(trackIndexNeg2.isSelProng(), CandidateType::Cand3Prong)) { // continue immediately
+              if (!config.debug) {
                 continue;
+              } else {
+                isSelected3ProngCand = 0;
               }
+            }
 
-              if (nVtxFrom3ProngFitterSecondLoop == 0) {
+            if (config.applyKaonPidIn3Prongs && !TESTBIT(trackIndexPos1.isIdentifiedPid(), channelKaonPid)) { // continue immediately if kaon PID enabled and opposite-sign track not a kaon
+              if (!config.debug) {
                 continue;
+              } else {
+                isSelected3ProngCand = 0;
               }
-              // get secondary vertex
-              const auto& secondaryVertex3 = df3.getPCACandidate();
-              // get track momenta
-              std::array<float, 3> pvec0;
-              std::array<float, 3> pvec1;
-              std::array<float, 3> pvec2;
-              auto trackParVarPcaNeg1 = df3.getTrack(0);
-              auto trackParVarPcaPos1 = df3.getTrack(1);
-              auto trackParVarPcaNeg2 = df3.getTrack(2);
-              trackParVarPcaNeg1.getPxPyPzGlo(pvec0);
-              trackParVarPcaPos1.getPxPyPzGlo(pvec1);
-              trackParVarPcaNeg2.getPxPyPzGlo(pvec2);
+            }
 
-              auto pVecCandProng3Neg = RecoDecay::pVec(pvec0, pvec1, pvec2);
+            auto trackNeg2 = trackIndexNeg2.template track_as<TTracks>();
+            // the track is re-propagated to this collision only for candidates to be preselected
+            auto trackParVarNeg2 = isSelected3ProngCand ? worker.negativeCandidates.trackParVar[iNeg2] : getTrackParCov(trackNeg2);
+            auto dcaInfoNeg2 = isSelected3ProngCand ? worker.negativeCandidates.dcaInfo[iNeg2] : o2::gpu::gpustd::array<float, 2>{trackNeg2.dcaXY(), trackNeg2.dcaZ()};
 
-              // 3-prong selections after secondary vertex
-              applySelection3Prong(pVecCandProng3Neg, secondaryVertex3, pvRefitCoord3Prong1Pos2Neg, cutStatus3Prong, isSelected3ProngCand);
+            // preselection of 3-prong candidates
+            if (isSelected3ProngCand) {
+              const auto& pVecTrackNeg2 = worker.negativeCandidates.pVec[iNeg2];
 
-              std::array<std::vector<float>, kN3ProngDecays> mlScores3Prongs;
-              if (config.applyMlForHfFilters) {
-                std::vector<float> inputFeatures{trackParVarPcaNeg1.getPt(), dcaInfoNeg1[0], dcaInfoNeg1[1], trackParVarPcaPos1.getPt(), dcaInfoPos1[0], dcaInfoPos1[1], trackParVarPcaNeg2.getPt(), dcaInfoNeg2[0], dcaInfoNeg2[1]};
-                applyMlSelectionForHfFilters3Prong(inputFeatures, mlScores3Prongs, isSelected3ProngCand);
+              if (config.debug) {
+                for (int iDecay3P = 0; iDecay3P < kN3ProngDecays; iDecay3P++) {
+                  for (int iCut = 0; iCut < kNCuts3Prong[iDecay3P]; iCut++) {
+                    cutStatus3Prong[iDecay3P][iCut] = true;
+                  }
+                }
               }
 
+              // 3-prong preselections
+              int8_t isIdentifiedPidTrackNeg1 = trackIndexNeg1.isIdentifiedPid();
+              int8_t isIdentifiedPidTrackNeg2 = trackIndexNeg2.isIdentifiedPid();
+              applyPreselection3Prong(pVecTrackNeg1, pVecTrackPos1, pVecTrackNeg2, isIdentifiedPidTrackNeg1, isIdentifiedPidTrackNeg2, cutStatus3Prong, whichHypo3Prong, isSelected3ProngCand);
               if (!config.debug && isSelected3ProngCand == 0) {
                 continue;
               }
+            }
 
-              // fill table row
-              rowTrackIndexProng3(thisCollId, trackNeg1.globalIndex(), trackPos1.globalIndex(), trackNeg2.globalIndex(), isSelected3ProngCand);
-              if (config.applyMlForHfFilters) {
-                rowTrackIndexMlScoreProng3(mlScores3Prongs[0], mlScores3Prongs[1], mlScores3Prongs[2], mlScores3Prongs[3]);
+            /// PV refit excluding the candidate daughters, if contributors
+            std::array<float, 3> pvRefitCoord3Prong1Pos2Neg = {collision.posX(), collision.posY(), collision.posZ()}; /// initialize to the original PV
+            std::array<float, 6> pvRefitCovMatrix3Prong1Pos2Neg = getPrimaryVertex(collision).getCov();               /// initialize to the original PV
+            if constexpr (doPvRefit) {
+              if (config.fillHistograms) {
+                output.fill(HIST("PvRefit/verticesPerCandidate"), 1);
               }
-              // fill table row of coordinates of PV refit
-              if constexpr (doPvRefit) {
-                rowProng3PVrefit(pvRefitCoord3Prong1Pos2Neg[0], pvRefitCoord3Prong1Pos2Neg[1], pvRefitCoord3Prong1Pos2Neg[2],
-                                 pvRefitCovMatrix3Prong1Pos2Neg[0], pvRefitCovMatrix3Prong1Pos2Neg[1], pvRefitCovMatrix3Prong1Pos2Neg[2], pvRefitCovMatrix3Prong1Pos2Neg[3], pvRefitCovMatrix3Prong1Pos2Neg[4], pvRefitCovMatrix3Prong1Pos2Neg[5]);
+              int nCandContr = 3;
+              bool isTrackFirstContr = true;
+              bool isTrackSecondContr = true;
+              bool isTrackThirdContr = true;
+              if (!worker.pvRefitter.isContributor(trackPos1.globalIndex())) {
+                /// This track did not contribute to the original PV refit
+                if (config.debugPvRefit) {
+                  LOG(info) << "--- [3 prong] trackPos1 with globalIndex " << trackPos1.globalIndex() << " was not a PV contributor";
+                }
+                nCandContr--;
+                isTrackFirstContr = false;
+              }
+              if (!worker.pvRefitter.isContributor(trackNeg1.globalIndex())) {
+                /// This track did not contribute to the original PV refit
+                if (config.debugPvRefit) {
+                  LOG(info) << "--- [3 prong] trackNeg1 with globalIndex " << trackNeg1.globalIndex() << " was not a PV contributor";
+                }
+                nCandContr--;
+                isTrackSecondContr = false;
+              }
+              if (!worker.pvRefitter.isContributor(trackNeg2.globalIndex())) {
+                /// This track did not contribute to the original PV refit
+                if (config.debugPvRefit) {
+                  LOG(info) << "--- [3 prong] trackNeg2 with globalIndex " << trackNeg2.globalIndex() << " was not a PV contributor";
+                }
+                nCandContr--;
+                isTrackThirdContr = false;
               }
 
-              if (config.debug) {
-                int Prong3CutStatus[kN3ProngDecays];
-                for (int iDecay3P = 0; iDecay3P < kN3ProngDecays; iDecay3P++) {
-                  Prong3CutStatus[iDecay3P] = nCutStatus3ProngBit[iDecay3P];
-                  for (int iCut = 0; iCut < kNCuts3Prong[iDecay3P]; iCut++) {
-                    if (!cutStatus3Prong[iDecay3P][iCut]) {
-                      CLRBIT(Prong3CutStatus[iDecay3P], iCut);
-                    }
+              // Fill a vector with global ID of candidate daughters that are contributors
+              std::vector<int64_t> vecCandPvContributorGlobId = {};
+              if (isTrackFirstContr) {
+                vecCandPvContributorGlobId.push_back(trackPos1.globalIndex());
+              }
+              if (isTrackSecondContr) {
+                vecCandPvContributorGlobId.push_back(trackNeg1.globalIndex());
+              }
+              if (isTrackThirdContr) {
+                vecCandPvContributorGlobId.push_back(trackNeg2.globalIndex());
+              }
+
+              if (nCandContr == 3 || nCandContr == 2) {
+                /// At least two of the daughter tracks were used for the original PV refit, let's refit it after excluding them
+                if (config.debugPvRefit) {
+                  LOG(info) << "### [3 prong] Calling performPvRefitCandProngs for HF 3 prong candidate, removing " << nCandContr << " daughters";
+                }
+                performPvRefitCandProngs(collision, vecCandPvContributorGlobId, pvRefitCoord3Prong1Pos2Neg, pvRefitCovMatrix3Prong1Pos2Neg, worker.pvRefitter, output);
+              } else if (nCandContr == 1) {
+                /// Only one daughter was a contributor, let's use then the PV recalculated by excluding only it
+                if (config.debugPvRefit) {
+                  LOG(info) << "####### [3 Prong] nCandContr==" << nCandContr << " ---> just 1 contributor!";
+                }
+                if (config.fillHistograms) {
+                  output.fill(HIST("PvRefit/verticesPerCandidate"), 5);
+                }
+                if (isTrackFirstContr && !isTrackSecondContr && !isTrackThirdContr) {
+                  /// the first daughter is contributor, the second and the third are not
+                  pvRefitCoord3Prong1Pos2Neg = {trackPos1.pvRefitX(), trackPos1.pvRefitY(), trackPos1.pvRefitZ()};
+                  pvRefitCovMatrix3Prong1Pos2Neg = {trackPos1.pvRefitSigmaX2(), trackPos1.pvRefitSigmaXY(), trackPos1.pvRefitSigmaY2(), trackPos1.pvRefitSigmaXZ(), trackPos1.pvRefitSigmaYZ(), trackPos1.pvRefitSigmaZ2()};
+                } else if (!isTrackFirstContr && isTrackSecondContr && !isTrackThirdContr) {
+                  /// the second daughter is contributor, the first and the third are not
+                  pvRefitCoord3Prong1Pos2Neg = {trackNeg1.pvRefitX(), trackNeg1.pvRefitY(), trackNeg1.pvRefitZ()};
+                  pvRefitCovMatrix3Prong1Pos2Neg = {trackNeg1.pvRefitSigmaX2(), trackNeg1.pvRefitSigmaXY(), trackNeg1.pvRefitSigmaY2(), trackNeg1.pvRefitSigmaXZ(), trackNeg1.pvRefitSigmaYZ(), trackNeg1.pvRefitSigmaZ2()};
+                } else if (!isTrackFirstContr && !isTrackSecondContr && isTrackThirdContr) {
+                  /// the third daughter is contributor, the first and the second are not
+                  pvRefitCoord3Prong1Pos2Neg = {trackNeg2.pvRefitX(), trackNeg2.pvRefitY(), trackNeg2.pvRefitZ()};
+                  pvRefitCovMatrix3Prong1Pos2Neg = {trackNeg2.pvRefitSigmaX2(), trackNeg2.pvRefitSigmaXY(), trackNeg2.pvRefitSigmaY2(), trackNeg2.pvRefitSigmaXZ(), trackNeg2.pvRefitSigmaYZ(), trackNeg2.pvRefitSigmaZ2()};
+                }
+              } else {
+                /// 0 contributors among the HF candidate daughters
+                if (config.fillHistograms) {
+                  output.fill(HIST("PvRefit/verticesPerCandidate"), 6);
+                }
+                if (config.debugPvRefit) {
+                  LOG(info) << "####### [3 prong] nCandContr==" << nCandContr << " ---> some of the candidate daughters did not contribute to the original PV fit, PV refit not redone";
+                }
+              }
+            }
+
+            // reconstruct the 3-prong secondary vertex
+            int nVtxFrom3ProngFitterSecondLoop = 0;
+            try {
+              nVtxFrom3ProngFitterSecondLoop = worker.df3.process(trackParVarNeg1, trackParVarPos1, trackParVarNeg2);
+            } catch (...) {
+              continue;
+            }
+
+            if (nVtxFrom3ProngFitterSecondLoop == 0) {
+              continue;
+            }
+            // get secondary vertex
+            const auto& secondaryVertex3 = worker.df3.getPCACandidate();
+            // get track momenta
+            std::array<float, 3> pvec0;
+            std::array<float, 3> pvec1;
+            std::array<float, 3> pvec2;
+            auto trackParVarPcaNeg1 = worker.df3.getTrack(0);
+            auto trackParVarPcaPos1 = worker.df3.getTrack(1);
+            auto trackParVarPcaNeg2 = worker.df3.getTrack(2);
+            trackParVarPcaNeg1.getPxPyPzGlo(pvec0);
+            trackParVarPcaPos1.getPxPyPzGlo(pvec1);
+            trackParVarPcaNeg2.getPxPyPzGlo(pvec2);
+
+            auto pVecCandProng3Neg = RecoDecay::pVec(pvec0, pvec1, pvec2);
+
+            // 3-prong selections after secondary vertex
+            applySelection3Prong(pVecCandProng3Neg, secondaryVertex3, pvRefitCoord3Prong1Pos2Neg, cutStatus3Prong, isSelected3ProngCand);
+
+            std::array<std::vector<float>, kN3ProngDecays> mlScores3Prongs;
+            if (config.applyMlForHfFilters) {
+              std::vector<float> inputFeatures{trackParVarPcaNeg1.getPt(), dcaInfoNeg1[0], dcaInfoNeg1[1], trackParVarPcaPos1.getPt(), dcaInfoPos1[0], dcaInfoPos1[1], trackParVarPcaNeg2.getPt(), dcaInfoNeg2[0], dcaInfoNeg2[1]};
+              applyMlSelectionForHfFilters3Prong(inputFeatures, mlScores3Prongs, isSelected3ProngCand, output);
+            }
+
+            if (!config.debug && isSelected3ProngCand == 0) {
+              continue;
+            }
+
+            // fill table row
+            output.rowTrackIndexProng3(thisCollId, trackNeg1.globalIndex(), trackPos1.globalIndex(), trackNeg2.globalIndex(), isSelected3ProngCand);
+            if (config.applyMlForHfFilters) {
+              output.rowTrackIndexMlScoreProng3(mlScores3Prongs[0], mlScores3Prongs[1], mlScores3Prongs[2], mlScores3Prongs[3]);
+            }
+            // fill table row of coordinates of PV refit
+            if constexpr (doPvRefit) {
+              output.rowProng3PVrefit(pvRefitCoord3Prong1Pos2Neg[0], pvRefitCoord3Prong1Pos2Neg[1], pvRefitCoord3Prong1Pos2Neg[2],
+                                      pvRefitCovMatrix3Prong1Pos2Neg[0], pvRefitCovMatrix3Prong1Pos2Neg[1], pvRefitCovMatrix3Prong1Pos2Neg[2], pvRefitCovMatrix3Prong1Pos2Neg[3], pvRefitCovMatrix3Prong1Pos2Neg[4], pvRefitCovMatrix3Prong1Pos2Neg[5]);
+            }
+
+            if (config.debug) {
+              int Prong3CutStatus[kN3ProngDecays];
+              for (int iDecay3P = 0; iDecay3P < kN3ProngDecays; iDecay3P++) {
+                Prong3CutStatus[iDecay3P] = nCutStatus3ProngBit[iDecay3P];
+                for (int iCut = 0; iCut < kNCuts3Prong[iDecay3P]; iCut++) {
+                  if (!cutStatus3Prong[iDecay3P][iCut]) {
+                    CLRBIT(Prong3CutStatus[iDecay3P], iCut);
                   }
                 }
-                rowProng3CutStatus(Prong3CutStatus[0], Prong3CutStatus[1], Prong3CutStatus[2], Prong3CutStatus[3]); // FIXME when we can do this by looping over kN3ProngDecays
               }
+              output.rowProng3CutStatus(Prong3CutStatus[0], Prong3CutStatus[1], Prong3CutStatus[2], Prong3CutStatus[3]); // FIXME when we can do this by looping over kN3ProngDecays
+            }
 
-              // fill histograms
-              if (config.fillHistograms) {
-                registry.fill(HIST("hVtx3ProngX"), secondaryVertex3[0]);
-                registry.fill(HIST("hVtx3ProngY"), secondaryVertex3[1]);
-                registry.fill(HIST("hVtx3ProngZ"), secondaryVertex3[2]);
-                std::array<std::array<float, 3>, 3> arr3Mom = {pvec0, pvec1, pvec2};
-                for (int iDecay3P = 0; iDecay3P < kN3ProngDecays; iDecay3P++) {
-                  if (TESTBIT(isSelected3ProngCand, iDecay3P)) {
-                    if (TESTBIT(whichHypo3Prong[iDecay3P], 0)) {
-                      auto mass3Prong = RecoDecay::m(arr3Mom, arrMass3Prong[iDecay3P][0]);
-                      switch (iDecay3P) {
-                        case hf_cand_3prong::DecayType::DplusToPiKPi:
-                          registry.fill(HIST("hMassDPlusToPiKPi"), mass3Prong);
-                          break;
-                        case hf_cand_3prong::DecayType::DsToKKPi:
-                          registry.fill(HIST("hMassDsToKKPi"), mass3Prong);
-                          break;
-                        case hf_cand_3prong::DecayType::LcToPKPi:
-                          registry.fill(HIST("hMassLcToPKPi"), mass3Prong);
-                          break;
-                        case hf_cand_3prong::DecayType::XicToPKPi:
-                          registry.fill(HIST("hMassXicToPKPi"), mass3Prong);
-                          break;
-                      }
+            // fill histograms
+            if (config.fillHistograms) {
+              output.fill(HIST("hVtx3ProngX"), secondaryVertex3[0]);
+              output.fill(HIST("hVtx3ProngY"), secondaryVertex3[1]);
+              output.fill(HIST("hVtx3ProngZ"), secondaryVertex3[2]);
+              std::array<std::array<float, 3>, 3> arr3Mom = {pvec0, pvec1, pvec2};
+              for (int iDecay3P = 0; iDecay3P < kN3ProngDecays; iDecay3P++) {
+                if (TESTBIT(isSelected3ProngCand, iDecay3P)) {
+                  if (TESTBIT(whichHypo3Prong[iDecay3P], 0)) {
+                    auto mass3Prong = RecoDecay::m(arr3Mom, arrMass3Prong[iDecay3P][0]);
+                    switch (iDecay3P) {
+                      case hf_cand_3prong::DecayType::DplusToPiKPi:
+                        output.fill(HIST("hMassDPlusToPiKPi"), mass3Prong);
+                        break;
+                      case hf_cand_3prong::DecayType::DsToKKPi:
+                        output.fill(HIST("hMassDsToKKPi"), mass3Prong);
+                        break;
+                      case hf_cand_3prong::DecayType::LcToPKPi:
+                        output.fill(HIST("hMassLcToPKPi"), mass3Prong);
+                        break;
+                      case hf_cand_3prong::DecayType::XicToPKPi:
+                        output.fill(HIST("hMassXicToPKPi"), mass3Prong);
+                        break;
                     }
-                    if (TESTBIT(whichHypo3Prong[iDecay3P], 1)) {
-                      auto mass3Prong = RecoDecay::m(arr3Mom, arrMass3Prong[iDecay3P][1]);
-                      switch (iDecay3P) {
-                        case hf_cand_3prong::DecayType::DsToKKPi:
-                          registry.fill(HIST("hMassDsToKKPi"), mass3Prong);
-                          break;
-                        case hf_cand_3prong::DecayType::LcToPKPi:
-                          registry.fill(HIST("hMassLcToPKPi"), mass3Prong);
-                          break;
-                        case hf_cand_3prong::DecayType::XicToPKPi:
-                          registry.fill(HIST("hMassXicToPKPi"), mass3Prong);
-                          break;
-                      }
+                  }
+                  if (TESTBIT(whichHypo3Prong[iDecay3P], 1)) {
+                    auto mass3Prong = RecoDecay::m(arr3Mom, arrMass3Prong[iDecay3P][1]);
+                    switch (iDecay3P) {
+                      case hf_cand_3prong::DecayType::DsToKKPi:
+                        output.fill(HIST("hMassDsToKKPi"), mass3Prong);
+                        break;
+                      case hf_cand_3prong::DecayType::LcToPKPi:
+                        output.fill(HIST("hMassLcToPKPi"), mass3Prong);
+                        break;
+                      case hf_cand_3prong::DecayType::XicToPKPi:
+                        output.fill(HIST("hMassXicToPKPi"), mass3Prong);
+                        break;
                     }
                   }
                 }
               }
             }
           }
+        }
 
-          if (config.doDstar && TESTBIT(isSelected2ProngCand, hf_cand_2prong::DecayType::D0ToPiK) && (pt2Prong + config.ptTolerance) * 1.2 > config.binsPtDstarToD0Pi->at(0) && whichHypo2Prong[kN2ProngDecays] != 0) { // if D* enabled and pt of the D0 is larger than the minimum of the D* one within 20% (D* and D0 momenta are very similar, always within 20% according to PYTHIA8)
-            // second loop over positive tracks
-            if (TESTBIT(whichHypo2Prong[kN2ProngDecays], 0) && (!config.applyKaonPidIn3Prongs || TESTBIT(trackIndexNeg1.isIdentifiedPid(), channelKaonPid))) { // only for D0 candidates; moreover if kaon PID enabled, apply to the negative track
-              auto groupedTrackIndicesSoftPionsPos = positiveSoftPions->sliceByCached(aod::track::collisionId, collision.globalIndex(), cache);
-              for (auto trackIndexPos2 = groupedTrackIndicesSoftPionsPos.begin(); trackIndexPos2 != groupedTrackIndicesSoftPionsPos.end(); ++trackIndexPos2) {
-                if (trackIndexPos2 == trackIndexPos1) {
-                  continue;
-                }
-                auto trackPos2 = trackIndexPos2.template track_as<TTracks>();
-                std::array<float, 3> pVecTrackPos2{trackPos2.pVector()};
-                if (thisCollId != trackPos2.collisionId()) { // this is not the "default" collision for this track, we have to re-propagate it
-                  auto trackParVarPos2 = getTrackParCov(trackPos2);
-                  o2::gpu::gpustd::array<float, 2> dcaInfoPos2{trackPos2.dcaXY(), trackPos2.dcaZ()};
-                  o2::base::Propagator::Instance()->propagateToDCABxByBz({collision.posX(), collision.posY(), collision.posZ()}, trackParVarPos2, 2.f, noMatCorr, &dcaInfoPos2);
-                  getPxPyPz(trackParVarPos2, pVecTrackPos2);
-                }
+        if (config.doDstar && TESTBIT(isSelected2ProngCand, hf_cand_2prong::DecayType::D0ToPiK) && (pt2Prong + config.ptTolerance) * 1.2 > config.binsPtDstarToD0Pi->at(0) && whichHypo2Prong[kN2ProngDecays] != 0) { // if D* enabled and pt of the D0 is larger than the minimum of the D* one within 20% (D* and D0 momenta are very similar, always within 20% according to PYTHIA8)
+          // second loop over positive tracks
+          if (TESTBIT(whichHypo2Prong[kN2ProngDecays], 0) && (!config.applyKaonPidIn3Prongs || TESTBIT(trackIndexNeg1.isIdentifiedPid(), channelKaonPid))) { // only for D0 candidates; moreover if kaon PID enabled, apply to the negative track
+            auto& groupedTrackIndicesSoftPionsPos = batch.softPionIndicesPos[iCollision];
+            for (auto trackIndexPos2 = groupedTrackIndicesSoftPionsPos.begin(); trackIndexPos2 != groupedTrackIndicesSoftPionsPos.end(); ++trackIndexPos2) {
+              if (trackIndexPos2 == trackIndexPos1) {
+                continue;
+              }
+              auto trackPos2 = trackIndexPos2.template track_as<TTracks>();
+              std::array<float, 3> pVecTrackPos2{trackPos2.pVector()};
+              if (thisCollId != trackPos2.collisionId()) { // this is not the "default" collision for this track, we have to re-propagate it
+                auto trackParVarPos2 = getTrackParCov(trackPos2);
+                o2::gpu::gpustd::array<float, 2> dcaInfoPos2{trackPos2.dcaXY(), trackPos2.dcaZ()};
+                o2::base::Propagator::Instance()->propagateToDCABxByBz({collision.posX(), collision.posY(), collision.posZ()}, trackParVarPos2, 2.f, noMatCorr, &dcaInfoPos2);
+                getPxPyPz(trackParVarPos2, pVecTrackPos2);
+              }
 
-                uint8_t isSelectedDstar{0};
-                uint8_t cutStatus{BIT(kNCutsDstar) - 1};
-                float deltaMass{-1.};
-                isSelectedDstar = applySelectionDstar(pVecTrackPos1, pVecTrackNeg1, pVecTrackPos2, cutStatus, deltaMass); // we do not compute the D* decay vertex at this stage because we are not interested in applying topological selections
-                if (isSelectedDstar) {
-                  rowTrackIndexDstar(thisCollId, trackPos2.globalIndex(), lastFilledD0);
-                  if (config.fillHistograms) {
-                    registry.fill(HIST("hMassDstarToD0Pi"), deltaMass);
-                  }
-                  if constexpr (doPvRefit) {
-                    // fill table row with coordinates of PV refit (same as 2-prong because we do not remove the soft pion)
-                    rowDstarPVrefit(pvRefitCoord2Prong[0], pvRefitCoord2Prong[1], pvRefitCoord2Prong[2],
-                                    pvRefitCovMatrix2Prong[0], pvRefitCovMatrix2Prong[1], pvRefitCovMatrix2Prong[2], pvRefitCovMatrix2Prong[3], pvRefitCovMatrix2Prong[4], pvRefitCovMatrix2Prong[5]);
-                  }
+              uint8_t isSelectedDstar{0};
+              uint8_t cutStatus{BIT(kNCutsDstar) - 1};
+              float deltaMass{-1.};
+              isSelectedDstar = applySelectionDstar(pVecTrackPos1, pVecTrackNeg1, pVecTrackPos2, cutStatus, deltaMass); // we do not compute the D* decay vertex at this stage because we are not interested in applying topological selections
+              if (isSelectedDstar) {
+                output.rowTrackIndexDstar(thisCollId, trackPos2.globalIndex(), lastFilledD0);
+                if (config.fillHistograms) {
+                  output.fill(HIST("hMassDstarToD0Pi"), deltaMass);
                 }
-                if (config.debug) {
-                  rowDstarCutStatus(cutStatus);
+                if constexpr (doPvRefit) {
+                  // fill table row with coordinates of PV refit (same as 2-prong because we do not remove the soft pion)
+                  output.rowDstarPVrefit(pvRefitCoord2Prong[0], pvRefitCoord2Prong[1], pvRefitCoord2Prong[2],
+                                         pvRefitCovMatrix2Prong[0], pvRefitCovMatrix2Prong[1], pvRefitCovMatrix2Prong[2], pvRefitCovMatrix2Prong[3], pvRefitCovMatrix2Prong[4], pvRefitCovMatrix2Prong[5]);
                 }
               }
+              if (config.debug) {
+                output.rowDstarCutStatus(cutStatus);
+              }
             }
+          }
 
-            // second loop over negative tracks
-            if (TESTBIT(whichHypo2Prong[kN2ProngDecays], 1) && (!config.applyKaonPidIn3Prongs || TESTBIT(trackIndexPos1.isIdentifiedPid(), channelKaonPid))) { // only for D0bar candidates; moreover if kaon PID enabled, apply to the positive track
-              auto groupedTrackIndicesSoftPionsNeg = negativeSoftPions->sliceByCached(aod::track::collisionId, collision.globalIndex(), cache);
-              for (auto trackIndexNeg2 = groupedTrackIndicesSoftPionsNeg.begin(); trackIndexNeg2 != groupedTrackIndicesSoftPionsNeg.end(); ++trackIndexNeg2) {
-                if (trackIndexNeg1 == trackIndexNeg2) {
-                  continue;
-                }
-                auto trackNeg2 = trackIndexNeg2.template track_as<TTracks>();
-                std::array<float, 3> pVecTrackNeg2{trackNeg2.pVector()};
-                if (thisCollId != trackNeg2.collisionId()) { // this is not the "default" collision for this track, we have to re-propagate it
-                  auto trackParVarNeg2 = getTrackParCov(trackNeg2);
-                  o2::gpu::gpustd::array<float, 2> dcaInfoNeg2{trackNeg2.dcaXY(), trackNeg2.dcaZ()};
-                  o2::base::Propagator::Instance()->propagateToDCABxByBz({collision.posX(), collision.posY(), collision.posZ()}, trackParVarNeg2, 2.f, noMatCorr, &dcaInfoNeg2);
-                  getPxPyPz(trackParVarNeg2, pVecTrackNeg2);
-                }
+          // second loop over negative tracks
+          if (TESTBIT(whichHypo2Prong[kN2ProngDecays], 1) && (!config.applyKaonPidIn3Prongs || TESTBIT(trackIndexPos1.isIdentifiedPid(), channelKaonPid))) { // only for D0bar candidates; moreover if kaon PID enabled, apply to the positive track
+            auto& groupedTrackIndicesSoftPionsNeg = batch.softPionIndicesNeg[iCollision];
+            for (auto trackIndexNeg2 = groupedTrackIndicesSoftPionsNeg.begin(); trackIndexNeg2 != groupedTrackIndicesSoftPionsNeg.end(); ++trackIndexNeg2) {
+              if (trackIndexNeg1 == trackIndexNeg2) {
+                continue;
+              }
+              auto trackNeg2 = trackIndexNeg2.template track_as<TTracks>();
+              std::array<float, 3> pVecTrackNeg2{trackNeg2.pVector()};
+              if (thisCollId != trackNeg2.collisionId()) { // this is not the "default" collision for this track, we have to re-propagate it
+                auto trackParVarNeg2 = getTrackParCov(trackNeg2);
+                o2::gpu::gpustd::array<float, 2> dcaInfoNeg2{trackNeg2.dcaXY(), trackNeg2.dcaZ()};
+                o2::base::Propagator::Instance()->propagateToDCABxByBz({collision.posX(), collision.posY(), collision.posZ()}, trackParVarNeg2, 2.f, noMatCorr, &dcaInfoNeg2);
+                getPxPyPz(trackParVarNeg2, pVecTrackNeg2);
+              }
 
-                uint8_t isSelectedDstar{0};
-                uint8_t cutStatus{BIT(kNCutsDstar) - 1};
-                float deltaMass{-1.};
-                isSelectedDstar = applySelectionDstar(pVecTrackNeg1, pVecTrackPos1, pVecTrackNeg2, cutStatus, deltaMass); // we do not compute the D* decay vertex at this stage because we are not interested in applying topological selections
-                if (isSelectedDstar) {
-                  rowTrackIndexDstar(thisCollId, trackNeg2.globalIndex(), lastFilledD0);
-                  if (config.fillHistograms) {
-                    registry.fill(HIST("hMassDstarToD0Pi"), deltaMass);
-                  }
-                  if constexpr (doPvRefit) {
-                    // fill table row with coordinates of PV refit (same as 2-prong because we do not remove the soft pion)
-                    rowDstarPVrefit(pvRefitCoord2Prong[0], pvRefitCoord2Prong[1], pvRefitCoord2Prong[2],
-                                    pvRefitCovMatrix2Prong[0], pvRefitCovMatrix2Prong[1], pvRefitCovMatrix2Prong[2], pvRefitCovMatrix2Prong[3], pvRefitCovMatrix2Prong[4], pvRefitCovMatrix2Prong[5]);
-                  }
+              uint8_t isSelectedDstar{0};
+              uint8_t cutStatus{BIT(kNCutsDstar) - 1};
+              float deltaMass{-1.};
+              isSelectedDstar = applySelectionDstar(pVecTrackNeg1, pVecTrackPos1, pVecTrackNeg2, cutStatus, deltaMass); // we do not compute the D* decay vertex at this stage because we are not interested in applying topological selections
+              if (isSelectedDstar) {
+                output.rowTrackIndexDstar(thisCollId, trackNeg2.globalIndex(), lastFilledD0);
+                if (config.fillHistograms) {
+                  output.fill(HIST("hMassDstarToD0Pi"), deltaMass);
                 }
-                if (config.debug) {
-                  rowDstarCutStatus(cutStatus);
+                if constexpr (doPvRefit) {
+                  // fill table row with coordinates of PV refit (same as 2-prong because we do not remove the soft pion)
+                  output.rowDstarPVrefit(pvRefitCoord2Prong[0], pvRefitCoord2Prong[1], pvRefitCoord2Prong[2],
+                                         pvRefitCovMatrix2Prong[0], pvRefitCovMatrix2Prong[1], pvRefitCovMatrix2Prong[2], pvRefitCovMatrix2Prong[3], pvRefitCovMatrix2Prong[4], pvRefitCovMatrix2Prong[5]);
                 }
               }
+              if (config.debug) {
+                output.rowDstarCutStatus(cutStatus);
+              }
             }
-          } // end of D*
-        }
+          }
+        } // end of D*
       }
+    }
 
-      int nTracks = 0;
-      // auto nTracks = trackIndicesPerCollision.lastIndex() - trackIndicesPerCollision.firstIndex(); // number of tracks passing 2 and 3 prong selection in this collision
-      nCand2 = rowTrackIndexProng2.lastIndex() - nCand2; // number of 2-prong candidates in this collision
-      nCand3 = rowTrackIndexProng3.lastIndex() - nCand3; // number of 3-prong candidates in this collision
+    int nTracks = 0;
+    // auto nTracks = trackIndicesPerCollision.lastIndex() - trackIndicesPerCollision.firstIndex(); // number of tracks passing 2 and 3 prong selection in this collision
+    nCand2 = output.rowTrackIndexProng2.lastIndex() - nCand2; // number of 2-prong candidates in this collision
+    nCand3 = output.rowTrackIndexProng3.lastIndex() - nCand3; // number of 3-prong candidates in this collision
 
-      if (config.fillHistograms) {
-        registry.fill(HIST("hNTracks"), nTracks);
-        registry.fill(HIST("hNCand2Prong"), nCand2);
-        registry.fill(HIST("hNCand3Prong"), nCand3);
-        registry.fill(HIST("hNCand2ProngVsNTracks"), nTracks, nCand2);
-        registry.fill(HIST("hNCand3ProngVsNTracks"), nTracks, nCand3);
-      }
+    if (config.fillHistograms) {
+      output.fill(HIST("hNTracks"), nTracks);
+      output.fill(HIST("hNCand2Prong"), nCand2);
+      output.fill(HIST("hNCand3Prong"), nCand3);
+      output.fill(HIST("hNCand2ProngVsNTracks"), nTracks, nCand2);
+      output.fill(HIST("hNCand3ProngVsNTracks"), nTracks, nCand3);
     }
-  } /// end of run2And3Prongs function
+  } /// end of run2And3ProngsCollision function
 
   void processNo2And3Prongs(SelectedCollisions const&)
   {
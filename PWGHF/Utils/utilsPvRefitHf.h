@@ -0,0 +1,127 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+
+/// \file utilsPvRefitHf.h
+/// \brief Primary-vertex refit excluding candidate daughters, prepared once per collision, for HF analyses
+
+#ifndef PWGHF_UTILS_UTILSPVREFITHF_H_
+#define PWGHF_UTILS_UTILSPVREFITHF_H_
+
+#include <unordered_map>
+#include <vector>
+
+#include "DetectorsBase/Propagator.h"
+#include "DetectorsVertexing/PVertexer.h"
+#include "ReconstructionDataFormats/Track.h"
+#include "ReconstructionDataFormats/Vertex.h"
+
+namespace o2::hf_pvrefit
+{
+/// Refit of the primary vertex of a collision without some of its contributors.
+/// The contributors are propagated to the vertex (PVertexer::prepareVertexRefit) only once per collision,
+/// each refit then only switches off the removed tracks, looked up by global index in a hash map.
+class PvRefitter
+{
+ public:
+  PvRefitter() = default;
+  ~PvRefitter() = default;
+
+  /// Initialises the vertexer with the nominal magnetic field of the propagator, done otherwise at the prepare calls
+  void init() { setBz(o2::base::Propagator::Instance()->getNominalBz()); }
+
+  /// Initialises the vertexer, again if the magnetic field changed (new run).
+  /// To be called after each field update before using several refitters in parallel, the vertexer parameters are global
+  /// \param bz is the magnetic field
+  void setBz(float bz)
+  {
+    if (!mIsVertexerInitialised || bz != mBz) {
+      o2::conf::ConfigurableParam::updateFromString("pvertexer.useMeanVertexConstraint=false"); /// remove diamond constraint (let's keep it at the moment...)
+      mVertexer.init();
+      mVertexer.setBz(bz);
+      mBz = bz;
+      mIsVertexerInitialised = true;
+    }
+  }
+
+  /// Prepares the refit of the primary vertex of a collision
+  /// \param collision is the collision
+  /// \param contributorGlobIds are the global indices of the PV contributors of the collision
+  /// \param contributorTrackParCovs are the TrackParCov of the PV contributors of the collision
+  /// \return true if the vertex can be refitted
+  template <typename TCollision>
+  bool prepare(TCollision const& collision, std::vector<int64_t> const& contributorGlobIds, std::vector<o2::track::TrackParCov> const& contributorTrackParCovs)
+  {
+    init();
+    mPrimVtx.setX(collision.posX());
+    mPrimVtx.setY(collision.posY());
+    mPrimVtx.setZ(collision.posZ());
+    mPrimVtx.setCov(collision.covXX(), collision.covXY(), collision.covYY(), collision.covXZ(), collision.covYZ(), collision.covZZ());
+
+    mSlotPerContributor.clear();
+    mSlotPerContributor.reserve(contributorGlobIds.size());
+    for (size_t iContributor = 0; iContributor < contributorGlobIds.size(); iContributor++) {
+      mSlotPerContributor.emplace(contributorGlobIds[iContributor], iContributor);
+    }
+    mContributorUsed.assign(contributorGlobIds.size(), true);
+    mIsDoable = mVertexer.prepareVertexRefit(contributorTrackParCovs, mPrimVtx);
+    return mIsDoable;
+  }
+
+  /// \return true if the prepared vertex can be refitted
+  bool isDoable() const { return mIsDoable; }
+
+  /// \return number of PV contributors of the prepared vertex
+  int getNContributors() const { return mContributorUsed.size(); }
+
+  /// \return original primary vertex of the prepared collision
+  o2::dataformats::VertexBase const& getPrimaryVertex() const { return mPrimVtx; }
+
+  /// \param globalIndex is the global index of a track
+  /// \return true if the track is a PV contributor of the prepared collision
+  bool isContributor(int64_t globalIndex) const { return mSlotPerContributor.find(globalIndex) != mSlotPerContributor.end(); }
+
+  /// Refits the prepared vertex excluding the given tracks that are PV contributors
+  /// \param globIdsToRemove are the global indices of the tracks to be removed
+  /// \param nRemoved is filled with the number of PV contributors removed from the refit
+  /// \return refitted vertex, with negative chi2 if the refit failed
+  o2::vertexing::PVertex refitWithout(std::vector<int64_t> const& globIdsToRemove, int& nRemoved)
+  {
+    nRemoved = 0;
+    for (const auto& globalIndex : globIdsToRemove) {
+      auto it = mSlotPerContributor.find(globalIndex);
+      if (it != mSlotPerContributor.end()) {
+        mContributorUsed[it->second] = false; /// remove the track from the PV refitting
+        nRemoved++;
+      }
+    }
+    auto primVtxRefitted = mVertexer.refitVertex(mContributorUsed, mPrimVtx);
+    for (const auto& globalIndex : globIdsToRemove) {
+      auto it = mSlotPerContributor.find(globalIndex);
+      if (it != mSlotPerContributor.end()) {
+        mContributorUsed[it->second] = true; /// restore the track for the next PV refitting
+      }
+    }
+    return primVtxRefitted;
+  }
+
+ private:
+  o2::vertexing::PVertexer mVertexer;                   ///< vertexer, prepared with the contributors of the current collision
+  bool mIsVertexerInitialised = false;                  ///< flag set once the vertexer is initialised
+  float mBz = 0.f;                                      ///< magnetic field the vertexer was initialised with
+  bool mIsDoable = false;                               ///< flag set if the prepared vertex can be refitted
+  o2::dataformats::VertexBase mPrimVtx;                 ///< original primary vertex of the current collision
+  std::unordered_map<int64_t, int> mSlotPerContributor; ///< position of each contributor (by global index) in the vertexer
+  std::vector<bool> mContributorUsed;                   ///< contributors used in the refit
+};
+
+} // namespace o2::hf_pvrefit
+
+#endif // PWGHF_UTILS_UTILSPVREFITHF_H_
@@ -60,3 +60,38 @@ fastjet::ClusterSequenceArea JetFinder::findJets(std::vector<fastjet::PseudoJet>
   }
   return clusterSeq;
 }
+
+/// Generates the ghosts of the area definition, to be shared by the jet finding at several radii in one event
+/// \param ghosts vector of ghosts to be filled
+void JetFinder::generateGhosts(std::vector<fastjet::PseudoJet>& ghosts)
+{
+  ghosts.clear();
+  if (ghostRepeatN <= 0) {
+    return;
+  }
+  ghostAreaSpec = fastjet::GhostedAreaSpec(ghostEtaMax, ghostRepeatN, ghostArea, gridScatter, ktScatter, ghostktMean);
+  ghostAreaSpec.add_ghosts(ghosts);
+}
+
+/// Performs jet finding with explicit ghosts
+/// \note pure ghost jets are not returned and jet constituents include ghosts (without user info)
+/// \param inputParticles vector of input particles/tracks
+/// \param ghosts vector of ghosts from generateGhosts
+/// \param jets vector of jets to be filled
+/// \return cluster sequence needed to access constituents
+std::unique_ptr<fastjet::ClusterSequenceActiveAreaExplicitGhosts> JetFinder::findJets(std::vector<fastjet::PseudoJet>& inputParticles, std::vector<fastjet::PseudoJet> const& ghosts, std::vector<fastjet::PseudoJet>& jets)
+{
+  setParams();
+  jets.clear();
+  auto clusterSeq = std::make_unique<fastjet::ClusterSequenceActiveAreaExplicitGhosts>(inputParticles, jetDef, ghosts, ghosts.empty() ? 0. : ghostAreaSpec.actual_ghost_area());
+  for (const auto& jet : selJets(clusterSeq->inclusive_jets())) {
+    if (!jet.is_pure_ghost()) {
+      jets.push_back(jet);
+    }
+  }
+  jets = fastjet::sorted_by_pt(jets);
+  if (isReclustering) {
+    jetR = jetR / 5.0;
+  }
+  return clusterSeq;
+}
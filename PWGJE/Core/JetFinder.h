@@ -27,6 +27,7 @@
 
 #include "fastjet/PseudoJet.hh"
 #include "fastjet/ClusterSequenceArea.hh"
+#include "fastjet/ClusterSequenceActiveAreaExplicitGhosts.hh"
 #include "fastjet/AreaDefinition.hh"
 #include "fastjet/JetDefinition.hh"
 #include "fastjet/tools/Subtractor.hh"
@@ -73,6 +74,8 @@ class JetFinder
   bool isReclustering = false;
   bool isTriggering = false;
 
+  bool shareGhostsAcrossRadii = false; // multi-R mode: same ghosts for all jet radii of an event (see generateGhosts)
+
   fastjet::JetAlgorithm algorithm = fastjet::antikt_algorithm;
   fastjet::RecombinationScheme recombScheme = fastjet::E_scheme;
   fastjet::Strategy strategy = fastjet::Best;
@@ -93,6 +96,18 @@ class JetFinder
   /// \return ClusterSequenceArea object needed to access constituents
   fastjet::ClusterSequenceArea findJets(std::vector<fastjet::PseudoJet>& inputParticles, std::vector<fastjet::PseudoJet>& jets); // ideally find a way of passing the cluster sequence as a reeference
 
+  /// Generates the ghosts of the area definition, to be shared by the jet finding at several radii in one event
+  /// \param ghosts vector of ghosts to be filled
+  void generateGhosts(std::vector<fastjet::PseudoJet>& ghosts);
+
+  /// Performs jet finding with explicit ghosts
+  /// \note pure ghost jets are not returned and jet constituents include ghosts (without user info)
+  /// \param inputParticles vector of input particles/tracks
+  /// \param ghosts vector of ghosts from generateGhosts
+  /// \param jets vector of jets to be filled
+  /// \return cluster sequence needed to access constituents
+  std::unique_ptr<fastjet::ClusterSequenceActiveAreaExplicitGhosts> findJets(std::vector<fastjet::PseudoJet>& inputParticles, std::vector<fastjet::PseudoJet> const& ghosts, std::vector<fastjet::PseudoJet>& jets);
+
  private:
   ClassDefNV(JetFinder, 1);
 };
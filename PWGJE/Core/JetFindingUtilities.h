@@ -231,9 +231,59 @@ bool analyseV0s(std::vector<fastjet::PseudoJet>& inputParticles, T const& v0s, f
   }
 }
 
+/**
+ * Fills the jet tables with the jets found at one jet radius
+ *
+ * @param jets jets found at radius R
+ * @param R jet radius
+ * @param collision the collision within which jets are being found
+ * @param jetsTable output table of jets
+ * @param constituentsTable output table of jet constituents
+ * @param tracks, clusters, cands buffers for the constituent indices, reused for all jets
+ * @param doCandidateJetFinding set whether only jets containing a HF candidate are saved
+ */
+template <typename T, typename U, typename V>
+void fillJetTables(std::vector<fastjet::PseudoJet> const& jets, double R, float jetAreaFractionMin, T const& collision, U& jetsTable, V& constituentsTable, std::shared_ptr<THn> thnSparseJet, bool fillThnSparse, std::vector<int>& tracks, std::vector<int>& clusters, std::vector<int>& cands, bool doCandidateJetFinding)
+{
+  for (const auto& jet : jets) {
+    if (jet.has_area() && jet.area() < jetAreaFractionMin * M_PI * R * R) {
+      continue;
+    }
+    if (fillThnSparse) {
+      thnSparseJet->Fill(R, jet.pt(), jet.eta(), jet.phi()); // important for normalisation in V0Jet analyses to store all jets, including those that aren't V0s
+    }
+    // decode the constituent status once per constituent
+    tracks.clear();
+    clusters.clear();
+    cands.clear();
+    for (const auto& constituent : sorted_by_pt(jet.constituents())) {
+      if (!constituent.has_user_info()) { // explicit ghost
+        continue;
+      }
+      const auto& constituentInfo = constituent.template user_info<fastjetutilities::fastjet_user_info>();
+      const int constituentStatus = constituentInfo.getStatus();
+      if (constituentStatus == static_cast<int>(JetConstituentStatus::track)) {
+        tracks.push_back(constituentInfo.getIndex());
+      } else if (constituentStatus == static_cast<int>(JetConstituentStatus::cluster)) {
+        clusters.push_back(constituentInfo.getIndex());
+      } else if (constituentStatus == static_cast<int>(JetConstituentStatus::candidateHF)) {
+        cands.push_back(constituentInfo.getIndex());
+      }
+    }
+    if (doCandidateJetFinding && cands.empty()) { // note currently we cannot run V0 and HF in the same jet. If we ever need to we can seperate the loops
+      continue;
+    }
+    jetsTable(collision.globalIndex(), jet.pt(), jet.eta(), jet.phi(),
+              jet.E(), jet.rapidity(), jet.m(), jet.has_area() ? jet.area() : 0., std::round(R * 100));
+    constituentsTable(jetsTable.lastIndex(), tracks, clusters, cands);
+  }
+}
+
 /**
  * Performs jet finding and fills jet tables
  *
+ * In the multi-R mode (jetFinder.shareGhostsAcrossRadii) the ghosts are generated once per event and shared by all radii.
+ *
  * @param jetFinder JetFinder object which carries jet finding parameters
  * @param inputParticles fastjet container
  * @param jetRadius jet finding radii
@@ -248,48 +298,26 @@ void findJets(JetFinder& jetFinder, std::vector<fastjet::PseudoJet>& inputPartic
   auto jetRValues = static_cast<std::vector<double>>(jetRadius);
   jetFinder.jetPtMin = jetPtMin;
   jetFinder.jetPtMax = jetPtMax;
+  std::vector<int> tracks;
+  std::vector<int> cands;
+  std::vector<int> clusters;
+  if (!jetFinder.shareGhostsAcrossRadii) {
+    for (auto R : jetRValues) {
+      jetFinder.jetR = R;
+      std::vector<fastjet::PseudoJet> jets;
+      fastjet::ClusterSequenceArea clusterSeq(jetFinder.findJets(inputParticles, jets));
+      fillJetTables(jets, R, jetAreaFractionMin, collision, jetsTable, constituentsTable, thnSparseJet, fillThnSparse, tracks, clusters, cands, doCandidateJetFinding);
+    }
+    return;
+  }
+
+  std::vector<fastjet::PseudoJet> ghosts;
+  jetFinder.generateGhosts(ghosts);
   for (auto R : jetRValues) {
     jetFinder.jetR = R;
     std::vector<fastjet::PseudoJet> jets;
-    fastjet::ClusterSequenceArea clusterSeq(jetFinder.findJets(inputParticles, jets));
-    for (const auto& jet : jets) {
-      if (jet.has_area() && jet.area() < jetAreaFractionMin * M_PI * R * R) {
-        continue;
-      }
-      if (fillThnSparse) {
-        thnSparseJet->Fill(R, jet.pt(), jet.eta(), jet.phi()); // important for normalisation in V0Jet analyses to store all jets, including those that aren't V0s
-      }
-      bool isCandidateJet = false;
-      if (doCandidateJetFinding) {
-        for (const auto& constituent : jet.constituents()) {
-          auto constituentStatus = constituent.template user_info<fastjetutilities::fastjet_user_info>().getStatus();
-          if (constituentStatus == static_cast<int>(JetConstituentStatus::candidateHF)) { // note currently we cannot run V0 and HF in the same jet. If we ever need to we can seperate the loops
-            isCandidateJet = true;
-            break;
-          }
-        }
-        if (!isCandidateJet) {
-          continue;
-        }
-      }
-      std::vector<int> tracks;
-      std::vector<int> cands;
-      std::vector<int> clusters;
-      jetsTable(collision.globalIndex(), jet.pt(), jet.eta(), jet.phi(),
-                jet.E(), jet.rapidity(), jet.m(), jet.has_area() ? jet.area() : 0., std::round(R * 100));
-      for (const auto& constituent : sorted_by_pt(jet.constituents())) {
-        if (constituent.template user_info<fastjetutilities::fastjet_user_info>().getStatus() == static_cast<int>(JetConstituentStatus::track)) {
-          tracks.push_back(constituent.template user_info<fastjetutilities::fastjet_user_info>().getIndex());
-        }
-        if (constituent.template user_info<fastjetutilities::fastjet_user_info>().getStatus() == static_cast<int>(JetConstituentStatus::cluster)) {
-          clusters.push_back(constituent.template user_info<fastjetutilities::fastjet_user_info>().getIndex());
-        }
-        if (constituent.template user_info<fastjetutilities::fastjet_user_info>().getStatus() == static_cast<int>(JetConstituentStatus::candidateHF)) {
-          cands.push_back(constituent.template user_info<fastjetutilities::fastjet_user_info>().getIndex());
-        }
-      }
-      constituentsTable(jetsTable.lastIndex(), tracks, clusters, cands);
-    }
+    auto clusterSeq = jetFinder.findJets(inputParticles, ghosts, jets);
+    fillJetTables(jets, R, jetAreaFractionMin, collision, jetsTable, constituentsTable, thnSparseJet, fillThnSparse, tracks, clusters, cands, doCandidateJetFinding);
   }
 }
 
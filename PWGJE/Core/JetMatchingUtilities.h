@@ -26,6 +26,8 @@
 #include <optional>
 #include <tuple>
 #include <algorithm>
+#include <cmath>
+#include <cstdint>
 
 #include "Framework/AnalysisTask.h"
 #include "Framework/AnalysisDataModel.h"
@@ -296,68 +298,214 @@ std::tuple<std::vector<int>, std::vector<int>> MatchJetsGeometrically(
   return std::make_tuple(baseToTagMap, tagToBaseMap);
 }
 
-template <typename T, typename U>
-void MatchGeo(T const& jetsBasePerCollision, U const& jetsTagPerCollision, std::vector<std::vector<int>>& baseToTagMatchingGeo, std::vector<std::vector<int>>& tagToBaseMatchingGeo, float maxMatchingDistance)
+/**
+ * Uniform (eta, phi) grid of the jets of one collision, for the geometrical matching.
+ *
+ * The cells are at least as wide as the maximum matching distance, so all the jets within this distance
+ * of a point are in the 3x3 cells around it. Phi is periodic: the cells wrap around 2pi, so the jets
+ * don't need to be duplicated around the boundary. The same grid serves all the jet radii.
+ */
+class JetGeoGrid
 {
-  std::vector<double> jetsR;
-  for (const auto& jetBase : jetsBasePerCollision) {
-    if (std::find(jetsR.begin(), jetsR.end(), std::round(jetBase.r())) == jetsR.end()) {
-      jetsR.push_back(std::round(jetBase.r()));
+ public:
+  /**
+   * Fills the grid with the jets.
+   *
+   * @param jetsEta Jets eta
+   * @param jetsPhi Jets phi
+   * @param cellSize Minimum width of the cells in eta and phi, typically the maximum matching distance.
+   */
+  template <typename T>
+  void build(const std::vector<T>& jetsEta, const std::vector<T>& jetsPhi, double cellSize)
+  {
+    const int nJets = jetsEta.size();
+    mEtaMin = 0.;
+    mNEta = 1;
+    mCellEta = cellSize;
+    if (nJets > 0) {
+      const auto [etaMin, etaMax] = std::minmax_element(jetsEta.begin(), jetsEta.end());
+      mEtaMin = *etaMin;
+      mCellEta = std::max(cellSize, (*etaMax - mEtaMin) / MaxCellsPerAxis);
+      mNEta = static_cast<int>((*etaMax - mEtaMin) / mCellEta) + 1;
     }
-  }
-  for (const auto& jetTag : jetsTagPerCollision) {
-    if (std::find(jetsR.begin(), jetsR.end(), std::round(jetTag.r())) == jetsR.end()) {
-      jetsR.push_back(std::round(jetTag.r()));
+    mNPhi = std::clamp(static_cast<int>(TwoPI / cellSize), 1, MaxCellsPerAxis);
+    mCellPhi = TwoPI / mNPhi;
+
+    // counting sort of the jets in the cells
+    mCellStart.assign(mNEta * mNPhi + 1, 0);
+    mJetCell.resize(nJets);
+    for (int iJet = 0; iJet < nJets; iJet++) {
+      mJetCell[iJet] = getCell(getEtaBin(jetsEta[iJet]), getPhiBin(jetsPhi[iJet]));
+      mCellStart[mJetCell[iJet] + 1]++;
+    }
+    for (int iCell = 0; iCell < mNEta * mNPhi; iCell++) {
+      mCellStart[iCell + 1] += mCellStart[iCell];
+    }
+    mCellJets.resize(nJets);
+    mCellFill.assign(mCellStart.begin(), mCellStart.end() - 1);
+    for (int iJet = 0; iJet < nJets; iJet++) {
+      mCellJets[mCellFill[mJetCell[iJet]]++] = iJet;
     }
   }
-  for (auto jetR : jetsR) {
-    std::vector<double> jetsBasePhi;
-    std::vector<double> jetsBaseEta;
-    std::vector<int> baseToTagMatchingGeoIndex;
-    std::vector<int> tagToBaseMatchingGeoIndex;
 
-    for (const auto& jetBase : jetsBasePerCollision) {
-      if (std::round(jetBase.r()) != std::round(jetR)) {
-        continue;
+  /**
+   * Finds the closest jet of the grid with the given radius.
+   *
+   * @param eta Eta of the point
+   * @param phi Phi of the point
+   * @param jetR Radius of the jets to consider
+   * @param jetsEta Eta of the jets of the grid
+   * @param jetsPhi Phi of the jets of the grid
+   * @param jetsR Radius of the jets of the grid
+   * @param maxMatchingDistance Maximum distance, not larger than the cell size of the grid.
+   *
+   * @returns Index of the closest jet within the maximum distance, -1 if there is none.
+   */
+  template <typename T>
+  int findClosest(T eta, T phi, int jetR, const std::vector<T>& jetsEta, const std::vector<T>& jetsPhi, const std::vector<int>& jetsR, double maxMatchingDistance) const
+  {
+    const int etaBin = getEtaBin(eta);
+    const int phiBin = getPhiBin(phi);
+    int closestJet = -1;
+    double closestDistance = maxMatchingDistance;
+    for (int iEta = std::max(etaBin - 1, 0); iEta <= std::min(etaBin + 1, mNEta - 1); iEta++) {
+      for (int iPhiOffset = (mNPhi < 3 ? 0 : -1); iPhiOffset <= (mNPhi < 3 ? mNPhi - 1 : 1); iPhiOffset++) {
+        const int iCell = getCell(iEta, (phiBin + iPhiOffset + mNPhi) % mNPhi);
+        for (int i = mCellStart[iCell]; i < mCellStart[iCell + 1]; i++) {
+          const int iJet = mCellJets[i];
+          if (jetsR[iJet] != jetR) {
+            continue;
+          }
+          double deltaPhi = std::abs(phi - jetsPhi[iJet]);
+          if (deltaPhi > M_PI) {
+            deltaPhi = TwoPI - deltaPhi;
+          }
+          const double distance = std::sqrt((eta - jetsEta[iJet]) * (eta - jetsEta[iJet]) + deltaPhi * deltaPhi);
+          if (distance < closestDistance || (distance == closestDistance && closestJet >= 0 && iJet < closestJet)) {
+            closestDistance = distance;
+            closestJet = iJet;
+          }
+        }
       }
-      jetsBasePhi.emplace_back(jetBase.phi());
-      jetsBaseEta.emplace_back(jetBase.eta());
     }
-    std::vector<double> jetsTagPhi;
-    std::vector<double> jetsTagEta;
-    for (const auto& jetTag : jetsTagPerCollision) {
-      if (std::round(jetTag.r()) != std::round(jetR)) {
-        continue;
-      }
-      jetsTagPhi.emplace_back(jetTag.phi());
-      jetsTagEta.emplace_back(jetTag.eta());
+    return closestJet;
+  }
+
+ private:
+  static constexpr double TwoPI = 2. * M_PI;
+  static constexpr int MaxCellsPerAxis = 256;
+
+  int getEtaBin(double eta) const { return static_cast<int>(std::floor((eta - mEtaMin) / mCellEta)); }
+  int getPhiBin(double phi) const { return std::clamp(static_cast<int>(std::floor((phi - TwoPI * std::floor(phi / TwoPI)) / mCellPhi)), 0, mNPhi - 1); }
+  int getCell(int etaBin, int phiBin) const { return std::clamp(etaBin, 0, mNEta - 1) * mNPhi + phiBin; }
+
+  double mEtaMin = 0.;
+  double mCellEta = 1.;
+  double mCellPhi = TwoPI;
+  int mNEta = 1;
+  int mNPhi = 1;
+  std::vector<int> mCellStart; // jets of cell i are mCellJets[mCellStart[i]] to mCellJets[mCellStart[i + 1] - 1]
+  std::vector<int> mCellJets;
+  std::vector<int> mJetCell;
+  std::vector<int> mCellFill;
+};
+
+/**
+ * Geometrical jet matching of the jets of one collision, for all jet radii at once.
+ *
+ * Jets are matched only to jets with the same radius, within the provided matching distance, and are required
+ * to match uniquely - namely: base <-> tag. One grid is built per jet collection and serves all radii.
+ *
+ * @param jetsBaseEta Base jet collection eta.
+ * @param jetsBasePhi Base jet collection phi.
+ * @param jetsBaseR Base jet collection radius.
+ * @param jetsTagEta Tag jet collection eta.
+ * @param jetsTagPhi Tag jet collection phi.
+ * @param jetsTagR Tag jet collection radius.
+ * @param maxMatchingDistance Maximum matching distance.
+ * @param baseToTagMap Filled with the index of the matched tag jet of each base jet, -1 if none.
+ * @param tagToBaseMap Filled with the index of the matched base jet of each tag jet, -1 if none.
+ */
+template <typename T>
+void MatchJetsGeometricallyAllRadii(
+  const std::vector<T>& jetsBaseEta,
+  const std::vector<T>& jetsBasePhi,
+  const std::vector<int>& jetsBaseR,
+  const std::vector<T>& jetsTagEta,
+  const std::vector<T>& jetsTagPhi,
+  const std::vector<int>& jetsTagR,
+  double maxMatchingDistance,
+  std::vector<int>& baseToTagMap,
+  std::vector<int>& tagToBaseMap)
+{
+  const std::size_t nJetsBase = jetsBaseEta.size();
+  const std::size_t nJetsTag = jetsTagEta.size();
+  baseToTagMap.assign(nJetsBase, -1);
+  tagToBaseMap.assign(nJetsTag, -1);
+  if (!(nJetsBase && nJetsTag) || maxMatchingDistance <= 0.) {
+    return;
+  }
+
+  JetGeoGrid gridBase, gridTag;
+  gridBase.build(jetsBaseEta, jetsBasePhi, maxMatchingDistance);
+  gridTag.build(jetsTagEta, jetsTagPhi, maxMatchingDistance);
+
+  // Find the base jet closest to each tag jet
+  for (std::size_t iTag = 0; iTag < nJetsTag; iTag++) {
+    tagToBaseMap[iTag] = gridBase.findClosest(jetsTagEta[iTag], jetsTagPhi[iTag], jetsTagR[iTag], jetsBaseEta, jetsBasePhi, jetsBaseR, maxMatchingDistance);
+  }
+  // Keep the base jets whose closest tag jet is the one they are closest to
+  for (std::size_t iBase = 0; iBase < nJetsBase; iBase++) {
+    const int iTag = gridTag.findClosest(jetsBaseEta[iBase], jetsBasePhi[iBase], jetsBaseR[iBase], jetsTagEta, jetsTagPhi, jetsTagR, maxMatchingDistance);
+    if (iTag > -1 && tagToBaseMap[iTag] == static_cast<int>(iBase)) {
+      baseToTagMap[iBase] = iTag;
     }
-    std::tie(baseToTagMatchingGeoIndex, tagToBaseMatchingGeoIndex) = MatchJetsGeometrically(jetsBasePhi, jetsBaseEta, jetsTagPhi, jetsTagEta, maxMatchingDistance); // change max distnace to a function call
-    int jetBaseIndex = 0;
-    for (const auto& jetBase : jetsBasePerCollision) {
-      if (std::round(jetBase.r()) != std::round(jetR)) {
-        continue;
-      }
-      int jetTagIndex = baseToTagMatchingGeoIndex[jetBaseIndex];
-      int jetTagGlobalIndex;
-      if (jetTagIndex > -1 && jetTagIndex < jetsTagPerCollision.size()) {
-        jetTagGlobalIndex = jetsTagPerCollision.iteratorAt(jetTagIndex).globalIndex();
-        baseToTagMatchingGeo[jetBase.globalIndex()].push_back(jetTagGlobalIndex);
-      }
-      jetBaseIndex++;
+  }
+  for (std::size_t iTag = 0; iTag < nJetsTag; iTag++) {
+    if (tagToBaseMap[iTag] > -1 && baseToTagMap[tagToBaseMap[iTag]] != static_cast<int>(iTag)) {
+      tagToBaseMap[iTag] = -1;
     }
-    int jetTagIndex = 0;
-    for (const auto& jetTag : jetsTagPerCollision) {
-      if (std::round(jetTag.r()) != std::round(jetR)) {
-        continue;
-      }
-      int jetBaseIndex = tagToBaseMatchingGeoIndex[jetTagIndex];
-      int jetBaseGlobalIndex;
-      if (jetBaseIndex > -1 && jetBaseIndex < jetsBasePerCollision.size()) {
-        jetBaseGlobalIndex = jetsBasePerCollision.iteratorAt(jetBaseIndex).globalIndex();
-        tagToBaseMatchingGeo[jetTag.globalIndex()].push_back(jetBaseGlobalIndex);
-      }
-      jetTagIndex++;
+  }
+}
+
+template <typename T, typename U>
+void MatchGeo(T const& jetsBasePerCollision, U const& jetsTagPerCollision, std::vector<std::vector<int>>& baseToTagMatchingGeo, std::vector<std::vector<int>>& tagToBaseMatchingGeo, float maxMatchingDistance)
+{
+  // the jet geometry is cached once per collision and jet level, then all radii are matched at once
+  std::vector<double> jetsBaseEta, jetsBasePhi, jetsTagEta, jetsTagPhi;
+  std::vector<int> jetsBaseR, jetsTagR, jetsBaseGlobalIndex, jetsTagGlobalIndex;
+  jetsBaseEta.reserve(jetsBasePerCollision.size());
+  jetsBasePhi.reserve(jetsBasePerCollision.size());
+  jetsBaseR.reserve(jetsBasePerCollision.size());
+  jetsBaseGlobalIndex.reserve(jetsBasePerCollision.size());
+  for (const auto& jetBase : jetsBasePerCollision) {
+    jetsBaseEta.emplace_back(jetBase.eta());
+    jetsBasePhi.emplace_back(jetBase.phi());
+    jetsBaseR.emplace_back(std::round(jetBase.r()));
+    jetsBaseGlobalIndex.emplace_back(jetBase.globalIndex());
+  }
+  jetsTagEta.reserve(jetsTagPerCollision.size());
+  jetsTagPhi.reserve(jetsTagPerCollision.size());
+  jetsTagR.reserve(jetsTagPerCollision.size());
+  jetsTagGlobalIndex.reserve(jetsTagPerCollision.size());
+  for (const auto& jetTag : jetsTagPerCollision) {
+    jetsTagEta.emplace_back(jetTag.eta());
+    jetsTagPhi.emplace_back(jetTag.phi());
+    jetsTagR.emplace_back(std::round(jetTag.r()));
+    jetsTagGlobalIndex.emplace_back(jetTag.globalIndex());
+  }
+
+  std::vector<int> baseToTagMatchingGeoIndex;
+  std::vector<int> tagToBaseMatchingGeoIndex;
+  MatchJetsGeometricallyAllRadii(jetsBaseEta, jetsBasePhi, jetsBaseR, jetsTagEta, jetsTagPhi, jetsTagR, maxMatchingDistance, baseToTagMatchingGeoIndex, tagToBaseMatchingGeoIndex);
+  for (std::size_t iBase = 0; iBase < jetsBaseGlobalIndex.size(); iBase++) {
+    if (baseToTagMatchingGeoIndex[iBase] > -1) {
+      baseToTagMatchingGeo[jetsBaseGlobalIndex[iBase]].push_back(jetsTagGlobalIndex[baseToTagMatchingGeoIndex[iBase]]);
+    }
+  }
+  for (std::size_t iTag = 0; iTag < jetsTagGlobalIndex.size(); iTag++) {
+    if (tagToBaseMatchingGeoIndex[iTag] > -1) {
+      tagToBaseMatchingGeo[jetsTagGlobalIndex[iTag]].push_back(jetsBaseGlobalIndex[tagToBaseMatchingGeoIndex[iTag]]);
     }
   }
 }
@@ -366,28 +514,42 @@ void MatchGeo(T const& jetsBasePerCollision, U const& jetsTagPerCollision, std::
 template <bool jetsBaseIsMc, bool jetsTagIsMc, typename T, typename U, typename V, typename M, typename N, typename O>
 void MatchHF(T const& jetsBasePerCollision, U const& jetsTagPerCollision, std::vector<std::vector<int>>& baseToTagMatchingHF, std::vector<std::vector<int>>& tagToBaseMatchingHF, V const& /*candidatesBase*/, M const& /*candidatesTag*/, N const& tracksBase, O const& tracksTag)
 {
+  // the candidate of each tag jet is identified once, the jet pairs are then compared on the identifiers
+  std::vector<int64_t> candidatesTagId;
+  std::vector<int> jetsTagR, jetsTagGlobalIndex;
+  candidatesTagId.reserve(jetsTagPerCollision.size());
+  jetsTagR.reserve(jetsTagPerCollision.size());
+  jetsTagGlobalIndex.reserve(jetsTagPerCollision.size());
+  for (const auto& jetTag : jetsTagPerCollision) {
+    const auto candidateTag = jetTag.template hfcandidates_first_as<M>();
+    if constexpr (jetsBaseIsMc || jetsTagIsMc) {
+      candidatesTagId.push_back(candidateTag.mcParticleId());
+    } else {
+      candidatesTagId.push_back(candidateTag.globalIndex());
+    }
+    jetsTagR.push_back(std::round(jetTag.r()));
+    jetsTagGlobalIndex.push_back(jetTag.globalIndex());
+  }
+
   for (const auto& jetBase : jetsBasePerCollision) {
     const auto candidateBase = jetBase.template hfcandidates_first_as<V>();
-    for (const auto& jetTag : jetsTagPerCollision) {
-      if (std::round(jetBase.r()) != std::round(jetTag.r())) {
+    int64_t candidateBaseId;
+    if constexpr (jetsBaseIsMc || jetsTagIsMc) {
+      if (!jethfutilities::isMatchedHFCandidate(candidateBase)) {
         continue;
       }
-      if constexpr (jetsBaseIsMc || jetsTagIsMc) {
-        if (jethfutilities::isMatchedHFCandidate(candidateBase)) {
-          const auto candidateBaseMcId = jethfutilities::matchedParticleId(candidateBase, tracksBase, tracksTag);
-          const auto candidateTag = jetTag.template hfcandidates_first_as<M>();
-          const auto candidateTagId = candidateTag.mcParticleId();
-          if (candidateBaseMcId == candidateTagId) {
-            baseToTagMatchingHF[jetBase.globalIndex()].push_back(jetTag.globalIndex());
-            tagToBaseMatchingHF[jetTag.globalIndex()].push_back(jetBase.globalIndex());
-          }
-        }
-      } else {
-        const auto candidateTag = jetTag.template hfcandidates_first_as<M>();
-        if (candidateBase.globalIndex() == candidateTag.globalIndex()) {
-          baseToTagMatchingHF[jetBase.globalIndex()].push_back(jetTag.globalIndex());
-          tagToBaseMatchingHF[jetTag.globalIndex()].push_back(jetBase.globalIndex());
-        }
+      candidateBaseId = jethfutilities::matchedParticleId(candidateBase, tracksBase, tracksTag);
+    } else {
+      candidateBaseId = candidateBase.globalIndex();
+    }
+    const int jetBaseR = std::round(jetBase.r());
+    for (std::size_t iTag = 0; iTag < candidatesTagId.size(); iTag++) {
+      if (jetBaseR != jetsTagR[iTag]) {
+        continue;
+      }
+      if (candidateBaseId == candidatesTagId[iTag]) {
+        baseToTagMatchingHF[jetBase.globalIndex()].push_back(jetsTagGlobalIndex[iTag]);
+        tagToBaseMatchingHF[jetsTagGlobalIndex[iTag]].push_back(jetBase.globalIndex());
       }
     }
   }
@@ -480,28 +642,106 @@ auto getConstituents(T const& jet, U const& /*constituents*/)
   }
 }
 
+/**
+ * Constituents of the jets of one collision, cached once for the pt matching of all the jet pairs.
+ *
+ * The constituents of jet i are at positions offsets[i] to offsets[i + 1] - 1, their identifiers are also
+ * stored sorted within each jet to look them up by binary search.
+ */
+struct JetConstituentCache {
+  std::vector<int> offsets;
+  std::vector<int64_t> ids;
+  std::vector<float> pts;
+  std::vector<int64_t> sortedIds;
+  std::vector<int> jetsR;
+  std::vector<float> jetsPt;
+  std::vector<int> jetsGlobalIndex;
+
+  /// Fills the cache, the identifiers of the constituents are those used to compare with the other jet level
+  template <bool otherIsMc, typename T, typename U>
+  void fill(T const& jets, U const& tracks)
+  {
+    offsets.assign(1, 0);
+    ids.clear();
+    pts.clear();
+    jetsR.clear();
+    jetsPt.clear();
+    jetsGlobalIndex.clear();
+    for (const auto& jet : jets) {
+      for (const auto& track : getConstituents(jet, tracks)) {
+        ids.push_back(getConstituentId<otherIsMc>(track));
+        pts.push_back(track.pt());
+      }
+      offsets.push_back(ids.size());
+      jetsR.push_back(std::round(jet.r()));
+      jetsPt.push_back(jet.pt());
+      jetsGlobalIndex.push_back(jet.globalIndex());
+    }
+    sortedIds = ids;
+    for (std::size_t iJet = 0; iJet + 1 < offsets.size(); iJet++) {
+      std::sort(sortedIds.begin() + offsets[iJet], sortedIds.begin() + offsets[iJet + 1]);
+    }
+  }
+
+  /// Sum of the pt of the constituents of a jet which are also constituents of a jet of the other level, in the order of the constituents
+  float getPtSumShared(int iJet, JetConstituentCache const& other, int iOtherJet) const
+  {
+    const auto otherBegin = other.sortedIds.begin() + other.offsets[iOtherJet];
+    const auto otherEnd = other.sortedIds.begin() + other.offsets[iOtherJet + 1];
+    float ptSum = 0.;
+    for (int i = offsets[iJet]; i < offsets[iJet + 1]; i++) {
+      if (ids[i] != -1 && std::binary_search(otherBegin, otherEnd, ids[i])) {
+        ptSum += pts[i];
+      }
+    }
+    return ptSum;
+  }
+};
+
 template <bool jetsBaseIsMc, bool jetsTagIsMc, typename T, typename U, typename V, typename M, typename N, typename O>
 void MatchPt(T const& jetsBasePerCollision, U const& jetsTagPerCollision, std::vector<std::vector<int>>& baseToTagMatchingPt, std::vector<std::vector<int>>& tagToBaseMatchingPt, V const& tracksBase, M const& clustersBase, N const& tracksTag, O const& clustersTag, float minPtFraction)
 {
   float ptSumBase;
   float ptSumTag;
-  for (const auto& jetBase : jetsBasePerCollision) {
-    auto jetBaseTracks = getConstituents(jetBase, tracksBase);
-    auto jetBaseClusters = getConstituents(jetBase, clustersBase);
-    for (const auto& jetTag : jetsTagPerCollision) {
-      if (std::round(jetBase.r()) != std::round(jetTag.r())) {
-        continue;
+  if constexpr (!jetfindingutilities::isEMCALTable<M>() && !jetfindingutilities::isEMCALTable<O>()) {
+    // track-only jets: the constituents of each jet are read once, instead of once per jet pair
+    JetConstituentCache constituentsBase, constituentsTag;
+    constituentsBase.fill<jetsTagIsMc>(jetsBasePerCollision, tracksBase);
+    constituentsTag.fill<jetsBaseIsMc>(jetsTagPerCollision, tracksTag);
+    for (std::size_t iBase = 0; iBase < constituentsBase.jetsR.size(); iBase++) {
+      for (std::size_t iTag = 0; iTag < constituentsTag.jetsR.size(); iTag++) {
+        if (constituentsBase.jetsR[iBase] != constituentsTag.jetsR[iTag]) {
+          continue;
+        }
+        ptSumBase = constituentsBase.getPtSumShared(iBase, constituentsTag, iTag);
+        ptSumTag = constituentsTag.getPtSumShared(iTag, constituentsBase, iBase);
+        if (ptSumBase > constituentsBase.jetsPt[iBase] * minPtFraction) {
+          baseToTagMatchingPt[constituentsBase.jetsGlobalIndex[iBase]].push_back(constituentsTag.jetsGlobalIndex[iTag]);
+        }
+        if (ptSumTag > constituentsTag.jetsPt[iTag] * minPtFraction) {
+          tagToBaseMatchingPt[constituentsTag.jetsGlobalIndex[iTag]].push_back(constituentsBase.jetsGlobalIndex[iBase]);
+        }
       }
-      auto jetTagTracks = getConstituents(jetTag, tracksTag);
-      auto jetTagClusters = getConstituents(jetTag, clustersTag);
+    }
+  } else {
+    for (const auto& jetBase : jetsBasePerCollision) {
+      auto jetBaseTracks = getConstituents(jetBase, tracksBase);
+      auto jetBaseClusters = getConstituents(jetBase, clustersBase);
+      for (const auto& jetTag : jetsTagPerCollision) {
+        if (std::round(jetBase.r()) != std::round(jetTag.r())) {
+          continue;
+        }
+        auto jetTagTracks = getConstituents(jetTag, tracksTag);
+        auto jetTagClusters = getConstituents(jetTag, clustersTag);
 
-      ptSumBase = getPtSum < jetfindingutilities::isEMCALTable<M>() || jetfindingutilities::isEMCALTable<O>(), jetsBaseIsMc, jetsTagIsMc > (jetBaseTracks, jetBaseClusters, jetTagTracks, jetTagClusters);
-      ptSumTag = getPtSum < jetfindingutilities::isEMCALTable<M>() || jetfindingutilities::isEMCALTable<O>(), jetsTagIsMc, jetsBaseIsMc > (jetTagTracks, jetTagClusters, jetBaseTracks, jetBaseClusters);
-      if (ptSumBase > jetBase.pt() * minPtFraction) {
-        baseToTagMatchingPt[jetBase.globalIndex()].push_back(jetTag.globalIndex());
-      }
-      if (ptSumTag > jetTag.pt() * minPtFraction) {
-        tagToBaseMatchingPt[jetTag.globalIndex()].push_back(jetBase.globalIndex());
+        ptSumBase = getPtSum < jetfindingutilities::isEMCALTable<M>() || jetfindingutilities::isEMCALTable<O>(), jetsBaseIsMc, jetsTagIsMc > (jetBaseTracks, jetBaseClusters, jetTagTracks, jetTagClusters);
+        ptSumTag = getPtSum < jetfindingutilities::isEMCALTable<M>() || jetfindingutilities::isEMCALTable<O>(), jetsTagIsMc, jetsBaseIsMc > (jetTagTracks, jetTagClusters, jetBaseTracks, jetBaseClusters);
+        if (ptSumBase > jetBase.pt() * minPtFraction) {
+          baseToTagMatchingPt[jetBase.globalIndex()].push_back(jetTag.globalIndex());
+        }
+        if (ptSumTag > jetTag.pt() * minPtFraction) {
+          tagToBaseMatchingPt[jetTag.globalIndex()].push_back(jetBase.globalIndex());
+        }
       }
     }
   }
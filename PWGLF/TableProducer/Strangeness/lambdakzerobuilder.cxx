@@ -42,6 +42,10 @@
 #include <map>
 #include <iterator>
 #include <utility>
+#include <algorithm>
+#include <span>
+#include <memory>
+#include <vector>
 
 #include "TRandom3.h"
 #include "Framework/runDataProcessing.h"
@@ -53,6 +57,7 @@
 #include "ReconstructionDataFormats/Track.h"
 #include "Common/Core/RecoDecay.h"
 #include "Common/Core/trackUtilities.h"
+#include "Common/Core/WorkerPool.h"
 #include "PWGLF/DataModel/LFStrangenessTables.h"
 #include "PWGLF/DataModel/LFStrangenessMLTables.h"
 #include "PWGLF/DataModel/LFParticleIdentification.h"
@@ -206,6 +211,13 @@ struct lambdakzeroBuilder {
     Configurable<int> rejDiffCollTracks{"dcaFitterConfigurations.rejDiffCollTracks", 0, "rejDiffCollTracks"};
   } dcaFitterConfigurations;
 
+  // Parallel building: the V0s are fitted in chunks by several threads, each with its own fitter,
+  // and written out in the original order
+  struct : ConfigurableGroup {
+    Configurable<int> nThreads{"parallelConfigurations.nThreads", 1, "Number of threads fitting the V0s (1: serial)"};
+    Configurable<int> chunkSize{"parallelConfigurations.chunkSize", 2048, "Number of V0s fitted before being written out"};
+  } parallelConfigurations;
+
   // CCDB options
   struct : ConfigurableGroup {
     Configurable<std::string> ccdburl{"ccdbConfigurations.ccdb-url", "http://alice-ccdb.cern.ch", "url of the ccdb repository"};
@@ -281,8 +293,10 @@ struct lambdakzeroBuilder {
   o2::base::MatLayerCylSet* lut = nullptr;
   o2::dataformats::MeanVertexObject* mVtx = nullptr;
 
-  // Define o2 fitter, 2-prong, active memory (no need to redefine per event)
-  o2::vertexing::DCAFitterN<2> fitter;
+  // Define o2 fitters, 2-prong, active memory (no need to redefine per event)
+  // one fitter per thread of the parallel building
+  std::vector<o2::vertexing::DCAFitterN<2>> fitters;
+  std::unique_ptr<o2::common::core::WorkerPool> fitWorkers; // only with more than one thread
 
   // provision to repeat mass selections while doing AND with PID selections
   // fixme : this could be done more uniformly svertexer with reconstruction
@@ -315,7 +329,7 @@ struct lambdakzeroBuilder {
                 kNV0Steps };
 
   // Helper struct to pass V0 information
-  struct {
+  struct V0Candidate {
     float posTrackX;
     float negTrackX;
     std::array<float, 3> pos;
@@ -332,7 +346,46 @@ struct lambdakzeroBuilder {
     float k0ShortMass;
     float lambdaMass;
     float antiLambdaMass;
-  } v0candidate;
+  };
+
+  // Helper struct with the inputs and the results of the fit of one V0
+  struct V0FitSlot {
+    // inputs, copied from the tables
+    std::array<float, 3> primaryVertex;
+    bool hasCollision;
+    bool passesTPCrefit;
+    bool isCollinear;
+    bool dEdxK0Short;
+    bool dEdxLambda;
+    bool dEdxAntiLambda;
+    o2::track::TrackParCov posTrackIU;
+    o2::track::TrackParCov negTrackIU;
+
+    // results of the fit
+    int nStepsPassed;     // number of v0step selections passed
+    bool caughtException; // exception in the DCA fitter
+    bool isSelected;
+    V0Candidate candidate;
+    o2::track::TrackParCov posTrack; // at the PCA
+    o2::track::TrackParCov negTrack; // at the PCA
+    o2::track::TrackPar posTrackPar; // at the DCA to the PV
+    o2::track::TrackPar negTrackPar; // at the DCA to the PV
+    gpu::gpustd::array<float, 2> dcaInfo;
+    double chi2AtPCA;
+    std::array<float, 6> positionCovariance;
+
+    // filled while writing out
+    int ivanovMap;
+    int mlRow;
+  };
+
+  // buffers of the chunk being built, allocated once
+  std::vector<V0FitSlot> v0FitSlots;
+  static constexpr int nMLInputFeatures = 8;
+  std::vector<float> mlInputFeatures;
+  std::vector<float> mlOutputValues;
+  std::vector<float> mlLambdaScores;
+  std::vector<float> mlGammaScores;
 
   // Helper struct to do bookkeeping of building parameters
   struct {
@@ -397,7 +450,7 @@ struct lambdakzeroBuilder {
     return step * static_cast<float>(static_cast<int>((number) / step)) + TMath::Sign(1.0f, number) * (0.5f) * step;
   }
 
-  void roundV0CandidateVariables()
+  void roundV0CandidateVariables(V0Candidate& v0candidate)
   {
     v0candidate.dcaV0dau = roundToPrecision(v0candidate.dcaV0dau, precisionDCAs);
     v0candidate.posDCAxy = roundToPrecision(v0candidate.posDCAxy, precisionDCAs);
@@ -435,11 +488,6 @@ struct lambdakzeroBuilder {
     }
   }
 
-  o2::track::TrackParCov lPositiveTrack;
-  o2::track::TrackParCov lNegativeTrack;
-  o2::track::TrackParCov lPositiveTrackIU;
-  o2::track::TrackParCov lNegativeTrackIU;
-
   void init(InitContext& context)
   {
     prng.SetSeed(0);
@@ -661,24 +709,37 @@ struct lambdakzeroBuilder {
     }
     //*+-+*+-+*+-+*+-+*+-+*+-+*+-+*+-+*+-+*+-+*+-+*+-+*+-+*+-+*
 
-    // initialize O2 2-prong fitter (only once)
-    fitter.setPropagateToPCA(true);
-    fitter.setMaxR(200.);
-    fitter.setMinParamChange(1e-3);
-    fitter.setMinRelChi2Change(0.9);
-    fitter.setMaxDZIni(dcaFitterConfigurations.d_maxDZIni);
-    fitter.setMaxDXYIni(dcaFitterConfigurations.d_maxDXYIni);
-    fitter.setMaxChi2(1e9);
-    fitter.setUseAbsDCA(dcaFitterConfigurations.d_UseAbsDCA);
-    fitter.setWeightedFinalPCA(dcaFitterConfigurations.d_UseWeightedPCA);
-
     // Material correction in the DCA fitter
     o2::base::Propagator::MatCorrType matCorr = o2::base::Propagator::MatCorrType::USEMatCorrNONE;
     if (dcaFitterConfigurations.useMatCorrType == 1)
       matCorr = o2::base::Propagator::MatCorrType::USEMatCorrTGeo;
     if (dcaFitterConfigurations.useMatCorrType == 2)
       matCorr = o2::base::Propagator::MatCorrType::USEMatCorrLUT;
-    fitter.setMatCorrType(matCorr);
+
+    // the TGeo navigation of the material corrections is not thread-safe
+    if (parallelConfigurations.nThreads > 1 && dcaFitterConfigurations.useMatCorrType == 1) {
+      LOGF(fatal, "The V0s cannot be fitted with %d threads with the TGeo material correction. Please use the LUT or a single thread.", parallelConfigurations.nThreads.value);
+    }
+
+    // initialize O2 2-prong fitters (only once), one per thread
+    fitters.resize(std::max(parallelConfigurations.nThreads.value, 1));
+    for (auto& fitter : fitters) {
+      fitter.setPropagateToPCA(true);
+      fitter.setMaxR(200.);
+      fitter.setMinParamChange(1e-3);
+      fitter.setMinRelChi2Change(0.9);
+      fitter.setMaxDZIni(dcaFitterConfigurations.d_maxDZIni);
+      fitter.setMaxDXYIni(dcaFitterConfigurations.d_maxDXYIni);
+      fitter.setMaxChi2(1e9);
+      fitter.setUseAbsDCA(dcaFitterConfigurations.d_UseAbsDCA);
+      fitter.setWeightedFinalPCA(dcaFitterConfigurations.d_UseWeightedPCA);
+      fitter.setMatCorrType(matCorr);
+    }
+    if (fitters.size() > 1) {
+      LOGF(info, " ---+*> Will fit the V0s with %d threads", static_cast<int>(fitters.size()));
+      fitWorkers = std::make_unique<o2::common::core::WorkerPool>(fitters.size());
+    }
+    v0FitSlots.resize(std::max(parallelConfigurations.chunkSize.value, 1));
   }
 
   void initCCDB(aod::BCsWithTimestamps::iterator const& bc)
@@ -701,7 +762,9 @@ struct lambdakzeroBuilder {
     // In case override, don't proceed, please - no CCDB access required
     if (dcaFitterConfigurations.d_bz_input > -990) {
       d_bz = dcaFitterConfigurations.d_bz_input;
-      fitter.setBz(d_bz);
+      for (auto& fitter : fitters) {
+        fitter.setBz(d_bz);
+      }
       o2::parameters::GRPMagField grpmag;
       if (fabs(d_bz) > 1e-5) {
         grpmag.setL3Current(30000.f / (d_bz / 5.0f));
@@ -734,7 +797,9 @@ struct lambdakzeroBuilder {
     mVtx = ccdb->getForTimeStamp<o2::dataformats::MeanVertexObject>(ccdbConfigurations.mVtxPath, bc.timestamp());
     mRunNumber = bc.runNumber();
     // Set magnetic field value once known
-    fitter.setBz(d_bz);
+    for (auto& fitter : fitters) {
+      fitter.setBz(d_bz);
+    }
 
     if (dcaFitterConfigurations.useMatCorrType == 2) {
       // setMatLUT only after magfield has been initalized
@@ -798,55 +863,67 @@ struct lambdakzeroBuilder {
     LOG(info) << "ML Models loaded.";
   }
 
+  // copies the inputs of the fit of a V0 from the tables, to be called serially
   template <class TTrackTo, typename TV0Object>
-  bool buildV0Candidate(TV0Object const& V0)
+  void prepareV0Candidate(TV0Object const& V0, V0FitSlot& slot)
   {
     // Get tracks
     auto const& posTrack = V0.template posTrack_as<TTrackTo>();
     auto const& negTrack = V0.template negTrack_as<TTrackTo>();
 
     // for storing whatever is the relevant quantity for the PV
-    o2::dataformats::VertexBase primaryVertex;
-    if (V0.has_collision()) {
+    slot.hasCollision = V0.has_collision();
+    if (slot.hasCollision) {
       auto const& collision = V0.collision();
-      primaryVertex.setPos({collision.posX(), collision.posY(), collision.posZ()});
-      primaryVertex.setCov(collision.covXX(), collision.covXY(), collision.covYY(), collision.covXZ(), collision.covYZ(), collision.covZZ());
+      slot.primaryVertex = {collision.posX(), collision.posY(), collision.posZ()};
     } else {
-      primaryVertex.setPos({mVtx->getX(), mVtx->getY(), mVtx->getZ()});
+      slot.primaryVertex = {mVtx->getX(), mVtx->getY(), mVtx->getZ()};
     }
 
-    // value 0.5: any considered V0
-    statisticsRegistry.v0stats[kV0All]++;
-    if (!V0.has_collision())
-      statisticsRegistry.v0statsUnassociated[kV0All]++;
-
+    slot.passesTPCrefit = true;
     if (tpcrefit) {
-      if (!(posTrack.trackType() & o2::aod::track::TPCrefit)) {
-        return false;
-      }
-      if (!(negTrack.trackType() & o2::aod::track::TPCrefit)) {
-        return false;
-      }
+      slot.passesTPCrefit = (posTrack.trackType() & o2::aod::track::TPCrefit) && (negTrack.trackType() & o2::aod::track::TPCrefit);
+    }
+    slot.isCollinear = dcaFitterConfigurations.d_UseCollinearFit || V0.isCollinearV0();
+
+    // check if user requested to correlate mass requirement with TPC PID
+    // (useful for data volume reduction)
+    slot.dEdxK0Short = V0.isdEdxK0Short() || !massWindowWithTPCPID;
+    slot.dEdxLambda = V0.isdEdxLambda() || !massWindowWithTPCPID;
+    slot.dEdxAntiLambda = V0.isdEdxAntiLambda() || !massWindowWithTPCPID;
+
+    slot.posTrackIU = getTrackParCov(posTrack);
+    slot.negTrackIU = getTrackParCov(negTrack);
+  }
+
+  // fits a prepared V0 and applies the candidate selections
+  // only the slot and the fitter are modified: different slots can be fitted concurrently, each thread with its own fitter
+  void fitV0Candidate(V0FitSlot& slot, o2::vertexing::DCAFitterN<2>& fitter)
+  {
+    auto& v0candidate = slot.candidate;
+    slot.caughtException = false;
+    slot.isSelected = false;
+
+    // value 0.5: any considered V0
+    slot.nStepsPassed = kV0All + 1;
+    if (!slot.passesTPCrefit) {
+      return;
     }
 
     // Passes TPC refit
-    statisticsRegistry.v0stats[kV0TPCrefit]++;
-    if (!V0.has_collision())
-      statisticsRegistry.v0statsUnassociated[kV0TPCrefit]++;
+    slot.nStepsPassed = kV0TPCrefit + 1;
 
     // Calculate DCA with respect to the collision associated to the V0, not individual tracks
-    gpu::gpustd::array<float, 2> dcaInfo;
+    slot.posTrackPar = slot.posTrackIU;
+    o2::base::Propagator::Instance()->propagateToDCABxByBz({slot.primaryVertex[0], slot.primaryVertex[1], slot.primaryVertex[2]}, slot.posTrackPar, 2.f, fitter.getMatCorrType(), &slot.dcaInfo);
+    auto posTrackdcaXY = slot.dcaInfo[0];
 
-    auto posTrackPar = getTrackPar(posTrack);
-    o2::base::Propagator::Instance()->propagateToDCABxByBz({primaryVertex.getX(), primaryVertex.getY(), primaryVertex.getZ()}, posTrackPar, 2.f, fitter.getMatCorrType(), &dcaInfo);
-    auto posTrackdcaXY = dcaInfo[0];
-
-    auto negTrackPar = getTrackPar(negTrack);
-    o2::base::Propagator::Instance()->propagateToDCABxByBz({primaryVertex.getX(), primaryVertex.getY(), primaryVertex.getZ()}, negTrackPar, 2.f, fitter.getMatCorrType(), &dcaInfo);
-    auto negTrackdcaXY = dcaInfo[0];
+    slot.negTrackPar = slot.negTrackIU;
+    o2::base::Propagator::Instance()->propagateToDCABxByBz({slot.primaryVertex[0], slot.primaryVertex[1], slot.primaryVertex[2]}, slot.negTrackPar, 2.f, fitter.getMatCorrType(), &slot.dcaInfo);
+    auto negTrackdcaXY = slot.dcaInfo[0];
 
     if (fabs(posTrackdcaXY) < dcapostopv || fabs(negTrackdcaXY) < dcanegtopv) {
-      return false;
+      return;
     }
 
     // Initialize properly, please
@@ -854,40 +931,35 @@ struct lambdakzeroBuilder {
     v0candidate.negDCAxy = negTrackdcaXY;
 
     // passes DCAxy
-    statisticsRegistry.v0stats[kV0DCAxy]++;
-    if (!V0.has_collision())
-      statisticsRegistry.v0statsUnassociated[kV0DCAxy]++;
+    slot.nStepsPassed = kV0DCAxy + 1;
 
     // Change strangenessBuilder tracks
-    lPositiveTrack = getTrackParCov(posTrack);
-    lNegativeTrack = getTrackParCov(negTrack);
-    lPositiveTrackIU = getTrackParCov(posTrack);
-    lNegativeTrackIU = getTrackParCov(negTrack);
+    slot.posTrack = slot.posTrackIU;
+    slot.negTrack = slot.negTrackIU;
 
     //---/---/---/
     // Move close to minima
     int nCand = 0;
-    fitter.setCollinear(dcaFitterConfigurations.d_UseCollinearFit || V0.isCollinearV0());
+    fitter.setCollinear(slot.isCollinear);
     try {
-      nCand = fitter.process(lPositiveTrack, lNegativeTrack);
+      nCand = fitter.process(slot.posTrack, slot.negTrack);
     } catch (...) {
-      statisticsRegistry.exceptions++;
-      LOG(error) << "Exception caught in DCA fitter process call!";
-      return false;
+      slot.caughtException = true; // reported when the V0 is counted
+      return;
     }
     if (nCand == 0) {
-      return false;
+      return;
     }
 
     v0candidate.posTrackX = fitter.getTrack(0).getX();
     v0candidate.negTrackX = fitter.getTrack(1).getX();
 
-    lPositiveTrack = fitter.getTrack(0);
-    lNegativeTrack = fitter.getTrack(1);
-    lPositiveTrack.getPxPyPzGlo(v0candidate.posP);
-    lNegativeTrack.getPxPyPzGlo(v0candidate.negP);
-    lPositiveTrack.getXYZGlo(v0candidate.posPosition);
-    lNegativeTrack.getXYZGlo(v0candidate.negPosition);
+    slot.posTrack = fitter.getTrack(0);
+    slot.negTrack = fitter.getTrack(1);
+    slot.posTrack.getPxPyPzGlo(v0candidate.posP);
+    slot.negTrack.getPxPyPzGlo(v0candidate.negP);
+    slot.posTrack.getXYZGlo(v0candidate.posPosition);
+    slot.negTrack.getXYZGlo(v0candidate.negPosition);
 
     // get decay vertex coordinates
     const auto& vtx = fitter.getPCACandidate();
@@ -895,21 +967,20 @@ struct lambdakzeroBuilder {
       v0candidate.pos[i] = vtx[i];
     }
 
+    slot.chi2AtPCA = fitter.getChi2AtPCACandidate();
     v0candidate.dcaV0dau = TMath::Sqrt(fitter.getChi2AtPCACandidate());
 
     // Apply selections so a skimmed table is created only
     if (v0candidate.dcaV0dau > dcav0dau) {
-      return false;
+      return;
     }
 
     // Passes DCA between daughters check
-    statisticsRegistry.v0stats[kV0DCADau]++;
-    if (!V0.has_collision())
-      statisticsRegistry.v0statsUnassociated[kV0DCADau]++;
+    slot.nStepsPassed = kV0DCADau + 1;
 
-    v0candidate.cosPA = RecoDecay::cpa(array{primaryVertex.getX(), primaryVertex.getY(), primaryVertex.getZ()}, array{v0candidate.pos[0], v0candidate.pos[1], v0candidate.pos[2]}, array{v0candidate.posP[0] + v0candidate.negP[0], v0candidate.posP[1] + v0candidate.negP[1], v0candidate.posP[2] + v0candidate.negP[2]});
+    v0candidate.cosPA = RecoDecay::cpa(array{slot.primaryVertex[0], slot.primaryVertex[1], slot.primaryVertex[2]}, array{v0candidate.pos[0], v0candidate.pos[1], v0candidate.pos[2]}, array{v0candidate.posP[0] + v0candidate.negP[0], v0candidate.posP[1] + v0candidate.negP[1], v0candidate.posP[2] + v0candidate.negP[2]});
     if (v0candidate.cosPA < v0cospa) {
-      return false;
+      return;
     }
 
     v0candidate.dcav0topv = CalculateDCAStraightToPV(
@@ -917,40 +988,33 @@ struct lambdakzeroBuilder {
       v0candidate.posP[0] + v0candidate.negP[0],
       v0candidate.posP[1] + v0candidate.negP[1],
       v0candidate.posP[2] + v0candidate.negP[2],
-      primaryVertex.getX(), primaryVertex.getY(), primaryVertex.getZ());
+      slot.primaryVertex[0], slot.primaryVertex[1], slot.primaryVertex[2]);
 
     // Passes CosPA check
-    statisticsRegistry.v0stats[kV0CosPA]++;
-    if (!V0.has_collision())
-      statisticsRegistry.v0statsUnassociated[kV0CosPA]++;
+    slot.nStepsPassed = kV0CosPA + 1;
 
     v0candidate.V0radius = RecoDecay::sqrtSumOfSquares(v0candidate.pos[0], v0candidate.pos[1]);
     if (v0candidate.V0radius < v0radius) {
-      return false;
+      return;
     }
 
     // Passes radius check
-    statisticsRegistry.v0stats[kV0Radius]++;
-    if (!V0.has_collision())
-      statisticsRegistry.v0statsUnassociated[kV0Radius]++;
+    slot.nStepsPassed = kV0Radius + 1;
     // Return OK: passed all v0 candidate selecton criteria
 
-    auto px = v0candidate.posP[0] + v0candidate.negP[0];
-    auto py = v0candidate.posP[1] + v0candidate.negP[1];
-    auto pz = v0candidate.posP[2] + v0candidate.negP[2];
     auto lPt = RecoDecay::sqrtSumOfSquares(v0candidate.posP[0] + v0candidate.negP[0], v0candidate.posP[1] + v0candidate.negP[1]);
     auto lPtotal = RecoDecay::sqrtSumOfSquares(lPt, v0candidate.posP[2] + v0candidate.negP[2]);
-    auto lLengthTraveled = RecoDecay::sqrtSumOfSquares(v0candidate.pos[0] - primaryVertex.getX(), v0candidate.pos[1] - primaryVertex.getY(), v0candidate.pos[2] - primaryVertex.getZ());
+    auto lLengthTraveled = RecoDecay::sqrtSumOfSquares(v0candidate.pos[0] - slot.primaryVertex[0], v0candidate.pos[1] - slot.primaryVertex[1], v0candidate.pos[2] - slot.primaryVertex[2]);
 
     // Momentum range check
     if (lPt < minimumPt || lPt > maximumPt) {
-      return false; // reject if not within desired window
+      return; // reject if not within desired window
     }
 
     // Daughter eta check
     if (TMath::Abs(RecoDecay::eta(std::array{v0candidate.posP[0], v0candidate.posP[1], v0candidate.posP[2]})) > maxDaughterEta ||
         TMath::Abs(RecoDecay::eta(std::array{v0candidate.negP[0], v0candidate.negP[1], v0candidate.negP[2]})) > maxDaughterEta) {
-      return false; // reject - daughters have too large eta to be reliable for MC corrections
+      return; // reject - daughters have too large eta to be reliable for MC corrections
     }
 
     // calculate proper lifetime
@@ -959,17 +1023,12 @@ struct lambdakzeroBuilder {
     float lML2P_Lambda = o2::constants::physics::MassLambda * lLengthTraveled / lPtotal;
 
     // Passes momentum window check
-    statisticsRegistry.v0stats[kWithinMomentumRange]++;
-    if (!V0.has_collision())
-      statisticsRegistry.v0statsUnassociated[kWithinMomentumRange]++;
+    slot.nStepsPassed = kWithinMomentumRange + 1;
 
     // Calculate masses
-    auto lGammaMass = RecoDecay::m(array{array{v0candidate.posP[0], v0candidate.posP[1], v0candidate.posP[2]}, array{v0candidate.negP[0], v0candidate.negP[1], v0candidate.negP[2]}}, array{o2::constants::physics::MassElectron, o2::constants::physics::MassElectron});
     v0candidate.k0ShortMass = RecoDecay::m(array{array{v0candidate.posP[0], v0candidate.posP[1], v0candidate.posP[2]}, array{v0candidate.negP[0], v0candidate.negP[1], v0candidate.negP[2]}}, array{o2::constants::physics::MassPionCharged, o2::constants::physics::MassPionCharged});
     v0candidate.lambdaMass = RecoDecay::m(array{array{v0candidate.posP[0], v0candidate.posP[1], v0candidate.posP[2]}, array{v0candidate.negP[0], v0candidate.negP[1], v0candidate.negP[2]}}, array{o2::constants::physics::MassProton, o2::constants::physics::MassPionCharged});
     v0candidate.antiLambdaMass = RecoDecay::m(array{array{v0candidate.posP[0], v0candidate.posP[1], v0candidate.posP[2]}, array{v0candidate.negP[0], v0candidate.negP[1], v0candidate.negP[2]}}, array{o2::constants::physics::MassPionCharged, o2::constants::physics::MassProton});
-    auto lHypertritonMass = RecoDecay::m(array{array{2.0f * v0candidate.posP[0], 2.0f * v0candidate.posP[1], 2.0f * v0candidate.posP[2]}, array{v0candidate.negP[0], v0candidate.negP[1], v0candidate.negP[2]}}, array{o2::constants::physics::MassHelium3, o2::constants::physics::MassPionCharged});
-    auto lAntiHypertritonMass = RecoDecay::m(array{array{v0candidate.posP[0], v0candidate.posP[1], v0candidate.posP[2]}, array{2.0f * v0candidate.negP[0], 2.0f * v0candidate.negP[1], 2.0f * v0candidate.negP[2]}}, array{o2::constants::physics::MassPionCharged, o2::constants::physics::MassHelium3});
 
     // mass window check
     bool keepCandidate = false;
@@ -988,25 +1047,55 @@ struct lambdakzeroBuilder {
       desiredMassAntiLambda = TMath::Abs(v0candidate.antiLambdaMass - o2::constants::physics::MassLambda) < massWindownumberOfSigmas * getMassSigmaLambda(lPt) + massWindowSafetyMargin;
     }
 
-    // check if user requested to correlate mass requirement with TPC PID
-    // (useful for data volume reduction)
-    bool dEdxK0Short = V0.isdEdxK0Short() || !massWindowWithTPCPID;
-    bool dEdxLambda = V0.isdEdxLambda() || !massWindowWithTPCPID;
-    bool dEdxAntiLambda = V0.isdEdxAntiLambda() || !massWindowWithTPCPID;
-
     // check proper lifetime if asked for
     bool passML2P_K0Short = lML2P_K0Short < lifetimecut->get("lifetimecutK0S") || lifetimecut->get("lifetimecutK0S") > 1000;
     bool passML2P_Lambda = lML2P_Lambda < lifetimecut->get("lifetimecutLambda") || lifetimecut->get("lifetimecutLambda") > 1000;
 
-    if (passML2P_K0Short && dEdxK0Short && desiredMassK0Short)
+    if (passML2P_K0Short && slot.dEdxK0Short && desiredMassK0Short)
       keepCandidate = true;
-    if (passML2P_Lambda && dEdxLambda && desiredMassLambda)
+    if (passML2P_Lambda && slot.dEdxLambda && desiredMassLambda)
       keepCandidate = true;
-    if (passML2P_Lambda && dEdxAntiLambda && desiredMassAntiLambda)
+    if (passML2P_Lambda && slot.dEdxAntiLambda && desiredMassAntiLambda)
       keepCandidate = true;
 
     if (!keepCandidate)
-      return false;
+      return;
+
+    slot.isSelected = true;
+
+    // position covariance, needs the state of the fitter
+    if (createV0CovMats) {
+      auto covVtxV = fitter.calcPCACovMatrix(0);
+      slot.positionCovariance[0] = covVtxV(0, 0);
+      slot.positionCovariance[1] = covVtxV(1, 0);
+      slot.positionCovariance[2] = covVtxV(1, 1);
+      slot.positionCovariance[3] = covVtxV(2, 0);
+      slot.positionCovariance[4] = covVtxV(2, 1);
+      slot.positionCovariance[5] = covVtxV(2, 2);
+    }
+  }
+
+  // bookkeeping of the selection steps passed by a fitted V0, to be called serially
+  void countV0Steps(V0FitSlot const& slot)
+  {
+    for (int iStep = kV0All; iStep < slot.nStepsPassed; iStep++) {
+      statisticsRegistry.v0stats[iStep]++;
+      if (!slot.hasCollision)
+        statisticsRegistry.v0statsUnassociated[iStep]++;
+    }
+    if (slot.caughtException) {
+      statisticsRegistry.exceptions++;
+      LOG(error) << "Exception caught in DCA fitter process call!";
+    }
+  }
+
+  // QA of a selected V0, to be called serially
+  template <class TTrackTo, typename TV0Object>
+  void fillV0QA(TV0Object const& V0, V0FitSlot const& slot)
+  {
+    auto const& v0candidate = slot.candidate;
+    auto const& posTrack = V0.template posTrack_as<TTrackTo>();
+    auto const& negTrack = V0.template negTrack_as<TTrackTo>();
 
     if (qaConfigurations.d_doTrackQA) {
       if (posTrack.itsNCls() < 10)
@@ -1019,9 +1108,18 @@ struct lambdakzeroBuilder {
       bool mcUnchecked = !qaConfigurations.d_QA_checkMC;
       bool dEdxUnchecked = !qaConfigurations.d_QA_checkdEdx;
 
+      auto px = v0candidate.posP[0] + v0candidate.negP[0];
+      auto py = v0candidate.posP[1] + v0candidate.negP[1];
+      auto pz = v0candidate.posP[2] + v0candidate.negP[2];
+      auto lPt = RecoDecay::sqrtSumOfSquares(v0candidate.posP[0] + v0candidate.negP[0], v0candidate.posP[1] + v0candidate.negP[1]);
       auto lPtHy = RecoDecay::sqrtSumOfSquares(2.0f * v0candidate.posP[0] + v0candidate.negP[0], 2.0f * v0candidate.posP[1] + v0candidate.negP[1]);
       auto lPtAnHy = RecoDecay::sqrtSumOfSquares(v0candidate.posP[0] + 2.0f * v0candidate.negP[0], v0candidate.posP[1] + 2.0f * v0candidate.negP[1]);
 
+      // Calculate the masses not used in the selections
+      auto lGammaMass = RecoDecay::m(array{array{v0candidate.posP[0], v0candidate.posP[1], v0candidate.posP[2]}, array{v0candidate.negP[0], v0candidate.negP[1], v0candidate.negP[2]}}, array{o2::constants::physics::MassElectron, o2::constants::physics::MassElectron});
+      auto lHypertritonMass = RecoDecay::m(array{array{2.0f * v0candidate.posP[0], 2.0f * v0candidate.posP[1], 2.0f * v0candidate.posP[2]}, array{v0candidate.negP[0], v0candidate.negP[1], v0candidate.negP[2]}}, array{o2::constants::physics::MassHelium3, o2::constants::physics::MassPionCharged});
+      auto lAntiHypertritonMass = RecoDecay::m(array{array{v0candidate.posP[0], v0candidate.posP[1], v0candidate.posP[2]}, array{2.0f * v0candidate.negP[0], 2.0f * v0candidate.negP[1], 2.0f * v0candidate.negP[2]}}, array{o2::constants::physics::MassPionCharged, o2::constants::physics::MassHelium3});
+
       // Fill basic mass histograms
       if (TMath::Abs(RecoDecay::eta(std::array{px, py, pz})) < 0.5) {
         if ((V0.isdEdxGamma() || dEdxUnchecked) && (V0.isTrueGamma() || mcUnchecked))
@@ -1057,7 +1155,7 @@ struct lambdakzeroBuilder {
       }
 
       // QA extra: DCA to PV
-      float dcaV0toPV = std::sqrt((std::pow((primaryVertex.getY() - v0candidate.pos[1]) * pz - (primaryVertex.getZ() - v0candidate.pos[2]) * py, 2) + std::pow((primaryVertex.getX() - v0candidate.pos[0]) * pz - (primaryVertex.getZ() - v0candidate.pos[2]) * px, 2) + std::pow((primaryVertex.getX() - v0candidate.pos[0]) * py - (primaryVertex.getY() - v0candidate.pos[1]) * px, 2)) / (px * px + py * py + pz * pz));
+      float dcaV0toPV = std::sqrt((std::pow((slot.primaryVertex[1] - v0candidate.pos[1]) * pz - (slot.primaryVertex[2] - v0candidate.pos[2]) * py, 2) + std::pow((slot.primaryVertex[0] - v0candidate.pos[0]) * pz - (slot.primaryVertex[2] - v0candidate.pos[2]) * px, 2) + std::pow((slot.primaryVertex[0] - v0candidate.pos[0]) * py - (slot.primaryVertex[1] - v0candidate.pos[1]) * px, 2)) / (px * px + py * py + pz * pz));
 
       registry.fill(HIST("h2dTopoVarPointingAngle"), lPt, TMath::ACos(v0candidate.cosPA));
       registry.fill(HIST("h2dTopoVarRAP"), lPt, TMath::ACos(v0candidate.cosPA) * v0candidate.V0radius);
@@ -1076,8 +1174,8 @@ struct lambdakzeroBuilder {
 
       o2::math_utils::CircleXYf_t trcCircle1, trcCircle2;
       float sna, csa;
-      posTrackPar.getCircleParams(d_bz, trcCircle1, sna, csa);
-      negTrackPar.getCircleParams(d_bz, trcCircle2, sna, csa);
+      slot.posTrackPar.getCircleParams(d_bz, trcCircle1, sna, csa);
+      slot.negTrackPar.getCircleParams(d_bz, trcCircle2, sna, csa);
 
       // distance between circle centers (one circle is at origin -> easy)
       float centerDistance = std::hypot(trcCircle1.xC - trcCircle2.xC, trcCircle1.yC - trcCircle2.yC);
@@ -1094,15 +1192,15 @@ struct lambdakzeroBuilder {
       // let's just use tagged, cause we can
       if (!posTrack.hasITS() && !posTrack.hasTRD() && !posTrack.hasTOF() && !negTrack.hasITS() && !negTrack.hasTRD() && !negTrack.hasTOF()) {
         if (V0.isTrueGamma()) {
-          registry.fill(HIST("h2d_pcm_DCAXY_True"), lPt, std::hypot(dcaInfo[0], dcaInfo[1]));
-          registry.fill(HIST("h2d_pcm_DCACHI2_True"), lPt, fitter.getChi2AtPCACandidate());
+          registry.fill(HIST("h2d_pcm_DCAXY_True"), lPt, std::hypot(slot.dcaInfo[0], slot.dcaInfo[1]));
+          registry.fill(HIST("h2d_pcm_DCACHI2_True"), lPt, slot.chi2AtPCA);
           registry.fill(HIST("h2d_pcm_DeltaDistanceRadii_True"), lPt, centerDistance - trcCircle1.rC - trcCircle2.rC);
           registry.fill(HIST("h2d_pcm_PositionGuess_True"), lPt, delta2);
           registry.fill(HIST("h2d_pcm_RadiallyOutgoingAtThisRadius1_True"), lPt, delta3_track1);
           registry.fill(HIST("h2d_pcm_RadiallyOutgoingAtThisRadius2_True"), lPt, delta3_track2);
         } else {
-          registry.fill(HIST("h2d_pcm_DCAXY_Bg"), lPt, std::hypot(dcaInfo[0], dcaInfo[1]));
-          registry.fill(HIST("h2d_pcm_DCACHI2_Bg"), lPt, fitter.getChi2AtPCACandidate());
+          registry.fill(HIST("h2d_pcm_DCAXY_Bg"), lPt, std::hypot(slot.dcaInfo[0], slot.dcaInfo[1]));
+          registry.fill(HIST("h2d_pcm_DCACHI2_Bg"), lPt, slot.chi2AtPCA);
           registry.fill(HIST("h2d_pcm_DeltaDistanceRadii_Bg"), lPt, centerDistance - trcCircle1.rC - trcCircle2.rC);
           registry.fill(HIST("h2d_pcm_PositionGuess_Bg"), lPt, delta2);
           registry.fill(HIST("h2d_pcm_RadiallyOutgoingAtThisRadius1_Bg"), lPt, delta3_track1);
@@ -1111,61 +1209,107 @@ struct lambdakzeroBuilder {
       }
       // -------------------------------------------------------------------------------------
     } // end QA
-    return true;
   }
 
-  template <class TTrackTo, typename TV0Table>
-  void buildStrangenessTables(TV0Table const& V0s)
+  // evaluates a model on all rows of mlInputFeatures and keeps the score of each row
+  void evaluateMLScores(o2::ml::OnnxModel& model, std::vector<float>& scores)
   {
-    // Loops over all V0s in the time frame
-    for (auto& V0 : V0s) {
-      // downscale some V0s if requested to do so
-      if (downscalingOptions.downscaleFactor < 1.f && (static_cast<float>(rand_r(&randomSeed)) / static_cast<float>(RAND_MAX)) > downscalingOptions.downscaleFactor) {
-        return;
-      }
+    const int64_t nRows = mlInputFeatures.size() / nMLInputFeatures;
+    const int64_t nOutputValues = model.getNumOutputValuesPerRow();
+    mlOutputValues.resize(nRows * nOutputValues);
+    if (!model.evalModel(std::span<const float>{mlInputFeatures}, std::span<float>{mlOutputValues})) {
+      LOG(fatal) << "Error while evaluating the V0 ML scores!";
+    }
+    scores.resize(nRows);
+    for (int64_t iRow = 0; iRow < nRows; iRow++) {
+      scores[iRow] = mlOutputValues[iRow * nOutputValues + 1];
+    }
+  }
 
-      // populates v0candidate struct declared inside strangenessbuilder
-      bool validCandidate = buildV0Candidate<TTrackTo>(V0);
+  // builds the V0s of a chunk: the fits are distributed over the threads, the selected candidates
+  // are then written out serially, in the order of the V0 table
+  template <class TTrackTo, typename TV0Object>
+  void buildV0Chunk(std::vector<TV0Object> const& chunkV0s)
+  {
+    const int nV0s = chunkV0s.size();
+    if (nV0s == 0) {
+      return;
+    }
+
+    // the worker threads are started once in init and only woken up here
+    if (fitWorkers && nV0s > 1) {
+      const int nThreads = fitters.size();
+      fitWorkers->run([&](const int iThread) {
+        for (int iV0 = iThread; iV0 < nV0s; iV0 += nThreads) {
+          fitV0Candidate(v0FitSlots[iV0], fitters[iThread]);
+        }
+      });
+    } else {
+      for (int iV0 = 0; iV0 < nV0s; iV0++) {
+        fitV0Candidate(v0FitSlots[iV0], fitters[0]);
+      }
+    }
 
-      if (!validCandidate) {
+    const bool calculateMLScores = mlConfigurations.calculateK0ShortScores ||
+                                   mlConfigurations.calculateLambdaScores ||
+                                   mlConfigurations.calculateAntiLambdaScores ||
+                                   mlConfigurations.calculateGammaScores;
+    mlInputFeatures.clear();
+    for (int iV0 = 0; iV0 < nV0s; iV0++) {
+      auto& slot = v0FitSlots[iV0];
+      countV0Steps(slot);
+      if (!slot.isSelected) {
         continue; // doesn't pass selections
       }
+      fillV0QA<TTrackTo>(chunkV0s[iV0], slot);
 
-      int ivanovMap = 0;
-      float pt = RecoDecay::sqrtSumOfSquares(v0candidate.posP[0] + v0candidate.negP[0], v0candidate.posP[1] + v0candidate.negP[1]);
+      slot.ivanovMap = 0;
+      float pt = RecoDecay::sqrtSumOfSquares(slot.candidate.posP[0] + slot.candidate.negP[0], slot.candidate.posP[1] + slot.candidate.negP[1]);
       if (downscalingOptions.downscale_adaptive) {
-        ivanovMap = DownsampleMap(pt);
-        if (ivanovMap == 0)
+        slot.ivanovMap = DownsampleMap(pt);
+        if (slot.ivanovMap == 0) {
+          slot.isSelected = false;
           continue; // skip this V0, passes nothing
+        }
       }
 
       // round the DCA variables to a certain precision if asked
       if (roundDCAVariables)
-        roundV0CandidateVariables();
+        roundV0CandidateVariables(slot.candidate);
 
-      // evaluate machine-learning scores
-      float gammaScore = -1.0f, lambdaScore = -1.0f, antiLambdaScore = -1.0f, k0ShortScore = -1.0f;
-
-      if (mlConfigurations.calculateK0ShortScores ||
-          mlConfigurations.calculateLambdaScores ||
-          mlConfigurations.calculateAntiLambdaScores ||
-          mlConfigurations.calculateGammaScores) {
+      if (calculateMLScores) {
         // machine learning is on, go for calculation of thresholds
         // FIXME THIS NEEDS ADJUSTING
-        std::vector<float> inputFeatures{pt, 0.0f,
-                                         0.0f, v0candidate.V0radius,
-                                         v0candidate.cosPA, v0candidate.dcaV0dau,
-                                         v0candidate.posDCAxy, v0candidate.negDCAxy};
-
-        // calculate scores
-        if (mlConfigurations.calculateLambdaScores) {
-          float* lambdaProbability = mlModelLambda.evalModel(inputFeatures);
-          lambdaScore = lambdaProbability[1];
-        }
-        if (mlConfigurations.calculateGammaScores) {
-          float* gammaProbability = mlModelGamma.evalModel(inputFeatures);
-          gammaScore = gammaProbability[1];
-        }
+        slot.mlRow = mlInputFeatures.size() / nMLInputFeatures;
+        mlInputFeatures.insert(mlInputFeatures.end(), {pt, 0.0f,
+                                                       0.0f, slot.candidate.V0radius,
+                                                       slot.candidate.cosPA, slot.candidate.dcaV0dau,
+                                                       slot.candidate.posDCAxy, slot.candidate.negDCAxy});
+      }
+    }
+
+    // evaluate machine-learning scores of the chunk in one go
+    if (!mlInputFeatures.empty()) {
+      if (mlConfigurations.calculateLambdaScores)
+        evaluateMLScores(mlModelLambda, mlLambdaScores);
+      if (mlConfigurations.calculateGammaScores)
+        evaluateMLScores(mlModelGamma, mlGammaScores);
+    }
+
+    for (int iV0 = 0; iV0 < nV0s; iV0++) {
+      auto const& slot = v0FitSlots[iV0];
+      if (!slot.isSelected) {
+        continue;
+      }
+      auto const& V0 = chunkV0s[iV0];
+      auto const& v0candidate = slot.candidate;
+
+      float gammaScore = -1.0f, lambdaScore = -1.0f, antiLambdaScore = -1.0f, k0ShortScore = -1.0f;
+      if (calculateMLScores) {
+        if (mlConfigurations.calculateLambdaScores)
+          lambdaScore = mlLambdaScores[slot.mlRow];
+        if (mlConfigurations.calculateGammaScores)
+          gammaScore = mlGammaScores[slot.mlRow];
 
         // Skip anything that doesn't fulfull any of the desired conditions
         if (gammaScore < mlConfigurations.thresholdGamma.value &&
@@ -1182,10 +1326,7 @@ struct lambdakzeroBuilder {
         if (V0.v0Type() > 1 && !storePhotonCandidates)
           continue;
 
-        if (mlConfigurations.calculateK0ShortScores ||
-            mlConfigurations.calculateLambdaScores ||
-            mlConfigurations.calculateAntiLambdaScores ||
-            mlConfigurations.calculateGammaScores) {
+        if (calculateMLScores) {
           // at this stage, the candidate is interesting -> populate table
           gammaMLSelections(gammaScore);
           lambdaMLSelections(lambdaScore);
@@ -1216,13 +1357,13 @@ struct lambdakzeroBuilder {
         if (createV0PosAtDCAs) {
           std::array<float, 3> posPositionIU;
           std::array<float, 3> negPositionIU;
-          lPositiveTrackIU.getXYZGlo(posPositionIU);
-          lNegativeTrackIU.getXYZGlo(negPositionIU);
+          slot.posTrackIU.getXYZGlo(posPositionIU);
+          slot.negTrackIU.getXYZGlo(negPositionIU);
           v0dauPositionsIU(posPositionIU[0], posPositionIU[1], posPositionIU[2],
                            negPositionIU[0], negPositionIU[1], negPositionIU[2]);
         }
         if (downscalingOptions.downscale_adaptive) {
-          v0ivanovs(ivanovMap);
+          v0ivanovs(slot.ivanovMap);
         }
       } else {
         // place V0s built exclusively for the sake of cascades
@@ -1247,26 +1388,21 @@ struct lambdakzeroBuilder {
 
       // populate V0 covariance matrices if required by any other task
       if (createV0CovMats) {
-        // Calculate position covariance matrix
-        auto covVtxV = fitter.calcPCACovMatrix(0);
-        // std::array<float, 6> positionCovariance;
+        // Position covariance matrix calculated with the fit
         float positionCovariance[6];
-        positionCovariance[0] = covVtxV(0, 0);
-        positionCovariance[1] = covVtxV(1, 0);
-        positionCovariance[2] = covVtxV(1, 1);
-        positionCovariance[3] = covVtxV(2, 0);
-        positionCovariance[4] = covVtxV(2, 1);
-        positionCovariance[5] = covVtxV(2, 2);
+        for (int i = 0; i < 6; i++) {
+          positionCovariance[i] = slot.positionCovariance[i];
+        }
         std::array<float, 21> covTpositive = {0.};
         std::array<float, 21> covTnegative = {0.};
         std::array<float, 21> covTpositiveIU = {0.};
         std::array<float, 21> covTnegativeIU = {0.};
         // std::array<float, 6> momentumCovariance;
         float momentumCovariance[6];
-        lPositiveTrack.getCovXYZPxPyPzGlo(covTpositive);
-        lNegativeTrack.getCovXYZPxPyPzGlo(covTnegative);
-        lPositiveTrackIU.getCovXYZPxPyPzGlo(covTpositiveIU);
-        lNegativeTrackIU.getCovXYZPxPyPzGlo(covTnegativeIU);
+        slot.posTrack.getCovXYZPxPyPzGlo(covTpositive);
+        slot.negTrack.getCovXYZPxPyPzGlo(covTnegative);
+        slot.posTrackIU.getCovXYZPxPyPzGlo(covTpositiveIU);
+        slot.negTrackIU.getCovXYZPxPyPzGlo(covTnegativeIU);
         constexpr int MomInd[6] = {9, 13, 14, 18, 19, 20}; // cov matrix elements for momentum component
         for (int i = 0; i < 6; i++) {
           momentumCovariance[i] = covTpositive[MomInd[i]] + covTnegative[MomInd[i]];
@@ -1295,6 +1431,32 @@ struct lambdakzeroBuilder {
         }
       }
     }
+  }
+
+  template <class TTrackTo, typename TV0Table>
+  void buildStrangenessTables(TV0Table const& V0s)
+  {
+    // V0s collected for the current chunk, their fit inputs are stored in the slots with the same index
+    std::vector<std::decay_t<decltype(V0s.begin())>> chunkV0s;
+    chunkV0s.reserve(v0FitSlots.size());
+
+    // Loops over all V0s in the time frame
+    for (auto& V0 : V0s) {
+      // downscale some V0s if requested to do so
+      if (downscalingOptions.downscaleFactor < 1.f && (static_cast<float>(rand_r(&randomSeed)) / static_cast<float>(RAND_MAX)) > downscalingOptions.downscaleFactor) {
+        buildV0Chunk<TTrackTo>(chunkV0s);
+        return;
+      }
+
+      prepareV0Candidate<TTrackTo>(V0, v0FitSlots[chunkV0s.size()]);
+      chunkV0s.push_back(V0);
+      if (chunkV0s.size() == v0FitSlots.size()) {
+        buildV0Chunk<TTrackTo>(chunkV0s);
+        chunkV0s.clear();
+      }
+    }
+    buildV0Chunk<TTrackTo>(chunkV0s);
+
     // En masse histo filling at end of process call
     fillHistos();
     resetHistos();
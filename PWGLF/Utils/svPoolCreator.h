@@ -12,8 +12,8 @@
 #ifndef PWGLF_UTILS_SVPOOLCREATOR_H_
 #define PWGLF_UTILS_SVPOOLCREATOR_H_
 
+#include <algorithm>
 #include <array>
-#include <unordered_map>
 #include <vector>
 #include <utility>
 #include "Framework/AnalysisTask.h"
@@ -55,9 +55,13 @@ class svPoolCreator
     for (auto& pool : trackCandPool) {
       pool.clear();
     }
-    tmap.clear();
     svCandPool.clear();
-    bc2Coll.clear();
+    collBCs.clear();
+    collIdxs.clear();
+    collTimes.clear();
+    collTimeRes2s.clear();
+    ambiTrack2BC.clear();
+    isAmbiTrack2BCFilled = false;
   }
 
   void setTimeMargin(float timeMargin) { timeMarginNS = timeMargin; }
@@ -66,20 +70,61 @@ class svPoolCreator
   o2::vertexing::DCAFitterN<2>* getFitter() { return &fitter; }
   std::array<std::vector<TrackCand>, 4> getTrackCandPool() { return trackCandPool; }
 
+  // Stores the BC and the time of the collisions, sorted by BC, to find the collisions compatible with a track by binary search
   template <typename C>
   void fillBC2Coll(const C& collisions, aod::BCsWithTimestamps const&)
   {
+    std::vector<uint64_t> globalBCs(collisions.size(), 0);
+    std::vector<int> order;
+    order.reserve(collisions.size());
     for (unsigned i = 0; i < collisions.size(); i++) {
       auto collision = collisions.rawIteratorAt(i);
       if (!collision.has_bc()) {
         continue;
       }
-      bc2Coll[collision.template bc_as<aod::BCsWithTimestamps>().globalBC()] = i;
+      globalBCs[i] = collision.template bc_as<aod::BCsWithTimestamps>().globalBC();
+      order.push_back(i);
     }
+    // collisions are usually already sorted in time, stable sort keeps the index order within a BC
+    std::stable_sort(order.begin(), order.end(), [&globalBCs](int a, int b) { return globalBCs[a] < globalBCs[b]; });
+
+    collBCs.resize(order.size());
+    collIdxs.resize(order.size());
+    collTimes.resize(order.size());
+    collTimeRes2s.resize(order.size());
+    for (size_t iColl = 0; iColl < order.size(); iColl++) {
+      auto collision = collisions.rawIteratorAt(order[iColl]);
+      collBCs[iColl] = globalBCs[order[iColl]];
+      collIdxs[iColl] = order[iColl];
+      collTimes[iColl] = collision.collisionTime();
+      collTimeRes2s[iColl] = collision.collisionTimeRes() * collision.collisionTimeRes();
+    }
+  }
+
+  // Fills the BC of the ambiguous tracks, indexed by track
+  void fillAmbiTrack2BC(o2::aod::AmbiguousTracks const& ambiTracks)
+  {
+    ambiTrack2BC.clear();
+    // reverse loop: the first entry of a track is kept
+    for (int i = ambiTracks.size() - 1; i >= 0; i--) {
+      auto ambTrack = ambiTracks.rawIteratorAt(i);
+      if (ambTrack.trackId() < 0) {
+        continue;
+      }
+      if (static_cast<size_t>(ambTrack.trackId()) >= ambiTrack2BC.size()) {
+        ambiTrack2BC.resize(ambTrack.trackId() + 1, -1);
+      }
+      if (!ambTrack.has_bc() || ambTrack.bc_as<aod::BCsWithTimestamps>().size() == 0) {
+        ambiTrack2BC[ambTrack.trackId()] = -1;
+      } else {
+        ambiTrack2BC[ambTrack.trackId()] = ambTrack.bc_as<aod::BCsWithTimestamps>().begin().globalBC();
+      }
+    }
+    isAmbiTrack2BCFilled = true;
   }
 
   template <typename T, typename C>
-  void appendTrackCand(const T& trackCand, const C& collisions, int pdgHypo, o2::aod::AmbiguousTracks const& ambiTracks, aod::BCsWithTimestamps const&)
+  void appendTrackCand(const T& trackCand, const C& /*collisions*/, int pdgHypo, o2::aod::AmbiguousTracks const& ambiTracks, aod::BCsWithTimestamps const&)
   {
     if (pdgHypo != track0Pdg && pdgHypo != track1Pdg) {
       LOG(debug) << "Wrong pdg hypothesis";
@@ -92,16 +137,11 @@ class svPoolCreator
         globalBC = trackCand.template collision_as<C>().template bc_as<aod::BCsWithTimestamps>().globalBC();
       }
     } else if (!skipAmbiTracks) {
-      for (const auto& ambTrack : ambiTracks) {
-        if (ambTrack.trackId() != trackCand.globalIndex()) {
-          continue;
-        }
-        if (!ambTrack.has_bc() || ambTrack.bc_as<aod::BCsWithTimestamps>().size() == 0) {
-          globalBC = -1;
-          break;
-        }
-        globalBC = ambTrack.bc_as<aod::BCsWithTimestamps>().begin().globalBC();
-        break;
+      if (!isAmbiTrack2BCFilled) {
+        fillAmbiTrack2BC(ambiTracks);
+      }
+      if (static_cast<size_t>(trackCand.globalIndex()) < ambiTrack2BC.size()) {
+        globalBC = ambiTrack2BC[trackCand.globalIndex()];
       }
     } else {
       globalBC = -1;
@@ -111,42 +151,27 @@ class svPoolCreator
       return;
     }
 
-    uint64_t firstBC = globalBC < bOffsetMax ? 0 : globalBC - bOffsetMax;
-    uint64_t lastBC = globalBC + bOffsetMax;
-    int firstCollIdx = -1;
-    while (firstBC < lastBC) {
-      if (bc2Coll.find(firstBC) != bc2Coll.end()) {
-        firstCollIdx = bc2Coll[firstBC];
-        break;
-      }
-      firstBC++;
+    float trackTime{0.};
+    float trackTimeRes{0.};
+    if (trackCand.isPVContributor()) {
+      trackTime = trackCand.template collision_as<C>().collisionTime(); // if PV contributor, we assume the time to be the one of the collision
+      trackTimeRes = constants::lhc::LHCBunchSpacingNS;                 // 1 BC
+    } else {
+      trackTime = trackCand.trackTime();
+      trackTimeRes = trackCand.trackTimeRes();
     }
-    // now loop over all the collisions to make the pool
-    for (int i = firstCollIdx; i < collisions.size(); i++) {
-      const auto& collision = collisions.rawIteratorAt(i);
-      float collTime = collision.collisionTime();
-      float collTimeRes2 = collision.collisionTimeRes() * collision.collisionTimeRes();
-      uint64_t collBC = collision.template bc_as<aod::BCsWithTimestamps>().globalBC();
-      int collIdx = collision.globalIndex();
-      int64_t bcOffset = globalBC - (int64_t)collBC;
-      if (std::abs(bcOffset) > bOffsetMax && bcOffset < 0) {
-        break;
-      } else if (std::abs(bcOffset) > bOffsetMax && bcOffset > 0) {
-        continue;
-      }
 
-      float trackTime{0.};
-      float trackTimeRes{0.};
-      if (trackCand.isPVContributor()) {
-        trackTime = trackCand.template collision_as<C>().collisionTime(); // if PV contributor, we assume the time to be the one of the collision
-        trackTimeRes = constants::lhc::LHCBunchSpacingNS;                 // 1 BC
-      } else {
-        trackTime = trackCand.trackTime();
-        trackTimeRes = trackCand.trackTimeRes();
-      }
+    // loop over the collisions within bOffsetMax BCs to make the pool, the first one is found by binary search
+    uint64_t firstBC = globalBC < bOffsetMax ? 0 : globalBC - bOffsetMax;
+    uint64_t lastBC = globalBC + bOffsetMax;
+    int poolIndex = (1 - isDau0) * 2 + (trackCand.sign() < 0);
+    int trackPoolIdx = -1; // position of this track in the pool, once added
+    for (size_t iColl = std::lower_bound(collBCs.begin(), collBCs.end(), firstBC) - collBCs.begin(); iColl < collBCs.size() && collBCs[iColl] <= lastBC; iColl++) {
+      int collIdx = collIdxs[iColl];
+      int64_t bcOffset = globalBC - (int64_t)collBCs[iColl];
 
-      const float deltaTime = trackTime - collTime + bcOffset * constants::lhc::LHCBunchSpacingNS;
-      float sigmaTimeRes2 = collTimeRes2 + trackTimeRes * trackTimeRes;
+      const float deltaTime = trackTime - collTimes[iColl] + bcOffset * constants::lhc::LHCBunchSpacingNS;
+      float sigmaTimeRes2 = collTimeRes2s[iColl] + trackTimeRes * trackTimeRes;
 
       float thresholdTime = 0.;
       if (trackCand.isPVContributor()) {
@@ -164,19 +189,17 @@ class svPoolCreator
         continue;
       }
 
-      const auto& tref = tmap.find(trackCand.globalIndex());
-      if (tref != tmap.end()) {
+      if (trackPoolIdx >= 0) {
         LOG(debug) << "Track: " << trackCand.globalIndex() << " already processed with other vertex";
-        trackCandPool[tref->second.second][tref->second.first].collBracket.setMax(static_cast<int>(collIdx)); // this track was already processed with other vertex, account the latter
+        trackCandPool[poolIndex][trackPoolIdx].collBracket.setMax(static_cast<int>(collIdx)); // this track was already processed with other vertex, account the latter
         continue;
       }
 
-      int poolIndex = (1 - isDau0) * 2 + (trackCand.sign() < 0);
       trForpool.Idxtr = trackCand.globalIndex();
       trForpool.collBracket = {static_cast<int>(collIdx), static_cast<int>(collIdx)};
       // LOG(info) << "Adding track to pool: " << trForpool.Idxtr << " with bracket: " << trForpool.collBracket.getMin() << " " << trForpool.collBracket.getMax() << " and pool index: " << poolIndex;
       trackCandPool[poolIndex].emplace_back(trForpool);
-      tmap[trackCand.globalIndex()] = {trackCandPool[poolIndex].size() - 1, poolIndex};
+      trackPoolIdx = trackCandPool[poolIndex].size() - 1;
     }
 
     // is Sorting Needed ? TBD
@@ -250,8 +273,15 @@ class svPoolCreator
   int track1Pdg;
   float timeMarginNS = 600.;
   bool skipAmbiTracks = false;
-  std::unordered_map<int, std::pair<int, int>> tmap;
-  std::unordered_map<uint64_t, int> bc2Coll;
+
+  // collisions with a BC, sorted by BC
+  std::vector<uint64_t> collBCs;
+  std::vector<int> collIdxs;
+  std::vector<float> collTimes;
+  std::vector<float> collTimeRes2s;
+
+  std::vector<uint64_t> ambiTrack2BC; // BC of the ambiguous tracks, indexed by track
+  bool isAmbiTrack2BCFilled = false;
 
   std::array<std::vector<TrackCand>, 4> trackCandPool; // Sorting: dau0 pos, dau0 neg, dau1 pos, dau1 neg
   std::vector<SVCand> svCandPool;                      // index of the two tracks in the track table
@@ -39,8 +39,9 @@ class DGSelector
   }
 
   // Function to check if collision passes DG filter
+  // If bcActivity is given, then the FIT vetoes of the compatible BCs are taken from it
   template <typename CC, typename BCs, typename TCs, typename FWs>
-  int IsSelected(DGCutparHolder diffCuts, CC& collision, BCs& bcRange, TCs& tracks, FWs& fwdtracks)
+  int IsSelected(DGCutparHolder diffCuts, CC& collision, BCs& bcRange, TCs& tracks, FWs& fwdtracks, udhelpers::BCActivityIndex const* bcActivity = nullptr)
   {
     LOGF(debug, "Collision %f", collision.collisionTime());
     LOGF(debug, "Number of close BCs: %i", bcRange.size());
@@ -52,18 +53,25 @@ class DGSelector
     //  1 TSC
     //  2 TCE
     //  3 TOR
-    for (auto const& bc : bcRange) {
-      /* for debuging
-      auto isVetoed = udhelpers::FITveto(bc, diffCuts);
-      auto isClean = udhelpers::cleanFIT(bc, diffCuts.maxFITtime(), diffCuts.FITAmpLimits());
-      LOGF(info, "<IsSelected> isVetoed: %d isClean: %d", isVetoed, isClean);
-      if (isVetoed) {
+    if (bcActivity) {
+      auto [first, last] = udhelpers::BCActivityIndex::rows(bcRange);
+      if (bcActivity->FITveto(first, last, diffCuts)) {
         return 1;
       }
-      */
+    } else {
+      for (auto const& bc : bcRange) {
+        /* for debuging
+        auto isVetoed = udhelpers::FITveto(bc, diffCuts);
+        auto isClean = udhelpers::cleanFIT(bc, diffCuts.maxFITtime(), diffCuts.FITAmpLimits());
+        LOGF(info, "<IsSelected> isVetoed: %d isClean: %d", isVetoed, isClean);
+        if (isVetoed) {
+          return 1;
+        }
+        */
 
-      if (udhelpers::FITveto(bc, diffCuts)) {
-        return 1;
+        if (udhelpers::FITveto(bc, diffCuts)) {
+          return 1;
+        }
       }
     }
 
@@ -197,8 +205,9 @@ class DGSelector
   };
 
   // Function to check if BC passes DG filter (without associated collision)
+  // If bcActivity is given, then the FIT vetoes of the compatible BCs are taken from it
   template <typename BCs, typename TCs, typename FWs>
-  int IsSelected(DGCutparHolder diffCuts, BCs& bcRange, TCs& tracks, FWs& fwdtracks)
+  int IsSelected(DGCutparHolder diffCuts, BCs& bcRange, TCs& tracks, FWs& fwdtracks, udhelpers::BCActivityIndex const* bcActivity = nullptr)
   {
     // return if FIT veto is found in any of the compatible BCs
     // Double Gap (DG) condition
@@ -207,10 +216,17 @@ class DGSelector
     //  1 TSC
     //  2 TCE
     //  3 TOR
-    for (auto const& bc : bcRange) {
-      if (udhelpers::FITveto(bc, diffCuts)) {
+    if (bcActivity) {
+      auto [first, last] = udhelpers::BCActivityIndex::rows(bcRange);
+      if (bcActivity->FITveto(first, last, diffCuts)) {
         return 1;
       }
+    } else {
+      for (auto const& bc : bcRange) {
+        if (udhelpers::FITveto(bc, diffCuts)) {
+          return 1;
+        }
+      }
     }
 
     // no activity in muon arm
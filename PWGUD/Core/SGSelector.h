@@ -38,8 +38,9 @@ class SGSelector
     return 1;
   }
 
+  // If bcActivity is given, then the FIT activity of the compatible BCs is taken from it
   template <typename CC, typename BCs, typename BC>
-  SelectionResult<BC> IsSelected(SGCutParHolder diffCuts, CC& collision, BCs& bcRange, BC& oldbc)
+  SelectionResult<BC> IsSelected(SGCutParHolder diffCuts, CC& collision, BCs& bcRange, BC& oldbc, udhelpers::BCActivityIndex const* bcActivity = nullptr)
   {
     //        LOGF(info, "Collision %f", collision.collisionTime());
     //        LOGF(info, "Number of close BCs: %i", bcRange.size());
@@ -57,20 +58,31 @@ class SGSelector
     float ampc = 0;
     float ampa = 0;
     bool gA = true, gC = true;
-    for (auto const& bc : bcRange) {
-      if (!udhelpers::cleanFITA(bc, diffCuts.maxFITtime(), diffCuts.FITAmpLimits())) {
-        if (gA)
-          newbc = bc;
-        if (!gA && std::abs(static_cast<int64_t>(bc.globalBC() - oldbc.globalBC())) < std::abs(static_cast<int64_t>(newbc.globalBC() - oldbc.globalBC())))
-          newbc = bc;
-        gA = false;
+    if (bcActivity) {
+      // with a single side not clean, the BC of this side closest to oldbc is taken
+      auto [first, last] = udhelpers::BCActivityIndex::rows(bcRange);
+      gA = bcActivity->count(udhelpers::BCActivityIndex::kNotCleanFITA, first, last) == 0;
+      gC = bcActivity->count(udhelpers::BCActivityIndex::kNotCleanFITC, first, last) == 0;
+      if (gA != gC) {
+        auto activity = gA ? udhelpers::BCActivityIndex::kNotCleanFITC : udhelpers::BCActivityIndex::kNotCleanFITA;
+        newbc = bcRange.rawIteratorAt(bcActivity->closestRow(activity, first, last, oldbc.globalBC()) - first);
       }
-      if (!udhelpers::cleanFITC(bc, diffCuts.maxFITtime(), diffCuts.FITAmpLimits())) {
-        if (gC)
-          newbc = bc;
-        if (!gC && std::abs(static_cast<int64_t>(bc.globalBC() - oldbc.globalBC())) < std::abs(static_cast<int64_t>(newbc.globalBC() - oldbc.globalBC())))
-          newbc = bc;
-        gC = false;
+    } else {
+      for (auto const& bc : bcRange) {
+        if (!udhelpers::cleanFITA(bc, diffCuts.maxFITtime(), diffCuts.FITAmpLimits())) {
+          if (gA)
+            newbc = bc;
+          if (!gA && std::abs(static_cast<int64_t>(bc.globalBC() - oldbc.globalBC())) < std::abs(static_cast<int64_t>(newbc.globalBC() - oldbc.globalBC())))
+            newbc = bc;
+          gA = false;
+        }
+        if (!udhelpers::cleanFITC(bc, diffCuts.maxFITtime(), diffCuts.FITAmpLimits())) {
+          if (gC)
+            newbc = bc;
+          if (!gC && std::abs(static_cast<int64_t>(bc.globalBC() - oldbc.globalBC())) < std::abs(static_cast<int64_t>(newbc.globalBC() - oldbc.globalBC())))
+            newbc = bc;
+          gC = false;
+        }
       }
     }
     if (!gA && !gC) {
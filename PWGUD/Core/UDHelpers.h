@@ -16,6 +16,9 @@
 #ifndef PWGUD_CORE_UDHELPERS_H_
 #define PWGUD_CORE_UDHELPERS_H_
 
+#include <algorithm>
+#include <array>
+#include <utility>
 #include <vector>
 #include <bitset>
 #include "TLorentzVector.h"
@@ -106,8 +109,27 @@ T compatibleBCs(uint64_t meanBC, int deltaBC, T const& bcs);
 template <typename I, typename T>
 T compatibleBCs(I& bcIter, uint64_t meanBC, int deltaBC, T const& bcs);
 
-// In this variant of compatibleBCs the bcIter is ideally placed within
-// [minBC, maxBC], but it does not need to be. The range is given by meanBC +- delatBC.
+// -----------------------------------------------------------------------------
+// The BCs table is sorted by globalBC. Return the first row with globalBC >= bcnum,
+// bcs.size() if there is none.
+template <typename T>
+int64_t firstBCRow(T const& bcs, uint64_t bcnum)
+{
+  int64_t low = 0;
+  int64_t high = bcs.size();
+  while (low < high) {
+    int64_t middle = low + (high - low) / 2;
+    if (bcs.rawIteratorAt(middle).globalBC() < bcnum) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  return low;
+}
+
+// In this variant of compatibleBCs the range is given by meanBC +- delatBC. The slice of
+// compatible BCs is found by binary search, bcIter is not used to find it any more.
 template <typename I, typename T>
 T compatibleBCs(I& bcIter, uint64_t meanBC, int deltaBC, T const& bcs)
 {
@@ -123,45 +145,10 @@ T compatibleBCs(I& bcIter, uint64_t meanBC, int deltaBC, T const& bcs)
   }
 
   // find slice of BCs table with BC in [minBC, maxBC]
-  int moveCount = 0;
-  int64_t minBCId = bcIter.globalIndex();
-  int64_t maxBCId = bcIter.globalIndex();
-
-  // lower limit
-  if (bcIter.globalBC() < minBC) {
-    while (bcIter != bcs.end() && bcIter.globalBC() < minBC) {
-      ++bcIter;
-      ++moveCount;
-      minBCId = bcIter.globalIndex();
-    }
-  } else {
-    while (bcIter.globalIndex() > 0 && bcIter.globalBC() >= minBC) {
-      minBCId = bcIter.globalIndex();
-      --bcIter;
-      --moveCount;
-    }
-  }
-
-  // upper limit limit
-  if (bcIter.globalBC() < maxBC) {
-    while (bcIter != bcs.end() && bcIter.globalBC() <= maxBC) {
-      maxBCId = bcIter.globalIndex();
-      ++bcIter;
-      ++moveCount;
-    }
-
-  } else {
-    while (bcIter.globalIndex() > 0 && bcIter.globalBC() > maxBC) {
-      --bcIter;
-      --moveCount;
-      maxBCId = bcIter.globalIndex();
-    }
-  }
+  int64_t minBCId = firstBCRow(bcs, minBC);
+  int64_t maxBCId = firstBCRow(bcs, maxBC + 1) - 1;
   LOGF(debug, "  BC range: %d - %d", minBCId, maxBCId);
 
-  // reset bcIter
-  bcIter.moveByIndex(-moveCount);
-
   // create bc slice
   T slice{{bcs.asArrowTable()->Slice(minBCId, maxBCId - minBCId + 1)}, (uint64_t)minBCId};
   bcs.copyIndexBindings(slice);
@@ -540,6 +527,152 @@ bool FITveto(T const& bc, DGCutparHolder const& diffCuts)
   return false;
 }
 
+// -----------------------------------------------------------------------------
+// Index of the FIT/ZDC activity of the BCs of a time frame.
+// For each row of the BCs table the prefix sums of the FIT/ZDC amplitudes and of the numbers
+// of BCs with fired triggers or not clean FIT are stored. The activity of any range of BCs
+// is then given by the difference of two prefix sums, independent of the width of the range.
+class BCActivityIndex
+{
+ public:
+  // BCs counted
+  enum Activity { kTVX = 0, kTSC, kTCE, kNotCleanFIT, kNotCleanFITA, kNotCleanFITC, kZDC, kNActivities };
+  // amplitudes summed
+  enum Amplitude { kFV0A = 0, kFT0A, kFT0C, kFDDA, kFDDC, kZNA, kZNC, kNAmplitudes };
+
+  // fill the index with the BCs of a time frame, sorted by globalBC
+  // the FIT detectors are clean as defined by cleanFIT with maxFITtime and lims
+  template <typename T>
+  void build(T const& bcs, float maxFITtime, std::vector<float> const& lims)
+  {
+    auto nBCs = bcs.size();
+    mGlobalBCs.resize(nBCs);
+    for (auto& counts : mCounts) {
+      counts.assign(nBCs + 1, 0);
+    }
+    for (auto& sums : mSums) {
+      sums.assign(nBCs + 1, 0.);
+    }
+
+    std::array<float, kNAmplitudes> amps;
+    for (int64_t row = 0; row < nBCs; row++) {
+      auto bc = bcs.rawIteratorAt(row);
+      mGlobalBCs[row] = bc.globalBC();
+
+      bool cleanA = cleanFITA(bc, maxFITtime, lims);
+      bool cleanC = cleanFITC(bc, maxFITtime, lims);
+      std::array<bool, kNActivities> isActive{TVX(bc), TSC(bc), TCE(bc), !(cleanA && cleanC), !cleanA, !cleanC, bc.has_zdc()};
+      for (int activity = 0; activity < kNActivities; activity++) {
+        mCounts[activity][row + 1] = mCounts[activity][row] + isActive[activity];
+      }
+
+      amps.fill(0.f);
+      if (bc.has_foundFV0()) {
+        amps[kFV0A] = FV0AmplitudeA(bc.foundFV0());
+      }
+      if (bc.has_foundFT0()) {
+        amps[kFT0A] = FT0AmplitudeA(bc.foundFT0());
+        amps[kFT0C] = FT0AmplitudeC(bc.foundFT0());
+      }
+      if (bc.has_foundFDD()) {
+        amps[kFDDA] = FDDAmplitudeA(bc.foundFDD());
+        amps[kFDDC] = FDDAmplitudeC(bc.foundFDD());
+      }
+      if (bc.has_zdc()) {
+        amps[kZNA] = bc.zdc().energyCommonZNA();
+        amps[kZNC] = bc.zdc().energyCommonZNC();
+      }
+      for (int amplitude = 0; amplitude < kNAmplitudes; amplitude++) {
+        mSums[amplitude][row + 1] = mSums[amplitude][row] + amps[amplitude];
+      }
+    }
+    LOGF(debug, "<BCActivityIndex> built with %d BCs", nBCs);
+  }
+
+  // true if the index was built with this BCs table
+  template <typename T>
+  bool isBuiltFor(T const& bcs) const
+  {
+    if (static_cast<int64_t>(mGlobalBCs.size()) != bcs.size()) {
+      return false;
+    }
+    return mGlobalBCs.empty() || (mGlobalBCs.front() == bcs.rawIteratorAt(0).globalBC() && mGlobalBCs.back() == bcs.rawIteratorAt(bcs.size() - 1).globalBC());
+  }
+
+  // range of rows [first, last) of the BCs with globalBC in [minBC, maxBC]
+  std::pair<int64_t, int64_t> rows(uint64_t minBC, uint64_t maxBC) const
+  {
+    auto first = std::lower_bound(mGlobalBCs.begin(), mGlobalBCs.end(), minBC);
+    auto last = std::upper_bound(first, mGlobalBCs.end(), maxBC);
+    return {first - mGlobalBCs.begin(), last - mGlobalBCs.begin()};
+  }
+
+  // range of rows [first, last) of a slice of the BCs table, e.g. obtained with compatibleBCs
+  template <typename T>
+  static std::pair<int64_t, int64_t> rows(T const& bcRange)
+  {
+    return {static_cast<int64_t>(bcRange.offset()), static_cast<int64_t>(bcRange.offset()) + bcRange.size()};
+  }
+
+  // number of BCs with given activity in the rows [first, last)
+  int64_t count(Activity activity, int64_t first, int64_t last) const
+  {
+    return mCounts[activity][last] - mCounts[activity][first];
+  }
+
+  // sum of the given amplitude in the rows [first, last)
+  double amplitude(Amplitude amplitude, int64_t first, int64_t last) const
+  {
+    return mSums[amplitude][last] - mSums[amplitude][first];
+  }
+
+  // row of the BC with given activity in the rows [first, last) which is closest to bcnum,
+  // the earlier one if two are equally close, -1 if there is none
+  int64_t closestRow(Activity activity, int64_t first, int64_t last, uint64_t bcnum) const
+  {
+    auto const& counts = mCounts[activity];
+    int64_t pivot = std::clamp(rows(bcnum, bcnum).first, first, last);
+
+    // the active rows before and after the pivot
+    int64_t before = -1;
+    if (counts[pivot] > counts[first]) {
+      before = std::lower_bound(counts.begin(), counts.end(), counts[pivot]) - counts.begin() - 1;
+    }
+    int64_t after = -1;
+    if (counts[last] > counts[pivot]) {
+      after = std::upper_bound(counts.begin(), counts.end(), counts[pivot]) - counts.begin() - 1;
+    }
+    if (before < 0 || after < 0) {
+      return std::max(before, after);
+    }
+    auto distance = [this, bcnum](int64_t row) { return std::abs(static_cast<int64_t>(mGlobalBCs[row] - bcnum)); };
+    return distance(after) < distance(before) ? after : before;
+  }
+
+  // same as FITveto, for any of the BCs in the rows [first, last)
+  bool FITveto(int64_t first, int64_t last, DGCutparHolder const& diffCuts) const
+  {
+    if (diffCuts.withTVX()) {
+      return count(kTVX, first, last) > 0;
+    }
+    if (diffCuts.withTSC()) {
+      return count(kTSC, first, last) > 0;
+    }
+    if (diffCuts.withTCE()) {
+      return count(kTCE, first, last) > 0;
+    }
+    if (diffCuts.withTOR()) {
+      return count(kNotCleanFIT, first, last) > 0;
+    }
+    return false;
+  }
+
+ private:
+  std::vector<uint64_t> mGlobalBCs;                       // globalBC of each row
+  std::array<std::vector<int32_t>, kNActivities> mCounts; // number of active BCs before each row
+  std::array<std::vector<double>, kNAmplitudes> mSums;    // sum of the amplitudes before each row
+};
+
 // -----------------------------------------------------------------------------
 
 template <typename T>
@@ -680,12 +813,11 @@ template <typename B>
 void getFITinfo(upchelpers::FITInfo& info, uint64_t const& bcnum, B const& bcs, aod::FT0s const& ft0s, aod::FV0As const& fv0as, aod::FDDs const& fdds)
 {
   // find bc with globalBC = bcnum
-  Partition<B> selbc = aod::bc::globalBC == bcnum;
-  selbc.bindTable(bcs);
+  auto bcRow = firstBCRow(bcs, bcnum);
 
   // if BC exists then update FIT information for this BC
-  if (selbc.size() > 0) {
-    auto bc = selbc.begin();
+  if (bcRow < bcs.size() && bcs.rawIteratorAt(bcRow).globalBC() == bcnum) {
+    auto bc = bcs.rawIteratorAt(bcRow);
 
     // FV0A
     if (bc.has_foundFV0()) {
@@ -719,8 +851,10 @@ void getFITinfo(upchelpers::FITInfo& info, uint64_t const& bcnum, B const& bcs,
   // fill BG and BB flags
   auto minbc = bcnum - 16;
   auto maxbc = bcnum + 15;
-  Partition<B> bcrange = aod::bc::globalBC >= minbc && aod::bc::globalBC <= maxbc;
-  bcrange.bindTable(bcs);
+  auto minRow = firstBCRow(bcs, minbc);
+  auto maxRow = firstBCRow(bcs, maxbc + 1);
+  B bcrange{{bcs.asArrowTable()->Slice(minRow, maxRow - minRow)}, (uint64_t)minRow};
+  bcs.copyIndexBindings(bcrange);
   fillBGBBFlags(info, minbc, bcrange);
 }
 
@@ -740,6 +874,45 @@ bool cleanCalo(T const& bc, aod::Calos& calos, std::vector<float>& /*lims*/, Sli
   return (CaloBC.size() == 0);
 }
 
+// -----------------------------------------------------------------------------
+// Tracks grouped by BC in compressed sparse row format: the BCs are sorted and the tracks of
+// the i-th BC are mTrackIds[mOffsets[i]], ..., mTrackIds[mOffsets[i + 1] - 1], in the order
+// in which they were added.
+class TracksPerBC
+{
+ public:
+  void add(uint64_t bcnum, int32_t trackId) { mEntries.emplace_back(bcnum, trackId); }
+
+  // group the added tracks by BC
+  void build()
+  {
+    std::stable_sort(mEntries.begin(), mEntries.end(), [](auto const& a, auto const& b) { return a.first < b.first; });
+    mBCs.clear();
+    mOffsets.clear();
+    mTrackIds.clear();
+    mTrackIds.reserve(mEntries.size());
+    for (auto const& [bcnum, trackId] : mEntries) {
+      if (mBCs.empty() || mBCs.back() != bcnum) {
+        mBCs.push_back(bcnum);
+        mOffsets.push_back(mTrackIds.size());
+      }
+      mTrackIds.push_back(trackId);
+    }
+    mOffsets.push_back(mTrackIds.size());
+    mEntries.clear();
+  }
+
+  std::size_t size() const { return mBCs.size(); }
+  uint64_t bc(std::size_t i) const { return mBCs[i]; }
+  std::vector<int32_t> tracks(std::size_t i) const { return {mTrackIds.begin() + mOffsets[i], mTrackIds.begin() + mOffsets[i + 1]}; }
+
+ private:
+  std::vector<std::pair<uint64_t, int32_t>> mEntries; // added tracks, not yet grouped
+  std::vector<uint64_t> mBCs;
+  std::vector<std::size_t> mOffsets;
+  std::vector<int32_t> mTrackIds;
+};
+
 // -----------------------------------------------------------------------------
 // check if all tracks come from same MCCollision
 template <typename T>
@@ -68,7 +68,7 @@ struct tracksWGTInBCs {
     int rnum = bcs.iteratorAt(0).runNumber();
 
     // container to sort tracks with good timing according to their matching/closest BC
-    std::map<uint64_t, std::vector<int32_t>> tracksInBCList{};
+    udhelpers::TracksPerBC tracksInBCList;
     uint64_t closestBC = 0;
 
     // loop over all tracks and fill tracksInBCList
@@ -116,30 +116,33 @@ struct tracksWGTInBCs {
 
         // update tracksInBCList
         LOGF(debug, "Updating tracksInBCList with %d", closestBC);
-        tracksInBCList[closestBC].emplace_back((int32_t)track.globalIndex());
+        tracksInBCList.add(closestBC, (int32_t)track.globalIndex());
       }
     }
+    tracksInBCList.build();
 
     // fill tracksWGTInBCs
     int indBCToStart = 0;
     int indBCToSave;
-    for (auto const& tracksInBC : tracksInBCList) {
-      LOGF(debug, "tracksInBC.first %d", tracksInBC.first);
+    for (std::size_t iBC = 0; iBC < tracksInBCList.size(); iBC++) {
+      auto bcnum = tracksInBCList.bc(iBC);
+      auto tracksInBC = tracksInBCList.tracks(iBC);
+      LOGF(debug, "bcnum %d", bcnum);
       indBCToSave = -1;
       // find corresponding BC
       for (auto ind = indBCToStart; ind < bcs.size(); ind++) {
         auto bc = bcs.rawIteratorAt(ind);
-        if (bc.globalBC() == tracksInBC.first) {
+        if (bc.globalBC() == bcnum) {
           indBCToSave = ind;
           indBCToStart = ind;
           break;
         }
-        if (bc.globalBC() > tracksInBC.first) {
+        if (bc.globalBC() > bcnum) {
           break;
         }
       }
-      LOGF(debug, " BC %i/%u with %i tracks with good timing", indBCToSave, tracksInBC.first, tracksInBC.second.size());
-      tracksWGTInBCs(indBCToSave, rnum, tracksInBC.first, tracksInBC.second);
+      LOGF(debug, " BC %i/%u with %i tracks with good timing", indBCToSave, bcnum, tracksInBC.size());
+      tracksWGTInBCs(indBCToSave, rnum, bcnum, tracksInBC);
     }
     LOGF(debug, "barrel done");
   }
@@ -157,7 +160,7 @@ struct tracksWGTInBCs {
     int rnum = bcs.iteratorAt(0).runNumber();
 
     // container to sort forward tracks according to their matching/closest BC
-    std::map<uint64_t, std::vector<int32_t>> fwdTracksInBCList{};
+    udhelpers::TracksPerBC fwdTracksInBCList;
     uint64_t closestBC = 0;
 
     // loop over all forward tracks and fill fwdTracksInBCList
@@ -200,29 +203,32 @@ struct tracksWGTInBCs {
 
         // update tracksInBCList
         LOGF(debug, "Updating fwdTracksInBCList with %d", closestBC);
-        fwdTracksInBCList[closestBC].emplace_back((int32_t)fwdTrack.globalIndex());
+        fwdTracksInBCList.add(closestBC, (int32_t)fwdTrack.globalIndex());
       }
     }
+    fwdTracksInBCList.build();
 
     // fill fwdTracksWGTInBCs
     int indBCToStart = 0;
     int indBCToSave;
-    for (auto const& fwdTracksInBC : fwdTracksInBCList) {
+    for (std::size_t iBC = 0; iBC < fwdTracksInBCList.size(); iBC++) {
+      auto bcnum = fwdTracksInBCList.bc(iBC);
+      auto fwdTracksInBC = fwdTracksInBCList.tracks(iBC);
       indBCToSave = -1;
       // find corresponding BC
       for (auto ind = indBCToStart; ind < bcs.size(); ind++) {
         auto bc = bcs.rawIteratorAt(ind);
-        if (bc.globalBC() == fwdTracksInBC.first) {
+        if (bc.globalBC() == bcnum) {
           indBCToSave = ind;
           indBCToStart = ind;
           break;
         }
-        if (bc.globalBC() > fwdTracksInBC.first) {
+        if (bc.globalBC() > bcnum) {
           break;
         }
       }
-      fwdTracksWGTInBCs(indBCToSave, rnum, fwdTracksInBC.first, fwdTracksInBC.second);
-      LOGF(debug, " BC %i/%u with %i forward tracks with good timing", indBCToSave, fwdTracksInBC.first, fwdTracksInBC.second.size());
+      fwdTracksWGTInBCs(indBCToSave, rnum, bcnum, fwdTracksInBC);
+      LOGF(debug, " BC %i/%u with %i forward tracks with good timing", indBCToSave, bcnum, fwdTracksInBC.size());
     }
     LOGF(debug, "forward done");
   }
@@ -257,6 +263,9 @@ struct DGBCCandProducer {
   // DG selector
   DGSelector dgSelector;
 
+  // FIT activity of the BCs, built once per time frame
+  udhelpers::BCActivityIndex bcActivity;
+
   HistogramRegistry registry{
     "registry",
     {}};
@@ -377,6 +386,10 @@ struct DGBCCandProducer {
                      TCs const& tracks, aod::FwdTracks const& fwdtracks, FTIBCs const& ftibcs,
                      aod::Zdcs const& /*zdcs*/, aod::FT0s const& ft0s, aod::FV0As const& fv0as, aod::FDDs const& fdds)
   {
+    if (!bcActivity.isBuiltFor(bcs)) {
+      bcActivity.build(bcs, diffCuts.maxFITtime(), diffCuts.FITAmpLimits());
+    }
+
     // fill FITInfo
     auto bcnum = tibc.bcnum();
     upchelpers::FITInfo fitInfo{};
@@ -408,7 +421,7 @@ struct DGBCCandProducer {
         auto colTracks = tracks.sliceByCached(aod::track::collisionId, col.globalIndex(), cache);
         auto colFwdTracks = fwdtracks.sliceByCached(aod::fwdtrack::collisionId, col.globalIndex(), cache);
         auto bcRange = udhelpers::compatibleBCs(col, diffCuts.NDtcoll(), bcs, diffCuts.minNBCs());
-        isDG = dgSelector.IsSelected(diffCuts, col, bcRange, colTracks, colFwdTracks);
+        isDG = dgSelector.IsSelected(diffCuts, col, bcRange, colTracks, colFwdTracks, &bcActivity);
 
         // update UDTables, case 1.
         if (isDG == 0) {
@@ -432,14 +445,14 @@ struct DGBCCandProducer {
           if (ftibcSlice.size() > 0) {
             ftibcSlice.bindExternalIndices(&fwdtracks);
             auto fwdTracksArray = ftibcSlice.begin().fwdtrack_as<FTCs>();
-            isDG = dgSelector.IsSelected(diffCuts, bcRange, tracksArray, fwdTracksArray);
+            isDG = dgSelector.IsSelected(diffCuts, bcRange, tracksArray, fwdTracksArray, &bcActivity);
           } else {
             auto fwdTracksArray = FTCs{{fwdtracks.asArrowTable()->Slice(0, 0)}, (uint64_t)0};
-            isDG = dgSelector.IsSelected(diffCuts, bcRange, tracksArray, fwdTracksArray);
+            isDG = dgSelector.IsSelected(diffCuts, bcRange, tracksArray, fwdTracksArray, &bcActivity);
           }
         } else {
           auto fwdTracksArray = FTCs{{fwdtracks.asArrowTable()->Slice(0, 0)}, (uint64_t)0};
-          isDG = dgSelector.IsSelected(diffCuts, bcRange, tracksArray, fwdTracksArray);
+          isDG = dgSelector.IsSelected(diffCuts, bcRange, tracksArray, fwdTracksArray, &bcActivity);
         }
 
         // update UDTables, case 2.
@@ -478,14 +491,14 @@ struct DGBCCandProducer {
         if (ftibcPart.size() > 0) {
           ftibcPart.bindExternalIndices(&fwdtracks);
           auto fwdTracksArray = ftibcPart.begin().fwdtrack_as<FTCs>();
-          isDG = dgSelector.IsSelected(diffCuts, bcRange, tracksArray, fwdTracksArray);
+          isDG = dgSelector.IsSelected(diffCuts, bcRange, tracksArray, fwdTracksArray, &bcActivity);
         } else {
           auto fwdTracksArray = FTCs{{fwdtracks.asArrowTable()->Slice(0, 0)}, (uint64_t)0};
-          isDG = dgSelector.IsSelected(diffCuts, bcRange, tracksArray, fwdTracksArray);
+          isDG = dgSelector.IsSelected(diffCuts, bcRange, tracksArray, fwdTracksArray, &bcActivity);
         }
       } else {
         auto fwdTracksArray = FTCs{{fwdtracks.asArrowTable()->Slice(0, 0)}, (uint64_t)0};
-        isDG = dgSelector.IsSelected(diffCuts, bcRange, tracksArray, fwdTracksArray);
+        isDG = dgSelector.IsSelected(diffCuts, bcRange, tracksArray, fwdTracksArray, &bcActivity);
       }
 
       // update UDTables, case 3.
@@ -534,6 +547,9 @@ struct DGBCCandProducer {
     if (bcs.size() <= 0) {
       return;
     }
+    if (!bcActivity.isBuiltFor(bcs)) {
+      bcActivity.build(bcs, diffCuts.maxFITtime(), diffCuts.FITAmpLimits());
+    }
 
     // run over all BC in bcs and tibcs
     // int64_t lastCollision = 0;
@@ -602,7 +618,7 @@ struct DGBCCandProducer {
           auto bcRange = udhelpers::compatibleBCs(bc, bcnum, diffCuts.minNBCs(), bcs);
           auto colTracks = tracks.sliceByCached(aod::track::collisionId, col.globalIndex(), cache);
           auto colFwdTracks = fwdtracks.sliceByCached(aod::fwdtrack::collisionId, col.globalIndex(), cache);
-          isDG1 = dgSelector.IsSelected(diffCuts, col, bcRange, colTracks, colFwdTracks);
+          isDG1 = dgSelector.IsSelected(diffCuts, col, bcRange, colTracks, colFwdTracks, &bcActivity);
           LOGF(debug, "  isDG1 %d with %d tracks", isDG1, ntr1);
           if (isDG1 == 0) {
             // this is a DG candidate with proper collision vertex
@@ -643,14 +659,14 @@ struct DGBCCandProducer {
             }
             if (ftibc.bcnum() == bcnum) {
               auto fwdTracksArray = ftibc.fwdtrack_as<FTCs>();
-              isDG2 = dgSelector.IsSelected(diffCuts, bcRange, tracksArray, fwdTracksArray);
+              isDG2 = dgSelector.IsSelected(diffCuts, bcRange, tracksArray, fwdTracksArray, &bcActivity);
             } else {
               auto fwdTracksArray = FTCs{{fwdtracks.asArrowTable()->Slice(0, 0)}, (uint64_t)0};
-              isDG2 = dgSelector.IsSelected(diffCuts, bcRange, tracksArray, fwdTracksArray);
+              isDG2 = dgSelector.IsSelected(diffCuts, bcRange, tracksArray, fwdTracksArray, &bcActivity);
             }
           } else {
             auto fwdTracksArray = FTCs{{fwdtracks.asArrowTable()->Slice(0, 0)}, (uint64_t)0};
-            isDG2 = dgSelector.IsSelected(diffCuts, bcRange, tracksArray, fwdTracksArray);
+            isDG2 = dgSelector.IsSelected(diffCuts, bcRange, tracksArray, fwdTracksArray, &bcActivity);
           }
 
           LOGF(debug, "  isDG2 %d with %d tracks", isDG2, ntr2);
@@ -41,6 +41,9 @@ struct SGCandProducer {
   //  SG selector
   SGSelector sgSelector;
 
+  // FIT activity of the BCs, built once per time frame
+  udhelpers::BCActivityIndex bcActivity;
+
   // data tables
   Produces<aod::SGCollisions> outputSGCollisions;
   Produces<aod::UDCollisions> outputCollisions;
@@ -191,8 +194,11 @@ struct SGCandProducer {
     auto newbc = bc;
 
     // obtain slice of compatible BCs
+    if (!bcActivity.isBuiltFor(bcs)) {
+      bcActivity.build(bcs, sameCuts.maxFITtime(), sameCuts.FITAmpLimits());
+    }
     auto bcRange = udhelpers::compatibleBCs(collision, sameCuts.NDtcoll(), bcs, sameCuts.minNBCs());
-    auto isSGEvent = sgSelector.IsSelected(sameCuts, collision, bcRange, bc);
+    auto isSGEvent = sgSelector.IsSelected(sameCuts, collision, bcRange, bc, &bcActivity);
     // auto isSGEvent = sgSelector.IsSelected(sameCuts, collision, bcRange, tracks);
     int issgevent = isSGEvent.value;
     if (isSGEvent.bc) {
@@ -23,8 +23,12 @@
 #include <onnxruntime_cxx_api.h>
 #endif
 
+#include <algorithm>
 #include <map>
+#include <span>
 #include <string>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 #include "CCDB/CcdbApi.h"
@@ -74,6 +78,8 @@ class MlResponse
     mNModels = binsLimits.size() - 1;
     mModels = std::vector<o2::ml::OnnxModel>(mNModels);
     mPaths = std::vector<std::string>(mNModels);
+    mBatchInputs = std::vector<std::vector<TypeOutputScore>>(mNModels);
+    mBatchNRows = std::vector<int>(mNModels, 0);
   }
 
   /// Set model paths to CCDB
@@ -129,6 +135,11 @@ class MlResponse
     uint8_t counterModel{0};
     for (const auto& path : mPaths) {
       mModels[counterModel].initModel(path, enableOptimizations, threads);
+      if constexpr (std::is_same_v<TypeOutputScore, float>) {
+        if (mModels[counterModel].hasFixedOutputRowSize()) {
+          mModels[counterModel].initBinding(1); // single candidates are evaluated with a persistent binding
+        }
+      }
       ++counterModel;
     }
   }
@@ -158,7 +169,24 @@ class MlResponse
       LOG(fatal) << "Model index " << nModel << " is out of range! The number of initialised models is " << mModels.size() << ". Please check your configurables.";
     }
 
+    if constexpr (std::is_same_v<TypeOutputScore, float>) {
+      if (mModels[nModel].hasBinding()) {
+        auto bindingInput = mModels[nModel].getBindingInput(1);
+        if (input.size() != bindingInput.size()) {
+          LOG(fatal) << "Number of input features (" << input.size() << ") different from the number of model inputs (" << bindingInput.size() << ")! Please check your configurables.";
+        }
+        std::copy(input.begin(), input.end(), bindingInput.begin());
+        auto output = mModels[nModel].evalBinding();
+        if (output.size() < mNClasses) {
+          LOG(fatal) << "Number of model outputs (" << output.size() << ") smaller than the number of classes (" << static_cast<int>(mNClasses) << ")! Please check your configurables.";
+        }
+        return std::vector<TypeOutputScore>{output.begin(), output.begin() + mNClasses};
+      }
+    }
     TypeOutputScore* outputPtr = mModels[nModel].evalModel(input);
+    if (outputPtr == nullptr) {
+      LOG(fatal) << "Evaluation of the model " << nModel << " failed!";
+    }
     return std::vector<TypeOutputScore>{outputPtr, outputPtr + mNClasses};
   }
 
@@ -213,16 +241,114 @@ class MlResponse
     return true;
   }
 
+  /// Deferred batch inference, step 1: store the input features of a candidate in the contiguous buffer of its bin
+  /// \param input is the input features
+  /// \param candVar is the variable value (e.g. pT) used to select which model to use
+  /// \return position of the candidate in the batch, to be used to access the scores after evaluateBatch()
+  template <typename T1, typename T2>
+  int enqueueMl(const T1& input, const T2& candVar)
+  {
+    int nModel = findBin(candVar);
+    if (nModel < 0 || static_cast<std::size_t>(nModel) >= mModels.size()) {
+      LOG(fatal) << "Model index " << nModel << " is out of range! The number of initialised models is " << mModels.size() << ". Please check your configurables.";
+    }
+    mBatchInputs[nModel].insert(mBatchInputs[nModel].end(), input.begin(), input.end());
+    mBatchEntries.emplace_back(nModel, mBatchNRows[nModel]++);
+    return mBatchEntries.size() - 1;
+  }
+
+  /// Deferred batch inference, step 2: evaluate all the enqueued candidates with one model call per bin
+  /// \return model predictions for each class, nClasses consecutive values per candidate in the enqueue order
+  /// \note The batch is emptied, the returned scores stay valid until the next call
+  /// \note The models must accept a variable number of rows (dynamic batch dimension) and have a fixed number of outputs per row
+  std::span<const TypeOutputScore> evaluateBatch()
+  {
+    mBatchOutputsPerModel.resize(mNModels);
+    for (auto iModel{0}; iModel < mNModels; ++iModel) {
+      if (mBatchNRows[iModel] == 0) {
+        mBatchOutputsPerModel[iModel].clear();
+        continue;
+      }
+      if (!mModels[iModel].hasFixedOutputRowSize()) {
+        LOG(fatal) << "The model " << iModel << " has no fixed number of outputs per row, it cannot be evaluated in batches! Please use isSelectedMl.";
+      }
+      mBatchOutputsPerModel[iModel].resize(static_cast<std::size_t>(mBatchNRows[iModel]) * mModels[iModel].getNumOutputValuesPerRow());
+      if (!mModels[iModel].evalModel(std::span<const TypeOutputScore>{mBatchInputs[iModel]}, std::span<TypeOutputScore>{mBatchOutputsPerModel[iModel]})) {
+        LOG(fatal) << "Evaluation of the model " << iModel << " failed for a batch of " << mBatchNRows[iModel] << " candidates! The models must accept a variable number of rows.";
+      }
+    }
+    mBatchOutput.resize(mBatchEntries.size() * mNClasses);
+    mBatchEvaluatedModels.resize(mBatchEntries.size());
+    auto itOutput = mBatchOutput.begin();
+    auto itEvaluatedModel = mBatchEvaluatedModels.begin();
+    for (const auto& [nModel, iRow] : mBatchEntries) {
+      auto itModelOutput = mBatchOutputsPerModel[nModel].begin() + static_cast<std::size_t>(iRow) * mModels[nModel].getNumOutputValuesPerRow();
+      itOutput = std::copy(itModelOutput, itModelOutput + mNClasses, itOutput);
+      *itEvaluatedModel++ = nModel;
+    }
+    clearBatch();
+    return mBatchOutput;
+  }
+
+  /// Get the model predictions of an evaluated candidate
+  /// \param iCandidate is the position of the candidate in the batch returned by enqueueMl
+  /// \return model prediction for each class
+  std::span<const TypeOutputScore> getBatchOutput(int iCandidate) const
+  {
+    return std::span<const TypeOutputScore>{mBatchOutput}.subspan(static_cast<std::size_t>(iCandidate) * mNClasses, mNClasses);
+  }
+
+  /// ML selections of an evaluated candidate
+  /// \param iCandidate is the position of the candidate in the batch returned by enqueueMl
+  /// \param output is a container to be filled with model output
+  /// \return boolean telling if model predictions pass the cuts
+  bool isSelectedMlBatch(int iCandidate, std::vector<TypeOutputScore>& output)
+  {
+    auto scores = getBatchOutput(iCandidate);
+    output.assign(scores.begin(), scores.end());
+    int nModel = mBatchEvaluatedModels[iCandidate];
+    uint8_t iClass{0};
+    for (const auto& outputValue : output) {
+      uint8_t dir = mCutDir.at(iClass);
+      if (dir != o2::cuts_ml::CutDirection::CutNot) {
+        if (dir == o2::cuts_ml::CutDirection::CutGreater && outputValue > mCuts.get(nModel, iClass)) {
+          return false;
+        }
+        if (dir == o2::cuts_ml::CutDirection::CutSmaller && outputValue < mCuts.get(nModel, iClass)) {
+          return false;
+        }
+      }
+      ++iClass;
+    }
+    return true;
+  }
+
+  /// Drop the enqueued candidates without evaluating them
+  void clearBatch()
+  {
+    for (auto& input : mBatchInputs) {
+      input.clear();
+    }
+    std::fill(mBatchNRows.begin(), mBatchNRows.end(), 0);
+    mBatchEntries.clear();
+  }
+
  protected:
-  std::vector<o2::ml::OnnxModel> mModels;                 // OnnxModel objects, one for each bin
-  uint8_t mNModels = 1;                                   // number of bins
-  uint8_t mNClasses = 3;                                  // number of model classes
-  std::vector<double> mBinsLimits = {};                   // bin limits of the variable (e.g. pT) used to select which model to use
-  std::vector<std::string> mPaths = {""};                 // paths to the models, one for each bin
-  std::vector<int> mCutDir = {};                          // direction of the cuts on the model scores (no cut is also supported)
-  o2::framework::LabeledArray<double> mCuts = {};         // array of cut values to apply on the model scores
-  std::map<std::string, uint8_t> mAvailableInputFeatures; // map of available input features
-  std::vector<uint8_t> mCachedIndices;                    // vector of index correspondance between configurables and available input features
+  std::vector<o2::ml::OnnxModel> mModels;                          // OnnxModel objects, one for each bin
+  uint8_t mNModels = 1;                                            // number of bins
+  uint8_t mNClasses = 3;                                           // number of model classes
+  std::vector<double> mBinsLimits = {};                            // bin limits of the variable (e.g. pT) used to select which model to use
+  std::vector<std::string> mPaths = {""};                          // paths to the models, one for each bin
+  std::vector<int> mCutDir = {};                                   // direction of the cuts on the model scores (no cut is also supported)
+  o2::framework::LabeledArray<double> mCuts = {};                  // array of cut values to apply on the model scores
+  std::map<std::string, uint8_t> mAvailableInputFeatures;          // map of available input features
+  std::vector<uint8_t> mCachedIndices;                             // vector of index correspondance between configurables and available input features
+  std::vector<std::vector<TypeOutputScore>> mBatchInputs;          // input features of the enqueued candidates, one contiguous buffer for each bin
+  std::vector<int> mBatchNRows;                                    // number of enqueued candidates in each bin
+  std::vector<std::pair<int, int>> mBatchEntries;                  // bin and row in the bin of each enqueued candidate
+  std::vector<std::vector<TypeOutputScore>> mBatchOutputsPerModel; // model predictions of the last batch, one buffer for each bin
+  std::vector<TypeOutputScore> mBatchOutput;                       // model predictions of the last batch, in the enqueue order
+  std::vector<int> mBatchEvaluatedModels;                          // bin of each candidate of the last batch
 
   virtual void setAvailableInputFeatures() { return; } // method to fill the map of available input features
 
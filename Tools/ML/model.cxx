@@ -87,6 +87,10 @@ void OnnxModel::initModel(std::string localPath, bool enableOptimizations, int t
   mOutputNames = mSession->GetOutputNames();
   mOutputShapes = mSession->GetOutputShapes();
 #else
+  mInputNames.clear();
+  mInputShapes.clear();
+  mOutputNames.clear();
+  mOutputShapes.clear();
   Ort::AllocatorWithDefaultOptions tmpAllocator;
   for (size_t i = 0; i < mSession->GetInputCount(); ++i) {
     mInputNames.push_back(mSession->GetInputNameAllocated(i, tmpAllocator).get());
@@ -101,6 +105,25 @@ void OnnxModel::initModel(std::string localPath, bool enableOptimizations, int t
     mOutputShapes.emplace_back(mSession->GetOutputTypeInfo(i).GetTensorTypeAndShapeInfo().GetShape());
   }
 #endif
+  mInputNamesChar.resize(mInputNames.size());
+  std::transform(std::begin(mInputNames), std::end(mInputNames), std::begin(mInputNamesChar),
+                 [&](const std::string& str) { return str.c_str(); });
+  mOutputNamesChar.resize(mOutputNames.size());
+  std::transform(std::begin(mOutputNames), std::end(mOutputNames), std::begin(mOutputNamesChar),
+                 [&](const std::string& str) { return str.c_str(); });
+  mNumOutputValuesPerRow = 1;
+  for (size_t i = 1; i < mOutputShapes.back().size(); i++) {
+    if (mOutputShapes.back()[i] <= 0) {
+      mNumOutputValuesPerRow = -1; // dynamic dimension, only known after the evaluation
+      break;
+    }
+    mNumOutputValuesPerRow *= mOutputShapes.back()[i];
+  }
+  mMemoryInfo = Ort::MemoryInfo::CreateCpu(OrtAllocatorType::OrtArenaAllocator, OrtMemType::OrtMemTypeDefault);
+  mOutputTensors.clear();
+  mIoBinding.reset();
+  mBindingRows = 0;
+
   LOG(info) << "Input Nodes:";
   for (size_t i = 0; i < mInputNames.size(); i++) {
     LOG(info) << "\t" << mInputNames[i] << " : " << printShape(mInputShapes[i]);
@@ -119,6 +142,49 @@ void OnnxModel::initModel(std::string localPath, bool enableOptimizations, int t
   LOG(info) << "--- Model initialized! ---";
 }
 
+void OnnxModel::initBinding(int64_t maxBatchSize)
+{
+  if (!hasFixedOutputRowSize()) {
+    LOG(fatal) << "The persistent binding requires a fixed number of output values per row, the last output of the model has the shape " << printShape(mOutputShapes.back()) << "! Use evalModel(std::vector<T>&) instead.";
+  }
+  mBindingMaxRows = maxBatchSize;
+  mBindingInput.resize(maxBatchSize * mInputShapes[0][1]);
+  mBindingOutput.resize(maxBatchSize * mNumOutputValuesPerRow);
+  mIoBinding = std::make_unique<Ort::IoBinding>(*mSession);
+  mBindingRows = 0;
+}
+
+std::span<float> OnnxModel::getBindingInput(int64_t nRows)
+{
+  if (!mIoBinding || nRows > mBindingMaxRows) {
+    LOG(fatal) << "Binding of " << nRows << " rows requested, but only " << mBindingMaxRows << " rows are allocated! Call initBinding first.";
+  }
+  if (nRows != mBindingRows) {
+    const std::array<int64_t, 2> inputShape{nRows, mInputShapes[0][1]};
+    const std::array<int64_t, 2> outputShape{nRows, mNumOutputValuesPerRow};
+    mIoBinding->ClearBoundInputs();
+    mIoBinding->ClearBoundOutputs();
+    mIoBinding->BindInput(mInputNamesChar[0], Ort::Value::CreateTensor<float>(mMemoryInfo, mBindingInput.data(), nRows * mInputShapes[0][1], inputShape.data(), inputShape.size()));
+    for (size_t i = 0; i + 1 < mOutputNamesChar.size(); i++) {
+      mIoBinding->BindOutput(mOutputNamesChar[i], mMemoryInfo); // outputs not returned to the caller are allocated by ONNX Runtime
+    }
+    mIoBinding->BindOutput(mOutputNamesChar.back(), Ort::Value::CreateTensor<float>(mMemoryInfo, mBindingOutput.data(), nRows * mNumOutputValuesPerRow, outputShape.data(), mOutputShapes.back().size() > 1 ? 2 : 1));
+    mBindingRows = nRows;
+  }
+  return {mBindingInput.data(), static_cast<size_t>(nRows * mInputShapes[0][1])};
+}
+
+std::span<const float> OnnxModel::evalBinding()
+{
+  try {
+    Ort::RunOptions runOptions;
+    mSession->Ort::Session::Run(runOptions, *mIoBinding);
+  } catch (const Ort::Exception& exception) {
+    LOG(fatal) << "Error running model inference: " << exception.what();
+  }
+  return {mBindingOutput.data(), static_cast<size_t>(mBindingRows * mNumOutputValuesPerRow)};
+}
+
 void OnnxModel::setActiveThreads(int threads)
 {
   activeThreads = threads;
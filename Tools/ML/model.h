@@ -31,6 +31,8 @@
 #include <memory>
 #include <map>
 #include <algorithm>
+#include <array>
+#include <span>
 
 // ROOT includes
 #include "TSystem.h"
@@ -66,14 +68,7 @@ class OnnxModel
       auto outputTensors = mSession->Run(mInputNames, input, mOutputNames);
 #else
       Ort::RunOptions runOptions;
-      std::vector<const char*> inputNamesChar(mInputNames.size(), nullptr);
-      std::transform(std::begin(mInputNames), std::end(mInputNames), std::begin(inputNamesChar),
-                     [&](const std::string& str) { return str.c_str(); });
-
-      std::vector<const char*> outputNamesChar(mOutputNames.size(), nullptr);
-      std::transform(std::begin(mOutputNames), std::end(mOutputNames), std::begin(outputNamesChar),
-                     [&](const std::string& str) { return str.c_str(); });
-      auto outputTensors = mSession->Run(runOptions, inputNamesChar.data(), input.data(), input.size(), outputNamesChar.data(), outputNamesChar.size());
+      auto outputTensors = mSession->Run(runOptions, mInputNamesChar.data(), input.data(), input.size(), mOutputNamesChar.data(), mOutputNamesChar.size());
 #endif
       LOG(debug) << "Number of output tensors: " << outputTensors.size();
       if (outputTensors.size() != mOutputNames.size()) {
@@ -85,7 +80,9 @@ class OnnxModel
           LOG(fatal) << "Shape of tensor " << i << " does not agree with model specification! Output: " << printShape(outputTensors[i].GetTensorTypeAndShapeInfo().GetShape()) << " model: " << printShape(mOutputShapes[i]);
         }
       }
-      T* outputValues = outputTensors.back().GetTensorMutableData<T>();
+      // the output tensors are kept until the next evaluation, so that the returned pointer stays valid
+      mOutputTensors = std::move(outputTensors);
+      T* outputValues = mOutputTensors.back().template GetTensorMutableData<T>();
       return outputValues;
     } catch (const Ort::Exception& exception) {
       LOG(error) << "Error running model inference: " << exception.what();
@@ -103,14 +100,63 @@ class OnnxModel
 #if __has_include(<onnxruntime/core/session/onnxruntime_cxx_api.h>)
     inputTensors.emplace_back(Ort::Experimental::Value::CreateTensor<T>(input.data(), size, inputShape));
 #else
-    Ort::MemoryInfo mem_info =
-      Ort::MemoryInfo::CreateCpu(OrtAllocatorType::OrtArenaAllocator, OrtMemType::OrtMemTypeDefault);
-    inputTensors.emplace_back(Ort::Value::CreateTensor<T>(mem_info, input.data(), size, inputShape.data(), inputShape.size()));
+    inputTensors.emplace_back(Ort::Value::CreateTensor<T>(mMemoryInfo, input.data(), size, inputShape.data(), inputShape.size()));
 #endif
     LOG(debug) << "Input shape calculated from vector: " << printShape(inputShape);
     return evalModel<T>(inputTensors);
   }
 
+  /// Zero-copy evaluation: the input and the last output of the model are wrapped around the caller-owned buffers.
+  /// No state of the model is modified, so several threads can evaluate the same model concurrently.
+  /// \param input is the input features, getNumInputNodes() values per row
+  /// \param output is filled with the last output of the model, getNumOutputValuesPerRow() values per row
+  /// \return true if the evaluation succeeded
+  /// \note The last output must have a fixed number of values per row, see hasFixedOutputRowSize()
+  template <typename T>
+  bool evalModel(std::span<const T> input, std::span<T> output)
+  {
+    if (!hasFixedOutputRowSize()) {
+      LOG(fatal) << "The zero-copy evaluation requires a fixed number of output values per row, the last output of the model has the shape " << printShape(mOutputShapes.back()) << "! Use evalModel(std::vector<T>&) instead.";
+    }
+    const int64_t nRows = input.size() / mInputShapes[0][1];
+    if (static_cast<int64_t>(input.size()) != nRows * mInputShapes[0][1] || static_cast<int64_t>(output.size()) < nRows * mNumOutputValuesPerRow) {
+      LOG(fatal) << "Buffers of size " << input.size() << " and " << output.size() << " do not match the model with " << mInputShapes[0][1] << " input nodes and " << mNumOutputValuesPerRow << " output values per row";
+    }
+    const std::array<int64_t, 2> inputShape{nRows, mInputShapes[0][1]};
+    const std::array<int64_t, 2> outputShape{nRows, mNumOutputValuesPerRow};
+    // ONNX Runtime does not write to the input tensors
+    auto inputTensor = Ort::Value::CreateTensor<T>(mMemoryInfo, const_cast<T*>(input.data()), input.size(), inputShape.data(), inputShape.size());
+    auto outputTensor = Ort::Value::CreateTensor<T>(mMemoryInfo, output.data(), nRows * mNumOutputValuesPerRow, outputShape.data(), mOutputShapes.back().size() > 1 ? 2 : 1);
+    try {
+      Ort::RunOptions runOptions;
+      mSession->Ort::Session::Run(runOptions, mInputNamesChar.data(), &inputTensor, 1, &mOutputNamesChar.back(), &outputTensor, 1);
+    } catch (const Ort::Exception& exception) {
+      LOG(error) << "Error running model inference: " << exception.what();
+      return false;
+    }
+    return true;
+  }
+
+  /// Persistent binding: allocates the input and output buffers for up to maxBatchSize rows once,
+  /// they are then bound to the session with Ort::IoBinding and reused by every evalBinding call
+  /// \param maxBatchSize is the maximum number of rows evaluated at once
+  /// \note The last output must have a fixed number of values per row, see hasFixedOutputRowSize()
+  void initBinding(int64_t maxBatchSize);
+
+  /// \return true if initBinding was called
+  bool hasBinding() const { return mIoBinding != nullptr; }
+
+  /// Persistent binding: input buffer to be filled before evalBinding
+  /// \param nRows is the number of rows to evaluate, at most the maximum batch size given to initBinding
+  /// \return input buffer, getNumInputNodes() values per row
+  std::span<float> getBindingInput(int64_t nRows);
+
+  /// Persistent binding: evaluates the rows of the input buffer, the tensors are rebound only if the number of rows changes
+  /// \return last output of the model, getNumOutputValuesPerRow() values per row, valid until the next evaluation
+  /// \note A failure of the inference is fatal
+  /// \note Not thread safe, use the zero-copy evalModel to share the model between threads
+  std::span<const float> evalBinding();
+
   // Reset session
 #if __has_include(<onnxruntime/core/session/onnxruntime_cxx_api.h>)
   void resetSession() { mSession.reset(new Ort::Experimental::Session{*mEnv, modelPath, sessionOptions}); }
@@ -133,6 +179,8 @@ class OnnxModel
 #endif
   int getNumInputNodes() const { return mInputShapes[0][1]; }
   int getNumOutputNodes() const { return mOutputShapes[0][1]; }
+  int64_t getNumOutputValuesPerRow() const { return mNumOutputValuesPerRow; } // -1 if not fixed by the model
+  bool hasFixedOutputRowSize() const { return mNumOutputValuesPerRow > 0; }
   uint64_t getValidityFrom() const { return validFrom; }
   uint64_t getValidityUntil() const { return validUntil; }
   void setActiveThreads(int);
@@ -152,6 +200,18 @@ class OnnxModel
   std::vector<std::vector<int64_t>> mInputShapes;
   std::vector<std::string> mOutputNames;
   std::vector<std::vector<int64_t>> mOutputShapes;
+  std::vector<const char*> mInputNamesChar;  // names as C strings, cached at initialisation
+  std::vector<const char*> mOutputNamesChar; // names as C strings, cached at initialisation
+  int64_t mNumOutputValuesPerRow = 1;        // number of values per row in the last output, -1 for a dynamic dimension
+  Ort::MemoryInfo mMemoryInfo{nullptr};
+  std::vector<Ort::Value> mOutputTensors; // output tensors of the last evalModel call
+
+  // Persistent binding
+  std::unique_ptr<Ort::IoBinding> mIoBinding = nullptr;
+  std::vector<float> mBindingInput;
+  std::vector<float> mBindingOutput;
+  int64_t mBindingMaxRows = 0;
+  int64_t mBindingRows = 0; // number of rows of the currently bound tensors, 0 if not bound
 
   // Environment settings
   std::string modelPath;